@@ -0,0 +1,101 @@
+'''
+Learns a PCA basis of the 52 ARKit blendshapes for 'pcabasis'/'pca' packets (see source/net/facepipe_pca.h).
+
+The input are recordings written by FacePipe with RECORD_BLENDSHAPES (source/main.cpp), 52 float32 values per frame
+in ARKit order. The covariance is accumulated in parallel over chunks of all recordings and the partial results are
+merged pairwise, so long captures never have to be held in memory at once.
+
+    python external/blendshape_pca.py content/expression_basis.bin binaries/blendshapes.f32 [more.f32 ...] [--components 12]
+
+The output file is the binary content of an ExpressionBasis packet, mediapipe_landmarker_udp.py sends it as is
+when expression_basis_file points to it.
+'''
+
+import argparse
+import os
+import struct
+from concurrent.futures import ProcessPoolExecutor
+
+import numpy as np
+
+CHANNEL_COUNT = 52 # ARKitBlendshapeCount in facepipe_blendshapes.h
+CHUNK_FRAMES = 1 << 16
+
+def fnv1a(data):
+    h = 2166136261
+    for b in data:
+        h = ((h ^ b) * 16777619) & 0xFFFFFFFF
+    return h
+
+def accumulate(path, start, stop):
+    # count, mean and scatter matrix (sum of outer products of the centered frames) of one chunk
+    frames = np.memmap(path, dtype='<f4', mode='r').reshape(-1, CHANNEL_COUNT)[start:stop].astype(np.float64)
+    mean = frames.mean(axis=0)
+    centered = frames - mean
+    return len(frames), mean, centered.T @ centered
+
+def merge(a, b):
+    # Chan et al. pairwise update, exact for any split of the frames
+    (count_a, mean_a, scatter_a), (count_b, mean_b, scatter_b) = a, b
+    count = count_a + count_b
+    delta = mean_b - mean_a
+    mean = mean_a + delta * (count_b / count)
+    scatter = scatter_a + scatter_b + np.outer(delta, delta) * (count_a * count_b / count)
+    return count, mean, scatter
+
+def chunks(paths):
+    for path in paths:
+        frame_count = os.path.getsize(path) // (4 * CHANNEL_COUNT)
+        for start in range(0, frame_count, CHUNK_FRAMES):
+            yield path, start, min(start + CHUNK_FRAMES, frame_count)
+
+def main():
+    parser = argparse.ArgumentParser(description='Learns a PCA basis of recorded ARKit blendshapes')
+    parser.add_argument('output')
+    parser.add_argument('recordings', nargs='+')
+    parser.add_argument('--components', type=int, default=12)
+    args = parser.parse_args()
+
+    if not 1 <= args.components <= CHANNEL_COUNT:
+        parser.error(f'--components must be 1-{CHANNEL_COUNT}')
+
+    work = list(chunks(args.recordings))
+    if not work:
+        parser.error('the recordings are empty')
+
+    with ProcessPoolExecutor() as executor:
+        partials = list(executor.map(accumulate, *zip(*work)))
+
+    # merge neighbours level by level, keeps the rounding error balanced for long captures
+    while len(partials) > 1:
+        partials = [merge(partials[i], partials[i + 1]) if i + 1 < len(partials) else partials[i] for i in range(0, len(partials), 2)]
+    count, mean, scatter = partials[0]
+
+    covariance = scatter / max(count - 1, 1)
+    eigenvalues, eigenvectors = np.linalg.eigh(covariance)
+    order = np.argsort(eigenvalues)[::-1][:args.components]
+    components = eigenvectors[:, order].T
+
+    # eigenvectors have no inherent sign, pick one so that reruns on the same data give the same basis id
+    signs = np.sign(components[np.arange(len(components)), np.abs(components).argmax(axis=1)])
+    components *= signs[:, None]
+
+    mean = mean.astype('<f4')
+    components = np.ascontiguousarray(components, dtype='<f4')
+    basis_id = fnv1a(struct.pack('<I', args.components) + mean.tobytes() + components.tobytes()) # see HashExpressionBasis
+
+    with open(args.output, 'wb') as f:
+        f.write(struct.pack('<IIII', basis_id, args.components, CHANNEL_COUNT, 0) + mean.tobytes() + components.tobytes())
+
+    explained = eigenvalues[order].sum() / max(eigenvalues.sum(), 1e-30)
+    print(f'{count} frames from {len(args.recordings)} recording(s), {len(work)} chunk(s)')
+    print(f'basis {basis_id} with {args.components} components explains {100.0 * explained:.2f}% of the variance')
+
+    # reconstruction error on the first chunk, same math as the receiver (clamped to 0-1)
+    frames = np.memmap(work[0][0], dtype='<f4', mode='r').reshape(-1, CHANNEL_COUNT)[work[0][1]:work[0][2]]
+    reconstructed = np.clip((frames - mean) @ components.T @ components + mean, 0.0, 1.0)
+    error = np.abs(reconstructed - frames)
+    print(f'reconstruction error on {len(frames)} frames: rms {np.sqrt(np.mean(error ** 2)):.4f}, max {error.max():.4f}')
+
+if __name__ == '__main__':
+    main()
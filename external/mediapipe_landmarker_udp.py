@@ -19,11 +19,30 @@ import time
 import socket
 import time
 import signal
+import select
+import struct
+import zlib
 
 host = '127.0.0.1'
 port = 0
 targetip = '127.0.0.1'
 targetport = 9000
+use_binary = False # 'b' datagrams - raw little-endian floats instead of text
+landmark_bits = 0 # binary only - 0 sends raw floats, 1-16 quantizes each coordinate to that many bits (e.g. 16 or 12)
+use_dictionary = False # blendshape names are sent once in a 'dict' packet, 'bsv' packets then only carry values
+dictionary_refresh_seconds = 1.0 # resend so that receivers started later (or that lost the packet) pick it up
+use_composite = False # landmarks, blendshapes and matrices of a subject are sent together in one 'frame' datagram
+use_mesh = False # landmarks are sent as 'mesh' vertices of the canonical face, its triangles are announced in a 'meshtopo' packet
+mesh_topology_refresh_seconds = 1.0 # like dictionaries, resent so that receivers started later pick it up
+use_pose = False # the face matrix is sent as a 'pose' (quaternion, translation, scale) instead of 'mat44', half the size
+quantize_pose = False # binary only, pose rotations are packed into 32 bits as "smallest three" (20 instead of 32 bytes per pose)
+use_sequence = True # datagrams are numbered per stream so receivers can count loss and drop late or duplicate frames
+expression_basis_file = '' # e.g. 'content/expression_basis.bin' from external/blendshape_pca.py, blendshapes are then sent as a few 'pca' coefficients
+expression_basis_refresh_seconds = 1.0 # like dictionaries, resent so that receivers started later pick it up
+use_envelope = False # datagrams are LZ compressed into 'e' datagrams, about 2x smaller for ASCII but costs a few ms per datagram in Python
+max_datagram_size = 0 # 0 sends datagrams as they are, otherwise larger datagrams are split into 'f' fragments (1400 fits a typical MTU)
+parity_group_size = 0 # 0 sends no parity, otherwise packets are wrapped in 'p' packets and an XOR parity follows every group, receivers rebuild one lost packet per group
+use_feedback = False # the 'r' reports of the receiver (loss, queue depth, latency) quantize binary landmarks to 12 bits and then drop frames while it struggles
 udp_socket = socket.socket(socket.AF_INET, socket.SOCK_DGRAM)
 udp_socket.bind((host, 0)) # gets free port from OS
 port = udp_socket.getsockname()[1]
@@ -31,39 +50,531 @@ port = udp_socket.getsockname()[1]
 def to_array_string(arr):
     return json.dumps(arr, separators=(',', ':'))[1:-1] # [1,2,3,4,5] => "1,2,3,4,5"
 
-def on_mp_facelandmarker_result(result: mp.tasks.vision.FaceLandmarkerResult, output_image: mp.Image, timestamp_ms: int):
-    global udp_socket
+# EFacepipeData in facepipe.h
+FACEPIPE_BLENDSHAPES = 0
+FACEPIPE_LANDMARKS2D = 1
+FACEPIPE_LANDMARKS3D = 2
+FACEPIPE_MESH = 3
+FACEPIPE_MATRICES4X4 = 4
+FACEPIPE_DICTIONARY = 5
+FACEPIPE_BLENDSHAPEVALUES = 6
+FACEPIPE_COMPOSITE = 7
+FACEPIPE_MESHTOPOLOGY = 8
+FACEPIPE_EXPRESSIONBASIS = 10
+FACEPIPE_EXPRESSIONCOEFFICIENTS = 11
+FACEPIPE_POSES = 13
+
+FACEPIPE_FLAG_QUANTIZED = 1 << 0
+FACEPIPE_FLAG_SEQUENCED = 1 << 1
+
+def binary_header(source, data_type, scene, camera, subject, time, flags=0, sequence=None):
+    # see BinaryHeader in facepipe.h (32 bytes) followed by the source name padded to 4 bytes
+    source = source.encode('ascii')
+    if sequence is not None:
+        flags |= FACEPIPE_FLAG_SEQUENCED
+    header = struct.pack('<c2sBBBHHHHHIId', b'b', b'fp', 1, data_type, len(source), flags, scene, camera, subject, 0, sequence or 0, 0, time)
+    return header + source + bytes(-len(source) % 4)
+
+def binary_names(names):
+    return b''.join(struct.pack('<B', len(n)) + n.encode('ascii') for n in names)
+
+def dictionary_id(names):
+    return zlib.crc32(','.join(names).encode('ascii')) & 0x7fffffff # parsed as a signed int on the receiver
+
+def quantized_values(points, bits):
+    # points is (N, components), each axis gets its own scale/offset so the full integer range is used
+    components = points.shape[1]
+    low = points.min(axis=0)
+    scale = (points.max(axis=0) - low) / ((1 << bits) - 1)
+    scale[scale == 0.0] = 1.0
+    q = np.rint((points - low) / scale).astype(np.uint64).flatten()
+    scale_offset = np.zeros(6, dtype='<f4')
+    scale_offset[0:components] = scale
+    scale_offset[3:3+components] = low
+
+    # pack LSB first, value i starts at bit i*bits
+    bit_positions = np.arange(len(q), dtype=np.uint64) * bits
+    packed = np.zeros((len(q) * bits + 7) // 8 + 8, dtype=np.uint8)
+    for b in range(bits):
+        bit = ((q >> np.uint64(b)) & np.uint64(1)).astype(np.uint8)
+        position = bit_positions + np.uint64(b)
+        np.bitwise_or.at(packed, (position >> np.uint64(3)).astype(np.int64), (bit << (position & np.uint64(7)).astype(np.uint8)))
+    packed = packed[:(len(q) * bits + 7) // 8]
+
+    return len(q), scale_offset.tobytes() + packed.tobytes()
+
+def quantized_landmarks(width, height, points, bits):
+    count, values = quantized_values(points, bits)
+    return struct.pack('<IIII', width, height, count, bits) + values
+
+def fnv1a(data):
+    h = 2166136261
+    for b in data:
+        h = ((h ^ b) * 16777619) & 0xFFFFFFFF
+    return h
+
+def load_ply_triangles(path):
+    # ascii ply written by Blender, faces are fan-triangulated
+    with open(path) as f:
+        lines = f.read().splitlines()
+    vertex_count = int(next(line.split()[2] for line in lines if line.startswith('element vertex')))
+    faces = lines[lines.index('end_header') + 1 + vertex_count:]
+    indices = []
+    for face in faces:
+        values = [int(v) for v in face.split()]
+        polygon = values[1:values[0] + 1]
+        for i in range(1, len(polygon) - 1):
+            indices += [polygon[0], polygon[i], polygon[i + 1]]
+    return indices
+
+mesh_topologies = {} # vertex count -> (topology id, indices), the landmarker adds iris points to the canonical face
+def mesh_topology(vertex_count):
+    if vertex_count not in mesh_topologies:
+        indices = np.array(load_ply_triangles('content/thirdparty/mediapipe/canonical_face_model.ply'), dtype='<u4')
+        topology_id = fnv1a(struct.pack('<I', vertex_count) + indices.tobytes()) # see HashMeshTopology in facepipe_mesh.h
+        mesh_topologies[vertex_count] = (topology_id, indices)
+    return mesh_topologies[vertex_count]
+
+refresh_sent_time = {} # (kind, subject) -> time.time() when it was last sent
+def refresh_due(kind, subject, refresh_seconds):
+    now = time.time()
+    if now - refresh_sent_time.get((kind, subject), 0.0) < refresh_seconds:
+        return False
+    refresh_sent_time[(kind, subject)] = now
+    return True
+
+# A section is (data_type, ascii_token, content, binary_flags), content is bytes for binary and str for ascii
+def landmarks_section(width, height, points):
+    if use_binary:
+        bits = adaptive_landmark_bits()
+        if bits > 0:
+            return (FACEPIPE_LANDMARKS3D, 'l3d', quantized_landmarks(width, height, points.astype('<f4'), bits), FACEPIPE_FLAG_QUANTIZED)
+        values = points.astype('<f4').flatten()
+        return (FACEPIPE_LANDMARKS3D, 'l3d', struct.pack('<IIII', width, height, len(values), 0) + values.tobytes(), 0)
+
+    # l3d|640,480|0.1,0.2,0.3,...
+    return (FACEPIPE_LANDMARKS3D, 'l3d', f"{width},{height}|{to_array_string(points.flatten().tolist())}", 0)
+
+def mesh_section(points):
+    topology_id, indices = mesh_topology(len(points))
+    if use_binary:
+        bits = adaptive_landmark_bits()
+        if bits > 0:
+            count, values = quantized_values(points.astype('<f4'), bits)
+            return (FACEPIPE_MESH, 'mesh', struct.pack('<IIII', topology_id, len(points), 0, bits) + values, FACEPIPE_FLAG_QUANTIZED)
+        return (FACEPIPE_MESH, 'mesh', struct.pack('<IIII', topology_id, len(points), 0, 0) + points.astype('<f4').tobytes(), 0)
+    return (FACEPIPE_MESH, 'mesh', f"{topology_id}|{to_array_string(points.flatten().tolist())}", 0) # mesh|id|0.1,0.2,0.3,...
+
+def mesh_topology_section(vertex_count):
+    topology_id, indices = mesh_topology(vertex_count)
+    if use_binary:
+        return (FACEPIPE_MESHTOPOLOGY, 'meshtopo', struct.pack('<IIII', topology_id, vertex_count, len(indices), 0) + indices.tobytes(), 0)
+    return (FACEPIPE_MESHTOPOLOGY, 'meshtopo', f"{topology_id}|{vertex_count}|{to_array_string(indices.tolist())}", 0) # meshtopo|id|478|0,1,2,...
+
+def blendshapes_section(names, scores):
+    if use_dictionary:
+        dict_id = dictionary_id(names)
+        if use_binary:
+            return (FACEPIPE_BLENDSHAPEVALUES, 'bsv', struct.pack('<II', dict_id, len(scores)) + np.array(scores, dtype='<f4').tobytes(), 0)
+        return (FACEPIPE_BLENDSHAPEVALUES, 'bsv', f"{dict_id}|{to_array_string(scores)}", 0) # bsv|id|0,0.5,0.8
+
+    if use_binary:
+        return (FACEPIPE_BLENDSHAPES, 'bs', struct.pack('<I', len(scores)) + np.array(scores, dtype='<f4').tobytes() + binary_names(names), 0)
+    return (FACEPIPE_BLENDSHAPES, 'bs', '|'.join(f"{name}={score}" for name, score in zip(names, scores)), 0) # bs|name=0|other=0.5|smile=0.8
+
+# ARKitBlendshapeNames in facepipe_blendshapes.h, expression bases use this channel order
+ARKIT_BLENDSHAPE_NAMES = [
+    'eyeBlinkLeft', 'eyeLookDownLeft', 'eyeLookInLeft', 'eyeLookOutLeft', 'eyeLookUpLeft', 'eyeSquintLeft', 'eyeWideLeft',
+    'eyeBlinkRight', 'eyeLookDownRight', 'eyeLookInRight', 'eyeLookOutRight', 'eyeLookUpRight', 'eyeSquintRight', 'eyeWideRight',
+    'jawForward', 'jawLeft', 'jawRight', 'jawOpen',
+    'mouthClose', 'mouthFunnel', 'mouthPucker', 'mouthLeft', 'mouthRight',
+    'mouthSmileLeft', 'mouthSmileRight', 'mouthFrownLeft', 'mouthFrownRight', 'mouthDimpleLeft', 'mouthDimpleRight',
+    'mouthStretchLeft', 'mouthStretchRight', 'mouthRollLower', 'mouthRollUpper', 'mouthShrugLower', 'mouthShrugUpper',
+    'mouthPressLeft', 'mouthPressRight', 'mouthLowerDownLeft', 'mouthLowerDownRight', 'mouthUpperUpLeft', 'mouthUpperUpRight',
+    'browDownLeft', 'browDownRight', 'browInnerUp', 'browOuterUpLeft', 'browOuterUpRight',
+    'cheekPuff', 'cheekSquintLeft', 'cheekSquintRight',
+    'noseSneerLeft', 'noseSneerRight',
+    'tongueOut']
+ARKIT_BLENDSHAPE_INDICES = {name: i for i, name in enumerate(ARKIT_BLENDSHAPE_NAMES)}
+
+expression_basis = None # (binary content, basis id, mean, components) loaded on first use
+def load_expression_basis():
+    global expression_basis
+    if expression_basis is None:
+        with open(expression_basis_file, 'rb') as f:
+            content = f.read()
+        basis_id, component_count, channel_count, reserved = struct.unpack_from('<IIII', content)
+        values = np.frombuffer(content, dtype='<f4', offset=16)
+        mean = values[:channel_count]
+        components = values[channel_count:].reshape(component_count, channel_count)
+        expression_basis = (content, basis_id, mean, components)
+    return expression_basis
+
+def expression_basis_section():
+    content, basis_id, mean, components = load_expression_basis()
+    if use_binary:
+        return (FACEPIPE_EXPRESSIONBASIS, 'pcabasis', content, 0) # the file is the binary content
+    # pcabasis|id|12|mean...|components... - floats are printed exactly so the receiver computes the same basis id
+    return (FACEPIPE_EXPRESSIONBASIS, 'pcabasis', f"{basis_id}|{len(components)}|{to_array_string(mean.tolist())}|{to_array_string(components.flatten().tolist())}", 0)
+
+def expression_section(names, scores):
+    content, basis_id, mean, components = load_expression_basis()
+    values = mean.copy() # MediaPipe has no tongueOut, missing channels count as the mean
+    for name, score in zip(names, scores):
+        if name in ARKIT_BLENDSHAPE_INDICES:
+            values[ARKIT_BLENDSHAPE_INDICES[name]] = score
+    coefficients = (components @ (values - mean)).astype('<f4')
+    if use_binary:
+        return (FACEPIPE_EXPRESSIONCOEFFICIENTS, 'pca', struct.pack('<II', basis_id, len(coefficients)) + coefficients.tobytes(), 0)
+    return (FACEPIPE_EXPRESSIONCOEFFICIENTS, 'pca', f"{basis_id}|{to_array_string(coefficients.tolist())}", 0) # pca|id|0.8,-0.1,...
+
+def dictionary_section(names):
+    dict_id = dictionary_id(names)
+    if use_binary:
+        return (FACEPIPE_DICTIONARY, 'dict', struct.pack('<II', dict_id, len(names)) + binary_names(names), 0)
+    return (FACEPIPE_DICTIONARY, 'dict', f"{dict_id}|{','.join(names)}", 0) # dict|id|name,other,smile
+
+def matrix_section(name, matrix):
+    if use_binary:
+        return (FACEPIPE_MATRICES4X4, 'mat44', struct.pack('<I', 1) + np.array(matrix, dtype='<f4').flatten().tobytes() + binary_names([name]), 0)
+    return (FACEPIPE_MATRICES4X4, 'mat44', f"{name}={to_array_string(matrix.flatten().tolist())}", 0) # mat44|face=1,0,0,...
+
+def matrix_to_pose(matrix):
+    # same as DecomposeMatrix in facepipe_pose.cpp, matrix is row-major with the translation in the last column
+    m = np.array(matrix, dtype=np.float64).reshape(4, 4)
+    scale = math.sqrt(np.sum(m[:3, :3] ** 2) / 3.0)
+    r = m[:3, :3] / scale
+    trace = r[0, 0] + r[1, 1] + r[2, 2]
+    if trace > 0:
+        q = [r[2, 1] - r[1, 2], r[0, 2] - r[2, 0], r[1, 0] - r[0, 1], 1.0 + trace]
+    elif r[0, 0] > r[1, 1] and r[0, 0] > r[2, 2]:
+        q = [1.0 + r[0, 0] - r[1, 1] - r[2, 2], r[0, 1] + r[1, 0], r[0, 2] + r[2, 0], r[2, 1] - r[1, 2]]
+    elif r[1, 1] > r[2, 2]:
+        q = [r[0, 1] + r[1, 0], 1.0 + r[1, 1] - r[0, 0] - r[2, 2], r[1, 2] + r[2, 1], r[0, 2] - r[2, 0]]
+    else:
+        q = [r[0, 2] + r[2, 0], r[1, 2] + r[2, 1], 1.0 + r[2, 2] - r[0, 0] - r[1, 1], r[1, 0] - r[0, 1]]
+    q = np.array(q) / np.linalg.norm(q)
+    return q, m[:3, 3], scale
+
+def pack_rotation(q):
+    # smallest three, see facepipe_pose.h
+    largest = int(np.argmax(np.abs(q)))
+    if q[largest] < 0:
+        q = -q
+    packed = largest << 30
+    shift = 20
+    for i in range(4):
+        if i != largest:
+            packed |= int(np.clip((q[i] / math.sqrt(0.5)) * 0.5 + 0.5, 0.0, 1.0) * 1023 + 0.5) << shift
+            shift -= 10
+    return packed
+
+def pose_section(name, matrix):
+    q, t, scale = matrix_to_pose(matrix)
+    if use_binary:
+        if quantize_pose:
+            content = struct.pack('<I', 1) + struct.pack('<I4f', pack_rotation(q), *t, scale) + binary_names([name])
+            return (FACEPIPE_POSES, 'pose', content, FACEPIPE_FLAG_QUANTIZED)
+        return (FACEPIPE_POSES, 'pose', struct.pack('<I', 1) + struct.pack('<8f', *q, *t, scale) + binary_names([name]), 0)
+    return (FACEPIPE_POSES, 'pose', f"{name}={to_array_string(q.tolist() + t.tolist() + [scale])}", 0) # pose|face=qx,qy,qz,qw,tx,ty,tz,scale
+
+def composite_section(sections):
+    if use_binary:
+        # u32 count | count x (u8 type, u8 reserved, u16 flags, u32 offset, u32 size) | sections padded to 4 bytes
+        table_size = 4 + 12 * len(sections)
+        table = struct.pack('<I', len(sections))
+        data = b''
+        for data_type, token, content, flags in sections:
+            table += struct.pack('<BBHII', data_type, 0, flags, table_size + len(data), len(content))
+            data += content + bytes(-len(content) % 4)
+        return (FACEPIPE_COMPOSITE, 'frame', table + data, 0)
+
+    # frame|l3d,bs|12,34|<l3d content>|<bs content>
+    tokens = ','.join(token for data_type, token, content, flags in sections)
+    lengths = ','.join(str(len(content)) for data_type, token, content, flags in sections)
+    return (FACEPIPE_COMPOSITE, 'frame', f"{tokens}|{lengths}|" + '|'.join(content for data_type, token, content, flags in sections), 0)
+
+# Must match PresetDictionary in source/net/facepipe_envelope.cpp
+ENVELOPE_PRESET_DICTIONARY = (
+    b'a|facepipe|mediapipe|0,0,0|1000.0,0|frame|l3d,bs,mat44|28391,1729,178|640,480|0.a|facepipe|media'
+    b'pipe|0,0,0|1000.0,0|l3d|640,480|0.a|facepipe|mediapipe|0,0,0|1000.0,0|bsv|1879412587|a|facepipe|'
+    b'mediapipe|0,0,0|1000.0,0|mat44|face=0.0,0.0,0.0,1.0bfp\x01\x00\t\x02\x00\x00\x00\x00\x00\x00\x00\x00\x00\x00\x00\x00\x00\x00\x00\x00\x00\x00\x00\x00\x00\x00@\x8f@mediapipe\x00\x00\x004'
+    b'\x00\x00\x00\x08_neutral\x0cbrowDownLeft\rbrowDownRight\x0bbrowInnerUp\x0fbrowOuterUpLeft\x10browOuterUpRight\tcheekPuff\x0fc'
+    b'heekSquintLeft\x10cheekSquintRight\x0ceyeBlinkLeft\reyeBlinkRight\x0feyeLookDownLeft\x10eyeLookDownRight\reyeL'
+    b'ookInLeft\x0eeyeLookInRight\x0eeyeLookOutLeft\x0feyeLookOutRight\reyeLookUpLeft\x0eeyeLookUpRight\reyeSquintLe'
+    b'ft\x0eeyeSquintRight\x0beyeWideLeft\x0ceyeWideRight\njawForward\x07jawLeft\x07jawOpen\x08jawRight\nmouthClose\x0fmouthD'
+    b'impleLeft\x10mouthDimpleRight\x0emouthFrownLeft\x0fmouthFrownRight\x0bmouthFunnel\tmouthLeft\x12mouthLowerDownLe'
+    b'ft\x13mouthLowerDownRight\x0emouthPressLeft\x0fmouthPressRight\x0bmouthPucker\nmouthRight\x0emouthRollLower\x0emout'
+    b'hRollUpper\x0fmouthShrugLower\x0fmouthShrugUpper\x0emouthSmileLeft\x0fmouthSmileRight\x10mouthStretchLeft\x11mouth'
+    b'StretchRight\x10mouthUpperUpLeft\x11mouthUpperUpRight\rnoseSneerLeft\x0enoseSneerRight\x00\x80?\x04facea|facepipe|m'
+    b'ediapipe|0,0,0|1000.0,0|bs|_neutral=0.|browDownLeft=0.|browDownRight=0.|browInnerUp=0.|browOuter'
+    b'UpLeft=0.|browOuterUpRight=0.|cheekPuff=0.|cheekSquintLeft=0.|cheekSquintRight=0.|eyeBlinkLeft=0'
+    b'.|eyeBlinkRight=0.|eyeLookDownLeft=0.|eyeLookDownRight=0.|eyeLookInLeft=0.|eyeLookInRight=0.|eye'
+    b'LookOutLeft=0.|eyeLookOutRight=0.|eyeLookUpLeft=0.|eyeLookUpRight=0.|eyeSquintLeft=0.|eyeSquintR'
+    b'ight=0.|eyeWideLeft=0.|eyeWideRight=0.|jawForward=0.|jawLeft=0.|jawOpen=0.|jawRight=0.|mouthClos'
+    b'e=0.|mouthDimpleLeft=0.|mouthDimpleRight=0.|mouthFrownLeft=0.|mouthFrownRight=0.|mouthFunnel=0.|'
+    b'mouthLeft=0.|mouthLowerDownLeft=0.|mouthLowerDownRight=0.|mouthPressLeft=0.|mouthPressRight=0.|m'
+    b'outhPucker=0.|mouthRight=0.|mouthRollLower=0.|mouthRollUpper=0.|mouthShrugLower=0.|mouthShrugUpp'
+    b'er=0.|mouthSmileLeft=0.|mouthSmileRight=0.|mouthStretchLeft=0.|mouthStretchRight=0.|mouthUpperUp'
+    b'Left=0.|mouthUpperUpRight=0.|noseSneerLeft=0.|noseSneerRight=0.'
+)
+ENVELOPE_CODEC_LZ = 1
+ENVELOPE_CODEC_LZ_PACKED = 2
+ENVELOPE_DICTIONARY_PRESET = 1
+ENVELOPE_PACKED_SYMBOLS = {c: i for i, c in enumerate(b'0123456789,.-e|')}
+envelope_dictionary_positions = {} # first 4 bytes -> last position in the dictionary, built on first use
+
+def envelope_length(out, length):
+    while length >= 255:
+        out.append(255)
+        length -= 255
+    out.append(length)
 
-    protocol = "facepipe"
+def envelope_packed_literals(literals):
+    # 4 bit symbols low nibble first, anything that is not part of a number is 15 followed by the byte as two symbols
+    symbols = []
+    for c in literals:
+        symbol = ENVELOPE_PACKED_SYMBOLS.get(c)
+        if symbol is None:
+            symbols += (15, c & 15, c >> 4)
+        else:
+            symbols.append(symbol)
+    if len(symbols) % 2:
+        symbols.append(0)
+    return bytes(symbols[i] | (symbols[i + 1] << 4) for i in range(0, len(symbols), 2))
+
+def envelope_sequence(out, literals, packed, offset, length):
+    # LZ4 block format: token, literal length, literals, u16 offset, match length - length 0 ends the block
+    match_code = length - 4 if length > 0 else 0
+    out.append((min(len(literals), 15) << 4) | min(match_code, 15))
+    if len(literals) >= 15:
+        envelope_length(out, len(literals) - 15)
+    out += envelope_packed_literals(literals) if packed else literals
+    if length > 0:
+        out += struct.pack('<H', offset)
+        if match_code >= 15:
+            envelope_length(out, match_code - 15)
+
+def encode_envelope(datagram):
+    if not envelope_dictionary_positions:
+        for i in range(len(ENVELOPE_PRESET_DICTIONARY) - 3):
+            envelope_dictionary_positions[ENVELOPE_PRESET_DICTIONARY[i:i + 4]] = i
+
+    packed = datagram[:1] == b'a'
+    min_length = 8 if packed else 4
+    codec = ENVELOPE_CODEC_LZ_PACKED if packed else ENVELOPE_CODEC_LZ
+    out = bytearray(struct.pack('<cBBBI', b'e', 1, codec, ENVELOPE_DICTIONARY_PRESET, len(datagram)))
+
+    # matches can reference the dictionary as if it preceded the datagram
+    window = ENVELOPE_PRESET_DICTIONARY + datagram
+    positions = dict(envelope_dictionary_positions)
+    position = anchor = len(ENVELOPE_PRESET_DICTIONARY)
+    search_end = len(window) - 12
+    match_end = len(window) - 5
+    while position < search_end:
+        key = window[position:position + 4]
+        candidate = positions.get(key)
+        positions[key] = position
+        if candidate is None or position - candidate > 0xFFFF:
+            position += 1
+            continue
+        length = 4
+        while position + length < match_end and window[candidate + length] == window[position + length]:
+            length += 1
+        if length < min_length:
+            position += 1
+            continue
+        envelope_sequence(out, window[anchor:position], packed, position - candidate, length)
+        position += length
+        anchor = position
+    envelope_sequence(out, window[anchor:], packed, 0, 0)
+    return bytes(out)
+
+# see AdaptiveEncoding in facepipe_feedback.h, there is no delta encoder here so after quantizing only the rate is left
+FEEDBACK_CONGESTED_LOSS = 0.05
+FEEDBACK_HEALTHY_LOSS = 0.01
+FEEDBACK_CONGESTED_QUEUE_DEPTH = 64
+FEEDBACK_CONGESTED_LATENCY_MS = 50.0
+FEEDBACK_RECOVERY_REPORTS = 5
+FEEDBACK_MIN_RATE_SCALE = 0.25
+FEEDBACK_QUANTIZED_BITS = 12
+feedback = { 'quantized': False, 'rate_scale': 1.0, 'good_reports': 0, 'credit': 1.0 }
+
+def adaptive_landmark_bits():
+    if feedback['quantized'] and (landmark_bits == 0 or landmark_bits > FEEDBACK_QUANTIZED_BITS):
+        return FEEDBACK_QUANTIZED_BITS
+    return landmark_bits
+
+def on_receiver_report(received, lost, queue_depth, latency_ms):
+    loss = lost / (received + lost) if lost > 0 else 0.0
+    congested = loss > FEEDBACK_CONGESTED_LOSS or queue_depth > FEEDBACK_CONGESTED_QUEUE_DEPTH or latency_ms > FEEDBACK_CONGESTED_LATENCY_MS
+    healthy = loss < FEEDBACK_HEALTHY_LOSS and queue_depth <= FEEDBACK_CONGESTED_QUEUE_DEPTH // 4 and latency_ms <= FEEDBACK_CONGESTED_LATENCY_MS / 2
+
+    if congested:
+        feedback['good_reports'] = 0
+        if use_binary and not feedback['quantized']:
+            feedback['quantized'] = True
+        else:
+            feedback['rate_scale'] = max(feedback['rate_scale'] * 0.5, FEEDBACK_MIN_RATE_SCALE)
+        return
+
+    # in between counts neither way, recovery needs good reports in a row
+    feedback['good_reports'] = feedback['good_reports'] + 1 if healthy else 0
+    if feedback['good_reports'] < FEEDBACK_RECOVERY_REPORTS:
+        return
+
+    feedback['good_reports'] = 0
+    if feedback['rate_scale'] < 1.0:
+        feedback['rate_scale'] = min(feedback['rate_scale'] * 2.0, 1.0)
+    else:
+        feedback['quantized'] = False
+
+def poll_receiver_reports():
+    # the receiver sends its reports back to the port we send from, see ReceiverReport in facepipe_feedback.h (24 bytes)
+    while select.select([udp_socket], [], [], 0)[0]:
+        try:
+            report = udp_socket.recv(64)
+        except OSError: # e.g. the ICMP port unreachable of a receiver that is not running yet
+            return
+        if len(report) != 24:
+            continue
+        kind, version, reserved, received, lost, queue_depth, latency_ms, interval_seconds = struct.unpack('<cBHIIIff', report)
+        if kind == b'r' and version == 1:
+            on_receiver_report(received, lost, queue_depth, latency_ms)
+
+def feedback_should_send():
+    # every frame earns rate_scale, one is sent whenever a whole frame was earned
+    if not use_feedback:
+        return True
+    poll_receiver_reports()
+    if feedback['rate_scale'] >= 1.0:
+        return True
+    feedback['credit'] += feedback['rate_scale']
+    if feedback['credit'] < 1.0:
+        return False
+    feedback['credit'] -= 1.0
+    return True
+
+PARITY_HEADER_SIZE = 12
+PARITY_MAX_GROUP_SIZE = 16
+parity_group_id = 0
+parity_packets = []
+def send_packet(packet):
+    # see facepipe_fec.h, the parity is the XOR of the packets of the group zero padded to the longest one
+    global parity_group_id
+    if parity_group_size <= 0:
+        udp_socket.sendto(packet, (targetip, targetport))
+        return
+
+    group_size = min(parity_group_size, PARITY_MAX_GROUP_SIZE)
+    index = len(parity_packets)
+    udp_socket.sendto(struct.pack('<cBBBIHH', b'p', 1, index, group_size, parity_group_id, len(packet), 0) + packet, (targetip, targetport))
+    parity_packets.append(packet)
+    if len(parity_packets) < group_size:
+        return
+
+    longest = max(len(p) for p in parity_packets)
+    parity = 0
+    size_parity = 0
+    for p in parity_packets:
+        parity ^= int.from_bytes(p.ljust(longest, b'\0'), 'little')
+        size_parity ^= len(p)
+    udp_socket.sendto(struct.pack('<cBBBIHH', b'p', 1, group_size, group_size, parity_group_id, size_parity, 0) + parity.to_bytes(longest, 'little'), (targetip, targetport))
+    parity_group_id = (parity_group_id + 1) & 0xFFFFFFFF
+    parity_packets.clear()
+
+FRAGMENT_HEADER_SIZE = 16
+FRAGMENT_MAX_COUNT = 256
+fragment_message_id = 0
+def send_datagram(datagram):
+    global fragment_message_id
+    if use_envelope:
+        encoded = encode_envelope(datagram)
+        if len(encoded) < len(datagram):
+            datagram = encoded
+
+    # wrapped packets must still fit
+    packet_size = max_datagram_size - PARITY_HEADER_SIZE if parity_group_size > 0 else max_datagram_size
+    if packet_size <= FRAGMENT_HEADER_SIZE or len(datagram) <= packet_size:
+        send_packet(datagram)
+        return
+
+    fragment_size = min(packet_size - FRAGMENT_HEADER_SIZE, 0xFFFF)
+    count = (len(datagram) + fragment_size - 1) // fragment_size
+    if count > FRAGMENT_MAX_COUNT:
+        return
+
+    message_id = fragment_message_id
+    fragment_message_id = (fragment_message_id + 1) & 0xFFFFFFFF
+    for index in range(count):
+        payload = datagram[index * fragment_size:(index + 1) * fragment_size]
+        header = struct.pack('<cBHHHII', b'f', 1, index, count, fragment_size, message_id, len(datagram))
+        send_packet(header + payload)
+
+sequence_numbers = {} # (subject, data_type) -> next sequence number, receivers track each data type as its own stream
+def next_sequence(subject, data_type):
+    if not use_sequence:
+        return None
+    sequence = sequence_numbers.get((subject, data_type), 0)
+    sequence_numbers[(subject, data_type)] = (sequence + 1) & 0xFFFFFFFF
+    return sequence
+
+def send_sections(sections, source, scene, camera, subject, time):
+    if use_composite and len(sections) > 1:
+        sections = [composite_section(sections)]
+
+    for data_type, token, content, flags in sections:
+        sequence = next_sequence(subject, data_type)
+        if use_binary:
+            datagram = binary_header(source, data_type, scene, camera, subject, time, flags, sequence) + content
+        else:
+            time_field = f"{time},{sequence}" if sequence is not None else f"{time}"
+            datagram = f"a|facepipe|{source}|{scene},{camera},{subject}|{time_field}|{token}|{content}".encode('ascii')
+        send_datagram(datagram)
+
+def on_mp_facelandmarker_result(result: mp.tasks.vision.FaceLandmarkerResult, output_image: mp.Image, timestamp_ms: int):
     source = "mediapipe"
     scene = 0
     camera = 0
     time = float(timestamp_ms)/1000.0
 
+    # TODO: mesh (even though mediapipe technically does not have one)
+
+    # dropped frames are never numbered, the receiver does not count them as lost
+    if not feedback_should_send():
+        return
+
     for subject in range(0, len(result.face_landmarks)):
-        values = np.array([(lm.x, lm.y, lm.z) for lm in result.face_landmarks[subject]]).flatten().tolist() # each array is a set of landmark objects { 'x': 0, 'y': 0, 'z': 0, ... } - this unpacks it to a continuous list
-        values = to_array_string(values)
-        content = f"l3d|{output_image.width},{output_image.height}|{values}" 
-        udp_socket.sendto(f"a|{protocol}|{source}|{scene},{camera},{subject}|{time}|{content}".encode('ascii'), (targetip, targetport))
-
-    for subject in range(0, len(result.face_blendshapes)):
-        # bs|name=0|other=0.5|smile=0.8
-        content = "bs"
-        for i in range(0, len(result.face_blendshapes[subject])):
-            bs = result.face_blendshapes[subject][i]
-            content += f"|{bs.category_name}={bs.score}"
-        udp_socket.sendto(f"a|{protocol}|{source}|{scene},{camera},{subject}|{time}|{content}".encode('ascii'), (targetip, targetport))
+        sections = []
 
-    # TODO: mesh (even though mediapipe technically does not have one)
-    #message['data'] = {
-    #    'type': 'mesh'
-    #}
-    
-    for subject in range(0, len(result.facial_transformation_matrixes)):
-        values = result.facial_transformation_matrixes[subject].flatten().tolist()
-        values = to_array_string(values)
-        content = f"mat44|face={values}"
-        udp_socket.sendto(f"a|{protocol}|{source}|{scene},{camera},{subject}|{time}|{content}".encode('ascii'), (targetip, targetport))
+        # each array is a set of landmark objects { 'x': 0, 'y': 0, 'z': 0, ... } - this unpacks it to a (N, 3) array
+        points = np.array([(lm.x, lm.y, lm.z) for lm in result.face_landmarks[subject]])
+        if use_mesh:
+            if refresh_due('meshtopo', subject, mesh_topology_refresh_seconds):
+                send_sections([mesh_topology_section(len(points))], source, scene, camera, subject, time)
+            sections.append(mesh_section(points))
+        else:
+            sections.append(landmarks_section(output_image.width, output_image.height, points))
+
+        if subject < len(result.face_blendshapes):
+            names = [bs.category_name for bs in result.face_blendshapes[subject]]
+            scores = [bs.score for bs in result.face_blendshapes[subject]]
+            if expression_basis_file:
+                if refresh_due('pcabasis', subject, expression_basis_refresh_seconds):
+                    send_sections([expression_basis_section()], source, scene, camera, subject, time)
+                sections.append(expression_section(names, scores))
+            else:
+                if use_dictionary and refresh_due('dict', subject, dictionary_refresh_seconds):
+                    send_sections([dictionary_section(names)], source, scene, camera, subject, time)
+                sections.append(blendshapes_section(names, scores))
+
+        if subject < len(result.facial_transformation_matrixes):
+            if use_pose:
+                sections.append(pose_section('face', result.facial_transformation_matrixes[subject]))
+            else:
+                sections.append(matrix_section('face', result.facial_transformation_matrixes[subject]))
+
+        send_sections(sections, source, scene, camera, subject, time)
 
 options = mp.tasks.vision.FaceLandmarkerOptions(
     base_options = mp.tasks.BaseOptions(model_asset_path='content/thirdparty/mediapipe/face_landmarker.task'),
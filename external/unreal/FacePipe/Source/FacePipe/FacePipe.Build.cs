@@ -7,7 +7,7 @@ public class FacePipe : ModuleRules
 	public FacePipe(ReadOnlyTargetRules Target) : base(Target)
 	{
 		PCHUsage = ModuleRules.PCHUsageMode.UseExplicitOrSharedPCHs;
-        CppStandard = CppStandardVersion.Cpp17;
+        CppStandard = CppStandardVersion.Cpp20;
         bLegacyPublicIncludePaths = false;
 
         PublicIncludePaths.AddRange(new string[] { });
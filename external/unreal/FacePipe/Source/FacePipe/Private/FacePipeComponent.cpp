@@ -4,9 +4,35 @@
 #include "HAL/Runnable.h"
 
 #include "facepipe/facepipe.h"
+#include "facepipe/facepipe_delta.h"
+#include "facepipe/facepipe_dictionary.h"
+#include "facepipe/facepipe_envelope.h"
+#include "facepipe/facepipe_fec.h"
+#include "facepipe/facepipe_feedback.h"
+#include "facepipe/facepipe_fragment.h"
+#include "facepipe/facepipe_pca.h"
+#include "facepipe/facepipe_sequence.h"
+#include "facepipe/facepipe_sparse.h"
 
 #define UDP_MAX_SIZE 65507
 
+// FNames for the ARKit blendshapes are created once instead of for every packet
+static const TArray<FName>& GetARKitBlendshapeFNames()
+{
+	static TArray<FName> Names = []()
+	{
+		TArray<FName> Result;
+		Result.Reserve(FacePipe::ARKitBlendshapeCount);
+		for (std::string_view Name : FacePipe::ARKitBlendshapeNames)
+		{
+			Result.Add(FName(Name.size(), Name.data()));
+		}
+		return Result;
+	}();
+
+	return Names;
+}
+
 FFacePipeUDPListener::FFacePipeUDPListener(uint16 ListenPort)
 	: Port(ListenPort)
 {
@@ -35,6 +61,7 @@ bool FFacePipeUDPListener::Init()
         .BoundToEndpoint(Endpoint);
 
     ListenSocket->SetNonBlocking(true);
+	RemoteAddress = ISocketSubsystem::Get(PLATFORM_SOCKETSUBSYSTEM)->CreateInternetAddr();
 
 	return true;
 }
@@ -52,10 +79,15 @@ uint32 FFacePipeUDPListener::Run()
 			ReceivedData.SetNumUninitialized(BufferSize + 1, false); // +1 for null terminator
 
 			int32 Read = 0;
-			while (ListenSocket->Recv(ReceivedData.GetData(), ReceivedData.Num(), Read, ESocketReceiveFlags::None) && Read > 0)
+			while (ListenSocket->RecvFrom(ReceivedData.GetData(), ReceivedData.Num(), Read, *RemoteAddress) && Read > 0)
 			{
-				ReceivedData.Last() = 0; // null terminate
-				DatagramQueue.Enqueue(ReceivedData);
+				// The sender travels with the datagram, reports go back to it from the game thread
+				uint32 SenderIp = 0;
+				RemoteAddress->GetIp(SenderIp);
+				const uint64 SenderKey = (uint64(SenderIp) << 16) | uint64(uint16(RemoteAddress->GetPort()));
+
+				// Exact size, fragments are validated against their payload length and the component adds the null terminator
+				DatagramQueue.Enqueue({ TArray<uint8>(ReceivedData.GetData(), Read), FPlatformTime::Seconds(), SenderKey });
 			}
 		}
 
@@ -72,6 +104,7 @@ void FFacePipeUDPListener::Stop()
 
 void FFacePipeUDPListener::Exit()
 {
+	FScopeLock Lock(&SocketLock);
     if (ListenSocket)
     {
         ListenSocket->Close();
@@ -80,6 +113,20 @@ void FFacePipeUDPListener::Exit()
     }
 }
 
+bool FFacePipeUDPListener::SendReport(uint64 SenderKey, const FacePipe::ReceiverReport& Report)
+{
+	TSharedRef<FInternetAddr> SenderAddress = ISocketSubsystem::Get(PLATFORM_SOCKETSUBSYSTEM)->CreateInternetAddr();
+	SenderAddress->SetIp(uint32(SenderKey >> 16));
+	SenderAddress->SetPort(int32(SenderKey & 0xFFFF));
+
+	FScopeLock Lock(&SocketLock);
+	if (!ListenSocket)
+		return false;
+
+	int32 Sent = 0;
+	return ListenSocket->SendTo((const uint8*) &Report, sizeof(Report), Sent, *SenderAddress) && Sent == sizeof(Report);
+}
+
 UFacePipeComponent::UFacePipeComponent(const FObjectInitializer& ObjectInitializer)
 	: Super(ObjectInitializer)
 {
@@ -105,78 +152,222 @@ void UFacePipeComponent::TickComponent(float DeltaTime, enum ELevelTick TickType
 	if (!UDPListener)
 		return;
 
-	TArray<uint8> UEDatagram;
+	FFacePipeDatagram UEDatagram;
+	size_t QueueDepth = 0;
 	while (UDPListener->DatagramQueue.Dequeue(UEDatagram))
 	{
-		if (UEDatagram.Num() < 2)
+		QueueDepth++;
+		if (UEDatagram.Data.Num() < 2)
 			continue;
 
-		UEDatagram.Push('\0');
-
 		// Data starts from second byte
-		std::vector<char> Message(UEDatagram.GetData(), UEDatagram.GetData() + UEDatagram.Num());
+		std::vector<char> Message(UEDatagram.Data.GetData(), UEDatagram.Data.GetData() + UEDatagram.Data.Num());
 
-		FacePipe::MessageInfo MessageInfo;
-		if (!FacePipe::ParseHeader(Message, MessageInfo))
+		if (Message[0] != 'p')
 		{
+			HandleDatagram(Message, UEDatagram.SenderKey, UEDatagram.ReceivedTime);
 			continue;
 		}
 
-		switch (MessageInfo.DataType)
+		// Parity protected packets carry fragments and datagrams, a lost one is rebuilt once its group is complete.
+		// A recovered packet belongs to the group of the packet just added, so to the same sender.
+		std::vector<char> Unwrapped;
+		if (Parity.Add(Message, UEDatagram.SenderKey, FPlatformTime::Seconds(), Unwrapped))
+			HandleDatagram(Unwrapped, UEDatagram.SenderKey, UEDatagram.ReceivedTime);
+
+		if (Parity.TakeRecovered(Unwrapped))
+			HandleDatagram(Unwrapped, UEDatagram.SenderKey, UEDatagram.ReceivedTime);
+	}
+
+	// Once per second every sender is told how its datagrams arrive so it can adapt its encoding
+	Reporter.SetQueueDepth(QueueDepth);
+	uint64_t SenderKey = 0;
+	FacePipe::ReceiverReport Report;
+	while (Reporter.TakeDue(FPlatformTime::Seconds(), SenderKey, Report))
+		UDPListener->SendReport(SenderKey, Report);
+}
+
+void UFacePipeComponent::HandleDatagram(std::vector<char>& Message, uint64 SenderKey, double ReceivedTime)
+{
+	if (Message.empty())
+		return;
+
+	if (Message[0] == 'f')
+	{
+		if (!Fragments.Add(Message, SenderKey, FPlatformTime::Seconds(), Message))
+			return;
+	}
+
+	if (Message[0] == 'e')
+	{
+		const std::vector<char>* Decoded = FacePipe::DecodeEnvelope(Message);
+		if (!Decoded)
+			return;
+
+		Message = *Decoded;
+	}
+
+	Message.push_back('\0');
+
+	FacePipe::MessageInfo MessageInfo;
+	if (!FacePipe::ParseHeader(Message, MessageInfo, HeaderCache))
+	{
+		return;
+	}
+
+	int64_t LostChange = 0;
+	const bool bAccepted = Sequences.Accept(MessageInfo, LostChange);
+	const double Now = FPlatformTime::Seconds();
+	if (MessageInfo.bHasSequence)
+		Reporter.Add(SenderKey, MessageInfo, LostChange, Now - ReceivedTime, Now);
+
+	if (!bAccepted)
+		return;
+
+	HandleMessage(Message, MessageInfo);
+}
+
+void UFacePipeComponent::HandleMessage(const std::vector<char>& Message, const FacePipe::MessageInfo& MessageInfo)
+{
+	switch (MessageInfo.DataType)
+	{
+	case FacePipe::EFacepipeData::Blendshapes:
+	{
+		FacePipe::BlendshapeFrame Blendshapes;
+		if (FacePipe::GetBlendshapes(Message, MessageInfo, Blendshapes))
+		{
+			BroadcastBlendshapes(Blendshapes, MessageInfo.Time);
+			LatestBlendshapes = std::move(Blendshapes);
+		}
+		break;
+	}
+	case FacePipe::EFacepipeData::BlendshapeUpdates:
+	{
+		if (FacePipe::GetBlendshapeUpdates(Message, MessageInfo, LatestBlendshapes))
+		{
+			BroadcastBlendshapes(LatestBlendshapes, MessageInfo.Time);
+		}
+		break;
+	}
+	case FacePipe::EFacepipeData::ExpressionBasis:
+	{
+		ExpressionBases.Update(Message, MessageInfo);
+		break;
+	}
+	case FacePipe::EFacepipeData::ExpressionCoefficients:
+	{
+		FacePipe::BlendshapeFrame Blendshapes;
+		if (FacePipe::GetExpressionCoefficients(Message, MessageInfo, ExpressionBases, Blendshapes))
+		{
+			BroadcastBlendshapes(Blendshapes, MessageInfo.Time);
+		}
+		break;
+	}
+	case FacePipe::EFacepipeData::Dictionary:
+	{
+		Dictionaries.Update(Message, MessageInfo);
+		break;
+	}
+	case FacePipe::EFacepipeData::BlendshapeValues:
+	{
+		FacePipe::BlendshapeFrame Blendshapes;
+		if (FacePipe::GetBlendshapeValues(Message, MessageInfo, Dictionaries, Blendshapes))
 		{
-		case FacePipe::EFacepipeData::Blendshapes:
+			BroadcastBlendshapes(Blendshapes, MessageInfo.Time);
+		}
+		break;
+	}
+	case FacePipe::EFacepipeData::Landmarks2D:
+	case FacePipe::EFacepipeData::Landmarks3D:
+	{
+		std::span<const float> Values;
+		if (MessageInfo.DatagramType == FacePipe::EDatagramType::Bytes && (FacePipe::HasFlag(MessageInfo.BinaryFlags, FacePipe::EBinaryFlags::Delta) || FacePipe::HasFlag(MessageInfo.BinaryFlags, FacePipe::EBinaryFlags::Keyframe)))
 		{
-			std::map<std::string, float> Blendshapes;
-			FacePipe::GetBlendshapes(Message, MessageInfo, Blendshapes);
+			int ImageWidth = 0, ImageHeight = 0;
+			if (!LandmarkDeltas.Decode(Message, MessageInfo, DeltaLandmarks, ImageWidth, ImageHeight))
+				break;
 
-			TArray<FFacePipeBlendshapeData> BlendshapeData;
-			for (auto& Pair : Blendshapes)
-			{
-				FFacePipeBlendshapeData Data;
-				Data.Name = FName(Pair.first.c_str());
-				Data.Value = Pair.second;
-				BlendshapeData.Push(Data);
-			}
+			Values = DeltaLandmarks;
+		}
+		else
+		{
+			// The values are read straight from the datagram, no intermediate std::vector
+			if (!View.Bind(Message, MessageInfo))
+				break;
 
-			OnBlendshapesUpdate.Broadcast(BlendshapeData, MessageInfo.Time);
-			break;
+			Values = View.GetLandmarks();
 		}
-		case FacePipe::EFacepipeData::Landmarks2D:
-		case FacePipe::EFacepipeData::Landmarks3D:
+
+		// Could probably do a memcpy but better not to... UE5 has a different data type for FVector.
+		TArray<FVector> Landmarks;
+		if (MessageInfo.DataType == FacePipe::EFacepipeData::Landmarks2D)
 		{
-			int ImageWidth = 0;
-			int ImageHeight = 0;
-			std::vector<float> Values;
-			FacePipe::GetLandmarks(Message, MessageInfo, Values, ImageWidth, ImageHeight);
-
-			// Could probably do a memcpy but better not to... UE5 has a different data type for FVector.
-			TArray<FVector> Landmarks;
-			if (MessageInfo.DataType == FacePipe::EFacepipeData::Landmarks2D)
+			Landmarks.Reserve(Values.size()/2);
+			for (size_t i=0; i+1<Values.size(); i += 2)
 			{
-				Landmarks.Reserve(Values.size()/2);
-				for (int32 i=0; i<Values.size(); i += 2)
-				{
-					Landmarks.Add(FVector(Values[i], Values[i+1], 0.0f));
-				}
+				Landmarks.Add(FVector(Values[i], Values[i+1], 0.0f));
 			}
-			else
+		}
+		else
+		{
+			Landmarks.Reserve(Values.size()/3);
+			for (size_t i=0; i+2<Values.size(); i += 3)
 			{
-				Landmarks.Reserve(Values.size()/3);
-				for (int32 i=0; i<Values.size(); i += 3)
-				{
-					Landmarks.Add(FVector(Values[i], Values[i+1], Values[i+2]));
-				}
+				Landmarks.Add(FVector(Values[i], Values[i+1], Values[i+2]));
 			}
-
-			OnLandmarksUpdate.Broadcast(Landmarks, MessageInfo.Time);
-			break;
 		}
-		case FacePipe::EFacepipeData::Matrices4x4:
+
+		OnLandmarksUpdate.Broadcast(Landmarks, MessageInfo.Time);
+		break;
+	}
+	case FacePipe::EFacepipeData::Matrices4x4:
+	case FacePipe::EFacepipeData::Poses:
+	{
+		break;
+	}
+	case FacePipe::EFacepipeData::Composite:
+	{
+		FacePipe::MessageInfo Section;
+		for (size_t i = 0; FacePipe::GetSection(Message, MessageInfo, i, Section); ++i)
 		{
-			break;
+			HandleMessage(Message, Section);
 		}
+		break;
+	}
+	default:
+	{
+		CustomData.Update(Message, MessageInfo);
+		break;
+	}
+	}
+}
+
+void UFacePipeComponent::BroadcastBlendshapes(const FacePipe::BlendshapeFrame& Blendshapes, double Time)
+{
+	const TArray<FName>& ARKitNames = GetARKitBlendshapeFNames();
+
+	TArray<FFacePipeBlendshapeData> BlendshapeData;
+	BlendshapeData.Reserve(FacePipe::ARKitBlendshapeCount + Blendshapes.Other.size());
+	for (size_t i = 0; i < FacePipe::ARKitBlendshapeCount; ++i)
+	{
+		if (Blendshapes.IsValid(i))
+		{
+			FFacePipeBlendshapeData Data;
+			Data.Name = ARKitNames[i];
+			Data.Value = Blendshapes.Values[i];
+			BlendshapeData.Push(Data);
 		}
 	}
+
+	for (auto& Pair : Blendshapes.Other)
+	{
+		FFacePipeBlendshapeData Data;
+		Data.Name = FName(Pair.first.c_str());
+		Data.Value = Pair.second;
+		BlendshapeData.Push(Data);
+	}
+
+	OnBlendshapesUpdate.Broadcast(BlendshapeData, Time);
 }
 
 void UFacePipeComponent::StartListening(int32 Port)
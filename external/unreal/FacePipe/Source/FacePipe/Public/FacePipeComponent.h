@@ -2,8 +2,25 @@
 
 #include "CoreMinimal.h"
 #include "HAL/Runnable.h"
+#include "facepipe/facepipe_custom.h"
+#include "facepipe/facepipe_delta.h"
+#include "facepipe/facepipe_dictionary.h"
+#include "facepipe/facepipe_fec.h"
+#include "facepipe/facepipe_feedback.h"
+#include "facepipe/facepipe_fragment.h"
+#include "facepipe/facepipe_pca.h"
+#include "facepipe/facepipe_sequence.h"
+#include "facepipe/facepipe_sparse.h"
+#include "facepipe/facepipe_view.h"
 #include "FacePipeComponent.generated.h"
 
+struct FFacePipeDatagram
+{
+	TArray<uint8> Data;
+	double ReceivedTime = 0.0; // FPlatformTime::Seconds() when the listener received it
+	uint64 SenderKey = 0; // IPv4 address and port of the sender, see FFacePipeUDPListener::SendReport
+};
+
 class FFacePipeUDPListener : public FRunnable
 {
 public:
@@ -15,13 +32,17 @@ public:
     virtual void Stop() override;
 	virtual void Exit() override;
 
+	// Sends Report back to the sender of the datagrams with SenderKey, called from the game thread
+	bool SendReport(uint64 SenderKey, const FacePipe::ReceiverReport& Report);
+
 public:
-	TQueue<TArray<uint8>> DatagramQueue;
+	TQueue<FFacePipeDatagram> DatagramQueue;
 
 protected:
 	FRunnableThread* Thread = nullptr;
 	FThreadSafeBool bRunThread = true;
 
+	FCriticalSection SocketLock; // SendReport runs on the game thread, Exit closes the socket on the listener thread
     TSharedPtr<FInternetAddr> RemoteAddress;
     FSocket* ListenSocket;
     uint16 Port;
@@ -68,5 +89,21 @@ public:
 	FFacePipeLandmarksDelegate OnLandmarksUpdate;
 
 protected:
+	void HandleDatagram(std::vector<char>& Message, uint64 SenderKey, double ReceivedTime);
+	void HandleMessage(const std::vector<char>& Message, const FacePipe::MessageInfo& MessageInfo);
+	void BroadcastBlendshapes(const FacePipe::BlendshapeFrame& Blendshapes, double Time);
+
 	FFacePipeUDPListener* UDPListener;
+	FacePipe::DictionaryCache Dictionaries;
+	FacePipe::ExpressionBasisCache ExpressionBases;
+	FacePipe::FragmentReassembler Fragments; // keyed by FFacePipeDatagram::SenderKey, like Parity and Reporter
+	FacePipe::ParityDecoder Parity; // RecoveredCount and UnrecoverableCount tell how well parity copes with the link
+	FacePipe::SequenceTracker Sequences;
+	FacePipe::ReceiverReporter Reporter; // tells every sender once per second how its datagrams arrive, see facepipe_feedback.h
+	FacePipe::HeaderPrefixCache HeaderCache; // shared by all senders, usually there is only one
+	FacePipe::FrameView View; // reused so that decoding ASCII values does not allocate per datagram
+	FacePipe::LandmarkDeltaDecoder LandmarkDeltas;
+	std::vector<float> DeltaLandmarks; // landmarks decoded by LandmarkDeltas
+	FacePipe::BlendshapeFrame LatestBlendshapes; // BlendshapeUpdates are merged into the last full Blendshapes
+	FacePipe::CustomSchemas CustomData; // latest value of every schema in facepipe_custom.h, e.g. CustomData.Get<FacePipe::GazeData>()
 };
@@ -1,5 +1,11 @@
 #include "facepipe.h"
+#include "facepipe_livelink.h"
+#include "facepipe_custom.h"
 #include <type_traits>
+#include <bit>
+#include <cstring>
+#include <charconv>
+#include <algorithm>
 
 /*
 * Protocol layout
@@ -12,6 +18,7 @@
 * 
 * First byte of datagram.message[0] is the datagram type (see ToType)
 *	e.g. 'a' = ascii
+*	Live Link Face datagrams are recognized by their version byte and parsed natively, see facepipe_livelink.h
 * 
 * Protocol is a name so that the same socket could be used for other things.
 *	default facepipe
@@ -24,47 +31,75 @@
 *	scene and camera is most likely to be 0 at all times while there can be multiple subjects
 * 
 * Time is a 64 bit floating point value in seconds - either from epoch or application start (does not matter as long as it ticks at normal rate)
+*	it can be followed by an optional sequence number, e.g. 42.3312,1077
+*	sequence numbers count up by one per datagram of a (source, scene, camera, subject, data type) stream, see facepipe_sequence.h
 * 
 * Content is where the packet specific data begins. In facepipe the first word is the type followed by the data:
 *	Landmarks2D: l2d|0.1,0.2,0.3,0.4,...
 *	Landmarks3D: l3d|0.1,0.2,0.3,0.4,0.5,0.6,...
 *	Blendshapes: bs|mouthShrugUpper=0.5|eyeSquint_R=0.2
 *	Matrices:	 mat44|face=0.1,0.2,0.3,0.4,0.5,0.6,0.7,0.8,0.9,1.0,1.1,1.2,1.3,1.4,1.5|eyeL=...|eyeR=...|jaw=...
+*	Dictionary:	 dict|id|mouthShrugUpper,eyeSquint_R,...	(sent once and refreshed periodically, see facepipe_dictionary.h)
+*	BlendshapeValues: bsv|id|0.5,0.2,...			(values in the order of dictionary id)
+*	Mesh:		 mesh|topologyid|0.1,0.2,0.3,...		(xyz per vertex, see facepipe_mesh.h)
+*	MeshTopology: meshtopo|topologyid|vertexcount|0,1,2,2,1,3,...|0.5,0.5,...	(triangle indices, optional uv per vertex)
+*	BlendshapeUpdates: bsu|17=0.5|9=0.2				(ARKit index=value for the blendshapes that changed, see facepipe_sparse.h)
+*	ExpressionBasis: pcabasis|basisid|componentcount|mean...|components...	(sent once and refreshed periodically, see facepipe_pca.h)
+*	ExpressionCoefficients: pca|basisid|0.5,-0.2,...	(blendshapes as coefficients of the basis)
+*	Composite:	 frame|l3d,bs,mat44|12,34,56|<l3d content>|<bs content>|<mat44 content>
+*				 types and byte lengths of each section, followed by the sections separated by |
+*				 e.g. frame|bs,mat44|20,14|jawOpen=0.5|mouthClose=0|face=1,0,0,...
+* 
+* Binary datagrams ('b') carry the same information in a fixed little-endian layout, see BinaryHeader in facepipe.h.
+* Floats are stored raw so the content can be read in-place without any text parsing.
 */
 
+static_assert(std::endian::native == std::endian::little, "Binary datagrams are read in-place and assume a little-endian host");
+
 namespace FacePipe
 {
-	double VectorView::ParseDouble(const std::vector<char>& Message) noexcept
+	// Inserting only happens the first time a name is seen, after that the existing entry is reused
+	template<typename Map>
+	inline typename Map::mapped_type& FindOrAdd(Map& Values, std::string_view Name)
 	{
-		std::string s(Message.begin() + b, Message.begin() + e);
-		char* pEnd = nullptr;
-		double v = std::strtod(s.c_str(), &pEnd);
-		return (*pEnd) ? 0.0f : v;
+		auto It = Values.find(Name);
+		if (It == Values.end())
+			It = Values.emplace(std::string(Name), typename Map::mapped_type()).first;
+
+		return It->second;
 	}
 
-	float VectorView::ParseFloat(const std::vector<char>& Message) noexcept
+	template<typename T>
+	inline T FromChars(const std::vector<char>& Message, size_t b, size_t e) noexcept
 	{
-		return (float)ParseDouble(Message);
+		const char* First = Message.data() + b;
+		const char* Last = Message.data() + e;
+		if (First < Last && *First == '+') // strtod accepted a leading plus, from_chars does not
+			++First;
+
+		T v = T(0);
+		std::from_chars_result Result = std::from_chars(First, Last, v);
+		return (Result.ec != std::errc() || Result.ptr != Last) ? T(0) : v;
 	}
 
-	int VectorView::ParseInt(const std::vector<char>& Message) noexcept
+	double VectorView::ParseDouble(const std::vector<char>& Message) const noexcept
 	{
-		std::string s(Message.begin() + b, Message.begin() + e);
-		char* pEnd = nullptr;
-		int v = (int)std::strtol(s.c_str(), &pEnd, 10); // base 10
-		return (*pEnd) ? 0 : v;
+		return FromChars<double>(Message, b, e);
 	}
 
-	std::vector<float> VectorView::ParseFloatArray(const std::vector<char>& Message)
+	float VectorView::ParseFloat(const std::vector<char>& Message) const noexcept
 	{
-		std::vector<float> values;
-		VectorView SubView(b);
-		while (SubView.NextSubstring(Message, ',', e))
-		{
-			values.push_back(SubView.ParseFloat(Message));
-		}
+		return ParseFloatToken(Message.data() + b, Message.data() + e);
+	}
 
-		return values;
+	int VectorView::ParseInt(const std::vector<char>& Message) const noexcept
+	{
+		return FromChars<int>(Message, b, e);
+	}
+
+	std::vector<float> VectorView::ParseFloatArray(const std::vector<char>& Message)
+	{
+		return ParseArray<float>(Message);
 	}
 
 	bool VectorView::NextSubstring(const std::vector<char>& Message, char Delimiter, size_t End)
@@ -82,55 +117,326 @@ namespace FacePipe
 			b = e;
 		}
 
-		while (e < End)
+		e = FindDelimiter(Message.data() + e, Message.data() + End, Delimiter) - Message.data();
+
+		return true; // end of vector or delimiter
+	}
+
+	bool VectorView::NextNamedValues(const std::vector<char>& Message, size_t End, VectorView& OutName, VectorView& OutValues)
+	{
+		while (NextSubstring(Message, '|', End))
 		{
-			if (Message[e] == Delimiter)
-			{
-				break;
-			}
+			VectorView TupleView(b);
+			if (!TupleView.NextSubstring(Message, '=', e))
+				continue;
 
-			++e;
+			OutName = TupleView;
+			if (!TupleView.NextSubstring(Message, '=', e))
+				continue;
+
+			OutValues = TupleView;
+			return true;
 		}
 
-		return true; // end of vector or delimiter
+		return false;
+	}
+
+	void MessageInfo::Reset()
+	{
+		Scene = 0;
+		Camera = 0;
+		Subject = 0;
+		Source.assign("None");
+		DataType = EFacepipeData::INVALID;
+		Time = 0.0;
+		DatagramType = EDatagramType::Invalid;
+		BinaryFlags = 0;
+		Sequence = 0;
+		bHasSequence = false;
+		ContentView = VectorView();
+	}
+
+	void BlendshapeFrame::Set(std::string_view Name, float Value)
+	{
+		int Index = FindARKitBlendshape(Name);
+		if (Index >= 0)
+			Set((size_t) Index, Value);
+		else
+			FindOrAdd(Other, Name) = Value;
+	}
+
+	bool NamedValuesView::NextName(size_t& Offset, std::string_view& OutName) const
+	{
+		if (Offset >= Names.size())
+			return false;
+
+		size_t Length = (uint8_t) Names[Offset];
+		if (Offset + 1 + Length > Names.size())
+			return false;
+
+		OutName = std::string_view(Names.data() + Offset + 1, Length);
+		Offset += 1 + Length;
+		return true;
 	}
 }
 
 namespace FacePipe
 {
-	bool ParseHeader(const std::vector<char>& Message, MessageInfo& OutInfo)
+	bool ParseBinaryHeader(const std::vector<char>& Message, MessageInfo& OutInfo)
 	{
-		// a|protocol|source|scene,camera,subject|time|content
+		BinaryHeader Header;
+		if (!ReadBinary(Message, 0, Message.size(), Header))
+			return false;
 
-		OutInfo = MessageInfo();
+		if (Header.Protocol[0] != 'f' || Header.Protocol[1] != 'p' || Header.Version != 1)
+			return false;
 
-		if (Message.size() <= 2) // a| - first two characters must exist for us to do anything with this
+		size_t ContentStart = sizeof(BinaryHeader) + ((Header.SourceLength + 3) & ~size_t(3));
+		if (ContentStart > Message.size())
 			return false;
 
-		// First byte is the type
-		EDatagramType Type = EDatagramType::Invalid;
-		switch (Message[0])
+		OutInfo.Source.assign(Message.data() + sizeof(BinaryHeader), Header.SourceLength);
+		OutInfo.Scene = Header.Scene;
+		OutInfo.Camera = Header.Camera;
+		OutInfo.Subject = Header.Subject;
+		OutInfo.Time = Header.Time;
+		OutInfo.BinaryFlags = Header.Flags;
+		OutInfo.Sequence = Header.Sequence;
+		OutInfo.bHasSequence = HasFlag(Header.Flags, EBinaryFlags::Sequenced);
+
+		// Every known data type has a token, including the schemas of CustomSchemas
+		if (!ToToken((EFacepipeData) Header.DataType).empty())
+			OutInfo.DataType = (EFacepipeData) Header.DataType;
+
+		OutInfo.ContentView = VectorView(ContentStart, Message.size());
+		return true;
+	}
+
+	bool ReadQuantizedValues(const std::vector<char>& Message, size_t Offset, size_t End, size_t Count, uint32_t Bits, size_t Components, float* OutValues)
+	{
+		float ScaleOffset[6] = {}; // scale xyz, offset xyz
+		if (!ReadBinary(Message, Offset, End, ScaleOffset))
+			return false;
+
+		const size_t DataStart = Offset + sizeof(ScaleOffset);
+		const size_t DataSize = (Count * Bits + 7) / 8;
+		if (Bits == 0 || Bits > 16 || Components == 0 || Components > 3 || DataStart > End || DataSize > End - DataStart)
+			return false;
+
+		const uint8_t* Data = (const uint8_t*) Message.data() + DataStart;
+
+		if (Bits == 16 && reinterpret_cast<uintptr_t>(Data) % alignof(uint16_t) == 0)
 		{
-		case 'a': { Type = EDatagramType::ASCII; break; }
-		case 'b': { Type = EDatagramType::Bytes; break; }
-		case 's': { Type = EDatagramType::String; break; }
-		case 'w': { Type = EDatagramType::WString; break; }
-		case 'e': { Type = EDatagramType::Encoded; break; }
-		default: { break; }
+			DequantizeLandmarks(reinterpret_cast<const uint16_t*>(Data), Count, Components, ScaleOffset, ScaleOffset + 3, OutValues);
+			return true;
 		}
 
-		if (Type != EDatagramType::ASCII) // we don't support anything else at the moment
+		// Unpack in blocks that are a whole number of points so every block starts on x
+		static const size_t BlockSize = 240;
+		uint16_t Block[BlockSize];
+		const uint32_t Mask = (1u << Bits) - 1;
+		for (size_t BlockStart = 0; BlockStart < Count; BlockStart += BlockSize)
+		{
+			const size_t BlockCount = std::min(BlockSize, Count - BlockStart);
+			for (size_t i = 0; i < BlockCount; ++i)
+			{
+				// 16 bits at any bit offset span at most 3 bytes
+				size_t BitOffset = (BlockStart + i) * Bits;
+				size_t Byte = BitOffset >> 3;
+				uint32_t Word = 0;
+				std::memcpy(&Word, Data + Byte, std::min<size_t>(sizeof(Word), DataSize - Byte));
+				Block[i] = (uint16_t) ((Word >> (BitOffset & 7)) & Mask);
+			}
+
+			DequantizeLandmarks(Block, BlockCount, Components, ScaleOffset, ScaleOffset + 3, OutValues + BlockStart);
+		}
+
+		return true;
+	}
+
+	bool GetQuantizedLandmarks(const std::vector<char>& Message, const MessageInfo& Info, std::vector<float>& OutValues, int& ImageWidth, int& ImageHeight)
+	{
+		uint32_t Dimensions[4] = {}; // width, height, value count, bits
+		if (!ReadBinary(Message, Info.ContentView.b, Info.ContentView.e, Dimensions))
 			return false;
-		
-		VectorView HeaderView(0,1);
-		int index = 0;
+
+		// Validate before resizing so that a bogus count cannot trigger a huge allocation
+		const size_t Count = Dimensions[2];
+		const uint32_t Bits = Dimensions[3];
+		const size_t DataStart = Info.ContentView.b + sizeof(Dimensions) + 6 * sizeof(float);
+		if (Bits == 0 || Bits > 16 || DataStart > Info.ContentView.e || (Count * Bits + 7) / 8 > Info.ContentView.e - DataStart)
+			return false;
+
+		const size_t Components = (Info.DataType == EFacepipeData::Landmarks3D) ? 3 : 2;
+		OutValues.resize(Count);
+		if (!ReadQuantizedValues(Message, Info.ContentView.b + sizeof(Dimensions), Info.ContentView.e, Count, Bits, Components, OutValues.data()))
+			return false;
+
+		ImageWidth = (int) Dimensions[0];
+		ImageHeight = (int) Dimensions[1];
+		return true;
+	}
+
+	bool GetNamedValuesView(const std::vector<char>& Message, const MessageInfo& Info, size_t Stride, NamedValuesView& OutView)
+	{
+		uint32_t Count = 0;
+		if (!ReadBinary(Message, Info.ContentView.b, Info.ContentView.e, Count))
+			return false;
+
+		// ReadBinaryFloats fails for counts that overrun the content, so NamesStart is never beyond ContentView.e
+		size_t ValuesStart = Info.ContentView.b + sizeof(uint32_t);
+		if (!ReadBinaryFloats(Message, ValuesStart, Info.ContentView.e, Count * Stride, OutView.Values))
+			return false;
+
+		size_t NamesStart = ValuesStart + OutView.Values.size_bytes();
+		OutView.Names = std::span<const char>(Message.data() + NamesStart, Info.ContentView.e - NamesStart);
+		OutView.Stride = Stride;
+		return true;
+	}
+}
+
+namespace FacePipe
+{
+	namespace TokenHash
+	{
+		struct Entry
+		{
+			std::string_view Token;
+			EFacepipeData DataType = EFacepipeData::INVALID;
+		};
+
+		inline constexpr Entry BuiltinTokens[] = {
+			{ "bs", EFacepipeData::Blendshapes },
+			{ "l2d", EFacepipeData::Landmarks2D },
+			{ "l3d", EFacepipeData::Landmarks3D },
+			{ "mesh", EFacepipeData::Mesh },
+			{ "mat44", EFacepipeData::Matrices4x4 },
+			{ "dict", EFacepipeData::Dictionary },
+			{ "bsv", EFacepipeData::BlendshapeValues },
+			{ "frame", EFacepipeData::Composite },
+			{ "meshtopo", EFacepipeData::MeshTopology },
+			{ "bsu", EFacepipeData::BlendshapeUpdates },
+			{ "pcabasis", EFacepipeData::ExpressionBasis },
+			{ "pca", EFacepipeData::ExpressionCoefficients },
+			{ "pose", EFacepipeData::Poses },
+		};
+
+		static const size_t MaxTokenLength = 8;
+		static const uint32_t SlotBits = 6;
+		static const uint64_t MaxSeed = 4096;
+
+		// Tokens are at most 8 characters, packed into an integer they are hashed and compared in one go. At runtime
+		// the bytes are read with two overlapping loads instead of a loop, either way the first character ends up lowest.
+		constexpr uint64_t Pack(std::string_view Token)
+		{
+			uint64_t Packed = 0;
+			if (std::is_constant_evaluated() || std::endian::native != std::endian::little || Token.empty())
+			{
+				for (size_t i = 0; i < Token.size(); ++i)
+					Packed |= uint64_t((uint8_t) Token[i]) << (8 * i);
+				return Packed;
+			}
+
+			const uint8_t* Bytes = (const uint8_t*) Token.data();
+			const size_t Size = Token.size();
+			if (Size >= 4)
+			{
+				uint32_t Low, High;
+				std::memcpy(&Low, Bytes, sizeof(Low));
+				std::memcpy(&High, Bytes + Size - 4, sizeof(High));
+				return uint64_t(Low) | (uint64_t(High) << (8 * (Size - 4)));
+			}
+
+			return uint64_t(Bytes[0]) | (uint64_t(Bytes[Size / 2]) << (8 * (Size / 2))) | (uint64_t(Bytes[Size - 1]) << (8 * (Size - 1)));
+		}
+
+		// Multiplicative hash, the top SlotBits select the slot
+		constexpr uint32_t Slot(uint64_t Packed, uint64_t Seed)
+		{
+			return (uint32_t) ((Packed * (Seed * 2 + 1) * 0x9E3779B97F4A7C15ull) >> (64 - SlotBits));
+		}
+
+		struct Table
+		{
+			uint64_t Packed[1 << SlotBits] = {};				// 0 for empty slots, no token packs to 0
+			uint8_t Lengths[1 << SlotBits] = {};				// packing ignores trailing zero bytes
+			EFacepipeData DataTypes[1 << SlotBits] = {};
+			std::string_view Tokens[256] = {};					// indexed by data type
+			uint64_t Seed = 0;
+			bool bPerfect = false;
+			bool bValidTokens = true;
+			bool bUniqueDataTypes = true;
+		};
+
+		// Unlike the ARKit names the tokens grow with CustomSchemas, so the seed is searched for at compile time
+		constexpr Table Build()
+		{
+			Table Result;
+			for (uint64_t Seed = 0; Seed < MaxSeed && !Result.bPerfect; ++Seed)
+			{
+				Result = Table();
+				Result.Seed = Seed;
+				Result.bPerfect = true;
+
+				auto Add = [&](const std::string_view Token, EFacepipeData DataType)
+				{
+					Result.bValidTokens = Result.bValidTokens && !Token.empty() && Token.size() <= MaxTokenLength && Token.find('|') == std::string_view::npos;
+
+					const uint32_t Index = Slot(Pack(Token), Seed);
+					Result.bPerfect = Result.bPerfect && Result.Packed[Index] == 0;
+					Result.Packed[Index] = Pack(Token);
+					Result.Lengths[Index] = (uint8_t) Token.size();
+					Result.DataTypes[Index] = DataType;
+
+					std::string_view& ByType = Result.Tokens[(uint8_t) DataType];
+					Result.bUniqueDataTypes = Result.bUniqueDataTypes && ByType.empty() && DataType != EFacepipeData::INVALID;
+					ByType = Token;
+				};
+
+				for (const Entry& Builtin : BuiltinTokens)
+					Add(Builtin.Token, Builtin.DataType);
+				for (const auto& Custom : CustomSchemas::Tokens)
+					Add(Custom.Token, Custom.DataType);
+
+				if (!Result.bValidTokens || !Result.bUniqueDataTypes)
+					break;
+			}
+
+			return Result;
+		}
+
+		inline constexpr Table Lookup = Build();
+		static_assert(Lookup.bValidTokens, "Tokens are 1-8 characters without '|'");
+		static_assert(Lookup.bUniqueDataTypes, "Every data type needs its own value in EFacepipeData");
+		static_assert(Lookup.bPerfect, "No collision free token hash, a token is probably declared twice");
+	}
+
+	EFacepipeData ToDataType(std::string_view Token)
+	{
+		if (Token.empty() || Token.size() > TokenHash::MaxTokenLength)
+			return EFacepipeData::INVALID;
+
+		const uint64_t Packed = TokenHash::Pack(Token);
+		const uint32_t Index = TokenHash::Slot(Packed, TokenHash::Lookup.Seed);
+		const bool bMatch = TokenHash::Lookup.Packed[Index] == Packed && TokenHash::Lookup.Lengths[Index] == Token.size();
+		return bMatch ? TokenHash::Lookup.DataTypes[Index] : EFacepipeData::INVALID;
+	}
+
+	std::string_view ToToken(EFacepipeData DataType)
+	{
+		return TokenHash::Lookup.Tokens[(uint8_t) DataType];
+	}
+
+	// Tokenizes the ASCII header from the delimiter at HeaderView.e onwards, Index is the number of fields already parsed
+	bool ParseHeaderFields(const std::vector<char>& Message, MessageInfo& OutInfo, VectorView HeaderView, int index, size_t& OutTimeStart)
+	{
 		while (HeaderView.NextSubstring(Message, '|', Message.size()))
 		{
 			switch (++index)
 			{
 				case 1: 
 				{ 
-					if (HeaderView.String(Message) != "facepipe")
+					if (HeaderView.StringView(Message) != "facepipe")
 					{
 						return false;
 					}
@@ -138,13 +444,13 @@ namespace FacePipe
 				}
 				case 2: 
 				{ 
-					OutInfo.Source = HeaderView.String(Message); 
+					OutInfo.Source.assign(HeaderView.StringView(Message));
 					break;
 				}
 				case 3: 
 				{
-					std::vector<int> channels = HeaderView.ParseArray<int>(Message);
-					if (channels.size() != 3)
+					int channels[3] = {};
+					if (HeaderView.ParseArray(Message, channels, 3) != 3)
 					{
 						return false;
 					}
@@ -155,25 +461,38 @@ namespace FacePipe
 				}
 				case 4:
 				{
-					OutInfo.Time = HeaderView.ParseDouble(Message);
+					// time[,sequence]
+					OutTimeStart = HeaderView.b;
+					VectorView TimeView(HeaderView.b);
+					if (TimeView.NextSubstring(Message, ',', HeaderView.e))
+						OutInfo.Time = TimeView.ParseDouble(Message);
+
+					if (TimeView.NextSubstring(Message, ',', HeaderView.e))
+					{
+						uint32_t Sequence = 0;
+						const char* Last = Message.data() + TimeView.e;
+						std::from_chars_result Result = std::from_chars(Message.data() + TimeView.b, Last, Sequence);
+						if (Result.ec != std::errc() || Result.ptr != Last)
+							return false;
+
+						OutInfo.Sequence = Sequence;
+						OutInfo.bHasSequence = true;
+					}
 					break;
 				}
 				case 5:
 				{
-					std::string type = HeaderView.String(Message);
-					if (type == "l2d")
-						OutInfo.DataType = EFacepipeData::Landmarks2D;
-					else if (type == "l3d")
-						OutInfo.DataType = EFacepipeData::Landmarks3D;
-					else if (type == "bs")
-						OutInfo.DataType = EFacepipeData::Blendshapes;
-					else if (type == "mat44")
-						OutInfo.DataType = EFacepipeData::Matrices4x4;
+					OutInfo.DataType = ToDataType(HeaderView.StringView(Message));
 					break;
 				}
 				case 6:
 				{
-					OutInfo.ContentView = VectorView(HeaderView.b, Message.size());
+					// Receivers that null terminate the datagram (e.g. the Unreal plugin) must not have the terminator parsed as part of the last value
+					size_t ContentEnd = Message.size();
+					if (Message.back() == '\0')
+						--ContentEnd;
+
+					OutInfo.ContentView = VectorView(HeaderView.b, ContentEnd);
 					return true;
 				}
 			}
@@ -182,26 +501,121 @@ namespace FacePipe
 		return false; // only when we reach case 6 are we successful
 	}
 
-	bool GetBlendshapes(const std::vector<char>& Message, const MessageInfo& Info, std::map<std::string, float>& OutBlendshapes)
+	bool ParseHeader(const std::vector<char>& Message, MessageInfo& OutInfo)
+	{
+		// a|protocol|source|scene,camera,subject|time|content
+
+		OutInfo.Reset();
+
+		if (Message.size() <= 2) // a| - first two characters must exist for us to do anything with this
+			return false;
+
+		// First byte is the type
+		EDatagramType Type = EDatagramType::Invalid;
+		switch (Message[0])
+		{
+		case 'a': { Type = EDatagramType::ASCII; break; }
+		case 'b': { Type = EDatagramType::Bytes; break; }
+		case 's': { Type = EDatagramType::String; break; }
+		case 'w': { Type = EDatagramType::WString; break; }
+		case 'e': { Type = EDatagramType::Encoded; break; }
+		case 'f': { Type = EDatagramType::Fragment; break; }
+		case 'p': { Type = EDatagramType::Parity; break; }
+		case 'r': { Type = EDatagramType::Report; break; }
+		case LiveLinkFaceVersion: { Type = EDatagramType::LiveLinkFace; break; }
+		default: { break; }
+		}
+
+		OutInfo.DatagramType = Type;
+
+		if (Type == EDatagramType::Bytes)
+			return ParseBinaryHeader(Message, OutInfo);
+
+		if (Type == EDatagramType::LiveLinkFace)
+			return ParseLiveLinkFaceHeader(Message, OutInfo);
+
+		if (Type != EDatagramType::ASCII) // we don't support anything else at the moment
+			return false;
+		
+		size_t TimeStart = 0;
+		return ParseHeaderFields(Message, OutInfo, VectorView(0,1), 0, TimeStart);
+	}
+
+	bool ParseHeader(const std::vector<char>& Message, MessageInfo& OutInfo, HeaderPrefixCache& Cache)
+	{
+		// Steady state senders repeat "a|facepipe|source|scene,camera,subject|", only time and content have to be parsed
+		for (HeaderPrefixCache::Entry& Entry : Cache.Entries)
+		{
+			const size_t Length = Entry.Prefix.size();
+			if (Length == 0 || Message.size() <= Length || std::memcmp(Message.data(), Entry.Prefix.data(), Length) != 0)
+				continue;
+
+			OutInfo.Reset();
+			OutInfo.DatagramType = EDatagramType::ASCII;
+			OutInfo.Source.assign(Entry.Source);
+			OutInfo.Scene = Entry.Scene;
+			OutInfo.Camera = Entry.Camera;
+			OutInfo.Subject = Entry.Subject;
+
+			size_t TimeStart = 0;
+			return ParseHeaderFields(Message, OutInfo, VectorView(Length - 2, Length - 1), 3, TimeStart);
+		}
+
+		if (Message.empty() || Message[0] != 'a')
+			return ParseHeader(Message, OutInfo);
+
+		OutInfo.Reset();
+		OutInfo.DatagramType = EDatagramType::ASCII;
+
+		size_t TimeStart = 0;
+		if (!ParseHeaderFields(Message, OutInfo, VectorView(0,1), 0, TimeStart))
+			return false;
+
+		// Replace entries round robin, a sender with more subjects than entries still parses correctly but misses the cache
+		HeaderPrefixCache::Entry& Entry = Cache.Entries[Cache.NextEntry];
+		Cache.NextEntry = (Cache.NextEntry + 1) % HeaderPrefixCache::EntryCount;
+
+		Entry.Prefix.assign(Message.begin(), Message.begin() + TimeStart);
+		Entry.Source.assign(OutInfo.Source);
+		Entry.Scene = OutInfo.Scene;
+		Entry.Camera = OutInfo.Camera;
+		Entry.Subject = OutInfo.Subject;
+		return true;
+	}
+
+	bool GetBlendshapes(const std::vector<char>& Message, const MessageInfo& Info, BlendshapeFrame& OutBlendshapes)
 	{
 		if (Info.DataType != EFacepipeData::Blendshapes)
 			return false;
 
-		VectorView BSView(Info.ContentView.b);
-		while (BSView.NextSubstring(Message, '|', Info.ContentView.e))
+		if (Info.DatagramType == EDatagramType::LiveLinkFace)
+			return GetLiveLinkFaceBlendshapes(Message, Info, OutBlendshapes);
+
+		if (Info.DatagramType == EDatagramType::Bytes)
 		{
-			VectorView TupleView(BSView.b);
-			if (TupleView.NextSubstring(Message, '=', BSView.e))
+			NamedValuesView View;
+			if (!GetBlendshapesView(Message, Info, View))
+				return false;
+
+			size_t NameOffset = 0;
+			std::string_view Name;
+			for (float Value : View.Values)
 			{
-				std::string Name = TupleView.String(Message);
+				if (!View.NextName(NameOffset, Name))
+					return false;
 
-				if (TupleView.NextSubstring(Message, '=', BSView.e))
-				{
-					OutBlendshapes[Name] = TupleView.ParseFloat(Message);
-				}
+				OutBlendshapes.Set(Name, Value);
 			}
+
+			return true;
 		}
-		
+
+		VectorView BSView(Info.ContentView.b), NameView, ValueView;
+		while (BSView.NextNamedValues(Message, Info.ContentView.e, NameView, ValueView))
+		{
+			OutBlendshapes.Set(NameView.StringView(Message), ValueView.ParseFloat(Message));
+		}
+
 		return true;
 	}
 
@@ -210,12 +624,32 @@ namespace FacePipe
 		if (Info.DataType != EFacepipeData::Landmarks2D && Info.DataType != EFacepipeData::Landmarks3D)
 			return false;
 
+		if (Info.DatagramType == EDatagramType::Bytes && HasFlag(Info.BinaryFlags, EBinaryFlags::Delta))
+			return false; // needs the keyframe, see LandmarkDeltaDecoder
+
+		if (Info.DatagramType == EDatagramType::Bytes && HasFlag(Info.BinaryFlags, EBinaryFlags::Quantized))
+		{
+			return GetQuantizedLandmarks(Message, Info, OutValues, ImageWidth, ImageHeight);
+		}
+
+		if (Info.DatagramType == EDatagramType::Bytes)
+		{
+			LandmarksView View;
+			if (!GetLandmarksView(Message, Info, View))
+				return false;
+
+			ImageWidth = View.ImageWidth;
+			ImageHeight = View.ImageHeight;
+			OutValues.assign(View.Values.begin(), View.Values.end());
+			return true;
+		}
+
 		VectorView LandmarkView(Info.ContentView.b);
 		if (!LandmarkView.NextSubstring(Message, '|', Info.ContentView.e))
 			return false;
 
-		std::vector<int> ImageDimensions = LandmarkView.ParseArray<int>(Message);
-		if (ImageDimensions.size() != 2)
+		int ImageDimensions[2] = {};
+		if (LandmarkView.ParseArray(Message, ImageDimensions, 2) != 2)
 			return false;
 		ImageWidth = ImageDimensions[0];
 		ImageHeight = ImageDimensions[1];
@@ -223,31 +657,143 @@ namespace FacePipe
 		if (!LandmarkView.NextSubstring(Message, '|', Info.ContentView.e))
 			return false;
 
-		OutValues = LandmarkView.ParseArray<float>(Message);
+		LandmarkView.ParseArray(Message, OutValues);
 
 		return true;
 	}
 
-	bool GetMatrices(const std::vector<char>& Message, const MessageInfo& Info, std::map<std::string, std::vector<float>>& OutMatrices)
+	bool GetMatrices(const std::vector<char>& Message, const MessageInfo& Info, MatrixMap& OutMatrices)
 	{
 		if (Info.DataType != EFacepipeData::Matrices4x4)
 			return false;
 
-		VectorView MatView(Info.ContentView.b);
-		while (MatView.NextSubstring(Message, '|', Info.ContentView.e))
+		if (Info.DatagramType == EDatagramType::Bytes)
 		{
-			VectorView TupleView(MatView.b);
-			if (TupleView.NextSubstring(Message, '=', MatView.e))
+			NamedValuesView View;
+			if (!GetMatricesView(Message, Info, View))
+				return false;
+
+			size_t NameOffset = 0;
+			std::string_view Name;
+			for (size_t i = 0; i < View.Values.size(); i += View.Stride)
 			{
-				std::string Name = TupleView.String(Message);
+				if (!View.NextName(NameOffset, Name))
+					return false;
 
-				if (TupleView.NextSubstring(Message, '=', MatView.e))
-				{
-					OutMatrices[Name] = TupleView.ParseFloatArray(Message);
-				}
+				FindOrAdd(OutMatrices, Name).assign(View.Values.begin() + i, View.Values.begin() + i + View.Stride);
 			}
+
+			return true;
+		}
+
+		VectorView MatView(Info.ContentView.b), NameView, ValuesView;
+		while (MatView.NextNamedValues(Message, Info.ContentView.e, NameView, ValuesView))
+		{
+			ValuesView.ParseArray(Message, FindOrAdd(OutMatrices, NameView.StringView(Message)));
 		}
 
 		return true;
 	}
+
+	bool GetLandmarksView(const std::vector<char>& Message, const MessageInfo& Info, LandmarksView& OutView)
+	{
+		if (Info.DatagramType != EDatagramType::Bytes || HasFlag(Info.BinaryFlags, EBinaryFlags::Quantized) || HasFlag(Info.BinaryFlags, EBinaryFlags::Delta))
+			return false;
+
+		if (Info.DataType != EFacepipeData::Landmarks2D && Info.DataType != EFacepipeData::Landmarks3D)
+			return false;
+
+		uint32_t Dimensions[4] = {}; // width, height, value count, reserved
+		if (!ReadBinary(Message, Info.ContentView.b, Info.ContentView.e, Dimensions))
+			return false;
+
+		OutView.ImageWidth = (int) Dimensions[0];
+		OutView.ImageHeight = (int) Dimensions[1];
+		return ReadBinaryFloats(Message, Info.ContentView.b + sizeof(Dimensions), Info.ContentView.e, Dimensions[2], OutView.Values);
+	}
+
+	bool GetBlendshapesView(const std::vector<char>& Message, const MessageInfo& Info, NamedValuesView& OutView)
+	{
+		if (Info.DatagramType != EDatagramType::Bytes || Info.DataType != EFacepipeData::Blendshapes)
+			return false;
+
+		return GetNamedValuesView(Message, Info, 1, OutView);
+	}
+
+	bool GetMatricesView(const std::vector<char>& Message, const MessageInfo& Info, NamedValuesView& OutView)
+	{
+		if (Info.DatagramType != EDatagramType::Bytes || Info.DataType != EFacepipeData::Matrices4x4)
+			return false;
+
+		return GetNamedValuesView(Message, Info, 16, OutView);
+	}
+
+	bool GetSection(const std::vector<char>& Message, const MessageInfo& Info, size_t Index, MessageInfo& OutSection)
+	{
+		if (Info.DataType != EFacepipeData::Composite)
+			return false;
+
+		if (Info.DatagramType == EDatagramType::Bytes)
+		{
+			uint32_t Count = 0;
+			CompositeSection Section;
+			if (!ReadBinary(Message, Info.ContentView.b, Info.ContentView.e, Count) || Index >= Count)
+				return false;
+
+			if (!ReadBinary(Message, Info.ContentView.b + sizeof(uint32_t) + Index * sizeof(CompositeSection), Info.ContentView.e, Section))
+				return false;
+
+			size_t Begin = Info.ContentView.b + Section.Offset;
+			if (Section.Offset > Info.ContentView.e - Info.ContentView.b || Section.Size > Info.ContentView.e - Begin)
+				return false;
+
+			OutSection = Info;
+			OutSection.DataType = (EFacepipeData) Section.DataType;
+			OutSection.BinaryFlags = Section.Flags;
+			OutSection.ContentView = VectorView(Begin, Begin + Section.Size);
+			return OutSection.DataType != EFacepipeData::Composite;
+		}
+
+		// frame|types|lengths|sections
+		VectorView TypesView(Info.ContentView.b);
+		if (!TypesView.NextSubstring(Message, '|', Info.ContentView.e))
+			return false;
+
+		VectorView LengthsView(TypesView.e);
+		if (!LengthsView.NextSubstring(Message, '|', Info.ContentView.e))
+			return false;
+
+		VectorView TypeView(TypesView.b);
+		VectorView LengthView(LengthsView.b);
+		size_t Begin = LengthsView.e + 1;
+		for (size_t i = 0; TypeView.NextSubstring(Message, ',', TypesView.e) && LengthView.NextSubstring(Message, ',', LengthsView.e); ++i)
+		{
+			int Length = LengthView.ParseInt(Message);
+			if (Length < 0 || Begin + Length > Info.ContentView.e)
+				return false;
+
+			if (i == Index)
+			{
+				OutSection = Info;
+				OutSection.DataType = ToDataType(TypeView.StringView(Message));
+				OutSection.ContentView = VectorView(Begin, Begin + Length);
+				return OutSection.DataType != EFacepipeData::Composite;
+			}
+
+			Begin += Length + 1; // sections are separated by |
+		}
+
+		return false;
+	}
+
+	bool FindSection(const std::vector<char>& Message, const MessageInfo& Info, EFacepipeData DataType, MessageInfo& OutSection)
+	{
+		for (size_t i = 0; GetSection(Message, Info, i, OutSection); ++i)
+		{
+			if (OutSection.DataType == DataType)
+				return true;
+		}
+
+		return false;
+	}
 }
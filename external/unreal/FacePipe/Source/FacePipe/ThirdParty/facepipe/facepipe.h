@@ -2,8 +2,14 @@
 
 #include <stdint.h>
 #include <string>
+#include <string_view>
 #include <vector>
 #include <map>
+#include <span>
+#include <cstring>
+
+#include "facepipe_simd.h"
+#include "facepipe_blendshapes.h"
 
 namespace FacePipe
 {
@@ -22,8 +28,17 @@ namespace FacePipe
 		Blendshapes = 0,
 		Landmarks2D = 1,
 		Landmarks3D = 2,
-		Mesh = 3,
+		Mesh = 3,				// Vertex positions of a MeshTopology, see facepipe_mesh.h
 		Matrices4x4 = 4,
+		Dictionary = 5,			// Channel names announced once per source, referenced by id
+		BlendshapeValues = 6,	// Blendshape values only, names come from a Dictionary
+		Composite = 7,			// Several of the above for the same subject and frame in one datagram
+		MeshTopology = 8,		// Triangles and UVs of a Mesh, sent once under a content hash
+		BlendshapeUpdates = 9,	// Only the blendshapes that changed, merged into the last full Blendshapes, see facepipe_sparse.h
+		ExpressionBasis = 10,	// Mean and principal components of the blendshapes, sent once under a content hash
+		ExpressionCoefficients = 11, // Blendshapes as coefficients of an ExpressionBasis, see facepipe_pca.h
+		Gaze = 12,				// Eye gaze directions, declared as a schema in facepipe_custom.h
+		Poses = 13,				// Quaternion, translation and scale per name, the compact alternative to Matrices4x4, see facepipe_pose.h
 
 		INVALID = 255
 	};
@@ -35,8 +50,12 @@ namespace FacePipe
 		Bytes = 2,
 		String = 3,
 		WString = 4,
-		Encoded = 5,
-		MAX = 6
+		Encoded = 5,	// Compressed datagram, see facepipe_envelope.h
+		Fragment = 6,	// Part of a larger datagram, see facepipe_fragment.h
+		Parity = 7,		// Datagram of a group protected by an XOR parity datagram, see facepipe_fec.h
+		LiveLinkFace = 8, // Blendshapes in the binary format of Live Link Face, see facepipe_livelink.h
+		Report = 9,		// Sent back by receivers to adapt the encoding of the sender, see facepipe_feedback.h
+		MAX = 10
 	};
 
 	// similar intention as std::string_view but it is actually supported...
@@ -52,31 +71,183 @@ namespace FacePipe
 			return std::string(Message.begin() + b, Message.begin() + e);
 		}
 
-		double ParseDouble(const std::vector<char>& Message) noexcept;
-		float ParseFloat(const std::vector<char>& Message) noexcept;
-		int ParseInt(const std::vector<char>& Message) noexcept;
+		inline std::string_view StringView(const std::vector<char>& Message) const
+		{
+			return std::string_view(Message.data() + b, e - b);
+		}
+
+		// Parsing is done in-place with std::from_chars, the functions never allocate
+		double ParseDouble(const std::vector<char>& Message) const noexcept;
+		float ParseFloat(const std::vector<char>& Message) const noexcept;
+		int ParseInt(const std::vector<char>& Message) const noexcept;
 		std::vector<float> ParseFloatArray(const std::vector<char>& Message);
 
 		template<typename T>
-		std::vector<T> ParseArray(const std::vector<char>& Message)
+		T ParseValue(const std::vector<char>& Message) const noexcept
 		{
-			std::vector<T> values;
+			if constexpr (std::is_same<T, float>())
+				return ParseFloat(Message);
+			else if constexpr (std::is_same<T, double>())
+				return ParseDouble(Message);
+			else if constexpr (std::is_same<T, int>())
+				return ParseInt(Message);
+		}
+
+		// Reuses the capacity of OutValues, only allocates if the array grows beyond what it has seen before
+		template<typename T>
+		size_t ParseArray(const std::vector<char>& Message, std::vector<T>& OutValues)
+		{
+			if constexpr (std::is_same<T, float>())
+			{
+				ParseFloatList(Message.data() + b, Message.data() + e, OutValues);
+				return OutValues.size();
+			}
+
+			OutValues.clear();
 			VectorView SubView(b);
 			while (SubView.NextSubstring(Message, ',', e))
 			{
-				if constexpr (std::is_same<T, float>())
-					values.push_back(SubView.ParseFloat(Message));
-				else if constexpr (std::is_same<T, double>())
-					values.push_back(SubView.ParseDouble(Message));
-				else if constexpr (std::is_same<T, int>())
-					values.push_back(SubView.ParseInt(Message));
+				OutValues.push_back(SubView.ParseValue<T>(Message));
 			}
 
+			return OutValues.size();
+		}
+
+		// Writes at most Capacity values, returns the number of values in the array (can be greater than Capacity)
+		template<typename T>
+		size_t ParseArray(const std::vector<char>& Message, T* OutValues, size_t Capacity)
+		{
+			size_t Count = 0;
+			VectorView SubView(b);
+			while (SubView.NextSubstring(Message, ',', e))
+			{
+				if (Count < Capacity)
+					OutValues[Count] = SubView.ParseValue<T>(Message);
+				++Count;
+			}
+
+			return Count;
+		}
+
+		template<typename T>
+		std::vector<T> ParseArray(const std::vector<char>& Message)
+		{
+			std::vector<T> values;
+			ParseArray(Message, values);
 			return values;
 		}
 
 		bool NextSubstring(const std::vector<char>& Message, char Delimiter, size_t End);
+
+		// Steps over the name=values tuples of an ASCII bs or mat44 content ("jawOpen=0.5|mouthClose=0.1"), tuples
+		// without a value are skipped. Returns false when there are no more tuples before End.
+		bool NextNamedValues(const std::vector<char>& Message, size_t End, VectorView& OutName, VectorView& OutValues);
+	};
+
+	/*
+	* Binary ('b') datagram layout, all values little-endian
+	* 
+	* BinaryHeader (32 bytes) | source name (SourceLength bytes, zero padded to 4 byte alignment) | content
+	* 
+	* Content is fixed-layout per data type so that float payloads can be read in-place:
+	*	Landmarks2D/3D: u32 ImageWidth, u32 ImageHeight, u32 ValueCount, u32 Reserved | f32[ValueCount]
+	*		Quantized:	u32 ImageWidth, u32 ImageHeight, u32 ValueCount, u32 Bits | f32 Scale[3], f32 Offset[3] | packed values
+	*					Bits is 1-16, values are packed LSB first and value = q * Scale[axis] + Offset[axis]
+	*		Delta:		u32 ImageWidth, u32 ImageHeight, u32 ValueCount, u32 Bits | u32 KeyframeSequence, u32 Reserved | quantized as above
+	*					the packed values are differences to the Keyframe landmarks with that sequence number (see facepipe_delta.h)
+	*	Blendshapes:	u32 Count | f32[Count] | Count x (u8 NameLength, char[NameLength])
+	*	Matrices4x4:	u32 Count | f32[16*Count] | Count x (u8 NameLength, char[NameLength])
+	*	Dictionary:		u32 DictionaryId, u32 Count | Count x (u8 NameLength, char[NameLength])
+	*	BlendshapeValues: u32 DictionaryId, u32 Count | f32[Count]
+	*	Mesh:			u32 TopologyId, u32 VertexCount, u32 Reserved, u32 Bits | f32[3*VertexCount]
+	*		Quantized:	same header, Bits is 1-16 | f32 Scale[3], f32 Offset[3] | packed values as for landmarks
+	*	MeshTopology:	u32 TopologyId, u32 VertexCount, u32 IndexCount, u32 UVCount | u32[IndexCount] | f32[2*UVCount]
+	*	BlendshapeUpdates: u32 Count | f32[Count] | u8 ARKitIndex[Count]
+	*	ExpressionBasis: u32 BasisId, u32 ComponentCount, u32 ChannelCount, u32 Reserved | f32 Mean[ChannelCount] | f32[ComponentCount*ChannelCount]
+	*	ExpressionCoefficients: u32 BasisId, u32 Count | f32[Count]
+	*	Poses:			u32 Count | Count x (f32 Rotation[4], f32 Translation[3], f32 Scale) | Count x (u8 NameLength, char[NameLength])
+	*		Quantized:	u32 Count | Count x (u32 Rotation, f32 Translation[3], f32 Scale) | names as above, smallest-three rotations (see facepipe_pose.h)
+	*	Gaze and other schemas: their fields in declaration order, see facepipe_schema.h
+	*	Composite:		u32 SectionCount | SectionCount x CompositeSection | sections, each 4 byte aligned
+	*					section content has the same layout as the standalone content of its data type
+	*/
+	enum class EBinaryFlags : uint16_t
+	{
+		None = 0,
+		Quantized = 1 << 0,	// Landmarks are stored as quantized integers instead of raw floats
+		Sequenced = 1 << 1,	// BinaryHeader::Sequence is set
+		Keyframe = 1 << 2,	// Landmarks that following Delta landmarks of the stream refer to, readable like any other landmarks
+		Delta = 1 << 3,		// Landmarks relative to a Keyframe, can only be decoded by a LandmarkDeltaDecoder
+	};
+
+	struct BinaryHeader
+	{
+		char Type = 'b';
+		char Protocol[2] = { 'f', 'p' };
+		uint8_t Version = 1;
+		uint8_t DataType = (uint8_t) EFacepipeData::INVALID;
+		uint8_t SourceLength = 0;
+		uint16_t Flags = 0;
+		uint16_t Scene = 0;
+		uint16_t Camera = 0;
+		uint16_t Subject = 0;
+		uint16_t Reserved0 = 0;
+		uint32_t Sequence = 0;	// only valid with EBinaryFlags::Sequenced
+		uint32_t Reserved2 = 0;
+		double Time = 0.0;
+	};
+	static_assert(sizeof(BinaryHeader) == 32, "BinaryHeader must match the wire layout");
+
+	// Helpers for reading binary content, Offset is relative to the start of the datagram. End is where the content
+	// ends (ContentView.e), a composite section must fail instead of reading into the section that follows it.
+	template<typename T>
+	inline bool ReadBinary(const std::vector<char>& Message, size_t Offset, size_t End, T& OutValue)
+	{
+		if (End > Message.size() || Offset > End || sizeof(T) > End - Offset)
+			return false;
+
+		std::memcpy(&OutValue, Message.data() + Offset, sizeof(T));
+		return true;
+	}
+
+	inline bool ReadBinaryFloats(const std::vector<char>& Message, size_t Offset, size_t End, size_t Count, std::span<const float>& OutValues)
+	{
+		if (End > Message.size() || Offset > End || Count > (End - Offset) / sizeof(float))
+			return false;
+
+		// The content is 4 byte aligned relative to the start of the datagram, so this only fails for unaligned buffers
+		const char* Data = Message.data() + Offset;
+		if (reinterpret_cast<uintptr_t>(Data) % alignof(float) != 0)
+			return false;
+
+		OutValues = std::span<const float>(reinterpret_cast<const float*>(Data), Count);
+		return true;
+	}
+
+	// Decodes Count quantized values stored at Offset as f32 Scale[3], f32 Offset[3] | packed values (see Landmarks above)
+	bool ReadQuantizedValues(const std::vector<char>& Message, size_t Offset, size_t End, size_t Count, uint32_t Bits, size_t Components, float* OutValues);
+
+	// FNV-1a step, content ids (mesh topologies, expression bases) hash their little-endian bytes starting from 2166136261
+	inline uint32_t HashBytes(uint32_t Hash, const void* Data, size_t Size)
+	{
+		const uint8_t* Bytes = (const uint8_t*) Data;
+		for (size_t i = 0; i < Size; ++i)
+		{
+			Hash ^= Bytes[i];
+			Hash *= 16777619u;
+		}
+		return Hash;
+	}
+
+	struct CompositeSection
+	{
+		uint8_t DataType = (uint8_t) EFacepipeData::INVALID;
+		uint8_t Reserved = 0;
+		uint16_t Flags = 0;		// EBinaryFlags for this section
+		uint32_t Offset = 0;	// relative to the start of the composite content
+		uint32_t Size = 0;
 	};
+	static_assert(sizeof(CompositeSection) == 12, "CompositeSection must match the wire layout");
 
 	struct MessageInfo
 	{
@@ -88,26 +259,145 @@ namespace FacePipe
 		EFacepipeData DataType = EFacepipeData::INVALID;	// What the data contains
 		double Time = 0.0;									// When the message was sent on the source side
 
+		EDatagramType DatagramType = EDatagramType::Invalid;	// Encoding of the datagram, decides how content is parsed
+		uint16_t BinaryFlags = 0;							// EBinaryFlags, only used by binary datagrams
 		VectorView ContentView;								// Range in message where content should be parsed
+
+		uint32_t Sequence = 0;								// Per stream datagram counter of the source, only valid if bHasSequence
+		bool bHasSequence = false;
+
+		// Resets all fields but keeps the capacity of Source so that reparsing does not allocate
+		void Reset();
+	};
+
+	// Identifies one subject of one source, used as key by the receiver side caches
+	struct SubjectKey
+	{
+		std::string Source;
+		int Scene = 0;
+		int Camera = 0;
+		int Subject = 0;
+
+		inline void Assign(const MessageInfo& Info)
+		{
+			Source.assign(Info.Source);
+			Scene = Info.Scene;
+			Camera = Info.Camera;
+			Subject = Info.Subject;
+		}
+
+		inline bool Matches(const MessageInfo& Info) const
+		{
+			return Scene == Info.Scene && Camera == Info.Camera && Subject == Info.Subject && Source == Info.Source;
+		}
+	};
+
+	// Transparent comparators so that lookups by std::string_view do not allocate a key
+	using BlendshapeMap = std::map<std::string, float, std::less<>>;
+	using MatrixMap = std::map<std::string, std::vector<float>, std::less<>>;
+
+	struct Pose
+	{
+		float Rotation[4] = { 0.0f, 0.0f, 0.0f, 1.0f };	// unit quaternion x, y, z, w
+		float Translation[3] = { 0.0f, 0.0f, 0.0f };	// in the units of the sender
+		float Scale = 1.0f;
+	};
+
+	using PoseMap = std::map<std::string, Pose, std::less<>>;
+
+	// Blendshapes stored densely in ARKit order, names outside of the ARKit set (e.g. MediaPipe _neutral) end up in Other
+	struct BlendshapeFrame
+	{
+		float Values[ARKitBlendshapeCount] = {};
+		uint64_t ValidMask = 0; // bit i is set once Values[i] has been received
+		BlendshapeMap Other;
+
+		void Set(std::string_view Name, float Value);
+		inline void Set(size_t Index, float Value) { Values[Index] = Value; ValidMask |= uint64_t(1) << Index; }
+		inline bool IsValid(size_t Index) const { return (ValidMask >> Index) & 1; }
 	};
 
+	inline bool HasFlag(uint16_t Flags, EBinaryFlags Flag) { return (Flags & (uint16_t) Flag) != 0; }
+
 	struct Frame
 	{
 		MessageInfo Meta;
-		std::map<std::string, float> Blendshapes;
-		std::map<std::string, std::vector<float>> Matrices;
+		BlendshapeFrame Blendshapes;
+		MatrixMap Matrices;
+		PoseMap Poses;
 		std::vector<float> Landmarks;
 
 		int ImageWidth = 0;
 		int ImageHeight = 0;
+
+		uint32_t MeshTopologyId = 0; // topology of the last applied Mesh, the positions live in the receiver's mesh
+	};
+
+	// Views into a binary datagram - only valid as long as the message is alive and unchanged
+	struct LandmarksView
+	{
+		std::span<const float> Values;
+		int ImageWidth = 0;
+		int ImageHeight = 0;
+	};
+
+	struct NamedValuesView
+	{
+		std::span<const float> Values;	// Stride floats per name
+		std::span<const char> Names;	// Count x (u8 NameLength, char[NameLength])
+		size_t Stride = 1;
+
+		// Offset starts at 0, returns false when there are no more names
+		bool NextName(size_t& Offset, std::string_view& OutName) const;
 	};
 }
 
 namespace FacePipe
 {
+	// The parse functions write into caller-owned storage. When the same outputs are reused between packets
+	// (e.g. a persistent Frame) steady state parsing of ASCII and binary datagrams does not allocate.
 	bool ParseHeader(const std::vector<char>& Message, MessageInfo& OutMeta);
 
-	bool GetBlendshapes(const std::vector<char>& Message, const MessageInfo& Info, std::map<std::string, float>& OutBlendshapes);
+	// Header prefixes ("a|facepipe|mediapipe|0,0,0|") recently parsed from one sender
+	struct HeaderPrefixCache
+	{
+		static const size_t EntryCount = 4; // one entry per subject the sender streams
+
+		struct Entry
+		{
+			std::vector<char> Prefix; // everything before the time field
+			std::string Source;
+			int Scene = 0;
+			int Camera = 0;
+			int Subject = 0;
+		};
+
+		Entry Entries[EntryCount];
+		size_t NextEntry = 0;
+	};
+
+	// Same result as ParseHeader. ASCII datagrams that start with a cached prefix are validated with a memcmp
+	// and only the time and content fields are parsed, other datagrams take the full parse and update the cache.
+	bool ParseHeader(const std::vector<char>& Message, MessageInfo& OutMeta, HeaderPrefixCache& Cache);
+
+	// Type token of the ASCII protocol, e.g. "l3d" => Landmarks3D, INVALID if unknown. Knows the schemas of facepipe_custom.h as well.
+	EFacepipeData ToDataType(std::string_view Token);
+	std::string_view ToToken(EFacepipeData DataType);
+
+	// Composite datagrams: OutSection gets the header of Info with DataType and ContentView narrowed to the section,
+	// so it can be passed straight to the Get* functions. Sections are looked up by index or by data type.
+	bool GetSection(const std::vector<char>& Message, const MessageInfo& Info, size_t Index, MessageInfo& OutSection);
+	bool FindSection(const std::vector<char>& Message, const MessageInfo& Info, EFacepipeData DataType, MessageInfo& OutSection);
+
+	bool GetBlendshapes(const std::vector<char>& Message, const MessageInfo& Info, BlendshapeFrame& OutBlendshapes);
 	bool GetLandmarks(const std::vector<char>& Message, const MessageInfo& Info, std::vector<float>& OutValues, int& ImageWidth, int& ImageHeight);
-	bool GetMatrices(const std::vector<char>& Message, const MessageInfo& Info, std::map<std::string, std::vector<float>>& OutMatrices);
+	bool GetMatrices(const std::vector<char>& Message, const MessageInfo& Info, MatrixMap& OutMatrices);
+
+	// Zero-copy access for binary datagrams, the views point into Message (quantized landmarks have no float view)
+	bool GetLandmarksView(const std::vector<char>& Message, const MessageInfo& Info, LandmarksView& OutView);
+	bool GetBlendshapesView(const std::vector<char>& Message, const MessageInfo& Info, NamedValuesView& OutView);
+	bool GetMatricesView(const std::vector<char>& Message, const MessageInfo& Info, NamedValuesView& OutView);
+
+	// The shared layout of the above and Poses: u32 Count | Count x Stride 4 byte values | Count names
+	bool GetNamedValuesView(const std::vector<char>& Message, const MessageInfo& Info, size_t Stride, NamedValuesView& OutView);
 }
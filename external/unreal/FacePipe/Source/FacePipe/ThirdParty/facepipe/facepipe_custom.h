@@ -0,0 +1,25 @@
+#pragma once
+
+#include "facepipe_schema.h"
+
+/*
+* Payloads declared as schemas (see facepipe_schema.h). Adding one takes a value in EFacepipeData, the struct below
+* and an entry in CustomSchemas, the parser, the encoder and the receivers of the app and the Unreal plugin pick it up from there.
+*/
+
+namespace FacePipe
+{
+	// Eye gaze from an eye tracker, unit direction vectors in the coordinate system of the sender
+	struct GazeData
+	{
+		float Left[3] = { 0.0f, 0.0f, 0.0f };
+		float Right[3] = { 0.0f, 0.0f, 0.0f };
+		float Confidence = 0.0f;	// 0-1
+
+		static constexpr EFacepipeData DataType = EFacepipeData::Gaze;
+		static constexpr std::string_view Token = "gaze";
+		static constexpr auto Fields() { return std::make_tuple(&GazeData::Left, &GazeData::Right, &GazeData::Confidence); }
+	};
+
+	using CustomSchemas = SchemaSet<GazeData>;
+}
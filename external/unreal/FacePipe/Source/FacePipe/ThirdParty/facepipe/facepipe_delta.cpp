@@ -0,0 +1,152 @@
+#include "facepipe_delta.h"
+#include "facepipe_encode.h"
+
+namespace FacePipe
+{
+	LandmarkDeltaEncoder::Stream& LandmarkDeltaEncoder::FindOrAdd(const MessageInfo& Info)
+	{
+		for (Stream& Existing : Streams)
+		{
+			if (Existing.DataType == Info.DataType && Existing.Key.Matches(Info))
+				return Existing;
+		}
+
+		Stream& NewStream = Streams.emplace_back();
+		NewStream.Key.Assign(Info);
+		NewStream.DataType = Info.DataType;
+		return NewStream;
+	}
+
+	void LandmarkDeltaEncoder::RequestKeyframe()
+	{
+		for (Stream& Existing : Streams)
+			Existing.bNeedsKeyframe = true;
+	}
+
+	size_t LandmarkDeltaEncoder::Encode(std::span<char> Out, const MessageInfo& Info, std::span<const float> Values, int ImageWidth, int ImageHeight)
+	{
+		if (Info.DatagramType != EDatagramType::Bytes)
+			return 0;
+
+		if (Info.DataType != EFacepipeData::Landmarks2D && Info.DataType != EFacepipeData::Landmarks3D)
+			return 0;
+
+		Stream& S = FindOrAdd(Info);
+
+		MessageInfo SequencedInfo = Info;
+		SequencedInfo.bHasSequence = true;
+		SequencedInfo.Sequence = S.Sequence;
+
+		const bool bKeyframe = S.bNeedsKeyframe || S.SinceKeyframe + 1 >= KeyframeInterval || S.Keyframe.size() != Values.size();
+		if (!bKeyframe)
+		{
+			S.Deltas.resize(Values.size());
+			for (size_t i = 0; i < Values.size(); ++i)
+				S.Deltas[i] = Values[i] - S.Keyframe[i];
+
+			const size_t Size = EncodeLandmarksDelta(Out, SequencedInfo, S.Deltas, S.KeyframeSequence, ImageWidth, ImageHeight, DeltaBits);
+			if (Size > 0)
+			{
+				S.Sequence++;
+				S.SinceKeyframe++;
+			}
+			return Size;
+		}
+
+		EncodeSettings Settings;
+		Settings.QuantizedBits = KeyframeBits;
+		Settings.bKeyframe = true;
+
+		const size_t Size = EncodeLandmarks(Out, SequencedInfo, Values, ImageWidth, ImageHeight, Settings);
+		if (Size == 0)
+			return 0;
+
+		bool bStored = false;
+		if (KeyframeBits > 0)
+		{
+			// Deltas are taken against the dequantized keyframe, otherwise the quantization error would show up in every delta
+			DecodeBuffer.assign(Out.data(), Out.data() + Size);
+			MessageInfo KeyframeInfo;
+			int Width = 0, Height = 0;
+			bStored = ParseHeader(DecodeBuffer, KeyframeInfo) && GetLandmarks(DecodeBuffer, KeyframeInfo, S.Keyframe, Width, Height);
+		}
+		else
+		{
+			S.Keyframe.assign(Values.begin(), Values.end());
+			bStored = true;
+		}
+
+		S.KeyframeSequence = S.Sequence;
+		S.SinceKeyframe = 0;
+		S.bNeedsKeyframe = !bStored;
+		S.Sequence++;
+		return Size;
+	}
+
+	LandmarkDeltaDecoder::Stream* LandmarkDeltaDecoder::Find(const MessageInfo& Info)
+	{
+		for (Stream& Existing : Streams)
+		{
+			if (Existing.DataType == Info.DataType && Existing.Key.Matches(Info))
+				return &Existing;
+		}
+
+		return nullptr;
+	}
+
+	LandmarkDeltaDecoder::Stream& LandmarkDeltaDecoder::FindOrAdd(const MessageInfo& Info)
+	{
+		if (Stream* Existing = Find(Info))
+			return *Existing;
+
+		Stream& NewStream = Streams.emplace_back();
+		NewStream.Key.Assign(Info);
+		NewStream.DataType = Info.DataType;
+		return NewStream;
+	}
+
+	bool LandmarkDeltaDecoder::Decode(const std::vector<char>& Message, const MessageInfo& Info, std::vector<float>& OutValues, int& ImageWidth, int& ImageHeight)
+	{
+		if (Info.DatagramType != EDatagramType::Bytes || !HasFlag(Info.BinaryFlags, EBinaryFlags::Delta))
+		{
+			if (!GetLandmarks(Message, Info, OutValues, ImageWidth, ImageHeight))
+				return false;
+
+			if (Info.DatagramType == EDatagramType::Bytes && Info.bHasSequence && HasFlag(Info.BinaryFlags, EBinaryFlags::Keyframe))
+			{
+				Stream& S = FindOrAdd(Info);
+				S.KeyframeSequence = Info.Sequence;
+				S.Keyframe.assign(OutValues.begin(), OutValues.end());
+			}
+			return true;
+		}
+
+		if (Info.DataType != EFacepipeData::Landmarks2D && Info.DataType != EFacepipeData::Landmarks3D)
+			return false;
+
+		uint32_t Dimensions[6] = {}; // width, height, value count, bits, keyframe sequence, reserved
+		if (!ReadBinary(Message, Info.ContentView.b, Info.ContentView.e, Dimensions))
+			return false;
+
+		const Stream* S = Find(Info);
+		if (!S || S->KeyframeSequence != Dimensions[4] || S->Keyframe.size() != Dimensions[2])
+		{
+			MissingKeyframeCount++;
+			return false;
+		}
+
+		// Count matches the stored keyframe, a bogus count cannot trigger a huge allocation
+		const size_t Count = Dimensions[2];
+		const size_t Components = (Info.DataType == EFacepipeData::Landmarks3D) ? 3 : 2;
+		OutValues.resize(Count);
+		if (!ReadQuantizedValues(Message, Info.ContentView.b + sizeof(Dimensions), Info.ContentView.e, Count, Dimensions[3], Components, OutValues.data()))
+			return false;
+
+		for (size_t i = 0; i < Count; ++i)
+			OutValues[i] += S->Keyframe[i];
+
+		ImageWidth = (int) Dimensions[0];
+		ImageHeight = (int) Dimensions[1];
+		return true;
+	}
+}
@@ -0,0 +1,431 @@
+#include "facepipe_writer.h"
+#include "facepipe_pose.h"
+
+#include <bit>
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+
+namespace FacePipe
+{
+	void WriteHeader(DatagramWriter& Writer, const MessageInfo& Info, EFacepipeData DataType, uint16_t Flags)
+	{
+		if (Info.DatagramType == EDatagramType::Bytes)
+		{
+			if (Info.Source.size() > UINT8_MAX)
+			{
+				Writer.Fail();
+				return;
+			}
+
+			BinaryHeader Header;
+			Header.DataType = (uint8_t) DataType;
+			Header.SourceLength = (uint8_t) Info.Source.size();
+			Header.Flags = Flags | (Info.bHasSequence ? (uint16_t) EBinaryFlags::Sequenced : 0);
+			Header.Scene = (uint16_t) Info.Scene;
+			Header.Camera = (uint16_t) Info.Camera;
+			Header.Subject = (uint16_t) Info.Subject;
+			Header.Sequence = Info.Sequence;
+			Header.Time = Info.Time;
+
+			Writer.PutBinary(Header);
+			Writer.Put(Info.Source);
+			Writer.PadTo4();
+			return;
+		}
+
+		if (Info.DatagramType != EDatagramType::ASCII)
+		{
+			Writer.Fail();
+			return;
+		}
+
+		// a|facepipe|source|scene,camera,subject|time[,sequence]|type|
+		Writer.Put("a|facepipe|");
+		Writer.Put(Info.Source);
+		Writer.Put('|');
+		Writer.PutNumber(Info.Scene);
+		Writer.Put(',');
+		Writer.PutNumber(Info.Camera);
+		Writer.Put(',');
+		Writer.PutNumber(Info.Subject);
+		Writer.Put('|');
+		Writer.PutNumber(Info.Time);
+		if (Info.bHasSequence)
+		{
+			Writer.Put(',');
+			Writer.PutNumber(Info.Sequence);
+		}
+		Writer.Put('|');
+		Writer.Put(ToToken(DataType));
+		Writer.Put('|');
+	}
+
+	void WriteFloatList(DatagramWriter& Writer, std::span<const float> Values, int Precision)
+	{
+		for (size_t i = 0; i < Values.size(); ++i)
+		{
+			if (i > 0)
+				Writer.Put(',');
+			Writer.PutNumber(Values[i], Precision);
+		}
+	}
+
+	// Same scheme as the Python sender, each axis is scaled to use the full integer range
+	void WriteQuantized(DatagramWriter& Writer, std::span<const float> Values, size_t Components, uint32_t Bits)
+	{
+		// Values that are not finite (a lost tracking point) must not stretch the range of the others
+		float Low[3] = { FLT_MAX, FLT_MAX, FLT_MAX };
+		float High[3] = { -FLT_MAX, -FLT_MAX, -FLT_MAX };
+		for (size_t i = 0; i + Components <= Values.size(); i += Components)
+		{
+			for (size_t Axis = 0; Axis < Components; ++Axis)
+			{
+				if (!std::isfinite(Values[i + Axis]))
+					continue;
+
+				Low[Axis] = std::min(Low[Axis], Values[i + Axis]);
+				High[Axis] = std::max(High[Axis], Values[i + Axis]);
+			}
+		}
+		for (size_t Axis = 0; Axis < 3; ++Axis)
+		{
+			if (Low[Axis] > High[Axis])
+				Low[Axis] = High[Axis] = 0.0f;
+		}
+
+		const uint32_t MaxValue = (1u << Bits) - 1;
+		float ScaleOffset[6] = {};
+		for (size_t Axis = 0; Axis < Components; ++Axis)
+		{
+			const float Scale = (High[Axis] - Low[Axis]) / (float) MaxValue;
+			ScaleOffset[Axis] = (Scale > 0.0f) ? Scale : 1.0f;
+			ScaleOffset[3 + Axis] = Low[Axis];
+		}
+		Writer.PutBinary(ScaleOffset);
+
+		uint8_t* Data = (uint8_t*) Writer.Reserve((Values.size() * Bits + 7) / 8);
+		if (!Data)
+			return;
+
+		const float InverseScale[3] = { 1.0f / ScaleOffset[0], 1.0f / ScaleOffset[1], 1.0f / ScaleOffset[2] };
+
+		// LSB first, value i starts at bit i*Bits
+		uint64_t Pending = 0;
+		uint32_t PendingBits = 0;
+		size_t Axis = 0;
+		for (float Value : Values)
+		{
+			// NaN would reach the integer conversion through std::clamp, it is written as the lowest value of its axis
+			const float Scaled = (Value - ScaleOffset[3 + Axis]) * InverseScale[Axis] + 0.5f;
+			const float Q = std::isnan(Scaled) ? 0.0f : std::clamp(Scaled, 0.0f, (float) MaxValue);
+			Axis = (Axis + 1 == Components) ? 0 : Axis + 1;
+
+			Pending |= uint64_t(uint32_t(Q)) << PendingBits;
+			PendingBits += Bits;
+			while (PendingBits >= 8)
+			{
+				*Data++ = (uint8_t) Pending;
+				Pending >>= 8;
+				PendingBits -= 8;
+			}
+		}
+		if (PendingBits > 0)
+			*Data = (uint8_t) Pending;
+	}
+
+	size_t EncodeBlendshapes(std::span<char> Out, const MessageInfo& Info, const BlendshapeFrame& Blendshapes, const EncodeSettings& Settings)
+	{
+		DatagramWriter Writer(Out);
+		WriteHeader(Writer, Info, EFacepipeData::Blendshapes, 0);
+
+		if (Info.DatagramType == EDatagramType::Bytes)
+		{
+			uint32_t Count = (uint32_t) (std::popcount(Blendshapes.ValidMask) + Blendshapes.Other.size());
+			Writer.PutBinary(Count);
+
+			for (size_t i = 0; i < ARKitBlendshapeCount; ++i)
+			{
+				if (Blendshapes.IsValid(i))
+					Writer.PutBinary(Blendshapes.Values[i]);
+			}
+			for (const auto& Pair : Blendshapes.Other)
+			{
+				Writer.PutBinary(Pair.second);
+			}
+
+			for (size_t i = 0; i < ARKitBlendshapeCount; ++i)
+			{
+				if (Blendshapes.IsValid(i))
+					Writer.PutName(ARKitBlendshapeNames[i]);
+			}
+			for (const auto& Pair : Blendshapes.Other)
+			{
+				Writer.PutName(Pair.first);
+			}
+
+			return Writer.Size();
+		}
+
+		// bs|name=0.5|other=0.1
+		bool bFirst = true;
+		auto WriteValue = [&](std::string_view Name, float Value)
+		{
+			if (!bFirst)
+				Writer.Put('|');
+			bFirst = false;
+
+			Writer.Put(Name);
+			Writer.Put('=');
+			Writer.PutNumber(Value, Settings.Precision);
+		};
+
+		for (size_t i = 0; i < ARKitBlendshapeCount; ++i)
+		{
+			if (Blendshapes.IsValid(i))
+				WriteValue(ARKitBlendshapeNames[i], Blendshapes.Values[i]);
+		}
+		for (const auto& Pair : Blendshapes.Other)
+		{
+			WriteValue(Pair.first, Pair.second);
+		}
+
+		return Writer.Size();
+	}
+
+	size_t EncodeBlendshapeUpdates(std::span<char> Out, const MessageInfo& Info, std::span<const uint8_t> Indices, std::span<const float> Values, const EncodeSettings& Settings)
+	{
+		if (Indices.size() != Values.size())
+			return 0;
+
+		DatagramWriter Writer(Out);
+		WriteHeader(Writer, Info, EFacepipeData::BlendshapeUpdates, 0);
+
+		if (Info.DatagramType == EDatagramType::Bytes)
+		{
+			Writer.PutBinary((uint32_t) Values.size());
+			Writer.Put(Values.data(), Values.size_bytes());
+			Writer.Put(Indices.data(), Indices.size_bytes());
+			return Writer.Size();
+		}
+
+		// bsu|17=0.5|9=0.2
+		for (size_t i = 0; i < Values.size(); ++i)
+		{
+			if (i > 0)
+				Writer.Put('|');
+
+			Writer.PutNumber(Indices[i]);
+			Writer.Put('=');
+			Writer.PutNumber(Values[i], Settings.Precision);
+		}
+
+		return Writer.Size();
+	}
+
+	size_t EncodeLandmarks(std::span<char> Out, const MessageInfo& Info, std::span<const float> Values, int ImageWidth, int ImageHeight, const EncodeSettings& Settings)
+	{
+		if (Info.DataType != EFacepipeData::Landmarks2D && Info.DataType != EFacepipeData::Landmarks3D)
+			return 0;
+
+		const bool bQuantized = Info.DatagramType == EDatagramType::Bytes && Settings.QuantizedBits > 0;
+		if (bQuantized && Settings.QuantizedBits > 16)
+			return 0;
+
+		uint16_t Flags = 0;
+		if (bQuantized)
+			Flags |= (uint16_t) EBinaryFlags::Quantized;
+		if (Settings.bKeyframe)
+			Flags |= (uint16_t) EBinaryFlags::Keyframe;
+
+		DatagramWriter Writer(Out);
+		WriteHeader(Writer, Info, Info.DataType, Flags);
+
+		if (Info.DatagramType == EDatagramType::Bytes)
+		{
+			const uint32_t Dimensions[4] = { (uint32_t) ImageWidth, (uint32_t) ImageHeight, (uint32_t) Values.size(), bQuantized ? Settings.QuantizedBits : 0 };
+			Writer.PutBinary(Dimensions);
+
+			if (bQuantized)
+				WriteQuantized(Writer, Values, (Info.DataType == EFacepipeData::Landmarks3D) ? 3 : 2, Settings.QuantizedBits);
+			else
+				Writer.Put(Values.data(), Values.size_bytes());
+
+			return Writer.Size();
+		}
+
+		// l3d|640,480|0.1,0.2,0.3,...
+		Writer.PutNumber(ImageWidth);
+		Writer.Put(',');
+		Writer.PutNumber(ImageHeight);
+		Writer.Put('|');
+		WriteFloatList(Writer, Values, Settings.Precision);
+
+		return Writer.Size();
+	}
+
+	size_t EncodeLandmarksDelta(std::span<char> Out, const MessageInfo& Info, std::span<const float> Deltas, uint32_t KeyframeSequence, int ImageWidth, int ImageHeight, uint32_t Bits)
+	{
+		if (Info.DataType != EFacepipeData::Landmarks2D && Info.DataType != EFacepipeData::Landmarks3D)
+			return 0;
+
+		if (Info.DatagramType != EDatagramType::Bytes || Bits == 0 || Bits > 16)
+			return 0;
+
+		DatagramWriter Writer(Out);
+		WriteHeader(Writer, Info, Info.DataType, (uint16_t) EBinaryFlags::Delta);
+
+		const uint32_t Dimensions[4] = { (uint32_t) ImageWidth, (uint32_t) ImageHeight, (uint32_t) Deltas.size(), Bits };
+		Writer.PutBinary(Dimensions);
+
+		const uint32_t Keyframe[2] = { KeyframeSequence, 0 };
+		Writer.PutBinary(Keyframe);
+
+		WriteQuantized(Writer, Deltas, (Info.DataType == EFacepipeData::Landmarks3D) ? 3 : 2, Bits);
+		return Writer.Size();
+	}
+
+	size_t EncodeExpressionBasis(std::span<char> Out, const MessageInfo& Info, uint32_t BasisId, uint32_t ComponentCount, std::span<const float> Mean, std::span<const float> Components, const EncodeSettings& Settings)
+	{
+		if (Components.size() != (size_t) ComponentCount * Mean.size())
+			return 0;
+
+		DatagramWriter Writer(Out);
+		WriteHeader(Writer, Info, EFacepipeData::ExpressionBasis, 0);
+
+		if (Info.DatagramType == EDatagramType::Bytes)
+		{
+			const uint32_t Counts[4] = { BasisId, ComponentCount, (uint32_t) Mean.size(), 0 };
+			Writer.PutBinary(Counts);
+			Writer.Put(Mean.data(), Mean.size_bytes());
+			Writer.Put(Components.data(), Components.size_bytes());
+			return Writer.Size();
+		}
+
+		// pcabasis|id|componentcount|mean...|components...
+		Writer.PutNumber(BasisId);
+		Writer.Put('|');
+		Writer.PutNumber(ComponentCount);
+		Writer.Put('|');
+		WriteFloatList(Writer, Mean, Settings.Precision);
+		Writer.Put('|');
+		WriteFloatList(Writer, Components, Settings.Precision);
+		return Writer.Size();
+	}
+
+	size_t EncodeExpressionCoefficients(std::span<char> Out, const MessageInfo& Info, uint32_t BasisId, std::span<const float> Coefficients, const EncodeSettings& Settings)
+	{
+		DatagramWriter Writer(Out);
+		WriteHeader(Writer, Info, EFacepipeData::ExpressionCoefficients, 0);
+
+		if (Info.DatagramType == EDatagramType::Bytes)
+		{
+			const uint32_t Counts[2] = { BasisId, (uint32_t) Coefficients.size() };
+			Writer.PutBinary(Counts);
+			Writer.Put(Coefficients.data(), Coefficients.size_bytes());
+			return Writer.Size();
+		}
+
+		// pca|id|0.5,-0.2,...
+		Writer.PutNumber(BasisId);
+		Writer.Put('|');
+		WriteFloatList(Writer, Coefficients, Settings.Precision);
+		return Writer.Size();
+	}
+
+	size_t EncodeMatrices(std::span<char> Out, const MessageInfo& Info, const MatrixMap& Matrices, const EncodeSettings& Settings)
+	{
+		DatagramWriter Writer(Out);
+		WriteHeader(Writer, Info, EFacepipeData::Matrices4x4, 0);
+
+		if (Info.DatagramType == EDatagramType::Bytes)
+		{
+			uint32_t Count = (uint32_t) std::count_if(Matrices.begin(), Matrices.end(), [](const auto& Pair) { return Pair.second.size() == 16; });
+			Writer.PutBinary(Count);
+
+			for (const auto& Pair : Matrices)
+			{
+				if (Pair.second.size() == 16)
+					Writer.Put(Pair.second.data(), 16 * sizeof(float));
+			}
+			for (const auto& Pair : Matrices)
+			{
+				if (Pair.second.size() == 16)
+					Writer.PutName(Pair.first);
+			}
+
+			return Writer.Size();
+		}
+
+		// mat44|face=1,0,0,...|eyeL=...
+		bool bFirst = true;
+		for (const auto& Pair : Matrices)
+		{
+			if (Pair.second.size() != 16)
+				continue;
+
+			if (!bFirst)
+				Writer.Put('|');
+			bFirst = false;
+
+			Writer.Put(Pair.first);
+			Writer.Put('=');
+			WriteFloatList(Writer, Pair.second, Settings.Precision);
+		}
+
+		return Writer.Size();
+	}
+
+	size_t EncodePoses(std::span<char> Out, const MessageInfo& Info, const PoseMap& Poses, const EncodeSettings& Settings)
+	{
+		const bool bQuantized = Info.DatagramType == EDatagramType::Bytes && Settings.QuantizedBits > 0;
+
+		DatagramWriter Writer(Out);
+		WriteHeader(Writer, Info, EFacepipeData::Poses, bQuantized ? (uint16_t) EBinaryFlags::Quantized : 0);
+
+		if (Info.DatagramType == EDatagramType::Bytes)
+		{
+			Writer.PutBinary((uint32_t) Poses.size());
+
+			for (const auto& Pair : Poses)
+			{
+				const Pose& P = Pair.second;
+				if (bQuantized)
+					Writer.PutBinary(PackRotation(P.Rotation));
+				else
+					Writer.PutBinary(P.Rotation);
+				Writer.PutBinary(P.Translation);
+				Writer.PutBinary(P.Scale);
+			}
+			for (const auto& Pair : Poses)
+			{
+				Writer.PutName(Pair.first);
+			}
+
+			return Writer.Size();
+		}
+
+		// pose|face=0,0,0,1,0.5,-2,30|eyeL=...,0.9
+		bool bFirst = true;
+		for (const auto& Pair : Poses)
+		{
+			if (!bFirst)
+				Writer.Put('|');
+			bFirst = false;
+
+			const Pose& P = Pair.second;
+			Writer.Put(Pair.first);
+			Writer.Put('=');
+			WriteFloatList(Writer, P.Rotation, Settings.Precision);
+			Writer.Put(',');
+			WriteFloatList(Writer, P.Translation, Settings.Precision);
+			if (P.Scale != 1.0f)
+			{
+				Writer.Put(',');
+				Writer.PutNumber(P.Scale, Settings.Precision);
+			}
+		}
+
+		return Writer.Size();
+	}
+}
@@ -0,0 +1,158 @@
+#include "facepipe_feedback.h"
+
+#include <algorithm>
+
+namespace FacePipe
+{
+	bool ReadReceiverReport(const std::vector<char>& Packet, ReceiverReport& OutReport)
+	{
+		if (Packet.size() != sizeof(ReceiverReport))
+			return false;
+
+		std::memcpy(&OutReport, Packet.data(), sizeof(ReceiverReport));
+
+		// NaN fails both comparisons
+		return OutReport.Type == 'r' && OutReport.Version == 1 && OutReport.LatencyMs >= 0.0f && OutReport.IntervalSeconds > 0.0f;
+	}
+
+	ReceiverReporter::ReceiverReporter(double IntervalSeconds)
+		: Interval(IntervalSeconds)
+	{
+	}
+
+	void ReceiverReporter::Add(uint64_t SenderKey, const MessageInfo& Info, int64_t LostChange, double LatencySeconds, double Now)
+	{
+		auto Found = std::find_if(Senders.begin(), Senders.end(), [&](const Sender& S) { return S.Key == SenderKey; });
+		if (Found == Senders.end())
+		{
+			Sender& NewSender = Senders.emplace_back();
+			NewSender.Key = SenderKey;
+			NewSender.IntervalStart = Now;
+			Found = Senders.end() - 1;
+		}
+
+		Sender& S = *Found;
+
+		S.Datagrams++;
+		if (Info.bHasSequence)
+			S.Received++;
+		S.Lost += LostChange;
+		S.LatencySum += std::max(LatencySeconds, 0.0);
+	}
+
+	void ReceiverReporter::SetQueueDepth(size_t Depth)
+	{
+		const uint32_t Clamped = (uint32_t) std::min<size_t>(Depth, UINT32_MAX);
+		for (Sender& S : Senders)
+			S.QueueDepth = std::max(S.QueueDepth, Clamped);
+	}
+
+	bool ReceiverReporter::TakeDue(double Now, uint64_t& OutSenderKey, ReceiverReport& OutReport)
+	{
+		for (size_t i = 0; i < Senders.size(); ++i)
+		{
+			Sender& S = Senders[i];
+			if (Now - S.IntervalStart < Interval)
+				continue;
+
+			if (S.Datagrams == 0)
+			{
+				Senders[i] = Senders.back();
+				Senders.pop_back();
+				--i;
+				continue;
+			}
+
+			OutSenderKey = S.Key;
+			OutReport = ReceiverReport();
+			OutReport.Received = S.Received;
+			// Late datagrams of the previous interval can leave it negative
+			OutReport.Lost = (uint32_t) std::clamp<int64_t>(S.Lost, 0, UINT32_MAX);
+			OutReport.QueueDepth = S.QueueDepth;
+			OutReport.LatencyMs = (float) (S.LatencySum / S.Datagrams * 1000.0);
+			OutReport.IntervalSeconds = (float) (Now - S.IntervalStart);
+
+			S.IntervalStart = Now;
+			S.Datagrams = 0;
+			S.Received = 0;
+			S.Lost = 0;
+			S.QueueDepth = 0;
+			S.LatencySum = 0.0;
+			return true;
+		}
+
+		return false;
+	}
+
+	bool ReceiverReporter::IsTracking(uint64_t SenderKey) const
+	{
+		return std::any_of(Senders.begin(), Senders.end(), [&](const Sender& S) { return S.Key == SenderKey; });
+	}
+
+	void AdaptiveEncoding::OnReport(const ReceiverReport& Report)
+	{
+		const float Loss = Report.LossRate();
+		const bool bCongested = Loss > CongestedLoss || Report.QueueDepth > CongestedQueueDepth || Report.LatencyMs > CongestedLatencyMs;
+		const bool bHealthy = Loss < HealthyLoss && Report.QueueDepth <= CongestedQueueDepth / 4 && Report.LatencyMs <= CongestedLatencyMs / 2;
+
+		if (bCongested)
+		{
+			GoodReports = 0;
+			if (Level != EEncodingLevel::Delta)
+				Level = EEncodingLevel(uint8_t(Level) + 1);
+			else
+				RateScale = std::max(RateScale * 0.5f, MinRateScale);
+			return;
+		}
+
+		// In between counts neither way, recovery needs good reports in a row
+		if (!bHealthy)
+		{
+			GoodReports = 0;
+			return;
+		}
+
+		if (++GoodReports < RecoveryReports)
+			return;
+
+		GoodReports = 0;
+		if (RateScale < 1.0f)
+			RateScale = std::min(RateScale * 2.0f, 1.0f);
+		else if (Level != EEncodingLevel::Full)
+			Level = EEncodingLevel(uint8_t(Level) - 1);
+	}
+
+	void AdaptiveEncoding::Configure(LandmarkDeltaEncoder& Encoder) const
+	{
+		// Full and Quantized send every frame as a keyframe, the receiver decodes them like any other landmarks
+		Encoder.KeyframeInterval = (Level == EEncodingLevel::Delta) ? 30 : 1;
+		Encoder.KeyframeBits = (Level == EEncodingLevel::Full) ? 0 : 12;
+		Encoder.DeltaBits = 8;
+	}
+
+	bool AdaptiveEncoding::ShouldSend(const MessageInfo& Info)
+	{
+		if (RateScale >= 1.0f)
+			return true;
+
+		auto Found = std::find_if(Streams.begin(), Streams.end(), [&](const Stream& S) { return S.DataType == Info.DataType && S.Key.Matches(Info); });
+		if (Found == Streams.end())
+		{
+			Stream& NewStream = Streams.emplace_back();
+			NewStream.Key.Assign(Info);
+			NewStream.DataType = Info.DataType;
+			NewStream.Credit = 1.0f; // the first datagram of a stream always goes out
+			Found = Streams.end() - 1;
+		}
+
+		Stream& S = *Found;
+
+		// Every datagram earns RateScale, one is sent whenever a whole datagram was earned
+		S.Credit += RateScale;
+		if (S.Credit < 1.0f)
+			return false;
+
+		S.Credit -= 1.0f;
+		return true;
+	}
+}
@@ -0,0 +1,175 @@
+#include "facepipe_fragment.h"
+
+#include <algorithm>
+
+namespace FacePipe
+{
+	size_t GetFragmentCount(size_t MessageSize, size_t MaxDatagramSize)
+	{
+		if (MaxDatagramSize <= sizeof(FragmentHeader) || MessageSize == 0 || MessageSize > MaxFragmentedMessageSize)
+			return 0;
+
+		const size_t FragmentSize = std::min<size_t>(MaxDatagramSize - sizeof(FragmentHeader), UINT16_MAX);
+		const size_t Count = (MessageSize + FragmentSize - 1) / FragmentSize;
+		return (Count <= MaxFragmentCount) ? Count : 0;
+	}
+
+	bool WriteFragment(std::span<const char> Message, uint32_t MessageId, size_t Index, size_t MaxDatagramSize, std::vector<char>& OutFragment)
+	{
+		const size_t Count = GetFragmentCount(Message.size(), MaxDatagramSize);
+		if (Index >= Count)
+			return false;
+
+		const size_t FragmentSize = std::min<size_t>(MaxDatagramSize - sizeof(FragmentHeader), UINT16_MAX);
+		const size_t Begin = Index * FragmentSize;
+		const size_t PayloadSize = std::min(FragmentSize, Message.size() - Begin);
+
+		FragmentHeader Header;
+		Header.FragmentIndex = (uint16_t) Index;
+		Header.FragmentCount = (uint16_t) Count;
+		Header.FragmentSize = (uint16_t) FragmentSize;
+		Header.MessageId = MessageId;
+		Header.MessageSize = (uint32_t) Message.size();
+
+		OutFragment.resize(sizeof(FragmentHeader) + PayloadSize);
+		std::memcpy(OutFragment.data(), &Header, sizeof(FragmentHeader));
+		std::memcpy(OutFragment.data() + sizeof(FragmentHeader), Message.data() + Begin, PayloadSize);
+		return true;
+	}
+
+	bool ReadFragmentHeader(const std::vector<char>& Fragment, FragmentHeader& OutHeader)
+	{
+		if (Fragment.size() <= sizeof(FragmentHeader))
+			return false;
+
+		std::memcpy(&OutHeader, Fragment.data(), sizeof(FragmentHeader));
+
+		if (OutHeader.Type != 'f' || OutHeader.Version != 1)
+			return false;
+
+		if (OutHeader.FragmentCount == 0 || OutHeader.FragmentCount > MaxFragmentCount || OutHeader.FragmentIndex >= OutHeader.FragmentCount)
+			return false;
+
+		if (OutHeader.FragmentSize == 0 || OutHeader.MessageSize == 0 || OutHeader.MessageSize > MaxFragmentedMessageSize)
+			return false;
+
+		// The advertised sizes must agree with each other and with this fragment's payload
+		const size_t Expected = (size_t) OutHeader.FragmentSize * (OutHeader.FragmentCount - 1);
+		if (OutHeader.MessageSize <= Expected || OutHeader.MessageSize - Expected > OutHeader.FragmentSize)
+			return false;
+
+		const size_t Begin = (size_t) OutHeader.FragmentIndex * OutHeader.FragmentSize;
+		const size_t PayloadSize = std::min<size_t>(OutHeader.FragmentSize, OutHeader.MessageSize - Begin);
+		return Fragment.size() - sizeof(FragmentHeader) == PayloadSize;
+	}
+
+	FragmentReassembler::FragmentReassembler(size_t MaxMessages, double TimeoutSeconds)
+		: Slots(std::max<size_t>(MaxMessages, 1)), Timeout(TimeoutSeconds)
+	{
+	}
+
+	void FragmentReassembler::Expire(double Now)
+	{
+		for (Slot& S : Slots)
+		{
+			if (S.bActive && Now - S.FirstReceived > Timeout)
+			{
+				S.bActive = false;
+				TimedOutCount++;
+			}
+		}
+	}
+
+	void FragmentReassembler::Clear()
+	{
+		for (Slot& S : Slots)
+		{
+			S.bActive = false;
+			S.bCompleted = false;
+		}
+	}
+
+	FragmentReassembler::Slot* FragmentReassembler::FindOrStart(const FragmentHeader& Header, uint64_t SenderKey, double Now)
+	{
+		Slot* Free = nullptr;
+		Slot* Oldest = nullptr;
+		for (Slot& S : Slots)
+		{
+			const bool bSameMessage = S.SenderKey == SenderKey && S.MessageId == Header.MessageId;
+			if (!S.bActive)
+			{
+				if (S.bCompleted && bSameMessage)
+					return nullptr;
+
+				if (!Free)
+					Free = &S;
+				continue;
+			}
+
+			if (bSameMessage)
+				return &S;
+
+			if (!Oldest || S.FirstReceived < Oldest->FirstReceived)
+				Oldest = &S;
+		}
+
+		Slot* Target = Free;
+		if (!Target)
+		{
+			Target = Oldest;
+			EvictedCount++;
+		}
+
+		Target->bActive = true;
+		Target->bCompleted = false;
+		Target->SenderKey = SenderKey;
+		Target->MessageId = Header.MessageId;
+		Target->MessageSize = Header.MessageSize;
+		Target->FragmentCount = Header.FragmentCount;
+		Target->FragmentSize = Header.FragmentSize;
+		Target->ReceivedCount = 0;
+		std::memset(Target->ReceivedMask, 0, sizeof(Target->ReceivedMask));
+		Target->FirstReceived = Now;
+		Target->Buffer.resize(Header.MessageSize);
+		return Target;
+	}
+
+	bool FragmentReassembler::Add(const std::vector<char>& Fragment, uint64_t SenderKey, double Now, std::vector<char>& OutMessage)
+	{
+		FragmentHeader Header;
+		if (!ReadFragmentHeader(Fragment, Header))
+		{
+			InvalidCount++;
+			return false;
+		}
+
+		Expire(Now);
+
+		Slot* S = FindOrStart(Header, SenderKey, Now);
+		if (!S)
+			return false; // duplicate
+
+		if (S->MessageSize != Header.MessageSize || S->FragmentCount != Header.FragmentCount || S->FragmentSize != Header.FragmentSize)
+		{
+			InvalidCount++;
+			return false;
+		}
+
+		uint64_t& Mask = S->ReceivedMask[Header.FragmentIndex / 64];
+		const uint64_t Bit = uint64_t(1) << (Header.FragmentIndex % 64);
+		if (Mask & Bit)
+			return false; // duplicate
+
+		Mask |= Bit;
+		std::memcpy(S->Buffer.data() + (size_t) Header.FragmentIndex * Header.FragmentSize, Fragment.data() + sizeof(FragmentHeader), Fragment.size() - sizeof(FragmentHeader));
+
+		if (++S->ReceivedCount < S->FragmentCount)
+			return false;
+
+		S->bActive = false;
+		S->bCompleted = true;
+		OutMessage.assign(S->Buffer.begin(), S->Buffer.end());
+		CompletedCount++;
+		return true;
+	}
+}
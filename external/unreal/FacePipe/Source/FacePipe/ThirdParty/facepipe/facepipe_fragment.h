@@ -0,0 +1,91 @@
+#pragma once
+
+#include "facepipe.h"
+
+/*
+* Fragments carry datagrams that are too large for a single packet (dense ASCII landmarks, meshes).
+* The complete datagram - ASCII or binary - is split into slices and every slice is prefixed with
+* a 16 byte little-endian header:
+*
+*	char	Type = 'f'
+*	u8		Version = 1
+*	u16		FragmentIndex
+*	u16		FragmentCount
+*	u16		FragmentSize		payload size of every fragment except the last one
+*	u32		MessageId			chosen by the sender, unique among its messages in flight
+*	u32		MessageSize			size of the reassembled datagram
+*	u8		Payload[]			bytes [FragmentIndex * FragmentSize, ...) of the datagram
+*
+* The receiver collects fragments per (sender, MessageId) in a small fixed table. A message that
+* does not complete within the timeout is dropped, losing one fragment loses the whole datagram
+* which is the same behaviour as a lost unfragmented datagram.
+*/
+
+namespace FacePipe
+{
+	struct FragmentHeader
+	{
+		char Type = 'f';
+		uint8_t Version = 1;
+		uint16_t FragmentIndex = 0;
+		uint16_t FragmentCount = 0;
+		uint16_t FragmentSize = 0;
+		uint32_t MessageId = 0;
+		uint32_t MessageSize = 0;
+	};
+	static_assert(sizeof(FragmentHeader) == 16, "FragmentHeader must match the wire format");
+
+	static const size_t SafeDatagramSize = 1400;	// stays below a 1500 byte Ethernet MTU with IP/UDP headers to spare
+	static const size_t MaxFragmentCount = 256;
+	static const size_t MaxFragmentedMessageSize = 1 << 20;
+
+	// Number of fragments needed for MessageSize bytes, 0 if the message is too large to be fragmented
+	size_t GetFragmentCount(size_t MessageSize, size_t MaxDatagramSize = SafeDatagramSize);
+
+	// Writes fragment Index of Message into OutFragment, reusing its capacity
+	bool WriteFragment(std::span<const char> Message, uint32_t MessageId, size_t Index, size_t MaxDatagramSize, std::vector<char>& OutFragment);
+
+	bool ReadFragmentHeader(const std::vector<char>& Fragment, FragmentHeader& OutHeader);
+
+	class FragmentReassembler
+	{
+	public:
+		FragmentReassembler(size_t MaxMessages = 8, double TimeoutSeconds = 0.25);
+
+		// Adds a received fragment. SenderKey identifies the sender (address and port) since message ids are only unique per sender.
+		// Returns true when the fragment completed a message, OutMessage then holds the reassembled datagram.
+		bool Add(const std::vector<char>& Fragment, uint64_t SenderKey, double Now, std::vector<char>& OutMessage);
+
+		// Drops messages older than the timeout, Add does this lazily but idle receivers can call it directly
+		void Expire(double Now);
+
+		void Clear();
+
+		size_t CompletedCount = 0;
+		size_t TimedOutCount = 0;	// incomplete messages dropped after the timeout
+		size_t EvictedCount = 0;	// incomplete messages dropped because the table was full
+		size_t InvalidCount = 0;	// malformed fragments or fragments contradicting their message
+
+	protected:
+		struct Slot
+		{
+			bool bActive = false;
+			bool bCompleted = false; // inactive but remembers its id so late duplicates do not start a new message
+			uint64_t SenderKey = 0;
+			uint32_t MessageId = 0;
+			uint32_t MessageSize = 0;
+			uint16_t FragmentCount = 0;
+			uint16_t FragmentSize = 0;
+			uint16_t ReceivedCount = 0;
+			uint64_t ReceivedMask[MaxFragmentCount / 64] = {};
+			double FirstReceived = 0.0;
+			std::vector<char> Buffer; // capacity is kept between messages
+		};
+
+		// Returns nullptr for fragments of a message that was just completed
+		Slot* FindOrStart(const FragmentHeader& Header, uint64_t SenderKey, double Now);
+
+		std::vector<Slot> Slots;
+		double Timeout = 0.25;
+	};
+}
@@ -0,0 +1,47 @@
+#pragma once
+
+#include "facepipe.h"
+
+/*
+* Live Link Face (and other ARKit apps built on Unreal's remote publisher) streams blendshapes in its own binary format.
+* ParseHeader recognizes it by the first byte, so it can be received on the same socket as FacePipe datagrams.
+* All values are big-endian:
+*
+*	u8		Version = 6
+*	i32		DeviceIdLength		| char DeviceId[DeviceIdLength]
+*	i32		SubjectNameLength	| char SubjectName[SubjectNameLength]
+*	i32		FrameNumber
+*	f32		SubFrame
+*	i32		FrameRateNumerator
+*	i32		FrameRateDenominator
+*	u8		ValueCount = 61
+*	f32		Values[ValueCount]	the 52 ARKit blendshapes in ARKit order, then yaw, pitch and roll of the head, left eye and right eye
+*
+* The datagram is reported as Blendshapes of Source "livelinkface", GetBlendshapes decodes it straight from the
+* big-endian values. The rotations end up in BlendshapeFrame::Other as headYaw, headPitch, ..., rightEyeRoll.
+* Time is the frame time in seconds. Every phone streams under its own subject name, Subject is a 15 bit hash
+* of it so that several phones on one socket stay apart.
+*/
+
+namespace FacePipe
+{
+	static const uint8_t LiveLinkFaceVersion = 6;
+	static const size_t LiveLinkFaceRotationCount = 9;
+
+	inline constexpr std::string_view LiveLinkFaceSource = "livelinkface";
+
+	inline constexpr std::string_view LiveLinkFaceRotationNames[LiveLinkFaceRotationCount] = {
+		"headYaw", "headPitch", "headRoll",
+		"leftEyeYaw", "leftEyePitch", "leftEyeRoll",
+		"rightEyeYaw", "rightEyePitch", "rightEyeRoll"
+	};
+
+	// Called by ParseHeader for datagrams starting with LiveLinkFaceVersion
+	bool ParseLiveLinkFaceHeader(const std::vector<char>& Message, MessageInfo& OutInfo);
+
+	// Called by GetBlendshapes for EDatagramType::LiveLinkFace
+	bool GetLiveLinkFaceBlendshapes(const std::vector<char>& Message, const MessageInfo& Info, BlendshapeFrame& OutBlendshapes);
+
+	// The subject name set in the app, points into Message
+	bool GetLiveLinkFaceSubjectName(const std::vector<char>& Message, const MessageInfo& Info, std::string_view& OutName);
+}
@@ -0,0 +1,196 @@
+#include "facepipe_mesh.h"
+
+#include <algorithm>
+#include <charconv>
+
+namespace FacePipe
+{
+	uint32_t HashMeshTopology(uint32_t VertexCount, std::span<const uint32_t> Indices, std::span<const float> UVs)
+	{
+		uint32_t Hash = 2166136261u;
+		Hash = HashBytes(Hash, &VertexCount, sizeof(VertexCount));
+		Hash = HashBytes(Hash, Indices.data(), Indices.size_bytes());
+		Hash = HashBytes(Hash, UVs.data(), UVs.size_bytes());
+		return Hash;
+	}
+
+	bool MeshTopologyCache::Update(const std::vector<char>& Message, const MessageInfo& Info)
+	{
+		uint32_t Id = 0;
+		if (!GetMeshTopologyId(Message, Info, Id))
+			return false;
+
+		// Same id means same content, refreshes do not need to be parsed again
+		if (Find(Id))
+			return true;
+
+		MeshTopology NewTopology;
+		if (!GetMeshTopology(Message, Info, NewTopology))
+			return false;
+
+		if (Topologies.size() >= MaxTopologies)
+			Topologies.erase(Topologies.begin());
+
+		Topologies.push_back(std::move(NewTopology));
+		return true;
+	}
+
+	const MeshTopology* MeshTopologyCache::Find(uint32_t Id) const
+	{
+		for (const MeshTopology& Existing : Topologies)
+		{
+			if (Existing.Id == Id)
+				return &Existing;
+		}
+
+		return nullptr;
+	}
+
+	bool GetMeshTopologyId(const std::vector<char>& Message, const MessageInfo& Info, uint32_t& OutId)
+	{
+		if (Info.DataType != EFacepipeData::MeshTopology && Info.DataType != EFacepipeData::Mesh)
+			return false;
+
+		if (Info.DatagramType == EDatagramType::Bytes)
+			return ReadBinary(Message, Info.ContentView.b, Info.ContentView.e, OutId);
+
+		VectorView IdView(Info.ContentView.b);
+		if (!IdView.NextSubstring(Message, '|', Info.ContentView.e))
+			return false;
+
+		const char* Last = Message.data() + IdView.e;
+		std::from_chars_result Result = std::from_chars(Message.data() + IdView.b, Last, OutId);
+		return Result.ec == std::errc() && Result.ptr == Last;
+	}
+
+	bool GetMeshTopology(const std::vector<char>& Message, const MessageInfo& Info, MeshTopology& OutTopology)
+	{
+		if (Info.DataType != EFacepipeData::MeshTopology || !GetMeshTopologyId(Message, Info, OutTopology.Id))
+			return false;
+
+		OutTopology.Indices.clear();
+		OutTopology.UVs.clear();
+
+		if (Info.DatagramType == EDatagramType::Bytes)
+		{
+			uint32_t Counts[4] = {}; // id, vertex count, index count, uv count
+			if (!ReadBinary(Message, Info.ContentView.b, Info.ContentView.e, Counts))
+				return false;
+
+			const size_t IndicesStart = Info.ContentView.b + sizeof(Counts);
+			const size_t UVsStart = IndicesStart + (size_t) Counts[2] * sizeof(uint32_t);
+			const size_t End = UVsStart + (size_t) Counts[3] * 2 * sizeof(float);
+			if (End > Info.ContentView.e || End > Message.size())
+				return false;
+
+			OutTopology.VertexCount = Counts[1];
+			OutTopology.Indices.resize(Counts[2]);
+			OutTopology.UVs.resize((size_t) Counts[3] * 2);
+			if (!OutTopology.Indices.empty())
+				std::memcpy(OutTopology.Indices.data(), Message.data() + IndicesStart, OutTopology.Indices.size() * sizeof(uint32_t));
+			if (!OutTopology.UVs.empty())
+				std::memcpy(OutTopology.UVs.data(), Message.data() + UVsStart, OutTopology.UVs.size() * sizeof(float));
+		}
+		else
+		{
+			// id|vertexcount|indices[|uvs]
+			VectorView FieldView(Info.ContentView.b);
+			if (!FieldView.NextSubstring(Message, '|', Info.ContentView.e) || !FieldView.NextSubstring(Message, '|', Info.ContentView.e))
+				return false;
+
+			const int VertexCount = FieldView.ParseInt(Message);
+			if (VertexCount <= 0 || !FieldView.NextSubstring(Message, '|', Info.ContentView.e))
+				return false;
+
+			OutTopology.VertexCount = (uint32_t) VertexCount;
+
+			VectorView IndexView(FieldView.b);
+			while (IndexView.NextSubstring(Message, ',', FieldView.e))
+			{
+				const int Index = IndexView.ParseInt(Message);
+				if (Index < 0)
+					return false;
+
+				OutTopology.Indices.push_back((uint32_t) Index);
+			}
+
+			if (FieldView.NextSubstring(Message, '|', Info.ContentView.e))
+				FieldView.ParseArray(Message, OutTopology.UVs);
+		}
+
+		if (OutTopology.VertexCount == 0 || OutTopology.Indices.size() % 3 != 0)
+			return false;
+
+		if (!OutTopology.UVs.empty() && OutTopology.UVs.size() != (size_t) OutTopology.VertexCount * 2)
+			return false;
+
+		for (uint32_t Index : OutTopology.Indices)
+		{
+			if (Index >= OutTopology.VertexCount)
+				return false;
+		}
+
+		return HashMeshTopology(OutTopology.VertexCount, OutTopology.Indices, OutTopology.UVs) == OutTopology.Id;
+	}
+
+	bool GetMeshVertexCount(const std::vector<char>& Message, const MessageInfo& Info, uint32_t& OutTopologyId, uint32_t& OutVertexCount)
+	{
+		if (Info.DataType != EFacepipeData::Mesh)
+			return false;
+
+		if (Info.DatagramType == EDatagramType::Bytes)
+		{
+			uint32_t Counts[2] = {}; // id, vertex count
+			if (!ReadBinary(Message, Info.ContentView.b, Info.ContentView.e, Counts))
+				return false;
+
+			OutTopologyId = Counts[0];
+			OutVertexCount = Counts[1];
+			return true;
+		}
+
+		if (!GetMeshTopologyId(Message, Info, OutTopologyId))
+			return false;
+
+		VectorView ValuesView(Info.ContentView.b);
+		if (!ValuesView.NextSubstring(Message, '|', Info.ContentView.e) || !ValuesView.NextSubstring(Message, '|', Info.ContentView.e))
+			return false;
+
+		const size_t ValueCount = std::count(Message.begin() + ValuesView.b, Message.begin() + ValuesView.e, ',') + 1;
+		if (ValueCount % 3 != 0)
+			return false;
+
+		OutVertexCount = (uint32_t) (ValueCount / 3);
+		return true;
+	}
+
+	bool GetMeshVertices(const std::vector<char>& Message, const MessageInfo& Info, float* OutPositions, size_t VertexCount)
+	{
+		if (Info.DataType != EFacepipeData::Mesh)
+			return false;
+
+		if (Info.DatagramType == EDatagramType::Bytes)
+		{
+			uint32_t Header[4] = {}; // id, vertex count, reserved, bits
+			if (!ReadBinary(Message, Info.ContentView.b, Info.ContentView.e, Header) || Header[1] != VertexCount)
+				return false;
+
+			const size_t ValuesStart = Info.ContentView.b + sizeof(Header);
+			if (HasFlag(Info.BinaryFlags, EBinaryFlags::Quantized))
+				return ReadQuantizedValues(Message, ValuesStart, Info.ContentView.e, VertexCount * 3, Header[3], 3, OutPositions);
+
+			std::span<const float> Values;
+			if (!ReadBinaryFloats(Message, ValuesStart, Info.ContentView.e, VertexCount * 3, Values))
+				return false;
+
+			std::memcpy(OutPositions, Values.data(), Values.size_bytes());
+			return true;
+		}
+
+		VectorView ValuesView(Info.ContentView.b);
+		if (!ValuesView.NextSubstring(Message, '|', Info.ContentView.e) || !ValuesView.NextSubstring(Message, '|', Info.ContentView.e))
+			return false;
+
+		return ValuesView.ParseArray(Message, OutPositions, VertexCount * 3) == VertexCount * 3;
+	}
+}
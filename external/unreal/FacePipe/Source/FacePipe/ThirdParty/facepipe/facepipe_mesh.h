@@ -0,0 +1,55 @@
+#pragma once
+
+#include "facepipe.h"
+
+/*
+* Meshes are streamed as topology once, vertices every frame.
+*
+*	meshtopo|1813792217|1220|0,1,2,...|0.5,0.5,...		triangle indices and optional uv per vertex, refreshed periodically
+*	mesh|1813792217|0.1,0.2,0.3,...						xyz per vertex, every frame
+*
+* The topology id is a content hash (see HashMeshTopology) so a source can announce the same topology for
+* every subject, and a receiver can verify that what it cached is what the source meant. Vertex packets that
+* reference a topology that is not cached are dropped until the next refresh arrives.
+*
+* Binary vertex packets can be quantized with the same scheme as landmarks (EBinaryFlags::Quantized).
+*/
+
+namespace FacePipe
+{
+	struct MeshTopology
+	{
+		uint32_t Id = 0;
+		uint32_t VertexCount = 0;
+		std::vector<uint32_t> Indices;	// three per triangle
+		std::vector<float> UVs;			// two per vertex, or empty
+	};
+
+	// FNV-1a over the little-endian bytes of VertexCount, Indices and UVs
+	uint32_t HashMeshTopology(uint32_t VertexCount, std::span<const uint32_t> Indices, std::span<const float> UVs);
+
+	class MeshTopologyCache
+	{
+	public:
+		static const size_t MaxTopologies = 8;
+
+		// Stores the topology carried by a MeshTopology packet, returns false if the packet is malformed or fails its hash
+		bool Update(const std::vector<char>& Message, const MessageInfo& Info);
+
+		const MeshTopology* Find(uint32_t Id) const;
+
+		void Clear() { Topologies.clear(); }
+
+	protected:
+		std::vector<MeshTopology> Topologies; // most recently announced last
+	};
+
+	bool GetMeshTopologyId(const std::vector<char>& Message, const MessageInfo& Info, uint32_t& OutId);
+	bool GetMeshTopology(const std::vector<char>& Message, const MessageInfo& Info, MeshTopology& OutTopology);
+
+	// Reads the header of a Mesh packet so the caller can look up the topology and size its vertex storage
+	bool GetMeshVertexCount(const std::vector<char>& Message, const MessageInfo& Info, uint32_t& OutTopologyId, uint32_t& OutVertexCount);
+
+	// Writes xyz for VertexCount vertices, fails if the packet carries a different number of vertices
+	bool GetMeshVertices(const std::vector<char>& Message, const MessageInfo& Info, float* OutPositions, size_t VertexCount);
+}
@@ -0,0 +1,179 @@
+#include "facepipe_pca.h"
+
+#include <algorithm>
+#include <charconv>
+
+namespace FacePipe
+{
+	uint32_t HashExpressionBasis(uint32_t ComponentCount, std::span<const float> Mean, std::span<const float> Components)
+	{
+		uint32_t Hash = 2166136261u;
+		Hash = HashBytes(Hash, &ComponentCount, sizeof(ComponentCount));
+		Hash = HashBytes(Hash, Mean.data(), Mean.size_bytes());
+		Hash = HashBytes(Hash, Components.data(), Components.size_bytes());
+		return Hash;
+	}
+
+	bool ExpressionBasisCache::Update(const std::vector<char>& Message, const MessageInfo& Info)
+	{
+		uint32_t Id = 0;
+		if (!GetExpressionBasisId(Message, Info, Id))
+			return false;
+
+		// Same id means same content, refreshes do not need to be parsed again
+		if (Find(Id))
+			return true;
+
+		ExpressionBasis NewBasis;
+		if (!GetExpressionBasis(Message, Info, NewBasis))
+			return false;
+
+		if (Bases.size() >= MaxBases)
+			Bases.erase(Bases.begin());
+
+		Bases.push_back(std::move(NewBasis));
+		return true;
+	}
+
+	const ExpressionBasis* ExpressionBasisCache::Find(uint32_t Id) const
+	{
+		for (const ExpressionBasis& Existing : Bases)
+		{
+			if (Existing.Id == Id)
+				return &Existing;
+		}
+
+		return nullptr;
+	}
+
+	bool GetExpressionBasisId(const std::vector<char>& Message, const MessageInfo& Info, uint32_t& OutId)
+	{
+		if (Info.DataType != EFacepipeData::ExpressionBasis && Info.DataType != EFacepipeData::ExpressionCoefficients)
+			return false;
+
+		if (Info.DatagramType == EDatagramType::Bytes)
+			return ReadBinary(Message, Info.ContentView.b, Info.ContentView.e, OutId);
+
+		VectorView IdView(Info.ContentView.b);
+		if (!IdView.NextSubstring(Message, '|', Info.ContentView.e))
+			return false;
+
+		const char* Last = Message.data() + IdView.e;
+		std::from_chars_result Result = std::from_chars(Message.data() + IdView.b, Last, OutId);
+		return Result.ec == std::errc() && Result.ptr == Last;
+	}
+
+	bool GetExpressionBasis(const std::vector<char>& Message, const MessageInfo& Info, ExpressionBasis& OutBasis)
+	{
+		if (Info.DataType != EFacepipeData::ExpressionBasis || !GetExpressionBasisId(Message, Info, OutBasis.Id))
+			return false;
+
+		OutBasis.Mean.clear();
+		OutBasis.Components.clear();
+
+		if (Info.DatagramType == EDatagramType::Bytes)
+		{
+			uint32_t Counts[4] = {}; // id, component count, channel count, reserved
+			if (!ReadBinary(Message, Info.ContentView.b, Info.ContentView.e, Counts))
+				return false;
+
+			if (Counts[1] == 0 || Counts[1] > ARKitBlendshapeCount || Counts[2] != ARKitBlendshapeCount)
+				return false;
+
+			std::span<const float> Values;
+			if (!ReadBinaryFloats(Message, Info.ContentView.b + sizeof(Counts), Info.ContentView.e, ((size_t) Counts[1] + 1) * ARKitBlendshapeCount, Values))
+				return false;
+
+			OutBasis.ComponentCount = Counts[1];
+			OutBasis.Mean.assign(Values.begin(), Values.begin() + ARKitBlendshapeCount);
+			OutBasis.Components.assign(Values.begin() + ARKitBlendshapeCount, Values.end());
+		}
+		else
+		{
+			// id|componentcount|mean|components
+			VectorView FieldView(Info.ContentView.b);
+			if (!FieldView.NextSubstring(Message, '|', Info.ContentView.e) || !FieldView.NextSubstring(Message, '|', Info.ContentView.e))
+				return false;
+
+			const int ComponentCount = FieldView.ParseInt(Message);
+			if (ComponentCount <= 0 || ComponentCount > (int) ARKitBlendshapeCount)
+				return false;
+
+			OutBasis.ComponentCount = (uint32_t) ComponentCount;
+
+			if (!FieldView.NextSubstring(Message, '|', Info.ContentView.e))
+				return false;
+			FieldView.ParseArray(Message, OutBasis.Mean);
+
+			if (!FieldView.NextSubstring(Message, '|', Info.ContentView.e))
+				return false;
+			FieldView.ParseArray(Message, OutBasis.Components);
+
+			if (OutBasis.Mean.size() != ARKitBlendshapeCount || OutBasis.Components.size() != OutBasis.ComponentCount * ARKitBlendshapeCount)
+				return false;
+		}
+
+		return HashExpressionBasis(OutBasis.ComponentCount, OutBasis.Mean, OutBasis.Components) == OutBasis.Id;
+	}
+
+	bool GetExpressionCoefficients(const std::vector<char>& Message, const MessageInfo& Info, ExpressionBasisCache& Bases, BlendshapeFrame& OutBlendshapes)
+	{
+		uint32_t Id = 0;
+		if (Info.DataType != EFacepipeData::ExpressionCoefficients || !GetExpressionBasisId(Message, Info, Id))
+			return false;
+
+		const ExpressionBasis* Basis = Bases.Find(Id);
+		if (!Basis)
+		{
+			++Bases.UnknownBasisCount;
+			return false;
+		}
+
+		float Parsed[ARKitBlendshapeCount];
+		const float* Coefficients = Parsed;
+
+		if (Info.DatagramType == EDatagramType::Bytes)
+		{
+			uint32_t Counts[2] = {}; // id, count
+			std::span<const float> Values;
+			if (!ReadBinary(Message, Info.ContentView.b, Info.ContentView.e, Counts) || Counts[1] != Basis->ComponentCount || !ReadBinaryFloats(Message, Info.ContentView.b + sizeof(Counts), Info.ContentView.e, Counts[1], Values))
+				return false;
+
+			Coefficients = Values.data();
+		}
+		else
+		{
+			VectorView ValuesView(Info.ContentView.b);
+			if (!ValuesView.NextSubstring(Message, '|', Info.ContentView.e) || !ValuesView.NextSubstring(Message, '|', Info.ContentView.e))
+				return false;
+
+			if (ValuesView.ParseArray(Message, Parsed, ARKitBlendshapeCount) != Basis->ComponentCount)
+				return false;
+		}
+
+		ReconstructFromBasis(Basis->Mean.data(), Basis->Components.data(), Coefficients, Basis->ComponentCount, ARKitBlendshapeCount, OutBlendshapes.Values);
+
+		for (float& Value : OutBlendshapes.Values)
+			Value = std::clamp(Value, 0.0f, 1.0f);
+
+		OutBlendshapes.ValidMask = (uint64_t(1) << ARKitBlendshapeCount) - 1;
+		return true;
+	}
+
+	void ProjectOntoBasis(const ExpressionBasis& Basis, const BlendshapeFrame& Blendshapes, float* OutCoefficients)
+	{
+		float Centered[ARKitBlendshapeCount];
+		for (size_t j = 0; j < ARKitBlendshapeCount; ++j)
+			Centered[j] = Blendshapes.IsValid(j) ? Blendshapes.Values[j] - Basis.Mean[j] : 0.0f;
+
+		for (size_t k = 0; k < Basis.ComponentCount; ++k)
+		{
+			const float* Row = Basis.Components.data() + k * ARKitBlendshapeCount;
+
+			float Sum = 0.0f;
+			for (size_t j = 0; j < ARKitBlendshapeCount; ++j)
+				Sum += Row[j] * Centered[j];
+			OutCoefficients[k] = Sum;
+		}
+	}
+}
@@ -0,0 +1,57 @@
+#pragma once
+
+#include "facepipe.h"
+
+/*
+* The ARKit blendshapes are highly correlated, a dozen principal components reconstruct a performance well.
+* A basis learned offline (external/blendshape_pca.py) is announced once, afterwards only its coefficients are sent:
+*
+*	pcabasis|2864434397|12|mean...|components...		52 mean values and 12 x 52 component values, refreshed periodically
+*	pca|2864434397|0.81,-0.12,0.05,...					12 coefficients every frame
+*
+* The basis id is a content hash (see HashExpressionBasis) like mesh topologies. Channels are the 52 ARKit blendshapes
+* in ARKit order, reconstructed values are clamped to 0-1. Coefficients that reference a basis that is not cached are
+* dropped and counted until the next refresh arrives.
+*/
+
+namespace FacePipe
+{
+	struct ExpressionBasis
+	{
+		uint32_t Id = 0;
+		uint32_t ComponentCount = 0;
+		std::vector<float> Mean;		// ARKitBlendshapeCount values
+		std::vector<float> Components;	// ComponentCount rows of ARKitBlendshapeCount values
+	};
+
+	// FNV-1a over the little-endian bytes of ComponentCount, Mean and Components
+	uint32_t HashExpressionBasis(uint32_t ComponentCount, std::span<const float> Mean, std::span<const float> Components);
+
+	class ExpressionBasisCache
+	{
+	public:
+		static const size_t MaxBases = 8;
+
+		// Stores the basis carried by an ExpressionBasis packet, returns false if the packet is malformed or fails its hash
+		bool Update(const std::vector<char>& Message, const MessageInfo& Info);
+
+		const ExpressionBasis* Find(uint32_t Id) const;
+
+		void Clear() { Bases.clear(); }
+
+		size_t UnknownBasisCount = 0; // ExpressionCoefficients packets dropped because their basis was not cached
+
+	protected:
+		std::vector<ExpressionBasis> Bases; // most recently announced last
+	};
+
+	bool GetExpressionBasisId(const std::vector<char>& Message, const MessageInfo& Info, uint32_t& OutId);
+	bool GetExpressionBasis(const std::vector<char>& Message, const MessageInfo& Info, ExpressionBasis& OutBasis);
+
+	// Reconstructs all ARKit blendshapes of OutBlendshapes from the coefficients
+	bool GetExpressionCoefficients(const std::vector<char>& Message, const MessageInfo& Info, ExpressionBasisCache& Bases, BlendshapeFrame& OutBlendshapes);
+
+	// Sender side, writes Basis.ComponentCount coefficients for the ARKit blendshapes of Blendshapes (missing ones count as the mean).
+	// The packets are written with EncodeExpressionBasis and EncodeExpressionCoefficients.
+	void ProjectOntoBasis(const ExpressionBasis& Basis, const BlendshapeFrame& Blendshapes, float* OutCoefficients);
+}
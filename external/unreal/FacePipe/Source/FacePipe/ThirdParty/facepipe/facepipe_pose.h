@@ -0,0 +1,34 @@
+#pragma once
+
+#include "facepipe.h"
+
+/*
+* Poses are the compact form of rigid transforms: a unit quaternion, a translation and a uniform scale, 8 floats instead
+* of the 16 of Matrices4x4, and a representation the receiver can interpolate directly (nlerp/slerp + lerp).
+*
+*	pose|face=qx,qy,qz,qw,tx,ty,tz[,scale]|eyeL=...		ASCII, scale is left out when it is 1
+*	u32 Count | Count x (f32 qx,qy,qz,qw, f32 tx,ty,tz, f32 scale) | names		Bytes (32 bytes per pose)
+*	u32 Count | Count x (u32 rotation, f32 tx,ty,tz, f32 scale) | names			Bytes, EBinaryFlags::Quantized (20 bytes per pose)
+*
+* Quantized rotations are packed as "smallest three": q and -q are the same rotation, so the largest component is made
+* positive and left out, the receiver rebuilds it as sqrt(1 - a*a - b*b - c*c). Bits 30-31 hold its index (x=0 .. w=3),
+* bits 20-29, 10-19 and 0-9 the remaining components in order, each mapped from [-1/sqrt(2), 1/sqrt(2)] to 0-1023.
+* The rotation error stays below 0.25 degrees.
+*
+* Matrices are row-major with the translation in elements 3, 7 and 11, as MediaPipe sends them and main.cpp draws them.
+*/
+
+namespace FacePipe
+{
+	// Rotation, translation and uniform scale of a 16 float matrix, shear and non-uniform scale are averaged out.
+	// Fails for matrices that are not 16 floats or have no proper rotation (zero scale or a mirroring).
+	bool DecomposeMatrix(std::span<const float> Matrix, Pose& OutPose);
+	void ComposeMatrix(const Pose& Pose, float OutMatrix[16]);
+
+	// Smallest-three packing of a unit quaternion, see above
+	uint32_t PackRotation(const float Rotation[4]);
+	void UnpackRotation(uint32_t Packed, float OutRotation[4]);
+
+	// Rotations are normalized on the way in, so the poses can be interpolated without further checks
+	bool GetPoses(const std::vector<char>& Message, const MessageInfo& Info, PoseMap& OutPoses);
+}
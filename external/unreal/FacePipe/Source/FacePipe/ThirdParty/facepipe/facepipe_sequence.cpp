@@ -0,0 +1,106 @@
+#include "facepipe_sequence.h"
+
+namespace FacePipe
+{
+	void SequenceStats::Add(const SequenceStats& Other)
+	{
+		Received += Other.Received;
+		Lost += Other.Lost;
+		Reordered += Other.Reordered;
+		Duplicates += Other.Duplicates;
+		Restarts += Other.Restarts;
+	}
+
+	SequenceTracker::Stream& SequenceTracker::FindOrAdd(const MessageInfo& Info, bool& bOutAdded)
+	{
+		bOutAdded = false;
+		for (Stream& Existing : Streams)
+		{
+			if (Existing.DataType == Info.DataType && Existing.Key.Matches(Info))
+				return Existing;
+		}
+
+		bOutAdded = true;
+		Stream& NewStream = Streams.emplace_back();
+		NewStream.Key.Assign(Info);
+		NewStream.DataType = Info.DataType;
+		return NewStream;
+	}
+
+	bool SequenceTracker::Accept(const MessageInfo& Info)
+	{
+		int64_t LostChange = 0;
+		return Accept(Info, LostChange);
+	}
+
+	bool SequenceTracker::Accept(const MessageInfo& Info, int64_t& OutLostChange)
+	{
+		OutLostChange = 0;
+		if (!Info.bHasSequence)
+			return true;
+
+		bool bAdded = false;
+		Stream& S = FindOrAdd(Info, bAdded);
+		S.Stats.Received++;
+
+		// Serial number arithmetic so that wrapping around 2^32 is just another step forward
+		const int32_t Distance = (int32_t) (Info.Sequence - S.Highest);
+
+		// A lower number sent later, or a clock that went back, means the source started over. Reordered datagrams
+		// are older than Highest but only by a fraction of a second.
+		const bool bFarApart = Distance < -(int32_t) RestartDistance || Distance > (int32_t) RestartDistance;
+		const bool bTimeRestarted = (Distance <= 0 && Info.Time > S.HighestTime) || Info.Time < S.HighestTime - RestartTimeGap;
+
+		if (bAdded || bFarApart || bTimeRestarted)
+		{
+			if (!bAdded)
+				S.Stats.Restarts++;
+
+			S.Highest = Info.Sequence;
+			S.HighestTime = Info.Time;
+			S.Window = 1;
+			return true;
+		}
+
+		if (Distance > 0)
+		{
+			S.Stats.Lost += (uint64_t) (Distance - 1);
+			OutLostChange = Distance - 1;
+			S.Window = (Distance < 64) ? (S.Window << Distance) | 1 : 1;
+			S.Highest = Info.Sequence;
+			S.HighestTime = Info.Time;
+			return true;
+		}
+
+		const uint32_t Age = (uint32_t) -Distance;
+		if (Age < 64 && (S.Window >> Age) & 1)
+		{
+			S.Stats.Duplicates++;
+			return false;
+		}
+
+		// Late, it was counted as lost when the newer datagram arrived. Older than the window it cannot be told
+		// apart from a duplicate, it is counted as reordered either way since it is dropped.
+		if (Age < 64)
+		{
+			S.Window |= uint64_t(1) << Age;
+			if (S.Stats.Lost > 0)
+			{
+				S.Stats.Lost--;
+				OutLostChange = -1;
+			}
+		}
+
+		S.Stats.Reordered++;
+		return false;
+	}
+
+	SequenceStats SequenceTracker::GetTotals() const
+	{
+		SequenceStats Totals;
+		for (const Stream& Existing : Streams)
+			Totals.Add(Existing.Stats);
+
+		return Totals;
+	}
+}
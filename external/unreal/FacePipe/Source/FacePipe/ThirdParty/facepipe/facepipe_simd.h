@@ -0,0 +1,39 @@
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+#include <vector>
+
+/*
+* Vectorized helpers for the hot parts of the FacePipe protocol.
+* 
+* AVX2 is used when the compiler targets it (/arch:AVX2 or -mavx2), SSE2 on any x64 build,
+* and a plain scalar loop everywhere else. All paths produce identical results.
+*/
+
+#if defined(__AVX2__)
+	#define FACEPIPE_SIMD_AVX2 1
+#elif defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+	#define FACEPIPE_SIMD_SSE2 1
+#endif
+
+namespace FacePipe
+{
+	// Returns a pointer to the first Delimiter in [First, Last) or Last if there is none
+	const char* FindDelimiter(const char* First, const char* Last, char Delimiter) noexcept;
+
+	// Short decimal numbers such as 0.51234567 or -12.5 are parsed with SWAR (8 digits per step), anything else
+	// (exponents, inf/nan, mantissas above 2^53, more than 22 decimals) falls back to std::from_chars.
+	// The result is the same as std::from_chars either way. Returns 0.0f if the token is not a number.
+	float ParseFloatToken(const char* First, const char* Last) noexcept;
+
+	// Splits [First, Last) on ',' in a single vectorized pass and parses every token into OutValues.
+	// OutValues is cleared but keeps its capacity.
+	void ParseFloatList(const char* First, const char* Last, std::vector<float>& OutValues);
+
+	// OutValues[i] = Values[i] * Scale[i % Components] + Offset[i % Components], Components is 2 (x,y) or 3 (x,y,z)
+	void DequantizeLandmarks(const uint16_t* Values, size_t Count, size_t Components, const float Scale[3], const float Offset[3], float* OutValues) noexcept;
+
+	// OutValues[j] = Mean[j] + sum of Coefficients[k] * Basis[k * Count + j] over the ComponentCount rows of Basis, for j < Count
+	void ReconstructFromBasis(const float* Mean, const float* Basis, const float* Coefficients, size_t ComponentCount, size_t Count, float* OutValues) noexcept;
+}
@@ -0,0 +1,149 @@
+#include "facepipe_sparse.h"
+
+#include <algorithm>
+#include <charconv>
+#include <cmath>
+
+namespace FacePipe
+{
+	BlendshapeUpdateEncoder::Stream& BlendshapeUpdateEncoder::FindOrAdd(const MessageInfo& Info)
+	{
+		for (Stream& Existing : Streams)
+		{
+			if (Existing.Key.Matches(Info))
+				return Existing;
+		}
+
+		Stream& NewStream = Streams.emplace_back();
+		NewStream.Key.Assign(Info);
+		return NewStream;
+	}
+
+	void BlendshapeUpdateEncoder::RequestRefresh()
+	{
+		for (Stream& Existing : Streams)
+			Existing.bNeedsRefresh = true;
+	}
+
+	size_t BlendshapeUpdateEncoder::Encode(std::span<char> Out, const MessageInfo& Info, const BlendshapeFrame& Blendshapes, const EncodeSettings& Settings)
+	{
+		Stream& S = FindOrAdd(Info);
+		MessageInfo StreamInfo = Info;
+
+		if (S.bNeedsRefresh || S.SinceRefresh + 1 >= RefreshInterval)
+		{
+			StreamInfo.Sequence = S.RefreshSequence;
+
+			const size_t Size = EncodeBlendshapes(Out, StreamInfo, Blendshapes, Settings);
+			if (Size == 0)
+				return 0;
+
+			std::memcpy(S.Sent, Blendshapes.Values, sizeof(S.Sent));
+			S.SentMask = Blendshapes.ValidMask;
+			S.SinceRefresh = 0;
+			S.bNeedsRefresh = false;
+			S.RefreshSequence++;
+			return Size;
+		}
+
+		uint8_t Indices[ARKitBlendshapeCount];
+		float Values[ARKitBlendshapeCount];
+		size_t Count = 0;
+		for (size_t i = 0; i < ARKitBlendshapeCount; ++i)
+		{
+			if (!Blendshapes.IsValid(i))
+				continue;
+
+			const bool bSent = (S.SentMask >> i) & 1;
+			if (bSent && std::fabs(Blendshapes.Values[i] - S.Sent[i]) <= DeadBand)
+				continue;
+
+			Indices[Count] = (uint8_t) i;
+			Values[Count] = Blendshapes.Values[i];
+			++Count;
+		}
+
+		if (Count == 0)
+		{
+			S.SinceRefresh++;
+			return 0;
+		}
+
+		StreamInfo.Sequence = S.UpdateSequence;
+
+		const size_t Size = EncodeBlendshapeUpdates(Out, StreamInfo, std::span(Indices, Count), std::span(Values, Count), Settings);
+		if (Size == 0)
+			return 0;
+
+		for (size_t i = 0; i < Count; ++i)
+			S.Sent[Indices[i]] = Values[i];
+
+		S.SentMask |= Blendshapes.ValidMask;
+		S.SinceRefresh++;
+		S.UpdateSequence++;
+		return Size;
+	}
+
+	bool GetBlendshapeUpdates(const std::vector<char>& Message, const MessageInfo& Info, BlendshapeFrame& InOutBlendshapes)
+	{
+		if (Info.DataType != EFacepipeData::BlendshapeUpdates)
+			return false;
+
+		if (Info.DatagramType == EDatagramType::Bytes)
+		{
+			uint32_t Count = 0;
+			std::span<const float> Values;
+			if (!ReadBinary(Message, Info.ContentView.b, Info.ContentView.e, Count) || !ReadBinaryFloats(Message, Info.ContentView.b + sizeof(uint32_t), Info.ContentView.e, Count, Values))
+				return false;
+
+			const size_t IndicesStart = Info.ContentView.b + sizeof(uint32_t) + Values.size_bytes();
+			if (IndicesStart > Info.ContentView.e || Count > Info.ContentView.e - IndicesStart)
+				return false;
+
+			// An index outside of the ARKit set fails the whole datagram, nothing is merged
+			const uint8_t* Indices = (const uint8_t*) Message.data() + IndicesStart;
+			if (std::any_of(Indices, Indices + Count, [](uint8_t Index) { return Index >= ARKitBlendshapeCount; }))
+				return false;
+
+			for (size_t i = 0; i < Count; ++i)
+				InOutBlendshapes.Set((size_t) Indices[i], Values[i]);
+
+			return true;
+		}
+
+		// index=value, false if the index is not a complete ARKit index or the value is missing
+		auto NextUpdate = [&](VectorView& UpdateView, size_t& OutIndex, VectorView& OutValueView)
+		{
+			VectorView TupleView(UpdateView.b);
+			if (!TupleView.NextSubstring(Message, '=', UpdateView.e))
+				return false;
+
+			const char* Last = Message.data() + TupleView.e;
+			std::from_chars_result Result = std::from_chars(Message.data() + TupleView.b, Last, OutIndex);
+			if (Result.ec != std::errc() || Result.ptr != Last || OutIndex >= ARKitBlendshapeCount)
+				return false;
+
+			OutValueView = TupleView;
+			return OutValueView.NextSubstring(Message, '=', UpdateView.e);
+		};
+
+		// Checked before anything is merged so that a malformed datagram leaves the blendshapes as they are
+		size_t Index = 0;
+		VectorView ValueView;
+		VectorView UpdateView(Info.ContentView.b);
+		while (UpdateView.NextSubstring(Message, '|', Info.ContentView.e))
+		{
+			if (!NextUpdate(UpdateView, Index, ValueView))
+				return false;
+		}
+
+		UpdateView = VectorView(Info.ContentView.b);
+		while (UpdateView.NextSubstring(Message, '|', Info.ContentView.e))
+		{
+			NextUpdate(UpdateView, Index, ValueView);
+			InOutBlendshapes.Set(Index, ValueView.ParseFloat(Message));
+		}
+
+		return true;
+	}
+}
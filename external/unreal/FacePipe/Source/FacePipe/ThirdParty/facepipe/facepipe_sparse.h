@@ -0,0 +1,56 @@
+#pragma once
+
+#include "facepipe.h"
+#include "facepipe_encode.h"
+
+/*
+* Most blendshapes sit still for long stretches (brows, cheeks, nose), sparse updates only carry the ones that moved:
+*
+*	bs|browDownLeft=0.01|...|tongueOut=0		full refresh every RefreshInterval frames
+*	bsu|17=0.52|9=0.1							ARKit index=value of the blendshapes that changed since they were last sent
+*
+* A blendshape is sent when it moved more than DeadBand away from the value the receiver last got, so slow drifts
+* are sent as well once they add up. Receivers merge updates into the blendshapes they already have; after a lost update
+* a value stays stale until that blendshape moves again or until the next refresh, at most RefreshInterval frames.
+*
+* Only ARKit blendshapes can be updated, others (e.g. MediaPipe _neutral) are only sent with the full refresh.
+*/
+
+namespace FacePipe
+{
+	class BlendshapeUpdateEncoder
+	{
+	public:
+		float DeadBand = 0.01f;
+		uint32_t RefreshInterval = 30; // frames per full refresh, including the refresh
+
+		// Writes a Blendshapes or BlendshapeUpdates datagram for the subject of Info. If Info has a sequence number the
+		// encoder numbers both streams itself, receivers track each data type as its own stream.
+		// Returns 0 if no blendshape moved beyond the dead-band (nothing needs to be sent) or if the datagram did not fit.
+		size_t Encode(std::span<char> Out, const MessageInfo& Info, const BlendshapeFrame& Blendshapes, const EncodeSettings& Settings = {});
+
+		// The next datagram of every subject is a full refresh, e.g. when a new receiver joins
+		void RequestRefresh();
+
+		void Clear() { Streams.clear(); }
+
+	protected:
+		struct Stream
+		{
+			SubjectKey Key;
+			uint32_t RefreshSequence = 0;
+			uint32_t UpdateSequence = 0;
+			uint32_t SinceRefresh = 0;
+			bool bNeedsRefresh = true;
+			float Sent[ARKitBlendshapeCount] = {};	// what the receiver has
+			uint64_t SentMask = 0;
+		};
+
+		Stream& FindOrAdd(const MessageInfo& Info);
+
+		std::vector<Stream> Streams;
+	};
+
+	// Merges the values of a BlendshapeUpdates datagram into InOutBlendshapes, the other values are left as they are
+	bool GetBlendshapeUpdates(const std::vector<char>& Message, const MessageInfo& Info, BlendshapeFrame& InOutBlendshapes);
+}
@@ -0,0 +1,145 @@
+#include "facepipe_view.h"
+
+namespace FacePipe
+{
+	bool FrameView::Bind(const std::vector<char>& InMessage, const MessageInfo& Info)
+	{
+		Message = &InMessage;
+		DataType = Info.DataType;
+		DatagramType = Info.DatagramType;
+
+		ImageWidth = 0;
+		ImageHeight = 0;
+
+		Stride = 1;
+		Entries.clear();
+		Values = std::span<const float>();
+		Decoded.clear();
+
+		if (DatagramType != EDatagramType::ASCII && DatagramType != EDatagramType::Bytes)
+			return false;
+
+		switch (DataType)
+		{
+		case EFacepipeData::Landmarks2D:
+		case EFacepipeData::Landmarks3D:
+			return BindLandmarks(Info);
+		case EFacepipeData::Blendshapes:
+			return BindNamedValues(Info, 1);
+		case EFacepipeData::Matrices4x4:
+			return BindNamedValues(Info, 16);
+		default:
+			return false;
+		}
+	}
+
+	bool FrameView::BindLandmarks(const MessageInfo& Info)
+	{
+		LandmarksView View;
+		if (GetLandmarksView(*Message, Info, View))
+		{
+			ImageWidth = View.ImageWidth;
+			ImageHeight = View.ImageHeight;
+			Values = View.Values;
+			return true;
+		}
+
+		if (!FacePipe::GetLandmarks(*Message, Info, Decoded, ImageWidth, ImageHeight))
+			return false;
+
+		Values = Decoded;
+		return true;
+	}
+
+	bool FrameView::BindNamedValues(const MessageInfo& Info, size_t ValueStride)
+	{
+		Stride = ValueStride;
+
+		if (DatagramType == EDatagramType::Bytes)
+		{
+			NamedValuesView View;
+			if (!GetNamedValuesView(*Message, Info, Stride, View))
+				return false;
+
+			size_t NameOffset = 0;
+			std::string_view Name;
+			for (size_t i = 0; i < View.Values.size(); i += Stride)
+			{
+				if (!View.NextName(NameOffset, Name))
+					return false;
+
+				Entry& NewEntry = Entries.emplace_back();
+				NewEntry.Name.b = Name.data() - Message->data();
+				NewEntry.Name.e = NewEntry.Name.b + Name.size();
+				NewEntry.bDecoded = true;
+				NewEntry.bValid = true;
+			}
+
+			Values = View.Values;
+			return true;
+		}
+
+		// Only the split points are found here, values are parsed on request
+		VectorView TupleListView(Info.ContentView.b), NameView, ValuesView;
+		while (TupleListView.NextNamedValues(*Message, Info.ContentView.e, NameView, ValuesView))
+		{
+			Entry& NewEntry = Entries.emplace_back();
+			NewEntry.Name = NameView;
+			NewEntry.Values = ValuesView;
+		}
+
+		Decoded.resize(Entries.size() * Stride);
+		return true;
+	}
+
+	std::span<const float> FrameView::GetLandmarks() const
+	{
+		if (DataType != EFacepipeData::Landmarks2D && DataType != EFacepipeData::Landmarks3D)
+			return std::span<const float>();
+
+		return Values;
+	}
+
+	std::string_view FrameView::GetName(size_t Index) const
+	{
+		if (Index >= Entries.size())
+			return std::string_view();
+
+		return Entries[Index].Name.StringView(*Message);
+	}
+
+	std::span<const float> FrameView::GetValues(size_t Index)
+	{
+		if (Index >= Entries.size())
+			return std::span<const float>();
+
+		Entry& Found = Entries[Index];
+		if (!Found.bDecoded)
+		{
+			Found.bDecoded = true;
+			Found.bValid = Found.Values.ParseArray(*Message, Decoded.data() + Index * Stride, Stride) == Stride;
+		}
+
+		if (!Found.bValid)
+			return std::span<const float>();
+
+		if (DatagramType == EDatagramType::Bytes)
+			return Values.subspan(Index * Stride, Stride);
+
+		return std::span<const float>(Decoded.data() + Index * Stride, Stride);
+	}
+
+	bool FrameView::FindValues(std::string_view Name, std::span<const float>& OutValues)
+	{
+		for (size_t i = 0; i < Entries.size(); ++i)
+		{
+			if (Entries[i].Name.StringView(*Message) == Name)
+			{
+				OutValues = GetValues(i);
+				return !OutValues.empty();
+			}
+		}
+
+		return false;
+	}
+}
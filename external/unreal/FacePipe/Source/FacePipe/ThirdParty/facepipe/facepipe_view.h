@@ -0,0 +1,69 @@
+#pragma once
+
+#include "facepipe.h"
+
+/*
+* FrameView is a non-owning view of one datagram (or one composite section). Bind validates the content once,
+* afterwards values are read as spans:
+*
+*	FacePipe::FrameView View;
+*	std::span<const float> Face;
+*	if (View.Bind(Message, Info) && View.FindValues("face", Face))
+*		...
+*
+* Binary payloads are not copied, the spans point into Message. ASCII named values are parsed lazily into storage owned
+* by the view, only the values that are asked for are parsed. Landmarks that cannot be viewed in place (ASCII and
+* quantized) are decoded by Bind with GetLandmarks. Spans are valid until the next Bind or until Message changes,
+* whichever comes first. Reusing one view between datagrams does not allocate once it has seen the largest datagram.
+*
+* The datagrams are read with the parsers of facepipe.h: Get*View for binary and VectorView::NextNamedValues for
+* ASCII named values.
+*/
+
+namespace FacePipe
+{
+	class FrameView
+	{
+	public:
+		// Supports Landmarks2D/3D, Blendshapes and Matrices4x4. Composite datagrams are bound per section (see GetSection).
+		bool Bind(const std::vector<char>& Message, const MessageInfo& Info);
+
+		EFacepipeData GetDataType() const { return DataType; }
+
+		// Landmarks
+		int GetImageWidth() const { return ImageWidth; }
+		int GetImageHeight() const { return ImageHeight; }
+		std::span<const float> GetLandmarks() const;
+
+		// Blendshapes (one value per entry) and Matrices4x4 (16 values per entry)
+		size_t GetCount() const { return Entries.size(); }
+		size_t GetStride() const { return Stride; }
+		std::string_view GetName(size_t Index) const;
+		std::span<const float> GetValues(size_t Index); // empty if the entry is malformed
+		bool FindValues(std::string_view Name, std::span<const float>& OutValues);
+
+	protected:
+		struct Entry
+		{
+			VectorView Name;
+			VectorView Values;		// ASCII only, the unparsed values
+			bool bDecoded = false;	// ASCII only, Decoded holds the values at Index * Stride
+			bool bValid = false;
+		};
+
+		bool BindLandmarks(const MessageInfo& Info);
+		bool BindNamedValues(const MessageInfo& Info, size_t ValueStride);
+
+		const std::vector<char>* Message = nullptr;
+		EFacepipeData DataType = EFacepipeData::INVALID;
+		EDatagramType DatagramType = EDatagramType::Invalid;
+
+		int ImageWidth = 0;
+		int ImageHeight = 0;
+
+		size_t Stride = 1;
+		std::vector<Entry> Entries;
+		std::span<const float> Values;	// the landmarks, or all binary named values in entry order
+		std::vector<float> Decoded;		// ASCII values and landmarks that are not binary floats
+	};
+}
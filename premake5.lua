@@ -72,11 +72,13 @@ workspace "FacePipe"
     configurations { "Debug", "Release" }
 
     cppdialect "C++20"
-    systemversion("latest")
-    system      "windows"
-    platforms { "win64" }
+    -- system defaults to the target of premake (the host or --os), Linux builds the tests against the udp_posix.cpp backend
+    if os.istarget("windows") then
+        platforms { "win64" }
+    else
+        platforms { "linux64" }
+    end
     defines   { 
-        "OS_WINDOWS",
         "TINYOBJLOADER_IMPLEMENTATION",
         "PYTHON_ENABLED="..python_enable,
         "PYTHON_MULTITHREADED="..python_multithreaded
@@ -84,14 +86,23 @@ workspace "FacePipe"
 
     filter { "platforms:*64"} architecture "x64"
 
-    symbolspath '$(TargetName).pdb'
-    staticruntime "on"
+    filter { "system:windows" }
+        systemversion("latest")
+        defines     { "OS_WINDOWS" }
+        symbolspath '$(TargetName).pdb'
+        staticruntime "on"
+        links       { "opengl32", "SDL2", "ws2_32.lib" }
+        flags       { "MultiProcessorCompile" }
+
+    filter { "system:linux" }
+        defines     { "OS_LINUX" }
+        links       { "pthread" }
+
+    filter{}
 
     debugdir(binaries_folder)
     includedirs { includes_folder, source_folder, source_thirdparty_folder }
     libdirs     { libs_folder }
-    links       { "opengl32", "SDL2", "ws2_32.lib" }
-    flags       { "MultiProcessorCompile" }
 
     if python_enable == "1" then
         setupPython("python311")
@@ -109,10 +120,20 @@ workspace "FacePipe"
         
     filter{}
 
+-- Winsock, OpenGL and SDL are only set up for Windows
+if os.istarget("windows") then
 project "FacePipeApp"
     kind "ConsoleApp"
     targetdir(binaries_folder)
     targetname("main")
     files ({source_folder .. "**.h", source_folder .. "**.c", source_folder .. "**.cpp"})
     removefiles{ source_folder .. "main*.cpp"}
-    files ({source_folder .. "main.cpp"})
\ No newline at end of file
+    files ({source_folder .. "main.cpp"})
+end
+
+-- Tests of the protocol in source/net, see tests/tests.h
+project "FacePipeTests"
+    kind "ConsoleApp"
+    targetdir(binaries_folder)
+    targetname("tests")
+    files ({"tests/**.h", "tests/**.cpp", source_folder .. "net/**.h", source_folder .. "net/**.cpp"})
@@ -1,5 +1,6 @@
 #include "application.h"
 #include <atomic>
+#include <chrono>
 #include "opengl/framebuffer.h"
 
 bool App::bQuit = false;
@@ -21,8 +22,17 @@ WebCam App::webcam = WebCam();
 UDPSocket App::receiveDataSocket = UDPSocket();
 UDPDatagram App::lastReceivedDatagram = UDPDatagram();
 ThreadSafeQueue<UDPDatagram> App::datagramsQueue = ThreadSafeQueue<UDPDatagram>();
+std::atomic<size_t> App::recoveredDatagrams = 0;
+std::atomic<size_t> App::unrecoverableDatagrams = 0;
 
 FacePipe::Frame App::latestFrame = FacePipe::Frame();
+FacePipe::DictionaryCache App::dictionaries = FacePipe::DictionaryCache();
+FacePipe::SequenceTracker App::sequences = FacePipe::SequenceTracker();
+FacePipe::MeshTopologyCache App::meshTopologies = FacePipe::MeshTopologyCache();
+FacePipe::LandmarkDeltaDecoder App::landmarkDeltas = FacePipe::LandmarkDeltaDecoder();
+FacePipe::ExpressionBasisCache App::expressionBases = FacePipe::ExpressionBasisCache();
+FacePipe::CustomSchemas App::latestCustomData = FacePipe::CustomSchemas();
+WeakPtr<GLTriangleMesh> App::streamedMesh = WeakPtr<GLTriangleMesh>();
 
 std::function<void(float, float, const SDL_Event& event)> App::OnTickEvent = [](float time, float dt, const SDL_Event& event) -> void {};
 std::function<void(float, float)> App::OnTickScene = [](float time, float dt) -> void {};
@@ -32,14 +42,63 @@ std::thread receiveDatagramsThread;
 std::atomic<bool> shutdownReceiveThread = false;
 void ReceiveDatagramsThreadLoop()
 {
+	FacePipe::ParityDecoder parity;
+	FacePipe::FragmentReassembler fragments;
+	UDPDatagram unwrapped;
+	UDPDatagram reassembled;
+	std::vector<char> decoded;
+	const auto startTime = std::chrono::steady_clock::now();
+
+	auto deliver = [&](UDPDatagram& d, double now) -> void
+	{
+		UDPDatagram* complete = &d;
+		if (!d.message.empty() && d.message[0] == 'f')
+		{
+			// Only complete datagrams reach the main thread
+			if (!fragments.Add(d.message, d.source.Key(), now, reassembled.message))
+				return;
+
+			reassembled.source = d.source;
+			complete = &reassembled;
+		}
+
+		// Compressed datagrams are unwrapped here, the main thread and the forwarding only see plain datagrams
+		if (!complete->message.empty() && complete->message[0] == 'e')
+		{
+			if (!FacePipe::DecodeEnvelope(complete->message, decoded))
+				return;
+
+			complete->message.swap(decoded);
+		}
+
+		complete->received = std::chrono::steady_clock::now();
+		App::datagramsQueue.Push(*complete);
+	};
+
 	while (!shutdownReceiveThread)
 	{
 		std::vector<UDPDatagram> grams;
 		App::receiveDataSocket.Receive(grams);
 
+		const double now = std::chrono::duration<double>(std::chrono::steady_clock::now() - startTime).count();
 		for (UDPDatagram& d : grams)
 		{
-			App::datagramsQueue.Push(d);
+			if (d.message.empty() || d.message[0] != 'p')
+			{
+				deliver(d, now);
+				continue;
+			}
+
+			// Parity protected packets can carry fragments and envelopes themselves, they are unwrapped first
+			unwrapped.source = d.source;
+			if (parity.Add(d.message, d.source.Key(), now, unwrapped.message))
+				deliver(unwrapped, now);
+
+			if (parity.TakeRecovered(unwrapped.message))
+				deliver(unwrapped, now);
+
+			App::recoveredDatagrams = parity.RecoveredCount;
+			App::unrecoverableDatagrams = parity.UnrecoverableCount;
 		}
 
 		Sleep(1);
@@ -1,4 +1,5 @@
 #pragma once
+#include <atomic>
 #include "core/core.h"
 #include "net/net.h"
 #include "opengl/opengl.h"
@@ -82,6 +83,15 @@ public:
 	static UDPSocket receiveDataSocket;
 	static UDPDatagram lastReceivedDatagram;
 	static ThreadSafeQueue<UDPDatagram> datagramsQueue;
+	static std::atomic<size_t> recoveredDatagrams;		// rebuilt from parity packets by the receive thread
+	static std::atomic<size_t> unrecoverableDatagrams;	// lost despite parity protection
 
 	static FacePipe::Frame latestFrame;
+	static FacePipe::DictionaryCache dictionaries;
+	static FacePipe::SequenceTracker sequences;
+	static FacePipe::MeshTopologyCache meshTopologies;
+	static FacePipe::LandmarkDeltaDecoder landmarkDeltas;
+	static FacePipe::ExpressionBasisCache expressionBases;
+	static FacePipe::CustomSchemas latestCustomData; // schema payloads (gaze, ...) of latestFrame, see facepipe_custom.h
+	static WeakPtr<GLTriangleMesh> streamedMesh; // receives the vertices of Mesh datagrams
 };
\ No newline at end of file
@@ -127,7 +127,14 @@ void UI::GenerateMainLayout(UIManager& ui)
 							if (bShowBlendshapes)
 							{
 								ImGui::Text("Arkit Blendshapes");
-								for (auto& Pair : App::latestFrame.Blendshapes)
+								FacePipe::BlendshapeFrame& Blendshapes = App::latestFrame.Blendshapes;
+								for (size_t i = 0; i < FacePipe::ARKitBlendshapeCount; ++i)
+								{
+									if (Blendshapes.IsValid(i))
+										ImGui::SliderFloat(FacePipe::ARKitBlendshapeNames[i].data(), &Blendshapes.Values[i], -1.0f, 1.0f, "%.3f", ImGuiSliderFlags_NoInput);
+								}
+
+								for (auto& Pair : Blendshapes.Other)
 								{
 									ImGui::SliderFloat(Pair.first.c_str(), &Pair.second, -1.0f, 1.0f, "%.3f", ImGuiSliderFlags_NoInput);
 								}
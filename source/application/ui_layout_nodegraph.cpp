@@ -63,6 +63,13 @@ namespace UI
 						ImGui::Text("Camera: %d", meta.Camera);
 						ImGui::Text("Subject: %d", meta.Subject);
 						ImGui::Text("Time: %.2f", meta.Time);
+
+						FacePipe::SequenceStats stats = App::sequences.GetTotals();
+						ImGui::Text("Lost: %llu", (unsigned long long) stats.Lost);
+						ImGui::Text("Reordered: %llu", (unsigned long long) stats.Reordered);
+						ImGui::Text("Duplicates: %llu", (unsigned long long) stats.Duplicates);
+						ImGui::Text("Recovered: %llu", (unsigned long long) App::recoveredDatagrams.load());
+						ImGui::Text("Unrecoverable: %llu", (unsigned long long) App::unrecoverableDatagrams.load());
 					}
 
 					// spinner
@@ -1,8 +1,179 @@
 #include "application/application.h"
+#include <unordered_map>
+#include <fstream>
 
 namespace fs = std::filesystem;
 
 #define DEBUG_SHOW_SUZANNE true
+#define FORWARD_LANDMARK_DELTAS false // landmarks are forwarded to Unreal as keyframes and deltas instead of as received, unless the source already sends them that way
+#define FORWARD_SPARSE_BLENDSHAPES false // blendshapes are forwarded to Unreal as periodic refreshes and sparse updates instead of as received
+#define RECORD_BLENDSHAPES false // received blendshapes are appended to binaries/blendshapes.f32, the input of external/blendshape_pca.py
+#define FORWARD_OSC false // the latest frame is sent to oscAddress as one OSC bundle per tick in which datagrams arrived
+#define FORWARD_MATRICES_AS_POSES false // matrices are forwarded to Unreal as quantized poses (20 instead of 64 bytes per matrix) instead of as received
+#define FORWARD_WITH_PARITY false // datagrams forwarded to Unreal get an XOR parity packet per group of 4, a single lost packet per group is rebuilt
+#define SEND_RECEIVER_REPORTS false // senders that number their datagrams get a receiver report once per second, see facepipe_feedback.h
+#define ADAPTIVE_FORWARDING false // landmarks forwarded to Unreal switch between full, quantized and delta encoding and drop frames depending on the reports Unreal sends back
+
+// Mesh datagrams are decoded straight into the vertex storage of App::streamedMesh
+void ApplyMesh(const std::vector<char>& Message, const FacePipe::MessageInfo& Info)
+{
+	GLTriangleMesh* mesh = App::streamedMesh;
+	uint32_t topologyId = 0;
+	uint32_t vertexCount = 0;
+	if (!mesh || !FacePipe::GetMeshVertexCount(Message, Info, topologyId, vertexCount))
+		return;
+
+	// fails until the source has (re)sent the topology, the previous vertices are kept meanwhile
+	const FacePipe::MeshTopology* topology = App::meshTopologies.Find(topologyId);
+	if (!topology || topology->VertexCount != vertexCount)
+		return;
+
+	if (App::latestFrame.MeshTopologyId != topologyId || mesh->positions.size() != vertexCount)
+	{
+		mesh->positions.clear();
+		mesh->normals.clear();
+		mesh->colors.clear();
+		mesh->texCoords.clear();
+		for (uint32_t i = 0; i < vertexCount; ++i)
+		{
+			glm::fvec4 uv = topology->UVs.empty() ? glm::fvec4(0.0f) : glm::fvec4(topology->UVs[i*2], topology->UVs[i*2+1], 0.0f, 0.0f);
+			mesh->AddVertex(glm::fvec3(0.0f), glm::fvec3(0.0f, 0.0f, 1.0f), glm::fvec4(1.0f), uv);
+		}
+		mesh->indices.assign(topology->Indices.begin(), topology->Indices.end());
+		mesh->SendToGPU();
+		App::latestFrame.MeshTopologyId = topologyId;
+	}
+
+	static_assert(sizeof(glm::fvec3) == 3 * sizeof(float), "positions are written as a flat float array");
+	FacePipe::GetMeshVertices(Message, Info, &mesh->positions[0].x, vertexCount);
+}
+
+#if RECORD_BLENDSHAPES
+// 52 floats per frame in ARKit order, blendshapes that were never received are written as 0
+void RecordBlendshapes(const FacePipe::BlendshapeFrame& Blendshapes)
+{
+	static std::ofstream recording(App::Path("binaries/blendshapes.f32"), std::ios::binary | std::ios::app);
+	recording.write((const char*) Blendshapes.Values, sizeof(Blendshapes.Values));
+}
+#endif
+
+// Landmarks the source already sends as keyframes and deltas (see facepipe_delta.h). Its deltas refer to the sequence numbers
+// of its keyframes, so both are forwarded as received, re-encoding only the keyframes would leave the deltas without one.
+bool IsDeltaCoded(const FacePipe::MessageInfo& Info)
+{
+	return Info.DatagramType == FacePipe::EDatagramType::Bytes && (FacePipe::HasFlag(Info.BinaryFlags, FacePipe::EBinaryFlags::Delta) || FacePipe::HasFlag(Info.BinaryFlags, FacePipe::EBinaryFlags::Keyframe));
+}
+
+// Decodes one datagram, or one section of a composite datagram, into App::latestFrame
+void ApplyToLatestFrame(const std::vector<char>& Message, const FacePipe::MessageInfo& Info)
+{
+	switch (Info.DataType)
+	{
+	case FacePipe::EFacepipeData::Blendshapes:
+	{
+		FacePipe::GetBlendshapes(Message, Info, App::latestFrame.Blendshapes);
+#if RECORD_BLENDSHAPES
+		RecordBlendshapes(App::latestFrame.Blendshapes);
+#endif
+		break;
+	}
+	case FacePipe::EFacepipeData::Landmarks2D:
+	case FacePipe::EFacepipeData::Landmarks3D:
+	{
+		// TODO: Landmarks2D is a bit problematic when we store it as latestFrame, we expect 3D there
+		// fails for deltas until the source has sent their keyframe, the previous landmarks are kept meanwhile
+		App::landmarkDeltas.Decode(Message, Info, App::latestFrame.Landmarks, App::latestFrame.ImageWidth, App::latestFrame.ImageHeight);
+		break;
+	}
+	case FacePipe::EFacepipeData::Mesh:
+	{
+		ApplyMesh(Message, Info);
+		break;
+	}
+	case FacePipe::EFacepipeData::MeshTopology:
+	{
+		App::meshTopologies.Update(Message, Info);
+		break;
+	}
+	case FacePipe::EFacepipeData::Matrices4x4:
+	{
+		FacePipe::GetMatrices(Message, Info, App::latestFrame.Matrices);
+		break;
+	}
+	case FacePipe::EFacepipeData::Poses:
+	{
+		FacePipe::GetPoses(Message, Info, App::latestFrame.Poses);
+		break;
+	}
+	case FacePipe::EFacepipeData::Dictionary:
+	{
+		App::dictionaries.Update(Message, Info);
+		break;
+	}
+	case FacePipe::EFacepipeData::BlendshapeValues:
+	{
+		// fails until the source has (re)sent the dictionary, the previous values are kept meanwhile
+		if (FacePipe::GetBlendshapeValues(Message, Info, App::dictionaries, App::latestFrame.Blendshapes))
+		{
+#if RECORD_BLENDSHAPES
+			RecordBlendshapes(App::latestFrame.Blendshapes);
+#endif
+		}
+		break;
+	}
+	case FacePipe::EFacepipeData::BlendshapeUpdates:
+	{
+		// only the blendshapes that changed, the others keep their previous values
+		if (FacePipe::GetBlendshapeUpdates(Message, Info, App::latestFrame.Blendshapes))
+		{
+#if RECORD_BLENDSHAPES
+			RecordBlendshapes(App::latestFrame.Blendshapes);
+#endif
+		}
+		break;
+	}
+	case FacePipe::EFacepipeData::ExpressionBasis:
+	{
+		App::expressionBases.Update(Message, Info);
+		break;
+	}
+	case FacePipe::EFacepipeData::ExpressionCoefficients:
+	{
+		// fails until the source has (re)sent the basis, the previous values are kept meanwhile
+		FacePipe::GetExpressionCoefficients(Message, Info, App::expressionBases, App::latestFrame.Blendshapes);
+		break;
+	}
+	case FacePipe::EFacepipeData::Composite:
+	{
+		// all sections belong to the same subject and camera frame so they are applied together
+		// (GetSection rejects nested composites, so the static section is never reused while iterating)
+		static FacePipe::MessageInfo Section;
+		for (size_t i = 0; FacePipe::GetSection(Message, Info, i, Section); ++i)
+		{
+			ApplyToLatestFrame(Message, Section);
+		}
+		break;
+	}
+	default:
+	{
+		// every schema of facepipe_custom.h, decoded through its compile-time table
+		App::latestCustomData.Update(Message, Info);
+		break;
+	}
+	}
+}
+
+// The Unreal plugin reassembles fragments (and unwraps parity) but the Blender listener does not.
+// Packets are queued, everything forwarded during a tick is sent by one Flush() at its end.
+void ForwardToUnreal(const UDPDatagram& datagram, const UDPTarget& target)
+{
+#if FORWARD_WITH_PARITY
+	static FacePipe::ParityEncoder parity(4);
+	App::receiveDataSocket.QueueProtected(datagram, target, parity);
+#else
+	App::receiveDataSocket.QueueFragmented(datagram, target);
+#endif
+}
 
 /*
 	Application
@@ -45,6 +216,9 @@ int main(int argc, char* args[])
 	mpmesh->SetColors(glm::fvec4(0.0f, 0.0f, 0.0f, 1.0f));
 	mpmesh->SetUsage(GL_DYNAMIC_DRAW, true);
 
+	App::streamedMesh = GLTriangleMesh::Pool.CreateWeak();	// filled by Mesh datagrams
+	App::streamedMesh->SetUsage(GL_DYNAMIC_DRAW, false);
+
 #if DEBUG_SHOW_SUZANNE
 	WeakPtr<Object> suzanne = Object::Pool.CreateWeak();
 	suzanne->name = "Head";
@@ -67,12 +241,31 @@ int main(int argc, char* args[])
 	mphead->transform.scale = glm::vec3(1.0f);
 	App::world->AddChild(mphead);
 
+	WeakPtr<Object> streamedhead = Object::Pool.CreateWeak();
+	streamedhead->name = "StreamedMesh";
+	streamedhead->AddComponent(App::streamedMesh);
+	streamedhead->transform.scale = glm::vec3(1.0f);
+	App::world->AddChild(streamedhead);
+
 	WeakPtr<GLTexture> DefaultTexture = GLTexture::Pool.CreateWeak();
 	DefaultTexture->LoadPNG(App::Path("content/textures/default.png"));
 	DefaultTexture->CopyToGPU();
 
 	NetAddressIP4 unrealAddress(9001); // Unreal test
 	NetAddressIP4 blenderAddress(9002); // Blender test
+	NetAddressIP4 oscAddress(9003); // OSC test, VMC receivers (FacePipe::OscAddressMapping::VMC) usually listen on 39539
+
+	// resolved once, forwarding to them is queued and flushed once per tick
+	UDPTarget unrealTarget, blenderTarget, oscTarget;
+	UDPSocket::Resolve(unrealAddress, unrealTarget);
+	UDPSocket::Resolve(blenderAddress, blenderTarget);
+	UDPSocket::Resolve(oscAddress, oscTarget);
+
+	std::unordered_map<uint64_t, FacePipe::HeaderPrefixCache> headerCaches; // per sender address, all dropped when more than maxHeaderCaches addresses send
+	const size_t maxHeaderCaches = 64;
+	std::unordered_map<uint64_t, UDPTarget> senders; // reports go back to the address the datagrams came from, dropped with the reporter's sender
+	FacePipe::ReceiverReporter reporter;
+	FacePipe::AdaptiveEncoding unrealEncoding; // follows the reports Unreal sends back
 
 	App::OnTickEvent = [&](float time, float dt, const SDL_Event& event) -> void 
 	{
@@ -107,45 +300,211 @@ int main(int argc, char* args[])
 		
 		// Receiving packets
 		UDPDatagram datagram;
+		bool bAppliedAnyDatagram = false;
+		size_t queueDepth = 0;
+		const auto tickStart = std::chrono::steady_clock::now();
+		const double now = std::chrono::duration<double>(tickStart.time_since_epoch()).count();
 		while (App::datagramsQueue.Pop(datagram))
 		{
-			if (!FacePipe::ParseHeader(datagram.message, datagram.metaData))
+			queueDepth++;
+
+			// Receivers we forward to report how our datagrams arrive
+			FacePipe::ReceiverReport receivedReport;
+			if (FacePipe::ReadReceiverReport(datagram.message, receivedReport))
+			{
+				if (datagram.source.Key() == unrealAddress.Key())
+					unrealEncoding.OnReport(receivedReport);
+				continue;
+			}
+
+			// Every address gets a cache, a burst of new addresses must not grow the map forever
+			const uint64_t sourceKey = datagram.source.Key();
+			if (headerCaches.size() >= maxHeaderCaches && !headerCaches.contains(sourceKey))
+				headerCaches.clear();
+
+			if (!FacePipe::ParseHeader(datagram.message, datagram.metaData, headerCaches[sourceKey]))
 			{
 				App::lastReceivedDatagram = UDPDatagram();
 				continue;
 			}
 
-			switch (datagram.metaData.DataType)
+			int64_t lostChange = 0;
+			const bool bAccepted = App::sequences.Accept(datagram.metaData, lostChange);
+#if SEND_RECEIVER_REPORTS
+			// Without sequence numbers the sender is not necessarily FacePipe and would not know what to do with a report
+			if (datagram.metaData.bHasSequence)
 			{
-			case FacePipe::EFacepipeData::Blendshapes:
+				reporter.Add(sourceKey, datagram.metaData, lostChange, std::chrono::duration<double>(tickStart - datagram.received).count(), now);
+				if (auto [sender, bAdded] = senders.try_emplace(sourceKey); bAdded)
+					UDPSocket::Resolve(datagram.source, sender->second);
+			}
+#endif
+
+			// Stale and duplicate datagrams would move the head back in time, they are neither applied nor forwarded
+			if (!bAccepted)
+				continue;
+
+			ApplyToLatestFrame(datagram.message, datagram.metaData);
+			bAppliedAnyDatagram = true;
+
+			App::lastReceivedDatagram = datagram;
+
+			// forward to next application
+#if ADAPTIVE_FORWARDING
+			const bool bAdaptiveLandmarks = datagram.metaData.DataType == FacePipe::EFacepipeData::Landmarks2D || datagram.metaData.DataType == FacePipe::EFacepipeData::Landmarks3D;
+			if (bAdaptiveLandmarks && !IsDeltaCoded(datagram.metaData))
 			{
-				FacePipe::GetBlendshapes(datagram.message, datagram.metaData, App::latestFrame.Blendshapes);
-				break;
+				static FacePipe::LandmarkDeltaEncoder adaptiveEncoder;
+				static char adaptiveBuffer[FacePipe::SafeEncodeSize];
+				static UDPDatagram adaptiveDatagram;
+				static std::vector<float> adaptiveLandmarks;
+
+				// Every level goes through the delta encoder so the stream keeps one sequence, dropped frames are never numbered and do not count as lost.
+				// The datagram's own landmarks are encoded, App::latestFrame keeps the previous ones when decoding fails.
+				int imageWidth = 0, imageHeight = 0;
+				if (unrealEncoding.ShouldSend(datagram.metaData) && FacePipe::GetLandmarks(datagram.message, datagram.metaData, adaptiveLandmarks, imageWidth, imageHeight))
+				{
+					unrealEncoding.Configure(adaptiveEncoder);
+					FacePipe::MessageInfo adaptiveInfo = datagram.metaData;
+					adaptiveInfo.DatagramType = FacePipe::EDatagramType::Bytes;
+					size_t adaptiveSize = adaptiveEncoder.Encode(adaptiveBuffer, adaptiveInfo, adaptiveLandmarks, imageWidth, imageHeight);
+					if (adaptiveSize > 0)
+					{
+						adaptiveDatagram.message.assign(adaptiveBuffer, adaptiveBuffer + adaptiveSize);
+						ForwardToUnreal(adaptiveDatagram, unrealTarget);
+					}
+				}
 			}
-			case FacePipe::EFacepipeData::Landmarks2D:
-			case FacePipe::EFacepipeData::Landmarks3D:
+			else
+#endif
+#if FORWARD_LANDMARK_DELTAS
+			const bool bLandmarks = datagram.metaData.DataType == FacePipe::EFacepipeData::Landmarks2D || datagram.metaData.DataType == FacePipe::EFacepipeData::Landmarks3D;
+			if (bLandmarks && !IsDeltaCoded(datagram.metaData))
 			{
-				// TODO: Landmarks2D is a bit problematic when we store it as latestFrame, we expect 3D there
-				FacePipe::GetLandmarks(datagram.message, datagram.metaData, App::latestFrame.Landmarks, App::latestFrame.ImageWidth, App::latestFrame.ImageHeight);
-				break;
+				static FacePipe::LandmarkDeltaEncoder deltaEncoder;
+				static char deltaBuffer[FacePipe::SafeEncodeSize];
+				static UDPDatagram deltaDatagram;
+				static std::vector<float> deltaLandmarks;
+
+				// This datagram's own landmarks, App::latestFrame keeps the previous ones when decoding fails
+				int imageWidth = 0, imageHeight = 0;
+				if (FacePipe::GetLandmarks(datagram.message, datagram.metaData, deltaLandmarks, imageWidth, imageHeight))
+				{
+					FacePipe::MessageInfo deltaInfo = datagram.metaData;
+					deltaInfo.DatagramType = FacePipe::EDatagramType::Bytes;
+					size_t deltaSize = deltaEncoder.Encode(deltaBuffer, deltaInfo, deltaLandmarks, imageWidth, imageHeight);
+					if (deltaSize > 0)
+					{
+						deltaDatagram.message.assign(deltaBuffer, deltaBuffer + deltaSize);
+						ForwardToUnreal(deltaDatagram, unrealTarget);
+					}
+				}
 			}
-			case FacePipe::EFacepipeData::Mesh:
+			else
+#endif
+#if FORWARD_MATRICES_AS_POSES
+			if (datagram.metaData.DataType == FacePipe::EFacepipeData::Matrices4x4)
+			{
+				static FacePipe::MatrixMap matrices;
+				static FacePipe::PoseMap poses;
+				static char poseBuffer[FacePipe::SafeEncodeSize];
+				static UDPDatagram poseDatagram;
+
+				// Only this datagram's matrices, App::latestFrame.Matrices merges every subject and source
+				matrices.clear();
+				if (FacePipe::GetMatrices(datagram.message, datagram.metaData, matrices))
+				{
+					// matrices that cannot be decomposed (e.g. mirrored) are left out, receivers keep their previous pose
+					poses.clear();
+					FacePipe::Pose pose;
+					for (const auto& [name, matrix] : matrices)
+					{
+						if (FacePipe::DecomposeMatrix(matrix, pose))
+							poses[name] = pose;
+					}
+
+					FacePipe::MessageInfo poseInfo = datagram.metaData;
+					poseInfo.DatagramType = FacePipe::EDatagramType::Bytes;
+					FacePipe::EncodeSettings poseSettings;
+					poseSettings.QuantizedBits = 10;
+					size_t poseSize = FacePipe::EncodePoses(poseBuffer, poseInfo, poses, poseSettings);
+					if (poseSize > 0)
+					{
+						poseDatagram.message.assign(poseBuffer, poseBuffer + poseSize);
+						ForwardToUnreal(poseDatagram, unrealTarget);
+					}
+				}
+			}
+			else
+#endif
+#if FORWARD_SPARSE_BLENDSHAPES
+			if (datagram.metaData.DataType == FacePipe::EFacepipeData::Blendshapes || datagram.metaData.DataType == FacePipe::EFacepipeData::BlendshapeValues)
 			{
-				break;
+				static FacePipe::BlendshapeUpdateEncoder updateEncoder;
+				static char updateBuffer[FacePipe::SafeEncodeSize];
+				static UDPDatagram updateDatagram;
+
+				// This datagram's own blendshapes, App::latestFrame keeps those of earlier datagrams and other subjects
+				FacePipe::BlendshapeFrame updateFrame;
+				const bool bDecoded = (datagram.metaData.DataType == FacePipe::EFacepipeData::Blendshapes)
+					? FacePipe::GetBlendshapes(datagram.message, datagram.metaData, updateFrame)
+					: FacePipe::GetBlendshapeValues(datagram.message, datagram.metaData, App::dictionaries, updateFrame);
+
+				size_t updateSize = bDecoded ? updateEncoder.Encode(updateBuffer, datagram.metaData, updateFrame) : 0;
+				if (updateSize > 0)
+				{
+					updateDatagram.message.assign(updateBuffer, updateBuffer + updateSize);
+					ForwardToUnreal(updateDatagram, unrealTarget);
+				}
 			}
-			case FacePipe::EFacepipeData::Matrices4x4:
+			else
+#endif
+			ForwardToUnreal(datagram, unrealTarget);
+
+			// Blender does not reassemble fragments, reassembled datagrams too large for a single one are not forwarded to it
+			if (datagram.message.size() <= FacePipe::SafeEncodeSize)
 			{
-				FacePipe::GetMatrices(datagram.message, datagram.metaData, App::latestFrame.Matrices);
-				break;
+				App::receiveDataSocket.Queue(datagram.message, blenderTarget);
 			}
+			else
+			{
+				static bool bLoggedTooLarge = false;
+				if (!bLoggedTooLarge)
+					Logf(LOG_NET_SEND, "Not forwarding datagrams larger than {} bytes to Blender [{}:{}]\n", FacePipe::SafeEncodeSize, blenderAddress.ip, blenderAddress.port);
+				bLoggedTooLarge = true;
 			}
+		}
 
-			App::lastReceivedDatagram = datagram;
+#if SEND_RECEIVER_REPORTS
+		// Once per second every sender is told how its datagrams arrive, see facepipe_feedback.h
+		reporter.SetQueueDepth(queueDepth);
+		uint64_t reportKey = 0;
+		FacePipe::ReceiverReport report;
+		while (reporter.TakeDue(now, reportKey, report))
+		{
+			auto sender = senders.find(reportKey);
+			if (sender != senders.end())
+				App::receiveDataSocket.Queue(std::span<const char>((const char*) &report, sizeof(report)), sender->second);
+		}
 
-			// forward to next application
-			App::receiveDataSocket.Send(datagram, unrealAddress);
-			App::receiveDataSocket.Send(datagram, blenderAddress);
+		// TakeDue forgets senders that went quiet
+		std::erase_if(senders, [&](const auto& sender) { return !reporter.IsTracking(sender.first); });
+#endif
+
+#if FORWARD_OSC
+		// One bundle per tick with everything the datagrams of this tick changed
+		if (bAppliedAnyDatagram)
+		{
+			static FacePipe::OscAddressMapping oscMapping;
+			static char oscBuffer[FacePipe::SafeEncodeSize];
+
+			size_t oscSize = FacePipe::EncodeOscBundle(oscBuffer, App::latestFrame, oscMapping);
+			App::receiveDataSocket.Queue(std::span<const char>(oscBuffer, oscSize), oscTarget);
 		}
+#endif
+
+		// Everything forwarded and reported during this tick, one sendmmsg() on Linux
+		App::receiveDataSocket.Flush();
 
 		float w = (float) App::latestFrame.ImageWidth;
 		float h = (float) App::latestFrame.ImageHeight;
@@ -156,14 +515,9 @@ int main(int argc, char* args[])
 		}
 		float ratio = w/h;
 
-		// Draw debug transforms
-		for (auto& Pair : App::latestFrame.Matrices)
+		// Draw debug transforms, m is a row-major 4x4 as received in Matrices4x4 datagrams
+		auto drawTransform = [&](const float* m)
 		{
-			auto& m = Pair.second;
-
-			if (m.size() != 16)
-				continue;
-
 			glm::mat4 mat(
 				m[0], m[1], m[2], m[3],
 				m[4], m[5], m[6], m[7],
@@ -184,6 +538,19 @@ int main(int argc, char* args[])
 			App::ui.sceneViewport->debuglines->AddLine(origin, origin+x, glm::fvec4(1.0f, 0.0f, 0.0f, 1.0f));
 			App::ui.sceneViewport->debuglines->AddLine(origin, origin+y, glm::fvec4(0.0f, 1.0f, 0.0f, 1.0f));
 			App::ui.sceneViewport->debuglines->AddLine(origin, origin+z, glm::fvec4(0.0f, 0.0f, 1.0f, 1.0f));
+		};
+
+		for (auto& Pair : App::latestFrame.Matrices)
+		{
+			if (Pair.second.size() == 16)
+				drawTransform(Pair.second.data());
+		}
+
+		for (auto& Pair : App::latestFrame.Poses)
+		{
+			float m[16];
+			FacePipe::ComposeMatrix(Pair.second, m);
+			drawTransform(m);
 		}
 		
 		if (size_t mpcount = App::latestFrame.Landmarks.size()/3)
@@ -204,6 +571,11 @@ int main(int argc, char* args[])
 			}
 			mpmesh->SendToGPU();
 		}
+
+		if (!App::streamedMesh->positions.empty())
+		{
+			App::streamedMesh->SendPositionsToGPU();
+		}
 	};
 
 	App::OnTickRender = [&](float time, float dt) -> void 
@@ -223,8 +595,19 @@ int main(int argc, char* args[])
 			pointCloudShader.SetUniformFloat("size", App::settings.pointCloudSize);
 			mpmesh->Draw(GL_POINTS);
 
-#if DEBUG_SHOW_SUZANNE
 			GLProgram& meshShader = App::shaders.defaultMeshShader;
+
+			// Draw streamed mesh (normals are not streamed, flat shading derives them per triangle)
+			if (!App::streamedMesh->indices.empty())
+			{
+				meshShader.Use();
+				meshShader.SetUniformMat4("model", streamedhead->ComputeWorldMatrix());
+				meshShader.SetUniformInt("useTexture", 0);
+				meshShader.SetUniformInt("useFlatShading", 1);
+				App::streamedMesh->Draw();
+			}
+
+#if DEBUG_SHOW_SUZANNE
 			meshShader.Use();
 			meshShader.SetUniformMat4("model", suzanne->ComputeWorldMatrix());
 			meshShader.SetUniformInt("useTexture", 0);
@@ -0,0 +1,86 @@
+#pragma once
+
+#include <stdint.h>
+#include <string_view>
+
+/*
+* The 52 ARKit blendshape names in ARKit order (same order as ARFaceAnchor.BlendShapeLocation and Live Link Face).
+* MediaPipe outputs the same names, with the exception of tongueOut and with an additional _neutral.
+* 
+* Names are mapped to a dense index with a perfect hash so that decoding a blendshape packet is one hash and
+* one compare per name. The seed was found offline, the static_assert below guarantees there are no collisions.
+*/
+
+namespace FacePipe
+{
+	static const size_t ARKitBlendshapeCount = 52;
+
+	inline constexpr std::string_view ARKitBlendshapeNames[ARKitBlendshapeCount] = {
+		"eyeBlinkLeft", "eyeLookDownLeft", "eyeLookInLeft", "eyeLookOutLeft", "eyeLookUpLeft", "eyeSquintLeft", "eyeWideLeft",
+		"eyeBlinkRight", "eyeLookDownRight", "eyeLookInRight", "eyeLookOutRight", "eyeLookUpRight", "eyeSquintRight", "eyeWideRight",
+		"jawForward", "jawLeft", "jawRight", "jawOpen",
+		"mouthClose", "mouthFunnel", "mouthPucker", "mouthLeft", "mouthRight",
+		"mouthSmileLeft", "mouthSmileRight", "mouthFrownLeft", "mouthFrownRight", "mouthDimpleLeft", "mouthDimpleRight",
+		"mouthStretchLeft", "mouthStretchRight", "mouthRollLower", "mouthRollUpper", "mouthShrugLower", "mouthShrugUpper",
+		"mouthPressLeft", "mouthPressRight", "mouthLowerDownLeft", "mouthLowerDownRight", "mouthUpperUpLeft", "mouthUpperUpRight",
+		"browDownLeft", "browDownRight", "browInnerUp", "browOuterUpLeft", "browOuterUpRight",
+		"cheekPuff", "cheekSquintLeft", "cheekSquintRight",
+		"noseSneerLeft", "noseSneerRight",
+		"tongueOut"
+	};
+
+	namespace ARKitHash
+	{
+		static const uint32_t Seed = 26952;
+		static const uint32_t SlotBits = 7;
+		static const uint8_t EmptySlot = 0xFF;
+
+		// FNV-1a seeded with Seed, the top SlotBits select the slot
+		constexpr uint32_t Slot(std::string_view Name)
+		{
+			uint32_t Hash = Seed;
+			for (char c : Name)
+			{
+				Hash ^= (uint8_t) c;
+				Hash *= 16777619u;
+			}
+
+			return Hash >> (32 - SlotBits);
+		}
+
+		struct Table
+		{
+			uint8_t Slots[1 << SlotBits] = {};
+			bool bPerfect = true;
+		};
+
+		constexpr Table Build()
+		{
+			Table Result;
+			for (uint8_t& Slot : Result.Slots)
+				Slot = EmptySlot;
+
+			for (size_t i = 0; i < ARKitBlendshapeCount; ++i)
+			{
+				uint8_t& Slot = Result.Slots[ARKitHash::Slot(ARKitBlendshapeNames[i])];
+				if (Slot != EmptySlot)
+					Result.bPerfect = false;
+				Slot = (uint8_t) i;
+			}
+
+			return Result;
+		}
+
+		inline constexpr Table Lookup = Build();
+		static_assert(Lookup.bPerfect, "ARKit blendshape hash has collisions, pick a new Seed");
+	}
+
+	// Returns the ARKit index of Name or -1 if it is not one of the 52 ARKit blendshapes
+	constexpr int FindARKitBlendshape(std::string_view Name)
+	{
+		uint8_t Index = ARKitHash::Lookup.Slots[ARKitHash::Slot(Name)];
+		return (Index != ARKitHash::EmptySlot && ARKitBlendshapeNames[Index] == Name) ? (int) Index : -1;
+	}
+
+	static_assert(FindARKitBlendshape("jawOpen") == 17 && FindARKitBlendshape("tongueOut") == 51 && FindARKitBlendshape("_neutral") == -1);
+}
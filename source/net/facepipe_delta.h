@@ -0,0 +1,83 @@
+#pragma once
+
+#include "facepipe.h"
+
+/*
+* Landmarks barely move between frames, delta coding sends the full set every KeyframeInterval frames and
+* in between only the (quantized) difference to that keyframe:
+*
+*	seq 100		Keyframe				absolute landmarks, raw or quantized, readable by any receiver
+*	seq 101		Delta, keyframe 100		landmarks - keyframe 100
+*	seq 102		Delta, keyframe 100		landmarks - keyframe 100
+*	...
+*	seq 130		Keyframe
+*
+* Deltas always refer to a keyframe and never to the previous delta, so losing a delta costs that one frame
+* and errors do not accumulate. Deltas that reference a keyframe the receiver does not have (lost, or the
+* receiver joined late) are dropped and counted until the next keyframe arrives.
+*
+* Binary only. The encoder keeps the keyframe as the receiver decodes it, so quantized keyframes do not skew the deltas.
+*/
+
+namespace FacePipe
+{
+	class LandmarkDeltaEncoder
+	{
+	public:
+		uint32_t KeyframeInterval = 30;	// frames per keyframe, including the keyframe
+		uint32_t KeyframeBits = 0;		// 0 sends keyframes as raw floats, 1-16 quantizes them
+		uint32_t DeltaBits = 8;			// 1-16
+
+		// Writes a Keyframe or Delta datagram for the stream of Info (source, scene, camera, subject, data type).
+		// The encoder numbers the datagrams of each stream itself, Info.Sequence is ignored. Returns 0 if the datagram did not fit.
+		size_t Encode(std::span<char> Out, const MessageInfo& Info, std::span<const float> Values, int ImageWidth, int ImageHeight);
+
+		// The next datagram of every stream is a keyframe, e.g. when a new receiver joins
+		void RequestKeyframe();
+
+		void Clear() { Streams.clear(); }
+
+	protected:
+		struct Stream
+		{
+			SubjectKey Key;
+			EFacepipeData DataType = EFacepipeData::INVALID;
+			uint32_t Sequence = 0;
+			uint32_t KeyframeSequence = 0;
+			uint32_t SinceKeyframe = 0;
+			bool bNeedsKeyframe = true;
+			std::vector<float> Keyframe;	// as the receiver decodes it
+			std::vector<float> Deltas;
+		};
+
+		Stream& FindOrAdd(const MessageInfo& Info);
+
+		std::vector<Stream> Streams;
+		std::vector<char> DecodeBuffer; // quantized keyframes are decoded again to know what the receiver sees
+	};
+
+	class LandmarkDeltaDecoder
+	{
+	public:
+		// Decodes any landmark datagram. Keyframes are stored for their stream, deltas are added to the stored keyframe.
+		bool Decode(const std::vector<char>& Message, const MessageInfo& Info, std::vector<float>& OutValues, int& ImageWidth, int& ImageHeight);
+
+		void Clear() { Streams.clear(); }
+
+		size_t MissingKeyframeCount = 0; // Delta datagrams dropped because their keyframe was not stored
+
+	protected:
+		struct Stream
+		{
+			SubjectKey Key;
+			EFacepipeData DataType = EFacepipeData::INVALID;
+			uint32_t KeyframeSequence = 0;
+			std::vector<float> Keyframe;
+		};
+
+		Stream* Find(const MessageInfo& Info);
+		Stream& FindOrAdd(const MessageInfo& Info);
+
+		std::vector<Stream> Streams;
+	};
+}
@@ -0,0 +1,178 @@
+#include "facepipe_dictionary.h"
+
+#include <algorithm>
+#include <charconv>
+
+namespace FacePipe
+{
+	bool DictionaryCache::Update(const std::vector<char>& Message, const MessageInfo& Info)
+	{
+		uint32_t Id = 0;
+		if (!GetDictionaryId(Message, Info, Id))
+			return false;
+
+		for (Entry& Existing : Entries)
+		{
+			if (Existing.Key.Matches(Info))
+			{
+				// Same id means same names, refreshes do not need to be parsed again
+				if (Existing.Dict.Id == Id)
+					return true;
+
+				Dictionary NewDict;
+				if (!GetDictionary(Message, Info, NewDict))
+					return false;
+
+				Existing.Dict = std::move(NewDict);
+				return true;
+			}
+		}
+
+		Entry NewEntry;
+		NewEntry.Key.Assign(Info);
+		if (!GetDictionary(Message, Info, NewEntry.Dict))
+			return false;
+
+		Entries.push_back(std::move(NewEntry));
+		return true;
+	}
+
+	const Dictionary* DictionaryCache::Find(const MessageInfo& Info, uint32_t Id) const
+	{
+		for (const Entry& Existing : Entries)
+		{
+			if (Existing.Key.Matches(Info))
+				return (Existing.Dict.Id == Id) ? &Existing.Dict : nullptr;
+		}
+
+		return nullptr;
+	}
+
+	bool GetDictionaryId(const std::vector<char>& Message, const MessageInfo& Info, uint32_t& OutId)
+	{
+		if (Info.DataType != EFacepipeData::Dictionary && Info.DataType != EFacepipeData::BlendshapeValues)
+			return false;
+
+		if (Info.DatagramType == EDatagramType::Bytes)
+			return ReadBinary(Message, Info.ContentView.b, Info.ContentView.e, OutId);
+
+		VectorView IdView(Info.ContentView.b);
+		if (!IdView.NextSubstring(Message, '|', Info.ContentView.e))
+			return false;
+
+		const char* Last = Message.data() + IdView.e;
+		std::from_chars_result Result = std::from_chars(Message.data() + IdView.b, Last, OutId);
+		return Result.ec == std::errc() && Result.ptr == Last;
+	}
+
+	bool GetDictionary(const std::vector<char>& Message, const MessageInfo& Info, Dictionary& OutDictionary)
+	{
+		if (Info.DataType != EFacepipeData::Dictionary || !GetDictionaryId(Message, Info, OutDictionary.Id))
+			return false;
+
+		OutDictionary.Names.clear();
+		OutDictionary.ARKitIndices.clear();
+
+		if (Info.DatagramType == EDatagramType::Bytes)
+		{
+			uint32_t Count = 0;
+			if (!ReadBinary(Message, Info.ContentView.b + sizeof(uint32_t), Info.ContentView.e, Count))
+				return false;
+
+			// Every name takes at least its length byte, a count beyond that cannot be satisfied by the content
+			NamedValuesView View;
+			size_t NamesStart = Info.ContentView.b + 2 * sizeof(uint32_t);
+			if (Count > Info.ContentView.e - NamesStart)
+				return false;
+
+			View.Names = std::span<const char>(Message.data() + NamesStart, Info.ContentView.e - NamesStart);
+
+			size_t NameOffset = 0;
+			std::string_view Name;
+			while (OutDictionary.Names.size() < Count && View.NextName(NameOffset, Name))
+			{
+				OutDictionary.Names.emplace_back(Name);
+			}
+
+			if (OutDictionary.Names.size() != Count)
+				return false;
+		}
+		else
+		{
+			VectorView NamesView(Info.ContentView.b);
+			if (!NamesView.NextSubstring(Message, '|', Info.ContentView.e) || !NamesView.NextSubstring(Message, '|', Info.ContentView.e))
+				return false;
+
+			VectorView NameView(NamesView.b);
+			while (NameView.NextSubstring(Message, ',', NamesView.e))
+			{
+				OutDictionary.Names.emplace_back(NameView.StringView(Message));
+			}
+		}
+
+		for (const std::string& Name : OutDictionary.Names)
+		{
+			OutDictionary.ARKitIndices.push_back(FindARKitBlendshape(Name));
+		}
+
+		return true;
+	}
+
+	inline void SetDictionaryValue(const Dictionary& Dict, size_t Slot, float Value, BlendshapeFrame& OutBlendshapes)
+	{
+		if (Slot >= Dict.Names.size())
+			return;
+
+		if (Dict.ARKitIndices[Slot] >= 0)
+			OutBlendshapes.Set((size_t) Dict.ARKitIndices[Slot], Value);
+		else
+			OutBlendshapes.Set(Dict.Names[Slot], Value);
+	}
+
+	bool GetBlendshapeValues(const std::vector<char>& Message, const MessageInfo& Info, DictionaryCache& Dictionaries, BlendshapeFrame& OutBlendshapes)
+	{
+		uint32_t Id = 0;
+		if (Info.DataType != EFacepipeData::BlendshapeValues || !GetDictionaryId(Message, Info, Id))
+			return false;
+
+		const Dictionary* Dict = Dictionaries.Find(Info, Id);
+		if (!Dict)
+		{
+			++Dictionaries.UnknownDictionaryCount;
+			return false;
+		}
+
+		if (Info.DatagramType == EDatagramType::Bytes)
+		{
+			uint32_t Count = 0;
+			std::span<const float> Values;
+			if (!ReadBinary(Message, Info.ContentView.b + sizeof(uint32_t), Info.ContentView.e, Count) || Count > Dict->Names.size() || !ReadBinaryFloats(Message, Info.ContentView.b + 2 * sizeof(uint32_t), Info.ContentView.e, Count, Values))
+				return false;
+
+			for (size_t i = 0; i < Values.size(); ++i)
+			{
+				SetDictionaryValue(*Dict, i, Values[i], OutBlendshapes);
+			}
+
+			return true;
+		}
+
+		VectorView ValuesView(Info.ContentView.b);
+		if (!ValuesView.NextSubstring(Message, '|', Info.ContentView.e) || !ValuesView.NextSubstring(Message, '|', Info.ContentView.e))
+			return false;
+
+		// A value without a name means the packet was written for a different dictionary, none of it is applied
+		const size_t ValueCount = std::count(Message.begin() + ValuesView.b, Message.begin() + ValuesView.e, ',') + 1;
+		if (ValueCount > Dict->Names.size())
+			return false;
+
+		size_t Slot = 0;
+		VectorView ValueView(ValuesView.b);
+		while (ValueView.NextSubstring(Message, ',', ValuesView.e))
+		{
+			SetDictionaryValue(*Dict, Slot++, ValueView.ParseFloat(Message), OutBlendshapes);
+		}
+
+		return true;
+	}
+}
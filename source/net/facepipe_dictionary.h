@@ -0,0 +1,53 @@
+#pragma once
+
+#include "facepipe.h"
+
+/*
+* Name dictionaries let a source send blendshape names once instead of in every packet.
+* 
+*	dict|7|eyeBlinkLeft,eyeLookDownLeft,...		announced once and refreshed periodically by the source
+*	bsv|7|0.1,0.0,...							values only, in dictionary order
+* 
+* The receiver keeps the latest dictionary per (source, scene, camera, subject). A refresh with an id
+* that is already cached is ignored, so the periodic resend costs one header parse. Values that reference
+* an unknown dictionary are dropped and counted until the next refresh arrives, values beyond the names of
+* their dictionary fail the whole packet.
+*/
+
+namespace FacePipe
+{
+	struct Dictionary
+	{
+		uint32_t Id = 0;
+		std::vector<std::string> Names;
+		std::vector<int> ARKitIndices; // FindARKitBlendshape for each name, -1 if the name is not an ARKit blendshape
+	};
+
+	class DictionaryCache
+	{
+	public:
+		// Stores the dictionary carried by a Dictionary packet, returns false if the packet is malformed
+		bool Update(const std::vector<char>& Message, const MessageInfo& Info);
+
+		const Dictionary* Find(const MessageInfo& Info, uint32_t Id) const;
+
+		void Clear() { Entries.clear(); }
+
+		size_t UnknownDictionaryCount = 0; // BlendshapeValues packets dropped because their dictionary was not cached
+
+	protected:
+		struct Entry
+		{
+			SubjectKey Key;
+			Dictionary Dict;
+		};
+
+		std::vector<Entry> Entries;
+	};
+
+	bool GetDictionaryId(const std::vector<char>& Message, const MessageInfo& Info, uint32_t& OutId);
+	bool GetDictionary(const std::vector<char>& Message, const MessageInfo& Info, Dictionary& OutDictionary);
+
+	// Decodes a BlendshapeValues packet through the dictionary it references, names outside ARKit end up in OutBlendshapes.Other
+	bool GetBlendshapeValues(const std::vector<char>& Message, const MessageInfo& Info, DictionaryCache& Dictionaries, BlendshapeFrame& OutBlendshapes);
+}
@@ -0,0 +1,47 @@
+#pragma once
+
+#include "facepipe.h"
+
+/*
+* Encoders are the counterpart of the Get* functions, they write a complete datagram into a caller-provided buffer.
+*
+*	char Buffer[FacePipe::SafeEncodeSize];
+*	size_t Size = FacePipe::EncodeBlendshapes(Buffer, Info, Frame.Blendshapes);
+*
+* Info.DatagramType selects ASCII or Bytes, Source/Scene/Camera/Subject/Time/Sequence are taken from Info as well.
+* Numbers are formatted with std::to_chars and nothing is allocated. A return value of 0 means the datagram did not fit
+* (or the input cannot be represented, e.g. a name longer than 255 bytes in a binary datagram).
+*/
+
+namespace FacePipe
+{
+	static const size_t SafeEncodeSize = 65507; // largest UDP payload
+
+	struct EncodeSettings
+	{
+		int Precision = -1;				// ASCII only, digits after the decimal point or -1 for the shortest representation that round-trips
+		uint32_t QuantizedBits = 0;		// Bytes only, 1-16 quantizes landmarks (see EBinaryFlags::Quantized) and packs pose rotations, 0 writes raw floats
+		bool bKeyframe = false;			// Bytes only, marks landmarks as a reference for Delta landmarks (see facepipe_delta.h)
+	};
+
+	size_t EncodeBlendshapes(std::span<char> Out, const MessageInfo& Info, const BlendshapeFrame& Blendshapes, const EncodeSettings& Settings = {});
+
+	// Values of the ARKit blendshapes at Indices, normally written by a BlendshapeUpdateEncoder (see facepipe_sparse.h)
+	size_t EncodeBlendshapeUpdates(std::span<char> Out, const MessageInfo& Info, std::span<const uint8_t> Indices, std::span<const float> Values, const EncodeSettings& Settings = {});
+
+	// Info.DataType decides between Landmarks2D and Landmarks3D
+	size_t EncodeLandmarks(std::span<char> Out, const MessageInfo& Info, std::span<const float> Values, int ImageWidth, int ImageHeight, const EncodeSettings& Settings = {});
+
+	// Deltas are the landmarks minus the Keyframe landmarks sent with KeyframeSequence, quantized with 1-16 Bits.
+	// Normally written by a LandmarkDeltaEncoder which keeps track of the keyframes.
+	size_t EncodeLandmarksDelta(std::span<char> Out, const MessageInfo& Info, std::span<const float> Deltas, uint32_t KeyframeSequence, int ImageWidth, int ImageHeight, uint32_t Bits);
+
+	// Mean and Components of an ExpressionBasis (see facepipe_pca.h), Components holds ComponentCount rows of Mean.size() values
+	size_t EncodeExpressionBasis(std::span<char> Out, const MessageInfo& Info, uint32_t BasisId, uint32_t ComponentCount, std::span<const float> Mean, std::span<const float> Components, const EncodeSettings& Settings = {});
+	size_t EncodeExpressionCoefficients(std::span<char> Out, const MessageInfo& Info, uint32_t BasisId, std::span<const float> Coefficients, const EncodeSettings& Settings = {});
+
+	size_t EncodeMatrices(std::span<char> Out, const MessageInfo& Info, const MatrixMap& Matrices, const EncodeSettings& Settings = {});
+
+	// Settings.QuantizedBits > 0 packs the rotations as smallest-three (see facepipe_pose.h), the number of bits is fixed
+	size_t EncodePoses(std::span<char> Out, const MessageInfo& Info, const PoseMap& Poses, const EncodeSettings& Settings = {});
+}
@@ -0,0 +1,446 @@
+#include "facepipe_envelope.h"
+
+#include <algorithm>
+#include <array>
+
+namespace FacePipe
+{
+	// The parts of MediaPipe landmarker traffic that repeat between datagrams: headers up to the first value, binary
+	// name tables and the blendshape names of ASCII datagrams. Values are left out since they do not repeat.
+	// Changing the content breaks decoding of datagrams encoded with the old one, add a new EEnvelopeDictionary instead.
+	static const char PresetDictionary[] =
+		"a|facepipe|mediapipe|0,0,0|1000.0,0|frame|l3d,bs,mat44|28391,1729,178|640,480|0.a|facepipe|mediapipe|0,0,0|100"
+		"0.0,0|l3d|640,480|0.a|facepipe|mediapipe|0,0,0|1000.0,0|bsv|1879412587|a|facepipe|mediapipe|0,0,0|1000.0,0|mat"
+		"44|face=0.0,0.0,0.0,1.0bfp\001\000\011\002\000\000\000\000\000\000\000\000\000\000\000\000\000\000\000\000\000"
+		"\000\000\000\000\000@\217@mediapipe\000\000\0004\000\000\000\010_neutral\014browDownLeft\015browDownRight\013b"
+		"rowInnerUp\017browOuterUpLeft\020browOuterUpRight\011cheekPuff\017cheekSquintLeft\020cheekSquintRight\014eyeBl"
+		"inkLeft\015eyeBlinkRight\017eyeLookDownLeft\020eyeLookDownRight\015eyeLookInLeft\016eyeLookInRight\016eyeLookO"
+		"utLeft\017eyeLookOutRight\015eyeLookUpLeft\016eyeLookUpRight\015eyeSquintLeft\016eyeSquintRight\013eyeWideLeft"
+		"\014eyeWideRight\012jawForward\007jawLeft\007jawOpen\010jawRight\012mouthClose\017mouthDimpleLeft\020mouthDimp"
+		"leRight\016mouthFrownLeft\017mouthFrownRight\013mouthFunnel\011mouthLeft\022mouthLowerDownLeft\023mouthLowerDo"
+		"wnRight\016mouthPressLeft\017mouthPressRight\013mouthPucker\012mouthRight\016mouthRollLower\016mouthRollUpper\017"
+		"mouthShrugLower\017mouthShrugUpper\016mouthSmileLeft\017mouthSmileRight\020mouthStretchLeft\021mouthStretchRig"
+		"ht\020mouthUpperUpLeft\021mouthUpperUpRight\015noseSneerLeft\016noseSneerRight\000\200?\004facea|facepipe|medi"
+		"apipe|0,0,0|1000.0,0|bs|_neutral=0.|browDownLeft=0.|browDownRight=0.|browInnerUp=0.|browOuterUpLeft=0.|browOut"
+		"erUpRight=0.|cheekPuff=0.|cheekSquintLeft=0.|cheekSquintRight=0.|eyeBlinkLeft=0.|eyeBlinkRight=0.|eyeLookDownL"
+		"eft=0.|eyeLookDownRight=0.|eyeLookInLeft=0.|eyeLookInRight=0.|eyeLookOutLeft=0.|eyeLookOutRight=0.|eyeLookUpLe"
+		"ft=0.|eyeLookUpRight=0.|eyeSquintLeft=0.|eyeSquintRight=0.|eyeWideLeft=0.|eyeWideRight=0.|jawForward=0.|jawLef"
+		"t=0.|jawOpen=0.|jawRight=0.|mouthClose=0.|mouthDimpleLeft=0.|mouthDimpleRight=0.|mouthFrownLeft=0.|mouthFrownR"
+		"ight=0.|mouthFunnel=0.|mouthLeft=0.|mouthLowerDownLeft=0.|mouthLowerDownRight=0.|mouthPressLeft=0.|mouthPressR"
+		"ight=0.|mouthPucker=0.|mouthRight=0.|mouthRollLower=0.|mouthRollUpper=0.|mouthShrugLower=0.|mouthShrugUpper=0."
+		"|mouthSmileLeft=0.|mouthSmileRight=0.|mouthStretchLeft=0.|mouthStretchRight=0.|mouthUpperUpLeft=0.|mouthUpperU"
+		"pRight=0.|noseSneerLeft=0.|noseSneerRight=0.";
+
+	static const size_t MinMatch = 4;
+	static const size_t MinPackedMatch = 8;		// packed literals cost half a byte, shorter matches do not pay for their offset
+	static const size_t MaxOffset = 65535;
+	static const size_t LastLiterals = 5;		// the block format requires the last bytes to be literals
+	static const size_t MatchSearchEnd = 12;	// and no match to start this close to the end
+	static const uint32_t HashBits = 12;
+
+	using HashTable = std::array<uint32_t, size_t(1) << HashBits>;
+
+	static inline uint32_t Read32(const char* Data)
+	{
+		uint32_t Value;
+		std::memcpy(&Value, Data, sizeof(Value));
+		return Value;
+	}
+
+	static inline uint32_t Hash(uint32_t Sequence)
+	{
+		return (Sequence * 2654435761u) >> (32 - HashBits);
+	}
+
+	static std::span<const char> GetDictionary(EEnvelopeDictionary Dictionary)
+	{
+		if (Dictionary == EEnvelopeDictionary::Preset)
+			return std::span<const char>(PresetDictionary, sizeof(PresetDictionary) - 1);
+
+		return std::span<const char>();
+	}
+
+	// Positions of the dictionary are hashed once, every encode starts from a copy
+	static const HashTable& GetDictionaryHashTable(EEnvelopeDictionary Dictionary)
+	{
+		static const HashTable Preset = []()
+		{
+			HashTable Table = {};
+			std::span<const char> Data = GetDictionary(EEnvelopeDictionary::Preset);
+			for (size_t i = 0; i + MinMatch <= Data.size(); ++i)
+				Table[Hash(Read32(Data.data() + i))] = (uint32_t) i;
+			return Table;
+		}();
+		static const HashTable Empty = {};
+
+		return (Dictionary == EEnvelopeDictionary::Preset) ? Preset : Empty;
+	}
+
+	// Packed literals: the characters of numbers and separators are 4 bit symbols, anything else is the escape symbol
+	// followed by the byte as two symbols. Symbols are stored low nibble first, every sequence starts on a byte boundary.
+	static const char PackedCharacters[15] = { '0', '1', '2', '3', '4', '5', '6', '7', '8', '9', ',', '.', '-', 'e', '|' };
+	static const uint8_t PackedEscape = 15;
+
+	static const std::array<uint8_t, 256> PackedSymbols = []()
+	{
+		std::array<uint8_t, 256> Symbols;
+		Symbols.fill(PackedEscape);
+		for (uint8_t i = 0; i < PackedEscape; ++i)
+			Symbols[(uint8_t) PackedCharacters[i]] = i;
+		return Symbols;
+	}();
+
+	static bool WritePackedLiterals(char*& Out, const char* OutEnd, const char* Literals, size_t Count)
+	{
+		size_t SymbolCount = 0;
+		for (size_t i = 0; i < Count; ++i)
+			SymbolCount += (PackedSymbols[(uint8_t) Literals[i]] == PackedEscape) ? 3 : 1;
+
+		const size_t Size = (SymbolCount + 1) / 2;
+		if (Size > size_t(OutEnd - Out))
+			return false;
+
+		uint8_t* Packed = (uint8_t*) Out;
+		std::memset(Packed, 0, Size);
+
+		size_t Nibble = 0;
+		auto Put = [&](uint8_t Symbol)
+		{
+			Packed[Nibble >> 1] |= Symbol << ((Nibble & 1) * 4);
+			++Nibble;
+		};
+
+		for (size_t i = 0; i < Count; ++i)
+		{
+			const uint8_t Symbol = PackedSymbols[(uint8_t) Literals[i]];
+			Put(Symbol);
+			if (Symbol == PackedEscape)
+			{
+				Put((uint8_t) Literals[i] & 15);
+				Put((uint8_t) Literals[i] >> 4);
+			}
+		}
+
+		Out += Size;
+		return true;
+	}
+
+	static bool ReadPackedLiterals(const char*& In, const char* InEnd, char* Out, size_t Count)
+	{
+		const uint8_t* Packed = (const uint8_t*) In;
+		const size_t Available = size_t(InEnd - In) * 2;
+		size_t Nibble = 0;
+
+		auto Get = [&]() -> uint8_t
+		{
+			const uint8_t Symbol = (Packed[Nibble >> 1] >> ((Nibble & 1) * 4)) & 15;
+			++Nibble;
+			return Symbol;
+		};
+
+		for (size_t i = 0; i < Count; ++i)
+		{
+			if (Nibble >= Available)
+				return false;
+
+			// Two plain symbols in one byte are the common case
+			if ((Nibble & 1) == 0 && Count - i >= 2)
+			{
+				const uint8_t Pair = Packed[Nibble >> 1];
+				if ((Pair & 15) != PackedEscape && (Pair >> 4) != PackedEscape)
+				{
+					Out[i] = PackedCharacters[Pair & 15];
+					Out[++i] = PackedCharacters[Pair >> 4];
+					Nibble += 2;
+					continue;
+				}
+			}
+
+			const uint8_t Symbol = Get();
+			if (Symbol != PackedEscape)
+			{
+				Out[i] = PackedCharacters[Symbol];
+				continue;
+			}
+
+			if (Available - Nibble < 2)
+				return false;
+
+			const uint8_t Low = Get();
+			Out[i] = (char) (Low | (Get() << 4));
+		}
+
+		In += (Nibble + 1) / 2;
+		return true;
+	}
+
+	static inline bool WriteLength(char*& Out, const char* OutEnd, size_t Length)
+	{
+		for (; Length >= 255; Length -= 255)
+		{
+			if (Out == OutEnd)
+				return false;
+			*Out++ = (char) 255;
+		}
+
+		if (Out == OutEnd)
+			return false;
+		*Out++ = (char) Length;
+		return true;
+	}
+
+	static inline bool ReadLength(const char*& In, const char* InEnd, size_t& Length)
+	{
+		uint8_t Byte = 255;
+		while (Byte == 255)
+		{
+			if (In == InEnd)
+				return false;
+
+			Byte = (uint8_t) *In++;
+			Length += Byte;
+		}
+
+		return Length <= MaxEnvelopeDecodedSize;
+	}
+
+	// Token, literal length, literals, offset and match length - MatchLength 0 ends the block with literals only
+	static bool WriteSequence(char*& Out, const char* OutEnd, bool bPacked, const char* Literals, size_t LiteralCount, size_t Offset, size_t MatchLength)
+	{
+		if (Out == OutEnd)
+			return false;
+
+		const size_t MatchCode = (MatchLength > 0) ? MatchLength - MinMatch : 0;
+		char* Token = Out++;
+		*Token = (char) ((std::min<size_t>(LiteralCount, 15) << 4) | std::min<size_t>(MatchCode, 15));
+
+		if (LiteralCount >= 15 && !WriteLength(Out, OutEnd, LiteralCount - 15))
+			return false;
+
+		if (bPacked)
+		{
+			if (!WritePackedLiterals(Out, OutEnd, Literals, LiteralCount))
+				return false;
+		}
+		else
+		{
+			if (LiteralCount > size_t(OutEnd - Out))
+				return false;
+			std::memcpy(Out, Literals, LiteralCount);
+			Out += LiteralCount;
+		}
+
+		if (MatchLength == 0)
+			return true;
+
+		if (OutEnd - Out < 2)
+			return false;
+		*Out++ = (char) (Offset & 0xFF);
+		*Out++ = (char) (Offset >> 8);
+
+		return MatchCode < 15 || WriteLength(Out, OutEnd, MatchCode - 15);
+	}
+
+	size_t GetEnvelopeBound(size_t Size)
+	{
+		return sizeof(EnvelopeHeader) + Size + Size / 255 + 16;
+	}
+
+	size_t EncodeEnvelope(std::span<const char> Datagram, std::span<char> Out, EEnvelopeDictionary Dictionary)
+	{
+		if (Datagram.empty() || Datagram.size() > MaxEnvelopeDecodedSize || Out.size() <= sizeof(EnvelopeHeader))
+			return 0;
+
+		// Matches are searched in the dictionary followed by the datagram, positions are relative to the dictionary start
+		thread_local std::vector<char> Window;
+		thread_local HashTable Table;
+
+		std::span<const char> Preset = GetDictionary(Dictionary);
+		Window.resize(Preset.size() + Datagram.size());
+		if (!Preset.empty())
+			std::memcpy(Window.data(), Preset.data(), Preset.size());
+		std::memcpy(Window.data() + Preset.size(), Datagram.data(), Datagram.size());
+		Table = GetDictionaryHashTable(Dictionary);
+
+		// Text is mostly digits, binary datagrams would have most bytes escaped
+		const bool bPacked = Datagram[0] == 'a';
+		const size_t MinLength = bPacked ? MinPackedMatch : MinMatch;
+
+		EnvelopeHeader Header;
+		Header.Codec = (uint8_t) (bPacked ? EEnvelopeCodec::LZPacked : EEnvelopeCodec::LZ);
+		Header.Dictionary = (uint8_t) Dictionary;
+		Header.DecodedSize = (uint32_t) Datagram.size();
+		std::memcpy(Out.data(), &Header, sizeof(Header));
+
+		char* Cursor = Out.data() + sizeof(Header);
+		const char* OutEnd = Out.data() + Out.size();
+
+		const char* Base = Window.data();
+		const size_t End = Window.size();
+		size_t Position = Preset.size();
+		size_t Anchor = Position;
+
+		if (Datagram.size() > MatchSearchEnd)
+		{
+			const size_t SearchEnd = End - MatchSearchEnd;
+			const size_t MatchEnd = End - LastLiterals;
+			size_t Misses = 0;
+
+			while (Position < SearchEnd)
+			{
+				const uint32_t Sequence = Read32(Base + Position);
+				const uint32_t HashIndex = Hash(Sequence);
+				const size_t Candidate = Table[HashIndex];
+				Table[HashIndex] = (uint32_t) Position;
+
+				if (Candidate >= Position || Position - Candidate > MaxOffset || Read32(Base + Candidate) != Sequence)
+				{
+					// Skip ahead faster through data that does not compress
+					Position += 1 + (Misses++ >> 5);
+					continue;
+				}
+
+				size_t Length = MinMatch;
+				while (Position + Length < MatchEnd && Base[Candidate + Length] == Base[Position + Length])
+					++Length;
+
+				if (Length < MinLength)
+				{
+					Position += 1 + (Misses++ >> 5);
+					continue;
+				}
+
+				if (!WriteSequence(Cursor, OutEnd, bPacked, Base + Anchor, Position - Anchor, Position - Candidate, Length))
+					return 0;
+
+				Position += Length;
+				Anchor = Position;
+				Misses = 0;
+
+				if (Position < SearchEnd)
+					Table[Hash(Read32(Base + Position - 2))] = (uint32_t) (Position - 2);
+			}
+		}
+
+		if (!WriteSequence(Cursor, OutEnd, bPacked, Base + Anchor, End - Anchor, 0, 0))
+			return 0;
+
+		return Cursor - Out.data();
+	}
+
+	bool DecodeEnvelope(const std::vector<char>& Message, std::vector<char>& OutDatagram)
+	{
+		EnvelopeHeader Header;
+		if (!ReadBinary(Message, 0, Message.size(), Header))
+			return false;
+
+		if (Header.Type != 'e' || Header.Version != 1)
+			return false;
+
+		if (Header.Codec != (uint8_t) EEnvelopeCodec::LZ && Header.Codec != (uint8_t) EEnvelopeCodec::LZPacked)
+			return false;
+		const bool bPacked = Header.Codec == (uint8_t) EEnvelopeCodec::LZPacked;
+
+		if (Header.DecodedSize == 0 || Header.DecodedSize > MaxEnvelopeDecodedSize)
+			return false;
+
+		if (Header.Dictionary > (uint8_t) EEnvelopeDictionary::Preset)
+			return false;
+
+		std::span<const char> Preset = GetDictionary((EEnvelopeDictionary) Header.Dictionary);
+
+		OutDatagram.resize(Header.DecodedSize);
+		char* Out = OutDatagram.data();
+		const size_t OutSize = OutDatagram.size();
+		size_t Written = 0;
+
+		const char* In = Message.data() + sizeof(Header);
+		const char* InEnd = Message.data() + Message.size();
+
+		while (In < InEnd)
+		{
+			const uint8_t Token = (uint8_t) *In++;
+
+			size_t LiteralCount = Token >> 4;
+			if (LiteralCount == 15 && !ReadLength(In, InEnd, LiteralCount))
+				return false;
+
+			if (LiteralCount > OutSize - Written)
+				return false;
+
+			if (bPacked)
+			{
+				if (!ReadPackedLiterals(In, InEnd, Out + Written, LiteralCount))
+					return false;
+			}
+			else if (LiteralCount <= 16 && InEnd - In >= 16 && OutSize - Written >= 16)
+			{
+				std::memcpy(Out + Written, In, 16); // fixed size copies compile to a few moves, the excess is overwritten later
+				In += LiteralCount;
+			}
+			else
+			{
+				if (LiteralCount > size_t(InEnd - In))
+					return false;
+
+				std::memcpy(Out + Written, In, LiteralCount);
+				In += LiteralCount;
+			}
+			Written += LiteralCount;
+
+			if (In == InEnd)
+				break; // the last sequence has no match
+
+			if (InEnd - In < 2)
+				return false;
+
+			const size_t Offset = (uint8_t) In[0] | (size_t((uint8_t) In[1]) << 8);
+			In += 2;
+
+			size_t Length = Token & 15;
+			if (Length == 15 && !ReadLength(In, InEnd, Length))
+				return false;
+			Length += MinMatch;
+
+			if (Offset == 0 || Offset > Written + Preset.size() || Length > OutSize - Written)
+				return false;
+
+			// The part of the match that lies before the datagram comes from the end of the dictionary
+			if (Offset > Written)
+			{
+				const size_t FromPreset = std::min(Length, Offset - Written);
+				std::memcpy(Out + Written, Preset.data() + Preset.size() - (Offset - Written), FromPreset);
+				Written += FromPreset;
+				Length -= FromPreset;
+
+				if (Length == 0)
+					continue;
+			}
+
+			if (Offset >= 16 && Length <= 16 && OutSize - Written >= 16)
+			{
+				std::memcpy(Out + Written, Out + Written - Offset, 16);
+				Written += Length;
+			}
+			else if (Offset >= Length)
+			{
+				std::memcpy(Out + Written, Out + Written - Offset, Length);
+				Written += Length;
+			}
+			else
+			{
+				// Overlapping match repeats the last Offset bytes
+				for (; Length > 0; --Length, ++Written)
+					Out[Written] = Out[Written - Offset];
+			}
+		}
+
+		return Written == OutSize;
+	}
+
+	const std::vector<char>* DecodeEnvelope(const std::vector<char>& Message)
+	{
+		thread_local std::vector<char> Decoded;
+		return DecodeEnvelope(Message, Decoded) ? &Decoded : nullptr;
+	}
+}
@@ -0,0 +1,63 @@
+#pragma once
+
+#include "facepipe.h"
+
+/*
+* Encoded ('e') datagrams wrap another datagram - ASCII, binary or composite - in compressed form.
+* An 8 byte little-endian header is followed by the compressed datagram:
+*
+*	char	Type = 'e'
+*	u8		Version = 1
+*	u8		Codec				EEnvelopeCodec
+*	u8		Dictionary			EEnvelopeDictionary the compressor was primed with
+*	u32		DecodedSize			size of the wrapped datagram
+*	u8		Data[]
+*
+* The LZ codec uses the LZ4 block format (token, literals, 16 bit offset, match length) so decoding is
+* a tight copy loop without entropy coding. Numbers printed as text barely repeat, so for ASCII datagrams
+* LZPacked stores the literals as 4 bit symbols which roughly halves them. Single datagrams are too small to contain much repetition
+* of their own, the preset dictionary holds what typical traffic repeats between datagrams (headers,
+* tokens, blendshape names) and matches may reference it as if it preceded the datagram.
+*
+* Encoded datagrams can be fragmented like any other, receivers reassemble first and decode second.
+*/
+
+namespace FacePipe
+{
+	enum class EEnvelopeCodec : uint8_t
+	{
+		LZ = 1,
+		LZPacked = 2,	// literals are packed into 4 bit symbols for the digits and separators of ASCII datagrams
+	};
+
+	enum class EEnvelopeDictionary : uint8_t
+	{
+		None = 0,
+		Preset = 1,	// built from MediaPipe landmarker traffic, see PresetDictionary in facepipe_envelope.cpp
+	};
+
+	struct EnvelopeHeader
+	{
+		char Type = 'e';
+		uint8_t Version = 1;
+		uint8_t Codec = (uint8_t) EEnvelopeCodec::LZ;
+		uint8_t Dictionary = (uint8_t) EEnvelopeDictionary::None;
+		uint32_t DecodedSize = 0;
+	};
+	static_assert(sizeof(EnvelopeHeader) == 8, "EnvelopeHeader must match the wire format");
+
+	static const size_t MaxEnvelopeDecodedSize = 1 << 20; // same limit as fragmented datagrams
+
+	// Largest possible encoded size of a Size byte datagram, incompressible data grows slightly
+	size_t GetEnvelopeBound(size_t Size);
+
+	// Writes an 'e' datagram into Out and returns its size, 0 if it does not fit. An Out of Datagram.size() bytes
+	// therefore returns 0 whenever compressing would not save anything and the datagram should be sent as is.
+	size_t EncodeEnvelope(std::span<const char> Datagram, std::span<char> Out, EEnvelopeDictionary Dictionary = EEnvelopeDictionary::Preset);
+
+	// Decodes the wrapped datagram into OutDatagram, reusing its capacity
+	bool DecodeEnvelope(const std::vector<char>& Message, std::vector<char>& OutDatagram);
+
+	// Same as above into a buffer owned by the calling thread, valid until the next call on that thread. nullptr on failure.
+	const std::vector<char>* DecodeEnvelope(const std::vector<char>& Message);
+}
@@ -0,0 +1,250 @@
+#include "facepipe_fec.h"
+
+#include <algorithm>
+
+namespace FacePipe
+{
+	// Accumulator ^= Data, zero padding whichever is shorter
+	static void XorInto(std::vector<char>& Accumulator, const char* Data, size_t Size)
+	{
+		if (Accumulator.size() < Size)
+			Accumulator.resize(Size, 0);
+
+		// 8 bytes at a time, a char loop cannot be vectorized since char pointers may alias each other
+		char* Out = Accumulator.data();
+		size_t i = 0;
+		for (; i + sizeof(uint64_t) <= Size; i += sizeof(uint64_t))
+		{
+			uint64_t A, B;
+			std::memcpy(&A, Out + i, sizeof(A));
+			std::memcpy(&B, Data + i, sizeof(B));
+			A ^= B;
+			std::memcpy(Out + i, &A, sizeof(A));
+		}
+
+		for (; i < Size; ++i)
+			Out[i] ^= Data[i];
+	}
+
+	bool ReadParityHeader(const std::vector<char>& Packet, ParityHeader& OutHeader)
+	{
+		if (Packet.size() <= sizeof(ParityHeader) || Packet.size() - sizeof(ParityHeader) > MaxParityPayloadSize)
+			return false;
+
+		std::memcpy(&OutHeader, Packet.data(), sizeof(ParityHeader));
+
+		if (OutHeader.Type != 'p' || OutHeader.Version != 1)
+			return false;
+
+		if (OutHeader.GroupSize == 0 || OutHeader.GroupSize > MaxParityGroupSize || OutHeader.Index > OutHeader.GroupSize)
+			return false;
+
+		// The parity is as long as the longest packet of its group, only packets can be checked against their size
+		const bool bParity = OutHeader.Index == OutHeader.GroupSize;
+		return bParity || OutHeader.PayloadSize == Packet.size() - sizeof(ParityHeader);
+	}
+
+	ParityEncoder::ParityEncoder(size_t GroupSize)
+		: GroupSize(std::clamp<size_t>(GroupSize, 1, MaxParityGroupSize))
+	{
+	}
+
+	bool ParityEncoder::Protect(std::span<const char> Packet, std::vector<char>& OutPacket, std::vector<char>& OutParity)
+	{
+		if (Packet.empty() || Packet.size() > MaxParityPayloadSize)
+			return false;
+
+		ParityHeader Header;
+		Header.Index = (uint8_t) NextIndex;
+		Header.GroupSize = (uint8_t) GroupSize;
+		Header.GroupId = GroupId;
+		Header.PayloadSize = (uint16_t) Packet.size();
+
+		OutPacket.resize(sizeof(ParityHeader) + Packet.size());
+		std::memcpy(OutPacket.data(), &Header, sizeof(ParityHeader));
+		std::memcpy(OutPacket.data() + sizeof(ParityHeader), Packet.data(), Packet.size());
+
+		XorInto(Parity, Packet.data(), Packet.size());
+		SizeParity ^= Header.PayloadSize;
+
+		if (++NextIndex < GroupSize)
+			return false;
+
+		Header.Index = (uint8_t) GroupSize;
+		Header.PayloadSize = SizeParity;
+
+		OutParity.resize(sizeof(ParityHeader) + Parity.size());
+		std::memcpy(OutParity.data(), &Header, sizeof(ParityHeader));
+		std::memcpy(OutParity.data() + sizeof(ParityHeader), Parity.data(), Parity.size());
+
+		GroupId++;
+		NextIndex = 0;
+		SizeParity = 0;
+		Parity.clear();
+		return true;
+	}
+
+	ParityDecoder::ParityDecoder(size_t MaxGroups, double TimeoutSeconds)
+		: Groups(std::max<size_t>(MaxGroups, 1)), Timeout(TimeoutSeconds)
+	{
+	}
+
+	void ParityDecoder::Close(Group& G)
+	{
+		UnrecoverableCount += G.GroupSize - G.ReceivedCount;
+		G.bActive = false;
+		G.bCompleted = true;
+	}
+
+	void ParityDecoder::Expire(double Now)
+	{
+		for (Group& G : Groups)
+		{
+			if (G.bActive && Now - G.FirstReceived > Timeout)
+				Close(G);
+		}
+	}
+
+	void ParityDecoder::Clear()
+	{
+		for (Group& G : Groups)
+		{
+			G.bActive = false;
+			G.bCompleted = false;
+		}
+		bHasRecovered = false;
+	}
+
+	ParityDecoder::Group* ParityDecoder::FindOrStart(const ParityHeader& Header, uint64_t SenderKey, double Now)
+	{
+		Group* Free = nullptr;
+		Group* Oldest = nullptr;
+		for (Group& G : Groups)
+		{
+			const bool bSameGroup = G.SenderKey == SenderKey && G.GroupId == Header.GroupId;
+			if (!G.bActive)
+			{
+				if (G.bCompleted && bSameGroup)
+					return &G;
+
+				if (!Free || (Free->bCompleted && !G.bCompleted))
+					Free = &G;
+				continue;
+			}
+
+			if (bSameGroup)
+				return &G;
+
+			if (!Oldest || G.FirstReceived < Oldest->FirstReceived)
+				Oldest = &G;
+		}
+
+		Group* Target = Free;
+		if (!Target)
+		{
+			Target = Oldest;
+			Close(*Target);
+		}
+
+		Target->bActive = true;
+		Target->bCompleted = false;
+		Target->SenderKey = SenderKey;
+		Target->GroupId = Header.GroupId;
+		Target->GroupSize = Header.GroupSize;
+		Target->ReceivedCount = 0;
+		Target->bHasParity = false;
+		Target->ReceivedMask = 0;
+		Target->SizeParity = 0;
+		Target->FirstReceived = Now;
+		Target->Parity.clear();
+		return Target;
+	}
+
+	bool ParityDecoder::Add(const std::vector<char>& Packet, uint64_t SenderKey, double Now, std::vector<char>& OutPacket)
+	{
+		bHasRecovered = false;
+
+		ParityHeader Header;
+		if (!ReadParityHeader(Packet, Header))
+		{
+			InvalidCount++;
+			return false;
+		}
+
+		Expire(Now);
+
+		Group* G = FindOrStart(Header, SenderKey, Now);
+		if (G->GroupSize != Header.GroupSize)
+		{
+			InvalidCount++;
+			return false;
+		}
+
+		const uint32_t Bit = uint32_t(1) << Header.Index;
+		if (G->ReceivedMask & Bit)
+			return false; // duplicate, or a packet that was already recovered
+
+		G->ReceivedMask |= Bit;
+
+		const bool bParity = Header.Index == Header.GroupSize;
+		const char* Payload = Packet.data() + sizeof(ParityHeader);
+		const size_t PayloadSize = Packet.size() - sizeof(ParityHeader);
+
+		if (!G->bActive)
+		{
+			// Arrived after its group was given up on, it was counted as unrecoverable but can still be used
+			if (bParity)
+				return false;
+
+			UnrecoverableCount--;
+			OutPacket.assign(Payload, Payload + PayloadSize);
+			return true;
+		}
+
+		XorInto(G->Parity, Payload, PayloadSize);
+		G->SizeParity ^= Header.PayloadSize;
+
+		if (bParity)
+			G->bHasParity = true;
+		else
+			G->ReceivedCount++;
+
+		if (G->ReceivedCount + 1 == G->GroupSize && G->bHasParity)
+		{
+			// Everything but one packet cancelled out of the XOR, what remains is the missing packet and its size
+			if (G->SizeParity > 0 && G->SizeParity <= G->Parity.size())
+			{
+				Recovered.assign(G->Parity.begin(), G->Parity.begin() + G->SizeParity);
+				bHasRecovered = true;
+				RecoveredCount++;
+				G->ReceivedCount++;
+				G->ReceivedMask = (uint32_t(1) << (G->GroupSize + 1)) - 1;
+			}
+			else
+			{
+				InvalidCount++;
+			}
+			Close(*G);
+		}
+		else if (G->ReceivedCount == G->GroupSize)
+		{
+			Close(*G);
+		}
+
+		if (bParity)
+			return false;
+
+		OutPacket.assign(Payload, Payload + PayloadSize);
+		return true;
+	}
+
+	bool ParityDecoder::TakeRecovered(std::vector<char>& OutPacket)
+	{
+		if (!bHasRecovered)
+			return false;
+
+		OutPacket.swap(Recovered);
+		bHasRecovered = false;
+		return true;
+	}
+}
@@ -0,0 +1,117 @@
+#pragma once
+
+#include "facepipe.h"
+
+/*
+* Forward error correction for lossy links (Wi-Fi). Resending is pointless for real-time data, instead the sender
+* wraps every packet it sends in a parity ('p') packet and after every GroupSize packets adds one parity packet
+* from which the receiver can rebuild any single packet of the group that went missing. 12 byte little-endian header:
+*
+*	char	Type = 'p'
+*	u8		Version = 1
+*	u8		Index				0 to GroupSize-1 for the packets of the group, GroupSize for the parity
+*	u8		GroupSize			1 to MaxParityGroupSize
+*	u32		GroupId				counted up by the sender per group
+*	u16		PayloadSize			size of the wrapped packet, for the parity the XOR of the sizes of the group
+*	u16		Reserved
+*	u8		Payload[]			the wrapped packet (any datagram or fragment), for the parity the XOR of the
+*								packets of the group zero padded to the longest one
+*
+* Received packets are unwrapped right away, protection adds no latency unless a packet was lost. A lost packet is
+* rebuilt once the parity arrives, which is sent right after the last packet of the group, so it is late by at most
+* one group. Choose a GroupSize no larger than the packets of one frame so that the rebuilt packet arrives before
+* the next frame of its stream (otherwise the SequenceTracker drops it as late). The overhead is 1/GroupSize.
+*/
+
+namespace FacePipe
+{
+	struct ParityHeader
+	{
+		char Type = 'p';
+		uint8_t Version = 1;
+		uint8_t Index = 0;
+		uint8_t GroupSize = 0;
+		uint32_t GroupId = 0;
+		uint16_t PayloadSize = 0;
+		uint16_t Reserved = 0;
+	};
+	static_assert(sizeof(ParityHeader) == 12, "ParityHeader must match the wire format");
+
+	static const size_t MaxParityGroupSize = 16;
+	static const size_t MaxParityPayloadSize = UINT16_MAX;
+
+	bool ReadParityHeader(const std::vector<char>& Packet, ParityHeader& OutHeader);
+
+	// Sender side, one encoder per target
+	class ParityEncoder
+	{
+	public:
+		ParityEncoder(size_t GroupSize = 4);
+
+		// Writes Packet wrapped into OutPacket. Returns true when the packet completed a group,
+		// OutParity then holds the parity packet that has to be sent after it.
+		bool Protect(std::span<const char> Packet, std::vector<char>& OutPacket, std::vector<char>& OutParity);
+
+		size_t GetGroupSize() const { return GroupSize; }
+
+	protected:
+		size_t GroupSize = 4;
+		uint32_t GroupId = 0;
+		size_t NextIndex = 0;
+		uint16_t SizeParity = 0;
+		std::vector<char> Parity; // payload XOR of the group so far, as long as the longest packet
+	};
+
+	// Receiver side, keeps the running XOR of a few groups per sender
+	class ParityDecoder
+	{
+	public:
+		ParityDecoder(size_t MaxGroups = 8, double TimeoutSeconds = 0.25);
+
+		// Adds a received 'p' packet. SenderKey identifies the sender (address and port) since group ids are only unique per sender.
+		// Returns true if the packet wrapped a packet, OutPacket then holds it. Call TakeRecovered afterwards, both the parity
+		// and the last packet of a group can complete the recovery of another one.
+		bool Add(const std::vector<char>& Packet, uint64_t SenderKey, double Now, std::vector<char>& OutPacket);
+
+		// The packet rebuilt by the last Add, if any
+		bool TakeRecovered(std::vector<char>& OutPacket);
+
+		// Drops groups older than the timeout, Add does this lazily but idle receivers can call it directly
+		void Expire(double Now);
+
+		void Clear();
+
+		size_t RecoveredCount = 0;		// lost packets rebuilt from the parity
+		size_t UnrecoverableCount = 0;	// lost packets of groups that missed more than the parity could rebuild
+		size_t InvalidCount = 0;		// malformed packets or packets contradicting their group
+		// Groups lost as a whole do not show up in the counters, the SequenceTracker still counts their datagrams as lost
+
+	protected:
+		struct Group
+		{
+			bool bActive = false;
+			bool bCompleted = false; // inactive but remembers its id so late packets do not start a new group
+			uint64_t SenderKey = 0;
+			uint32_t GroupId = 0;
+			uint8_t GroupSize = 0;
+			uint8_t ReceivedCount = 0; // packets of the group, not counting the parity
+			bool bHasParity = false;
+			uint32_t ReceivedMask = 0; // bit Index is set for received packets and the parity
+			uint16_t SizeParity = 0;
+			double FirstReceived = 0.0;
+			std::vector<char> Parity; // capacity is kept between groups
+		};
+
+		// Returns nullptr for packets of a group that was just completed
+		Group* FindOrStart(const ParityHeader& Header, uint64_t SenderKey, double Now);
+
+		// Deactivates the group and counts the packets it is missing as unrecoverable
+		void Close(Group& G);
+
+		std::vector<Group> Groups;
+		double Timeout = 0.25;
+
+		std::vector<char> Recovered;
+		bool bHasRecovered = false;
+	};
+}
@@ -0,0 +1,128 @@
+#pragma once
+
+#include "facepipe.h"
+#include "facepipe_delta.h"
+
+/*
+* Receivers tell each sender once per second how its datagrams are doing, so that the sender can adapt to the link
+* and to how fast the receiver keeps up. The report is sent back to the address the datagrams came from, 24 bytes little-endian:
+*
+*	char	Type = 'r'
+*	u8		Version = 1
+*	u16		Reserved
+*	u32		Received			datagrams with a sequence number received in the interval
+*	u32		Lost				sequence numbers skipped in the interval, less the ones that arrived late
+*	u32		QueueDepth			most datagrams that were waiting to be processed at once
+*	f32		LatencyMs			mean time from receiving a datagram to processing it
+*	f32		IntervalSeconds		time the report covers
+*
+* Loss can only be measured for senders that number their datagrams (see facepipe_sequence.h), without sequence
+* numbers Received and Lost stay 0. Senders feed the reports into an AdaptiveEncoding which steps from full over
+* quantized to delta encoded landmarks while the link is congested, then lowers the send rate, and steps back up
+* after a few good reports in a row.
+*/
+
+namespace FacePipe
+{
+	struct ReceiverReport
+	{
+		char Type = 'r';
+		uint8_t Version = 1;
+		uint16_t Reserved = 0;
+		uint32_t Received = 0;
+		uint32_t Lost = 0;
+		uint32_t QueueDepth = 0;
+		float LatencyMs = 0.0f;
+		float IntervalSeconds = 0.0f;
+
+		// Lost datagrams out of all sent, 0 if nothing was numbered
+		float LossRate() const { return Lost > 0 ? float(Lost) / float(uint64_t(Received) + Lost) : 0.0f; }
+	};
+	static_assert(sizeof(ReceiverReport) == 24, "ReceiverReport must match the wire format");
+
+	bool ReadReceiverReport(const std::vector<char>& Packet, ReceiverReport& OutReport);
+
+	// Receiver side, collects the datagrams of every sender and hands out a report per sender and interval
+	class ReceiverReporter
+	{
+	public:
+		ReceiverReporter(double IntervalSeconds = 1.0);
+
+		// Adds a parsed datagram of SenderKey (address and port). LostChange is the change of the lost count
+		// from SequenceTracker::Accept, LatencySeconds the time from receiving the datagram to processing it.
+		void Add(uint64_t SenderKey, const MessageInfo& Info, int64_t LostChange, double LatencySeconds, double Now);
+
+		// Datagrams waiting to be processed, the reports carry the most seen in their interval
+		void SetQueueDepth(size_t Depth);
+
+		// Returns true with the report of a sender whose interval is over, call it until it returns false.
+		// Senders that sent nothing during their interval are forgotten.
+		bool TakeDue(double Now, uint64_t& OutSenderKey, ReceiverReport& OutReport);
+
+		// False once TakeDue forgot the sender, state kept per sender elsewhere can be dropped then
+		bool IsTracking(uint64_t SenderKey) const;
+
+		void Clear() { Senders.clear(); }
+
+	protected:
+		struct Sender
+		{
+			uint64_t Key = 0;
+			double IntervalStart = 0.0;
+			uint32_t Datagrams = 0;
+			uint32_t Received = 0;
+			int64_t Lost = 0;
+			uint32_t QueueDepth = 0;
+			double LatencySum = 0.0;
+		};
+
+		double Interval = 1.0;
+		std::vector<Sender> Senders;
+	};
+
+	enum class EEncodingLevel : uint8_t
+	{
+		Full = 0,		// landmarks as raw floats
+		Quantized = 1,	// landmarks quantized to 12 bits
+		Delta = 2,		// quantized keyframes and 8 bit deltas, see facepipe_delta.h
+	};
+
+	// Sender side, one per target. Picks the landmark encoding and thins the datagrams from the reports of the target.
+	class AdaptiveEncoding
+	{
+	public:
+		static constexpr float CongestedLoss = 0.05f;		// loss above this steps down
+		static constexpr float HealthyLoss = 0.01f;			// loss below this (with low queue and latency) counts as a good report
+		static constexpr uint32_t CongestedQueueDepth = 64;
+		static constexpr float CongestedLatencyMs = 50.0f;
+		static constexpr uint32_t RecoveryReports = 5;		// good reports in a row before stepping up again
+		static constexpr float MinRateScale = 0.25f;
+
+		// Steps down while the report shows congestion, steps up after RecoveryReports good ones. The rate is the
+		// last resort, it is lowered only at EEncodingLevel::Delta and restored before the encoding steps up.
+		void OnReport(const ReceiverReport& Report);
+
+		EEncodingLevel GetLevel() const { return Level; }
+		float GetRateScale() const { return RateScale; }
+
+		// Sets up Encoder for the current level so that all levels share its sequence numbers
+		void Configure(LandmarkDeltaEncoder& Encoder) const;
+
+		// Call per datagram of a stream, returns false for the datagrams dropped to reduce the rate to GetRateScale().
+		// Streams (source, scene, camera, subject, data type) are thinned evenly on their own.
+		bool ShouldSend(const MessageInfo& Info);
+
+	protected:
+		struct Stream
+		{
+			SubjectKey Key;
+			EFacepipeData DataType = EFacepipeData::INVALID;
+			float Credit = 0.0f;
+		};
+
+		EEncodingLevel Level = EEncodingLevel::Full;
+		float RateScale = 1.0f;
+		uint32_t GoodReports = 0;
+		std::vector<Stream> Streams;
+	};
+}
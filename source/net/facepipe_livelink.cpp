@@ -0,0 +1,123 @@
+#include "facepipe_livelink.h"
+
+#include <algorithm>
+
+namespace FacePipe
+{
+	static inline uint32_t ReadBigEndian32(const char* Data)
+	{
+		const uint8_t* Bytes = (const uint8_t*) Data;
+		return (uint32_t(Bytes[0]) << 24) | (uint32_t(Bytes[1]) << 16) | (uint32_t(Bytes[2]) << 8) | uint32_t(Bytes[3]);
+	}
+
+	static inline float ReadBigEndianFloat(const char* Data)
+	{
+		const uint32_t Bits = ReadBigEndian32(Data);
+		float Value;
+		std::memcpy(&Value, &Bits, sizeof(Value));
+		return Value;
+	}
+
+	struct LiveLinkFaceLayout
+	{
+		size_t SubjectName = 0;		// offsets from the start of the datagram
+		size_t SubjectNameLength = 0;
+		size_t FrameTime = 0;
+		size_t Values = 0;
+		size_t ValueCount = 0;
+	};
+
+	// i32 length followed by the characters
+	static bool ReadString(const std::vector<char>& Message, size_t& Offset, size_t& OutBegin, size_t& OutLength)
+	{
+		if (Message.size() - Offset < sizeof(uint32_t))
+			return false;
+
+		OutLength = ReadBigEndian32(Message.data() + Offset);
+		OutBegin = Offset + sizeof(uint32_t);
+		if (OutLength > Message.size() - OutBegin)
+			return false;
+
+		Offset = OutBegin + OutLength;
+		return true;
+	}
+
+	// Receivers may append a terminator (see the Unreal plugin), so bytes after the values are allowed
+	static bool ReadLayout(const std::vector<char>& Message, LiveLinkFaceLayout& OutLayout)
+	{
+		if (Message.empty() || (uint8_t) Message[0] != LiveLinkFaceVersion)
+			return false;
+
+		size_t Offset = 1;
+		size_t DeviceId = 0, DeviceIdLength = 0;
+		if (!ReadString(Message, Offset, DeviceId, DeviceIdLength) || !ReadString(Message, Offset, OutLayout.SubjectName, OutLayout.SubjectNameLength))
+			return false;
+
+		// frame number, sub frame, rate numerator, rate denominator, value count
+		if (Message.size() - Offset < 4 * sizeof(uint32_t) + 1)
+			return false;
+
+		OutLayout.FrameTime = Offset;
+		Offset += 4 * sizeof(uint32_t);
+		OutLayout.ValueCount = (uint8_t) Message[Offset];
+		OutLayout.Values = Offset + 1;
+
+		if (OutLayout.ValueCount < ARKitBlendshapeCount || OutLayout.ValueCount * sizeof(float) > Message.size() - OutLayout.Values)
+			return false;
+
+		return true;
+	}
+
+	bool ParseLiveLinkFaceHeader(const std::vector<char>& Message, MessageInfo& OutInfo)
+	{
+		OutInfo.Reset();
+
+		LiveLinkFaceLayout Layout;
+		if (!ReadLayout(Message, Layout))
+			return false;
+
+		const int32_t FrameNumber = (int32_t) ReadBigEndian32(Message.data() + Layout.FrameTime);
+		const float SubFrame = ReadBigEndianFloat(Message.data() + Layout.FrameTime + 4);
+		const int32_t RateNumerator = (int32_t) ReadBigEndian32(Message.data() + Layout.FrameTime + 8);
+		const int32_t RateDenominator = (int32_t) ReadBigEndian32(Message.data() + Layout.FrameTime + 12);
+
+		OutInfo.Source.assign(LiveLinkFaceSource);
+		OutInfo.Subject = (int) (HashBytes(2166136261u, Message.data() + Layout.SubjectName, Layout.SubjectNameLength) & 0x7FFF);
+		OutInfo.DataType = EFacepipeData::Blendshapes;
+		OutInfo.DatagramType = EDatagramType::LiveLinkFace;
+		OutInfo.Time = (RateNumerator > 0) ? (FrameNumber + (double) SubFrame) * RateDenominator / RateNumerator : 0.0;
+		OutInfo.ContentView = VectorView(Layout.Values, Layout.Values + Layout.ValueCount * sizeof(float));
+		return true;
+	}
+
+	bool GetLiveLinkFaceBlendshapes(const std::vector<char>& Message, const MessageInfo& Info, BlendshapeFrame& OutBlendshapes)
+	{
+		if (Info.DatagramType != EDatagramType::LiveLinkFace || Info.DataType != EFacepipeData::Blendshapes)
+			return false;
+
+		const size_t Count = (Info.ContentView.e - Info.ContentView.b) / sizeof(float);
+		if (Count < ARKitBlendshapeCount || Info.ContentView.e > Message.size())
+			return false;
+
+		const char* Values = Message.data() + Info.ContentView.b;
+		for (size_t i = 0; i < ARKitBlendshapeCount; ++i)
+			OutBlendshapes.Values[i] = ReadBigEndianFloat(Values + i * sizeof(float));
+		OutBlendshapes.ValidMask = (uint64_t(1) << ARKitBlendshapeCount) - 1;
+
+		const size_t RotationCount = std::min(Count - ARKitBlendshapeCount, LiveLinkFaceRotationCount);
+		for (size_t i = 0; i < RotationCount; ++i)
+			OutBlendshapes.Set(LiveLinkFaceRotationNames[i], ReadBigEndianFloat(Values + (ARKitBlendshapeCount + i) * sizeof(float)));
+
+		return true;
+	}
+
+	bool GetLiveLinkFaceSubjectName(const std::vector<char>& Message, const MessageInfo& Info, std::string_view& OutName)
+	{
+		LiveLinkFaceLayout Layout;
+		if (Info.DatagramType != EDatagramType::LiveLinkFace || !ReadLayout(Message, Layout))
+			return false;
+
+		OutName = std::string_view(Message.data() + Layout.SubjectName, Layout.SubjectNameLength);
+		return true;
+	}
+}
@@ -0,0 +1,141 @@
+#include "facepipe_osc.h"
+#include "facepipe_writer.h"
+
+#include <bit>
+#include <cctype>
+
+namespace FacePipe
+{
+	// DatagramWriter with the big-endian numbers and the 4 byte aligned strings of OSC
+	class OscWriter : public DatagramWriter
+	{
+	public:
+		using DatagramWriter::DatagramWriter;
+
+		// Prefix and Name are written as one string, terminated and zero padded to a multiple of 4
+		void PutString(std::string_view Prefix, std::string_view Name = {})
+		{
+			Put(Prefix);
+			Put(Name);
+			Put('\0');
+			PadTo4();
+		}
+
+		void PutInt32(uint32_t Value)
+		{
+			PutBinary(ToBigEndian(Value));
+		}
+
+		void PutFloat(float Value)
+		{
+			PutInt32(std::bit_cast<uint32_t>(Value));
+		}
+
+		// Bundle elements are prefixed with their size, which is filled in by EndElement
+		size_t BeginElement()
+		{
+			PutInt32(0);
+			return Offset();
+		}
+
+		void EndElement(size_t ElementBegin)
+		{
+			if (bFailed)
+				return;
+
+			const uint32_t Size = ToBigEndian(uint32_t(Offset() - ElementBegin));
+			std::memcpy(Begin + ElementBegin - sizeof(Size), &Size, sizeof(Size));
+		}
+
+	protected:
+		static uint32_t ToBigEndian(uint32_t Value)
+		{
+			return (Value >> 24) | ((Value >> 8) & 0xFF00) | ((Value << 8) & 0xFF0000) | (Value << 24);
+		}
+	};
+
+	static void PutBlendshape(OscWriter& Writer, const OscAddressMapping& Mapping, std::string_view Name, float Value)
+	{
+		size_t Element = Writer.BeginElement();
+		if (Mapping.bBlendshapeNameArgument)
+		{
+			Writer.PutString(Mapping.BlendshapeAddress);
+			Writer.PutString(",sf");
+			Writer.PutString(Name);
+		}
+		else
+		{
+			Writer.PutString(Mapping.BlendshapeAddress, Name);
+			Writer.PutString(",f");
+		}
+		Writer.PutFloat(Value);
+		Writer.EndElement(Element);
+	}
+
+	OscAddressMapping::OscAddressMapping()
+	{
+		for (size_t i = 0; i < ARKitBlendshapeCount; ++i)
+			BlendshapeNames[i] = ARKitBlendshapeNames[i];
+	}
+
+	OscAddressMapping OscAddressMapping::VMC()
+	{
+		OscAddressMapping Mapping;
+		Mapping.BlendshapeAddress = "/VMC/Ext/Blend/Val";
+		Mapping.bBlendshapeNameArgument = true;
+		Mapping.BlendshapeApplyAddress = "/VMC/Ext/Blend/Apply";
+		Mapping.MatrixAddress.clear();
+
+		for (std::string& Name : Mapping.BlendshapeNames)
+			Name[0] = (char) std::toupper((unsigned char) Name[0]);
+
+		return Mapping;
+	}
+
+	size_t EncodeOscBundle(std::span<char> Out, const Frame& Frame, const OscAddressMapping& Mapping)
+	{
+		OscWriter Writer(Out);
+		Writer.PutString("#bundle");
+		Writer.PutInt32(0);
+		Writer.PutInt32(1); // timetag 1 means immediately
+
+		const BlendshapeFrame& Blendshapes = Frame.Blendshapes;
+		for (size_t i = 0; i < ARKitBlendshapeCount; ++i)
+		{
+			if (Blendshapes.IsValid(i) && !Mapping.BlendshapeNames[i].empty())
+				PutBlendshape(Writer, Mapping, Mapping.BlendshapeNames[i], Blendshapes.Values[i]);
+		}
+
+		if (Mapping.bOtherBlendshapes)
+		{
+			for (const auto& [Name, Value] : Blendshapes.Other)
+				PutBlendshape(Writer, Mapping, Name, Value);
+		}
+
+		if (!Mapping.BlendshapeApplyAddress.empty())
+		{
+			size_t Element = Writer.BeginElement();
+			Writer.PutString(Mapping.BlendshapeApplyAddress);
+			Writer.PutString(",");
+			Writer.EndElement(Element);
+		}
+
+		if (!Mapping.MatrixAddress.empty())
+		{
+			for (const auto& [Name, Values] : Frame.Matrices)
+			{
+				if (Values.size() != 16)
+					continue;
+
+				size_t Element = Writer.BeginElement();
+				Writer.PutString(Mapping.MatrixAddress, Name);
+				Writer.PutString(",ffffffffffffffff");
+				for (float Value : Values)
+					Writer.PutFloat(Value);
+				Writer.EndElement(Element);
+			}
+		}
+
+		return Writer.Size();
+	}
+}
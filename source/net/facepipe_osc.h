@@ -0,0 +1,35 @@
+#pragma once
+
+#include "facepipe.h"
+
+/*
+* OSC output for tools that do not speak FacePipe (VTuber rigs, lighting desks). One OSC message per blendshape
+* would be 52 datagrams per frame, instead the whole frame is packed into a single OSC 1.0 bundle:
+*
+*	#bundle | timetag 1 (immediately) | size | /facepipe/blendshape/jawOpen ,f 0.5 | size | ... | size | /facepipe/matrix/face ,ffff... 16 floats
+*
+* Blendshapes are sent under BlendshapeAddress + name, or for receivers that take the name as an argument
+* (e.g. the VMC protocol: /VMC/Ext/Blend/Val ,sf jawOpen 0.5) all under BlendshapeAddress. Matrices are sent as
+* 16 floats in the order they were received. All values are big-endian and strings are zero padded to 4 bytes as OSC requires.
+*/
+
+namespace FacePipe
+{
+	struct OscAddressMapping
+	{
+		std::string BlendshapeAddress = "/facepipe/blendshape/";
+		bool bBlendshapeNameArgument = false;	// sends ,sf name value to BlendshapeAddress instead of ,f value to BlendshapeAddress + name
+		std::string BlendshapeNames[ARKitBlendshapeCount];	// OSC name of every ARKit blendshape, an empty name skips the blendshape
+		bool bOtherBlendshapes = false;			// also sends the names in BlendshapeFrame::Other (e.g. headYaw of Live Link Face) as they are
+		std::string BlendshapeApplyAddress;		// optional message without arguments after the blendshapes
+		std::string MatrixAddress = "/facepipe/matrix/"; // + matrix name, empty sends no matrices
+
+		OscAddressMapping();
+
+		// Blendshapes in "Perfect Sync" naming (EyeBlinkLeft, JawOpen, ...) for VMC protocol receivers, no matrices
+		static OscAddressMapping VMC();
+	};
+
+	// Writes Frame.Blendshapes and Frame.Matrices as one bundle into Out, nothing is allocated. Returns 0 if it does not fit.
+	size_t EncodeOscBundle(std::span<char> Out, const Frame& Frame, const OscAddressMapping& Mapping);
+}
@@ -0,0 +1,249 @@
+#include "facepipe_pose.h"
+
+#include <algorithm>
+#include <cmath>
+
+namespace FacePipe
+{
+	static const float SmallestThreeRange = 0.70710678f; // 1/sqrt(2), no component but the largest can be bigger
+	static const uint32_t SmallestThreeMax = 1023;
+
+	static void Normalize(float Rotation[4])
+	{
+		const float LengthSquared = Rotation[0] * Rotation[0] + Rotation[1] * Rotation[1] + Rotation[2] * Rotation[2] + Rotation[3] * Rotation[3];
+		if (!(LengthSquared > 0.0f) || !std::isfinite(LengthSquared))
+		{
+			Rotation[0] = Rotation[1] = Rotation[2] = 0.0f;
+			Rotation[3] = 1.0f;
+			return;
+		}
+
+		const float InverseLength = 1.0f / std::sqrt(LengthSquared);
+		for (int i = 0; i < 4; ++i)
+			Rotation[i] *= InverseLength;
+	}
+
+	bool DecomposeMatrix(std::span<const float> Matrix, Pose& OutPose)
+	{
+		if (Matrix.size() != 16)
+			return false;
+
+		auto M = [&](int Row, int Column) { return Matrix[Row * 4 + Column]; };
+
+		const float Determinant =
+			M(0, 0) * (M(1, 1) * M(2, 2) - M(1, 2) * M(2, 1)) -
+			M(0, 1) * (M(1, 0) * M(2, 2) - M(1, 2) * M(2, 0)) +
+			M(0, 2) * (M(1, 0) * M(2, 1) - M(1, 1) * M(2, 0));
+
+		// A mirroring (negative determinant) has no quaternion
+		if (!(Determinant > 1e-12f) || !std::isfinite(Determinant))
+			return false;
+
+		// Root mean square length of the axes, exact for uniform scale and cheaper than the cube root of the determinant
+		const float AxisLengthsSquared =
+			M(0, 0) * M(0, 0) + M(1, 0) * M(1, 0) + M(2, 0) * M(2, 0) +
+			M(0, 1) * M(0, 1) + M(1, 1) * M(1, 1) + M(2, 1) * M(2, 1) +
+			M(0, 2) * M(0, 2) + M(1, 2) * M(1, 2) + M(2, 2) * M(2, 2);
+		const float Scale = std::sqrt(AxisLengthsSquared * (1.0f / 3.0f));
+		const float InverseScale = 1.0f / Scale;
+		auto R = [&](int Row, int Column) { return M(Row, Column) * InverseScale; };
+
+		// Shepperd's method, branching on the largest diagonal term keeps the dominant component away from zero. Every
+		// branch is scaled by 4 * that component, which the normalization below removes again, so no square root is needed.
+		float* Q = OutPose.Rotation;
+		const float Trace = R(0, 0) + R(1, 1) + R(2, 2);
+		if (Trace > 0.0f)
+		{
+			Q[0] = R(2, 1) - R(1, 2);
+			Q[1] = R(0, 2) - R(2, 0);
+			Q[2] = R(1, 0) - R(0, 1);
+			Q[3] = 1.0f + Trace;
+		}
+		else if (R(0, 0) > R(1, 1) && R(0, 0) > R(2, 2))
+		{
+			Q[0] = 1.0f + R(0, 0) - R(1, 1) - R(2, 2);
+			Q[1] = R(0, 1) + R(1, 0);
+			Q[2] = R(0, 2) + R(2, 0);
+			Q[3] = R(2, 1) - R(1, 2);
+		}
+		else if (R(1, 1) > R(2, 2))
+		{
+			Q[0] = R(0, 1) + R(1, 0);
+			Q[1] = 1.0f + R(1, 1) - R(0, 0) - R(2, 2);
+			Q[2] = R(1, 2) + R(2, 1);
+			Q[3] = R(0, 2) - R(2, 0);
+		}
+		else
+		{
+			Q[0] = R(0, 2) + R(2, 0);
+			Q[1] = R(1, 2) + R(2, 1);
+			Q[2] = 1.0f + R(2, 2) - R(0, 0) - R(1, 1);
+			Q[3] = R(1, 0) - R(0, 1);
+		}
+		Normalize(Q);
+
+		OutPose.Translation[0] = M(0, 3);
+		OutPose.Translation[1] = M(1, 3);
+		OutPose.Translation[2] = M(2, 3);
+		OutPose.Scale = Scale;
+		return true;
+	}
+
+	void ComposeMatrix(const Pose& Pose, float OutMatrix[16])
+	{
+		const float X = Pose.Rotation[0], Y = Pose.Rotation[1], Z = Pose.Rotation[2], W = Pose.Rotation[3];
+		const float S = Pose.Scale;
+
+		OutMatrix[0] = S * (1.0f - 2.0f * (Y * Y + Z * Z));
+		OutMatrix[1] = S * 2.0f * (X * Y - Z * W);
+		OutMatrix[2] = S * 2.0f * (X * Z + Y * W);
+		OutMatrix[3] = Pose.Translation[0];
+
+		OutMatrix[4] = S * 2.0f * (X * Y + Z * W);
+		OutMatrix[5] = S * (1.0f - 2.0f * (X * X + Z * Z));
+		OutMatrix[6] = S * 2.0f * (Y * Z - X * W);
+		OutMatrix[7] = Pose.Translation[1];
+
+		OutMatrix[8] = S * 2.0f * (X * Z - Y * W);
+		OutMatrix[9] = S * 2.0f * (Y * Z + X * W);
+		OutMatrix[10] = S * (1.0f - 2.0f * (X * X + Y * Y));
+		OutMatrix[11] = Pose.Translation[2];
+
+		OutMatrix[12] = 0.0f;
+		OutMatrix[13] = 0.0f;
+		OutMatrix[14] = 0.0f;
+		OutMatrix[15] = 1.0f;
+	}
+
+	uint32_t PackRotation(const float InRotation[4])
+	{
+		// NaN would reach the integer conversion through std::clamp, it is packed as a zero component
+		float Rotation[4];
+		for (uint32_t i = 0; i < 4; ++i)
+			Rotation[i] = std::isnan(InRotation[i]) ? 0.0f : InRotation[i];
+
+		uint32_t Largest = 0;
+		for (uint32_t i = 1; i < 4; ++i)
+		{
+			if (std::fabs(Rotation[i]) > std::fabs(Rotation[Largest]))
+				Largest = i;
+		}
+
+		const float Sign = (Rotation[Largest] < 0.0f) ? -1.0f : 1.0f;
+
+		uint32_t Packed = Largest << 30;
+		uint32_t Shift = 20;
+		for (uint32_t i = 0; i < 4; ++i)
+		{
+			if (i == Largest)
+				continue;
+
+			const float Normalized = Sign * Rotation[i] * (0.5f / SmallestThreeRange) + 0.5f;
+			const float Q = std::clamp(Normalized * (float) SmallestThreeMax + 0.5f, 0.0f, (float) SmallestThreeMax);
+			Packed |= uint32_t(Q) << Shift;
+			Shift -= 10;
+		}
+
+		return Packed;
+	}
+
+	void UnpackRotation(uint32_t Packed, float OutRotation[4])
+	{
+		const uint32_t Largest = Packed >> 30;
+
+		float SumSquared = 0.0f;
+		uint32_t Shift = 20;
+		for (uint32_t i = 0; i < 4; ++i)
+		{
+			if (i == Largest)
+				continue;
+
+			const float Normalized = (float) ((Packed >> Shift) & SmallestThreeMax) / (float) SmallestThreeMax;
+			OutRotation[i] = (Normalized * 2.0f - 1.0f) * SmallestThreeRange;
+			SumSquared += OutRotation[i] * OutRotation[i];
+			Shift -= 10;
+		}
+
+		OutRotation[Largest] = std::sqrt(std::max(1.0f - SumSquared, 0.0f));
+		Normalize(OutRotation);
+	}
+
+	static Pose& FindOrAdd(PoseMap& Poses, std::string_view Name)
+	{
+		auto It = Poses.find(Name);
+		if (It == Poses.end())
+			It = Poses.emplace(std::string(Name), Pose()).first;
+
+		return It->second;
+	}
+
+	bool GetPoses(const std::vector<char>& Message, const MessageInfo& Info, PoseMap& OutPoses)
+	{
+		if (Info.DataType != EFacepipeData::Poses)
+			return false;
+
+		if (Info.DatagramType == EDatagramType::Bytes)
+		{
+			const bool bQuantized = HasFlag(Info.BinaryFlags, EBinaryFlags::Quantized);
+
+			NamedValuesView View;
+			if (!GetNamedValuesView(Message, Info, bQuantized ? 5 : 8, View))
+				return false;
+
+			size_t NameOffset = 0;
+			std::string_view Name;
+			for (size_t i = 0; i < View.Values.size(); i += View.Stride)
+			{
+				if (!View.NextName(NameOffset, Name))
+					return false;
+
+				const float* Values = View.Values.data() + i;
+				Pose& Target = FindOrAdd(OutPoses, Name);
+				if (bQuantized)
+				{
+					uint32_t Packed;
+					std::memcpy(&Packed, Values, sizeof(Packed));
+					UnpackRotation(Packed, Target.Rotation);
+					Values += 1;
+				}
+				else
+				{
+					std::memcpy(Target.Rotation, Values, sizeof(Target.Rotation));
+					Normalize(Target.Rotation);
+					Values += 4;
+				}
+				std::memcpy(Target.Translation, Values, sizeof(Target.Translation));
+				Target.Scale = Values[3];
+			}
+
+			return true;
+		}
+
+		// pose|face=qx,qy,qz,qw,tx,ty,tz[,scale]|...
+		VectorView PoseView(Info.ContentView.b);
+		while (PoseView.NextSubstring(Message, '|', Info.ContentView.e))
+		{
+			VectorView TupleView(PoseView.b);
+			if (!TupleView.NextSubstring(Message, '=', PoseView.e))
+				return false;
+
+			std::string_view Name = TupleView.StringView(Message);
+
+			float Values[8] = { 0.0f, 0.0f, 0.0f, 1.0f, 0.0f, 0.0f, 0.0f, 1.0f };
+			if (!TupleView.NextSubstring(Message, '=', PoseView.e))
+				return false;
+
+			const size_t Count = TupleView.ParseArray(Message, Values, 8);
+			if (Count != 7 && Count != 8)
+				return false;
+
+			Pose& Target = FindOrAdd(OutPoses, Name);
+			std::memcpy(Target.Rotation, Values, sizeof(Target.Rotation));
+			Normalize(Target.Rotation);
+			std::memcpy(Target.Translation, Values + 4, sizeof(Target.Translation));
+			Target.Scale = Values[7];
+		}
+
+		return true;
+	}
+}
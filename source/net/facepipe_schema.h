@@ -0,0 +1,229 @@
+#pragma once
+
+#include "facepipe_writer.h"
+
+#include <array>
+#include <tuple>
+#include <utility>
+#include <type_traits>
+
+/*
+* Schemas declare a payload once as a struct, its encoder and decoder for ASCII and binary datagrams are generated
+* from the member list at compile time and inlined where they are used:
+*
+*	struct GazeData
+*	{
+*		float Left[3] = {};
+*		float Right[3] = {};
+*		float Confidence = 0.0f;
+*
+*		static constexpr EFacepipeData DataType = EFacepipeData::Gaze;
+*		static constexpr std::string_view Token = "gaze";
+*		static constexpr auto Fields() { return std::make_tuple(&GazeData::Left, &GazeData::Right, &GazeData::Confidence); }
+*	};
+*
+*	ASCII:	gaze|0.1,0.2,-0.97|0.1,0.2,-0.97|0.9	one field per '|' in the order of Fields(), arrays comma separated
+*	Bytes:	f32 Left[3] | f32 Right[3] | f32 Confidence	fields in the order of Fields(), every field type is 4 bytes so nothing is padded
+*
+* Fields are float or int32_t, or fixed size arrays of them. Schemas are collected in a SchemaSet (see facepipe_custom.h),
+* which holds the latest value of every schema and decodes through a table indexed by data type. ToDataType and ToToken
+* know the tokens of the set, so ParseHeader accepts the datagrams without further code.
+*/
+
+namespace FacePipe
+{
+	namespace SchemaDetail
+	{
+		template<typename T>
+		struct FieldTraits
+		{
+			using Element = T;
+			static constexpr size_t Count = 1;
+		};
+
+		template<typename T, size_t N>
+		struct FieldTraits<T[N]>
+		{
+			using Element = T;
+			static constexpr size_t Count = N;
+		};
+
+		template<typename Pointer>
+		struct MemberType;
+
+		template<typename Schema, typename T>
+		struct MemberType<T Schema::*>
+		{
+			using Type = T;
+		};
+
+		template<typename Schema>
+		constexpr size_t BinarySize()
+		{
+			return std::apply([](auto... Members) { return (sizeof(typename MemberType<decltype(Members)>::Type) + ... + 0); }, Schema::Fields());
+		}
+
+		template<typename T>
+		void PutAscii(DatagramWriter& Writer, const T& Field, int Precision)
+		{
+			using Traits = FieldTraits<T>;
+			static_assert(std::is_same<typename Traits::Element, float>() || std::is_same<typename Traits::Element, int32_t>(), "Schema fields are float or int32_t, or arrays of them");
+
+			if constexpr (std::is_array<T>())
+			{
+				for (size_t i = 0; i < Traits::Count; ++i)
+				{
+					if (i > 0)
+						Writer.Put(',');
+					Writer.PutNumber(Field[i], Precision);
+				}
+			}
+			else
+			{
+				Writer.PutNumber(Field, Precision);
+			}
+		}
+
+		template<typename T>
+		bool ParseAscii(const std::vector<char>& Message, VectorView FieldView, T& OutField)
+		{
+			if constexpr (std::is_array<T>())
+			{
+				return FieldView.ParseArray(Message, OutField, FieldTraits<T>::Count) == FieldTraits<T>::Count;
+			}
+			else
+			{
+				if (FieldView.b == FieldView.e)
+					return false;
+				OutField = FieldView.ParseValue<T>(Message);
+				return true;
+			}
+		}
+	}
+
+	// Encoder of every schema, Info.DatagramType selects ASCII or Bytes just like for the encoders of facepipe_encode.h
+	template<typename Schema>
+	size_t EncodeSchema(std::span<char> Out, const MessageInfo& Info, const Schema& Value, const EncodeSettings& Settings = {})
+	{
+		DatagramWriter Writer(Out);
+		WriteHeader(Writer, Info, Schema::DataType, 0);
+
+		if (Info.DatagramType == EDatagramType::Bytes)
+		{
+			std::apply([&](auto... Members) { (Writer.PutBinary(Value.*Members), ...); }, Schema::Fields());
+			return Writer.Size();
+		}
+
+		bool bFirst = true;
+		auto WriteField = [&](const auto& Field)
+		{
+			if (!bFirst)
+				Writer.Put('|');
+			bFirst = false;
+
+			SchemaDetail::PutAscii(Writer, Field, Settings.Precision);
+		};
+		std::apply([&](auto... Members) { (WriteField(Value.*Members), ...); }, Schema::Fields());
+
+		return Writer.Size();
+	}
+
+	// Decoder of every schema, OutValue is only partially written if it fails
+	template<typename Schema>
+	bool GetSchema(const std::vector<char>& Message, const MessageInfo& Info, Schema& OutValue)
+	{
+		if (Info.DataType != Schema::DataType || Info.ContentView.e > Message.size() || Info.ContentView.b > Info.ContentView.e)
+			return false;
+
+		if (Info.DatagramType == EDatagramType::Bytes)
+		{
+			if (Info.ContentView.e - Info.ContentView.b < SchemaDetail::BinarySize<Schema>())
+				return false;
+
+			size_t Offset = Info.ContentView.b;
+			auto ReadField = [&](auto& Field)
+			{
+				std::memcpy(&Field, Message.data() + Offset, sizeof(Field));
+				Offset += sizeof(Field);
+			};
+			std::apply([&](auto... Members) { (ReadField(OutValue.*Members), ...); }, Schema::Fields());
+			return true;
+		}
+
+		VectorView FieldView(Info.ContentView.b);
+		auto ReadField = [&](auto& Field)
+		{
+			return FieldView.NextSubstring(Message, '|', Info.ContentView.e) && SchemaDetail::ParseAscii(Message, FieldView, Field);
+		};
+		return std::apply([&](auto... Members) { return (ReadField(OutValue.*Members) && ...); }, Schema::Fields());
+	}
+
+	// Latest value of each of Schemas, e.g. SchemaSet<GazeData> Custom; Custom.Update(Message, Info); Custom.Get<GazeData>()
+	template<typename... Schemas>
+	class SchemaSet
+	{
+	public:
+		static_assert(sizeof...(Schemas) <= 32, "ReceivedMask has a bit per schema");
+
+		struct TokenEntry
+		{
+			std::string_view Token;
+			EFacepipeData DataType = EFacepipeData::INVALID;
+		};
+
+		static constexpr std::array<TokenEntry, sizeof...(Schemas)> Tokens = { TokenEntry{ Schemas::Token, Schemas::DataType }... };
+
+		static constexpr bool Contains(EFacepipeData DataType) { return ((DataType == Schemas::DataType) || ...); }
+
+		// Decodes Message into the schema of Info.DataType, false if it is not one of Schemas or does not decode
+		bool Update(const std::vector<char>& Message, const MessageInfo& Info)
+		{
+			const Decoder Decode = Decoders[(uint8_t) Info.DataType];
+			return Decode && Decode(Message, Info, *this);
+		}
+
+		template<typename Schema>
+		const Schema& Get() const { return std::get<Schema>(Values); }
+
+		// True once a value of Schema was decoded
+		template<typename Schema>
+		bool Has() const { return ReceivedMask & (1u << IndexOf<Schema>()); }
+
+	protected:
+		using Decoder = bool (*)(const std::vector<char>&, const MessageInfo&, SchemaSet&);
+
+		template<typename Schema>
+		static constexpr size_t IndexOf()
+		{
+			size_t Index = 0;
+			const bool bFound = ((std::is_same<Schema, Schemas>() ? true : (++Index, false)) || ...);
+			return bFound ? Index : sizeof...(Schemas);
+		}
+
+		template<typename Schema>
+		static bool Decode(const std::vector<char>& Message, const MessageInfo& Info, SchemaSet& Set)
+		{
+			if (!GetSchema(Message, Info, std::get<Schema>(Set.Values)))
+				return false;
+
+			Set.ReceivedMask |= 1u << IndexOf<Schema>();
+			return true;
+		}
+
+		// Indexed by data type, filled in at compile time so dispatch is a single load instead of comparing every schema
+		static constexpr std::array<Decoder, 256> BuildDecoders()
+		{
+			std::array<Decoder, 256> Result = {};
+			((Result[(uint8_t) Schemas::DataType] = &SchemaSet::Decode<Schemas>), ...);
+			return Result;
+		}
+
+		static const std::array<Decoder, 256> Decoders;
+
+		std::tuple<Schemas...> Values;
+		uint32_t ReceivedMask = 0;
+	};
+
+	template<typename... Schemas>
+	constexpr std::array<typename SchemaSet<Schemas...>::Decoder, 256> SchemaSet<Schemas...>::Decoders = SchemaSet<Schemas...>::BuildDecoders();
+}
@@ -0,0 +1,66 @@
+#pragma once
+
+#include "facepipe.h"
+
+/*
+* Sources can number their datagrams per stream - one stream per (source, scene, camera, subject, data type).
+* The receiver keeps the highest sequence seen per stream and a 64 entry window below it:
+*
+*	newer than highest		accepted, skipped numbers are counted as lost
+*	inside the window		dropped, either a duplicate or a late datagram (which is then no longer lost)
+*	restarted				accepted, the stream starts over without counting anything as lost
+*
+* The source restarted its counter when the number is far from the highest in either direction (RestartDistance)
+* or when the sender time disagrees with the number: a lower number with a newer time, or a time more than
+* RestartTimeGap behind the highest (the clock of the source started over as well). Sources without a time
+* (always 0) are only recognized by the distance.
+*
+* Datagrams without a sequence number are always accepted.
+*/
+
+namespace FacePipe
+{
+	struct SequenceStats
+	{
+		uint64_t Received = 0;		// datagrams with a sequence number
+		uint64_t Lost = 0;			// skipped sequence numbers that never arrived (yet)
+		uint64_t Reordered = 0;		// arrived after a newer datagram and was dropped
+		uint64_t Duplicates = 0;	// dropped
+		uint64_t Restarts = 0;		// the source started counting from scratch
+
+		void Add(const SequenceStats& Other);
+	};
+
+	class SequenceTracker
+	{
+	public:
+		static const uint32_t RestartDistance = 1024; // datagrams this far behind or ahead are treated as a restarted source, also caps the loss one datagram can add
+		static constexpr double RestartTimeGap = 1.0; // seconds the sender time may go back before the source counts as restarted
+
+		// Returns false if the datagram is stale or a duplicate and should be discarded
+		bool Accept(const MessageInfo& Info);
+
+		// Same as above, OutLostChange is how much the datagram changed the lost count of its stream (see facepipe_feedback.h)
+		bool Accept(const MessageInfo& Info, int64_t& OutLostChange);
+
+		// Sums all streams
+		SequenceStats GetTotals() const;
+
+		void Clear() { Streams.clear(); }
+
+	protected:
+		struct Stream
+		{
+			SubjectKey Key;
+			EFacepipeData DataType = EFacepipeData::INVALID;
+			uint32_t Highest = 0;
+			double HighestTime = 0.0; // sender time of Highest
+			uint64_t Window = 0; // bit i set if Highest - i has been received
+			SequenceStats Stats;
+		};
+
+		Stream& FindOrAdd(const MessageInfo& Info, bool& bOutAdded);
+
+		std::vector<Stream> Streams;
+	};
+}
@@ -0,0 +1,263 @@
+#include "facepipe_simd.h"
+
+#include <bit>
+#include <charconv>
+#include <cstring>
+
+#if FACEPIPE_SIMD_AVX2
+	#include <immintrin.h>
+#elif FACEPIPE_SIMD_SSE2
+	#include <emmintrin.h>
+#endif
+
+namespace FacePipe
+{
+#if FACEPIPE_SIMD_AVX2
+	static const size_t DelimiterBlockSize = 32;
+
+	inline uint32_t DelimiterMask(const char* Block, char Delimiter) noexcept
+	{
+		__m256i Bytes = _mm256_loadu_si256((const __m256i*) Block);
+		return (uint32_t) _mm256_movemask_epi8(_mm256_cmpeq_epi8(Bytes, _mm256_set1_epi8(Delimiter)));
+	}
+#elif FACEPIPE_SIMD_SSE2
+	static const size_t DelimiterBlockSize = 32;
+
+	inline uint32_t DelimiterMask(const char* Block, char Delimiter) noexcept
+	{
+		__m128i Match = _mm_set1_epi8(Delimiter);
+		uint32_t Low = (uint32_t) _mm_movemask_epi8(_mm_cmpeq_epi8(_mm_loadu_si128((const __m128i*) Block), Match));
+		uint32_t High = (uint32_t) _mm_movemask_epi8(_mm_cmpeq_epi8(_mm_loadu_si128((const __m128i*) (Block + 16)), Match));
+		return Low | (High << 16);
+	}
+#endif
+
+	const char* FindDelimiter(const char* First, const char* Last, char Delimiter) noexcept
+	{
+#if FACEPIPE_SIMD_AVX2 || FACEPIPE_SIMD_SSE2
+		for (; size_t(Last - First) >= DelimiterBlockSize; First += DelimiterBlockSize)
+		{
+			if (uint32_t Mask = DelimiterMask(First, Delimiter))
+				return First + std::countr_zero(Mask);
+		}
+#endif
+
+		for (; First < Last; ++First)
+		{
+			if (*First == Delimiter)
+				return First;
+		}
+
+		return Last;
+	}
+
+	// https://lemire.me/blog/2022/01/21/swar-explained-parsing-eight-digits/
+	inline bool IsEightDigits(uint64_t Chars) noexcept
+	{
+		return ((Chars & 0xF0F0F0F0F0F0F0F0) | (((Chars + 0x0606060606060606) & 0xF0F0F0F0F0F0F0F0) >> 4)) == 0x3333333333333333;
+	}
+
+	inline uint32_t ParseEightDigits(uint64_t Chars) noexcept
+	{
+		Chars = (Chars & 0x0F0F0F0F0F0F0F0F) * 2561 >> 8;
+		Chars = (Chars & 0x00FF00FF00FF00FF) * 6553601 >> 16;
+		return (uint32_t) ((Chars & 0x0000FFFF0000FFFF) * 42949672960001 >> 32);
+	}
+
+	// Exactly representable powers of ten in a double
+	static const double Pow10[] = {
+		1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+		1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22
+	};
+
+	// Only mantissas up to 2^53 with exponents up to 22 are handled here, then the mantissa and the power of ten are exact
+	// doubles and the division is correctly rounded (Clinger's fast path). Narrowing that double to float rounds a second
+	// time, which only differs from rounding the decimal directly when the double is exactly halfway between two floats.
+	inline bool ParseDecimalFast(const char* p, const char* Last, float& OutValue) noexcept
+	{
+		static const uint64_t MaxMantissa = uint64_t(1) << 53;
+		static const uint64_t MaxBeforeDigit = (MaxMantissa - 9) / 10;			// one more digit stays within MaxMantissa
+		static const uint64_t MaxBeforeEightDigits = (MaxMantissa - 99999999) / 100000000;
+
+		bool bNegative = (p < Last && *p == '-');
+		if (bNegative || (p < Last && *p == '+'))
+			++p;
+
+		const char* DigitsBegin = p;
+		uint64_t Mantissa = 0;
+		int Exponent = 0;
+
+		for (; p < Last && unsigned(*p - '0') < 10; ++p)
+		{
+			if (Mantissa > MaxBeforeDigit)
+				return false;
+
+			Mantissa = Mantissa * 10 + unsigned(*p - '0');
+		}
+
+		if (p < Last && *p == '.')
+		{
+			++p;
+
+			uint64_t Chars = 0;
+			while (Last - p >= 8 && Mantissa <= MaxBeforeEightDigits && (std::memcpy(&Chars, p, 8), IsEightDigits(Chars)))
+			{
+				Mantissa = Mantissa * 100000000 + ParseEightDigits(Chars);
+				Exponent -= 8;
+				p += 8;
+			}
+
+			for (; p < Last && unsigned(*p - '0') < 10; ++p)
+			{
+				if (Mantissa > MaxBeforeDigit)
+					return false;
+
+				Mantissa = Mantissa * 10 + unsigned(*p - '0');
+				--Exponent;
+			}
+		}
+
+		// Exponents and any other trailing characters go through the slow path
+		if (p != Last || p == DigitsBegin || Exponent < -22)
+			return false;
+
+		const double Value = (double) Mantissa / Pow10[-Exponent];
+
+		// Halfway between two floats the low 29 of the 52 mantissa bits are exactly 1 followed by zeros. The values are
+		// at least 1e-22 and at most 2^53, always normal floats, so the float rounding bit is always at the same place.
+		const uint64_t Bits = std::bit_cast<uint64_t>(Value);
+		if ((Bits & 0x1FFFFFFF) == 0x10000000)
+			return false;
+
+		OutValue = (float) (bNegative ? -Value : Value);
+		return true;
+	}
+
+	float ParseFloatToken(const char* First, const char* Last) noexcept
+	{
+		float Value = 0.0f;
+		if (ParseDecimalFast(First, Last, Value))
+			return Value;
+
+		if (First < Last && *First == '+') // strtod accepted a leading plus, from_chars does not
+			++First;
+
+		std::from_chars_result Result = std::from_chars(First, Last, Value);
+		return (Result.ec != std::errc() || Result.ptr != Last) ? 0.0f : Value;
+	}
+
+	void ParseFloatList(const char* First, const char* Last, std::vector<float>& OutValues)
+	{
+		OutValues.clear();
+
+		// Same tokens as VectorView::ParseArray, which skips an empty first and an empty last token ("1,2," is 1,2)
+		if (First < Last && *First == ',')
+			++First;
+
+		if (First >= Last)
+			return;
+
+		const char* TokenBegin = First;
+		const char* p = First;
+
+#if FACEPIPE_SIMD_AVX2 || FACEPIPE_SIMD_SSE2
+		for (; size_t(Last - p) >= DelimiterBlockSize; p += DelimiterBlockSize)
+		{
+			uint32_t Mask = DelimiterMask(p, ',');
+			while (Mask)
+			{
+				const char* Delimiter = p + std::countr_zero(Mask);
+				OutValues.push_back(ParseFloatToken(TokenBegin, Delimiter));
+				TokenBegin = Delimiter + 1;
+				Mask &= Mask - 1;
+			}
+		}
+#endif
+
+		for (; p < Last; ++p)
+		{
+			if (*p == ',')
+			{
+				OutValues.push_back(ParseFloatToken(TokenBegin, p));
+				TokenBegin = p + 1;
+			}
+		}
+
+		if (TokenBegin < Last)
+			OutValues.push_back(ParseFloatToken(TokenBegin, Last));
+	}
+
+	void DequantizeLandmarks(const uint16_t* Values, size_t Count, size_t Components, const float Scale[3], const float Offset[3], float* OutValues) noexcept
+	{
+		size_t i = 0;
+
+#if FACEPIPE_SIMD_AVX2 || FACEPIPE_SIMD_SSE2
+		// 12 values is a whole number of both 2 and 3 component landmarks, so three vectors cover every phase of x,y,z
+		alignas(16) float BlockScale[12];
+		alignas(16) float BlockOffset[12];
+		for (size_t j = 0; j < 12; ++j)
+		{
+			BlockScale[j] = Scale[j % Components];
+			BlockOffset[j] = Offset[j % Components];
+		}
+
+		const __m128 Scale0 = _mm_load_ps(BlockScale), Scale1 = _mm_load_ps(BlockScale + 4), Scale2 = _mm_load_ps(BlockScale + 8);
+		const __m128 Offset0 = _mm_load_ps(BlockOffset), Offset1 = _mm_load_ps(BlockOffset + 4), Offset2 = _mm_load_ps(BlockOffset + 8);
+		const __m128i Zero = _mm_setzero_si128();
+
+		for (; i + 12 <= Count; i += 12)
+		{
+			__m128i Low = _mm_loadu_si128((const __m128i*) (Values + i));		// values 0-7
+			__m128i High = _mm_loadl_epi64((const __m128i*) (Values + i + 8));	// values 8-11
+
+			__m128 V0 = _mm_cvtepi32_ps(_mm_unpacklo_epi16(Low, Zero));
+			__m128 V1 = _mm_cvtepi32_ps(_mm_unpackhi_epi16(Low, Zero));
+			__m128 V2 = _mm_cvtepi32_ps(_mm_unpacklo_epi16(High, Zero));
+
+			_mm_storeu_ps(OutValues + i, _mm_add_ps(_mm_mul_ps(V0, Scale0), Offset0));
+			_mm_storeu_ps(OutValues + i + 4, _mm_add_ps(_mm_mul_ps(V1, Scale1), Offset1));
+			_mm_storeu_ps(OutValues + i + 8, _mm_add_ps(_mm_mul_ps(V2, Scale2), Offset2));
+		}
+#endif
+
+		for (; i < Count; ++i)
+		{
+			size_t Component = i % Components;
+			OutValues[i] = (float) Values[i] * Scale[Component] + Offset[Component];
+		}
+	}
+
+	void ReconstructFromBasis(const float* Mean, const float* Basis, const float* Coefficients, size_t ComponentCount, size_t Count, float* OutValues) noexcept
+	{
+		size_t j = 0;
+
+		// Each block of outputs stays in a register while the rows are added, mul + add (no FMA) so all paths round the same
+#if FACEPIPE_SIMD_AVX2
+		for (; j + 8 <= Count; j += 8)
+		{
+			__m256 Sum = _mm256_loadu_ps(Mean + j);
+			for (size_t k = 0; k < ComponentCount; ++k)
+				Sum = _mm256_add_ps(Sum, _mm256_mul_ps(_mm256_set1_ps(Coefficients[k]), _mm256_loadu_ps(Basis + k * Count + j)));
+			_mm256_storeu_ps(OutValues + j, Sum);
+		}
+#endif
+
+#if FACEPIPE_SIMD_AVX2 || FACEPIPE_SIMD_SSE2
+		for (; j + 4 <= Count; j += 4)
+		{
+			__m128 Sum = _mm_loadu_ps(Mean + j);
+			for (size_t k = 0; k < ComponentCount; ++k)
+				Sum = _mm_add_ps(Sum, _mm_mul_ps(_mm_set1_ps(Coefficients[k]), _mm_loadu_ps(Basis + k * Count + j)));
+			_mm_storeu_ps(OutValues + j, Sum);
+		}
+#endif
+
+		for (; j < Count; ++j)
+		{
+			float Sum = Mean[j];
+			for (size_t k = 0; k < ComponentCount; ++k)
+				Sum += Coefficients[k] * Basis[k * Count + j];
+			OutValues[j] = Sum;
+		}
+	}
+}
@@ -0,0 +1,159 @@
+#pragma once
+
+#include "facepipe_encode.h"
+
+#include <charconv>
+#include <cmath>
+
+/*
+* DatagramWriter is what the encoders of facepipe_encode.cpp write with. It is in a header so that the encoders
+* generated from schemas (see facepipe_schema.h) can be inlined at the call site.
+*/
+
+namespace FacePipe
+{
+	// Appends to a fixed buffer, once anything fails to fit the writer stays failed and Size() returns 0
+	class DatagramWriter
+	{
+	public:
+		DatagramWriter(std::span<char> Out) : Begin(Out.data()), Cursor(Out.data()), End(Out.data() + Out.size()) {}
+
+		size_t Size() const { return bFailed ? 0 : size_t(Cursor - Begin); }
+		size_t Offset() const { return size_t(Cursor - Begin); }
+		void Fail() { bFailed = true; }
+
+		void Put(char C)
+		{
+			if (bFailed || Cursor == End)
+			{
+				bFailed = true;
+				return;
+			}
+			*Cursor++ = C;
+		}
+
+		void Put(const void* Data, size_t Size)
+		{
+			if (bFailed || Size > size_t(End - Cursor))
+			{
+				bFailed = true;
+				return;
+			}
+			if (Size > 0)
+				std::memcpy(Cursor, Data, Size);
+			Cursor += Size;
+		}
+
+		void Put(std::string_view Text) { Put(Text.data(), Text.size()); }
+
+		template<typename T>
+		void PutBinary(const T& Value) { Put(&Value, sizeof(T)); }
+
+		template<typename T>
+		void PutNumber(T Value, int Precision = -1)
+		{
+			if (bFailed)
+				return;
+
+			std::to_chars_result Result;
+			if constexpr (std::is_floating_point<T>())
+			{
+				if (!std::isfinite(Value))
+					Value = T(0); // the parser has no representation for inf/nan
+
+				if (Precision >= 0 && Precision <= MaxFastPrecision && std::fabs(double(Value)) < 1e9)
+				{
+					PutFixed(double(Value), Precision);
+					return;
+				}
+
+				Result = (Precision < 0) ? std::to_chars(Cursor, End, Value) : std::to_chars(Cursor, End, Value, std::chars_format::fixed, Precision);
+			}
+			else
+			{
+				Result = std::to_chars(Cursor, End, Value);
+			}
+
+			if (Result.ec != std::errc())
+			{
+				bFailed = true;
+				return;
+			}
+			Cursor = Result.ptr;
+		}
+
+		// Space for Size bytes that the caller fills in directly, nullptr if it does not fit
+		char* Reserve(size_t Size)
+		{
+			if (bFailed || Size > size_t(End - Cursor))
+			{
+				bFailed = true;
+				return nullptr;
+			}
+			char* Reserved = Cursor;
+			Cursor += Size;
+			return Reserved;
+		}
+
+		void PadTo4()
+		{
+			static const char Zeros[4] = {};
+			Put(Zeros, (4 - Offset() % 4) % 4);
+		}
+
+		// Writes the u8 length prefixed name of the binary named value layouts
+		void PutName(std::string_view Name)
+		{
+			if (Name.size() > UINT8_MAX)
+			{
+				bFailed = true;
+				return;
+			}
+			PutBinary((uint8_t) Name.size());
+			Put(Name);
+		}
+
+	protected:
+		static const int MaxFastPrecision = 8;
+
+		// Fixed precision through integer formatting, floating point to_chars costs ~50ns per value in libstdc++
+		void PutFixed(double Value, int Precision)
+		{
+			static const int64_t Powers[MaxFastPrecision + 1] = { 1, 10, 100, 1000, 10000, 100000, 1000000, 10000000, 100000000 };
+
+			int64_t Scaled = std::llround(Value * (double) Powers[Precision]);
+			if (Scaled < 0)
+			{
+				Put('-');
+				Scaled = -Scaled;
+			}
+
+			PutNumber(Scaled / Powers[Precision]);
+			if (Precision == 0)
+				return;
+
+			char* Digits = Reserve(Precision + 1);
+			if (!Digits)
+				return;
+
+			Digits[0] = '.';
+			int64_t Fraction = Scaled % Powers[Precision];
+			for (int i = Precision; i > 0; --i)
+			{
+				Digits[i] = char('0' + Fraction % 10);
+				Fraction /= 10;
+			}
+		}
+
+		char* Begin = nullptr;
+		char* Cursor = nullptr;
+		char* End = nullptr;
+		bool bFailed = false;
+	};
+
+	// Writes everything up to the content, the ASCII variant ends with "type|"
+	void WriteHeader(DatagramWriter& Writer, const MessageInfo& Info, EFacepipeData DataType, uint16_t Flags);
+
+	// Comma separated
+	void WriteFloatList(DatagramWriter& Writer, std::span<const float> Values, int Precision);
+}
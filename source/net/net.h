@@ -1,4 +1,20 @@
 #pragma once
 
 #include "udp.h"
-#include "facepipe.h"
\ No newline at end of file
+#include "facepipe.h"
+#include "facepipe_custom.h"
+#include "facepipe_delta.h"
+#include "facepipe_dictionary.h"
+#include "facepipe_encode.h"
+#include "facepipe_envelope.h"
+#include "facepipe_feedback.h"
+#include "facepipe_fec.h"
+#include "facepipe_fragment.h"
+#include "facepipe_livelink.h"
+#include "facepipe_mesh.h"
+#include "facepipe_osc.h"
+#include "facepipe_pca.h"
+#include "facepipe_pose.h"
+#include "facepipe_sequence.h"
+#include "facepipe_sparse.h"
+#include "facepipe_view.h"
\ No newline at end of file
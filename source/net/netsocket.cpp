@@ -1,5 +1,7 @@
 #include "netsocket.h"
 
+#if defined(_WIN32)
+
 #include <winsock2.h>
 #include <ws2tcpip.h>
 
@@ -34,3 +36,22 @@ void Net::StopWinsock()
 		WSACleanup();
 	}
 }
+
+#else
+
+// BSD sockets need no startup, the functions only exist so that the application code is the same on every platform
+bool Net::WinsockReady()
+{
+	return true;
+}
+
+int Net::StartWinsock()
+{
+	return 0;
+}
+
+void Net::StopWinsock()
+{
+}
+
+#endif
@@ -1,6 +1,8 @@
 #pragma once
 
 #include <string>
+#include <functional>
+#include <stdint.h>
 
 namespace Net
 {
@@ -25,4 +27,7 @@ public:
 	std::string ip = Net::LocalHost;
 	int port = 0;
 	int id = 0; // set by internals
+
+	// Identifies the sender of received datagrams in lookup tables
+	uint64_t Key() const { return (uint64_t(std::hash<std::string>{}(ip)) << 16) ^ uint64_t(port); }
 };
@@ -1,5 +1,7 @@
 #include "udp.h"
 
+#if defined(_WIN32)
+
 #include <winsock2.h>
 #include <ws2tcpip.h>
 #include <format>
@@ -28,7 +30,7 @@ bool to_netsocket(const sockaddr_in& addr, NetAddressIP4& info)
 	if (inet_ntop(AF_INET, &(addr.sin_addr), from_ip, INET_ADDRSTRLEN))
 	{
 		info.ip = from_ip;
-		info.port = addr.sin_port;
+		info.port = ntohs(addr.sin_port);
 		return true;
 	}
 	else
@@ -129,9 +131,9 @@ void UDPSocket::Close()
 	}
 }
 
-bool UDPSocket::Send(const std::string& message, const NetAddressIP4& target)
+bool UDPSocket::Send(std::span<const char> packet, const NetAddressIP4& target)
 {
-	//if (message.length() >= 512)
+	//if (packet.size() >= 512)
 	//{
 	//	// UDP can be up to 65507 bytes but is limited by the Maximum Transmission Unit (1500 bytes or less).
 	//	// For portability it is recommended to send < 500 bytes at a time.
@@ -139,7 +141,7 @@ bool UDPSocket::Send(const std::string& message, const NetAddressIP4& target)
 	//}
 
 	sockaddr_in sock_addr;
-	if (to_net_addr(sock_addr, target) && sendto((SOCKET)ossocket, message.c_str(), (int) message.length(), 0, (SOCKADDR*)&sock_addr, sizeof(sockaddr_in)) == SOCKET_ERROR) 
+	if (to_net_addr(sock_addr, target) && sendto((SOCKET)ossocket, packet.data(), (int)packet.size(), 0, (SOCKADDR*)&sock_addr, sizeof(sockaddr_in)) == SOCKET_ERROR)
 	{
 		UDPLog("Failed to Send() message over UDP socket [{}:{}]\n", ip, port);
 		return false;
@@ -148,18 +150,44 @@ bool UDPSocket::Send(const std::string& message, const NetAddressIP4& target)
 	return true;
 }
 
-bool UDPSocket::Send(const UDPDatagram& datagram, const NetAddressIP4& target)
+bool UDPSocket::Resolve(const NetAddressIP4& address, UDPTarget& outTarget)
 {
-	sockaddr_in sock_addr;
-	if (to_net_addr(sock_addr, target) && sendto((SOCKET)ossocket, datagram.message.data(), (int)datagram.message.size(), 0, (SOCKADDR*)&sock_addr, sizeof(sockaddr_in)) == SOCKET_ERROR)
-	{
-		UDPLog("Failed to Send() message over UDP socket [{}:{}]\n", ip, port);
+	outTarget = UDPTarget();
+
+	sockaddr_in addr;
+	if (!to_net_addr(addr, address) || addr.sin_port == 0)
 		return false;
-	}
 
+	outTarget.address = addr.sin_addr.s_addr;
+	outTarget.port = addr.sin_port;
 	return true;
 }
 
+// Winsock has no sendmmsg(), the queue still saves resolving the targets for every packet
+bool UDPSocket::Flush()
+{
+	bool bSentAll = sendQueue.empty() || ossocket != nullptr;
+	if (ossocket)
+	{
+		for (const QueuedPacket& queued : sendQueue)
+		{
+			sockaddr_in sock_addr{};
+			sock_addr.sin_family = AF_INET;
+			sock_addr.sin_addr.s_addr = queued.target.address;
+			sock_addr.sin_port = queued.target.port;
+			if (sendto((SOCKET)ossocket, sendQueueBytes.data() + queued.offset, (int)queued.size, 0, (SOCKADDR*)&sock_addr, sizeof(sockaddr_in)) == SOCKET_ERROR)
+			{
+				UDPLog("Failed to Flush() packet over UDP socket [{}:{}]\n", ip, port);
+				bSentAll = false;
+			}
+		}
+	}
+
+	sendQueue.clear();
+	sendQueueBytes.clear();
+	return bSentAll;
+}
+
 bool is_socket_valid(SOCKET sock) 
 {
 	char optval;
@@ -178,8 +206,11 @@ bool is_socket_valid(SOCKET sock)
 
 bool UDPSocket::Receive(std::vector<UDPDatagram>& datagrams)
 {
-	static const int bufferLength = 65535; // 16 bit max value, max theoretical size for a UDP datagram is 65507
-	static char buffer[bufferLength]; // Buffer to hold received data
+	if (receiveBuffer.size() < ReceiveSlotSize)
+		receiveBuffer.resize(ReceiveSlotSize);
+
+	char* buffer = receiveBuffer.data();
+	const int bufferLength = (int) ReceiveSlotSize;
 
 	bool bReceivedAnyDatagram = false;
 	int bytes_received = 0;
@@ -239,3 +270,5 @@ std::string UDPSocket::ToString() const
 		return std::format("{}:{}", ip, port);
 	}
 }
+
+#endif
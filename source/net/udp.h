@@ -1,23 +1,55 @@
 #pragma once
 
 #include <functional>
+#include <chrono>
 #include "netsocket.h"
 #include "facepipe.h"
+#include "facepipe_fragment.h"
+#include "facepipe_fec.h"
 
 struct UDPDatagram
 {
 	NetAddressIP4 source;
 	std::vector<char> message;
 	FacePipe::MessageInfo metaData; // empty until parsed
+	std::chrono::steady_clock::time_point received; // when the receive thread handed it to the main thread
 };
 
+// Address resolved once by UDPSocket::Resolve, queued sends to it skip inet_pton
+struct UDPTarget
+{
+	uint32_t address = 0;	// IPv4 in network byte order
+	uint16_t port = 0;		// network byte order, 0 if the address did not resolve
+
+	bool IsValid() const { return port != 0; }
+};
+
+// Winsock on Windows (udp.cpp), BSD sockets elsewhere (udp_posix.cpp)
 class UDPSocket : public NetAddressIP4
 {
 protected:
 	void* ossocket = nullptr;
+	uint32_t nextMessageId = 0;
+	std::vector<char> receiveBuffer; // per socket so that sockets can receive on different threads, see ReceiveBatchSize
+	std::vector<char> fragmentBuffer;
+	std::vector<char> parityPacket;
+	std::vector<char> parityBuffer;
+
+	// Packets of Queue*() back to back in sendQueueBytes until Flush()
+	struct QueuedPacket
+	{
+		size_t offset = 0;
+		size_t size = 0;
+		UDPTarget target;
+	};
+	std::vector<char> sendQueueBytes;
+	std::vector<QueuedPacket> sendQueue;
 
 public:
 	static std::function<void(const char*)> Logger;
+	static const size_t ReceiveSlotSize = 65536;	// largest UDP datagram (65507) rounded up
+	static const size_t ReceiveBatchSize = 32;		// datagrams per recvmmsg() call on Linux, Winsock receives one at a time
+	static const size_t SendBatchSize = 64;			// queued packets per sendmmsg() call on Linux, Winsock sends one at a time
 	double bReceivedDataLastCall = false; // UI status hack
 
 	UDPSocket(const char* socketIP = Net::LocalHost, int socketPort = 0)
@@ -39,8 +71,26 @@ public:
 	bool Start();
 	void Close();
 
-	bool Send(const std::string& message, const NetAddressIP4& target);
-	bool Send(const UDPDatagram& datagram, const NetAddressIP4& target);
+	// The only send of the backends, everything else is built on it or on Flush()
+	bool Send(std::span<const char> packet, const NetAddressIP4& target);
+	bool Send(const std::string& message, const NetAddressIP4& target) { return Send(std::span<const char>(message), target); }
+	bool Send(const UDPDatagram& datagram, const NetAddressIP4& target) { return Send(std::span<const char>(datagram.message), target); }
+
+	// QueueFragmented() and QueueProtected() followed by Flush(), packets queued before are sent along
+	bool SendFragmented(const UDPDatagram& datagram, const NetAddressIP4& target, size_t maxDatagramSize = FacePipe::SafeDatagramSize);
+	bool SendProtected(const UDPDatagram& datagram, const NetAddressIP4& target, FacePipe::ParityEncoder& parity, size_t maxDatagramSize = FacePipe::SafeDatagramSize);
+
+	// Fan-out: the packets of a tick are queued (copied, the datagram can be reused right away) to targets resolved
+	// when they were configured, and Flush() sends them all at once - one sendmmsg() per SendBatchSize packets on Linux
+	static bool Resolve(const NetAddressIP4& address, UDPTarget& outTarget);
+	void Queue(std::span<const char> packet, const UDPTarget& target);
+	bool QueueFragmented(const UDPDatagram& datagram, const UDPTarget& target, size_t maxDatagramSize = FacePipe::SafeDatagramSize); // queues as-is if the datagram fits
+
+	// Same as above with every packet wrapped for parity, the parity encoder of the target adds a parity packet after every group
+	bool QueueProtected(const UDPDatagram& datagram, const UDPTarget& target, FacePipe::ParityEncoder& parity, size_t maxDatagramSize = FacePipe::SafeDatagramSize);
+	bool Flush(); // false if any packet failed to send, the queue is empty afterwards either way
+
+	// Appends every datagram that is waiting, returns false if there was none
 	bool Receive(std::vector<UDPDatagram>& datagrams);
 
 	bool IsConnected() const { return ossocket != nullptr; }
@@ -0,0 +1,286 @@
+#include "udp.h"
+
+#if !defined(_WIN32)
+
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <errno.h>
+#include <algorithm>
+#include <cstdio>
+
+std::function<void(const char*)> UDPSocket::Logger = [](const char*) -> void {};
+
+// snprintf instead of std::format, libstdc++ only has <format> since gcc 13
+#define UDPLog(str, ...) do { char udpLogLine[256]; std::snprintf(udpLogLine, sizeof(udpLogLine), str, __VA_ARGS__); UDPSocket::Logger(udpLogLine); } while (0)
+
+// ossocket holds the file descriptor + 1 so that nullptr still means closed (descriptor 0 is valid)
+static int to_fd(void* ossocket)
+{
+	return (int) (intptr_t) ossocket - 1;
+}
+
+static void* from_fd(int fd)
+{
+	return (void*) (intptr_t) (fd + 1);
+}
+
+// converts NetSocket to something the OS prefers
+bool to_net_addr(sockaddr_in& addr, const NetAddressIP4& info)
+{
+	addr = sockaddr_in{};
+	addr.sin_family = AF_INET;
+	addr.sin_port = htons(info.port);
+
+	if (inet_pton(AF_INET, info.ip.c_str(), &addr.sin_addr) <= 0)
+	{
+		return false;
+	}
+
+	return true;
+}
+
+bool to_netsocket(const sockaddr_in& addr, NetAddressIP4& info)
+{
+	char from_ip[INET_ADDRSTRLEN];
+	if (inet_ntop(AF_INET, &(addr.sin_addr), from_ip, INET_ADDRSTRLEN))
+	{
+		info.ip = from_ip;
+		info.port = ntohs(addr.sin_port);
+		return true;
+	}
+	else
+	{
+		return false;
+	}
+}
+
+void UDPSocket::Set(const char* socketIP, int socketPort)
+{
+	if (ossocket)
+	{
+		Close();
+	}
+
+	ip = socketIP;
+	port = socketPort;
+}
+
+bool UDPSocket::Start()
+{
+	if (ossocket)
+		return true;
+
+	int sock = socket(AF_INET, SOCK_DGRAM, IPPROTO_UDP);
+	if (sock < 0)
+	{
+		UDPLog("Failed to create UDP socket - socket() failed with errno %d [%s:%d]\n", errno, ip.c_str(), port);
+		return false;
+	}
+	ossocket = from_fd(sock);
+
+	int receiveBufferSize = 1024 * 1024;
+	int sendBufferSize = receiveBufferSize;
+	if (setsockopt(sock, SOL_SOCKET, SO_RCVBUF, &receiveBufferSize, sizeof(receiveBufferSize)) < 0)
+	{
+		UDPLog("Failed to create UDP socket - setsockopt() failed when trying to set buffer size [%s:%d]\n", ip.c_str(), port);
+		Close();
+		return false;
+	}
+
+	if (setsockopt(sock, SOL_SOCKET, SO_SNDBUF, &sendBufferSize, sizeof(sendBufferSize)) < 0)
+	{
+		UDPLog("Failed to create UDP socket - setsockopt() failed when trying to set buffer size [%s:%d]\n", ip.c_str(), port);
+		Close();
+		return false;
+	}
+
+	const int flags = fcntl(sock, F_GETFL, 0);
+	if (flags < 0 || fcntl(sock, F_SETFL, flags | O_NONBLOCK) < 0)
+	{
+		UDPLog("Failed to create UDP socket - fcntl() failed to set O_NONBLOCK [%s:%d]\n", ip.c_str(), port);
+		Close();
+		return false;
+	}
+
+	sockaddr_in addr;
+	if (!to_net_addr(addr, *((NetAddressIP4*)this)))
+	{
+		UDPLog("Failed to create UDP socket - inet_pton() failed [%s:%d]\n", ip.c_str(), port);
+		Close();
+		return false;
+	}
+
+	// Bind the socket to the address
+	if (bind(sock, (sockaddr*)&addr, sizeof(sockaddr_in)) < 0)
+	{
+		UDPLog("Failed to create UDP socket - bind() failed with errno %d [%s:%d]\n", errno, ip.c_str(), port);
+		Close();
+		return false;
+	}
+
+	UDPLog("Started UDP socket [%s]\n", ToString().c_str());
+
+	return true;
+}
+
+void UDPSocket::Close()
+{
+	if (ossocket)
+	{
+		close(to_fd(ossocket));
+		ossocket = nullptr;
+
+		UDPLog("Closed UDP socket [%s:%d]\n", ip.c_str(), port);
+	}
+}
+
+bool UDPSocket::Send(std::span<const char> packet, const NetAddressIP4& target)
+{
+	sockaddr_in sock_addr;
+	if (to_net_addr(sock_addr, target) && sendto(to_fd(ossocket), packet.data(), packet.size(), 0, (sockaddr*)&sock_addr, sizeof(sockaddr_in)) < 0)
+	{
+		UDPLog("Failed to Send() message over UDP socket [%s:%d]\n", ip.c_str(), port);
+		return false;
+	}
+
+	return true;
+}
+
+bool UDPSocket::Resolve(const NetAddressIP4& address, UDPTarget& outTarget)
+{
+	outTarget = UDPTarget();
+
+	sockaddr_in addr;
+	if (!to_net_addr(addr, address) || addr.sin_port == 0)
+		return false;
+
+	outTarget.address = addr.sin_addr.s_addr;
+	outTarget.port = addr.sin_port;
+	return true;
+}
+
+bool UDPSocket::Flush()
+{
+	mmsghdr messages[SendBatchSize];
+	iovec packets[SendBatchSize];
+	sockaddr_in targets[SendBatchSize];
+
+	bool bSentAll = sendQueue.empty() || ossocket != nullptr;
+	for (size_t first = 0; ossocket && first < sendQueue.size(); )
+	{
+		const size_t count = std::min<size_t>(sendQueue.size() - first, size_t(SendBatchSize));
+		for (size_t i = 0; i < count; i++)
+		{
+			const QueuedPacket& queued = sendQueue[first + i];
+			targets[i] = sockaddr_in{};
+			targets[i].sin_family = AF_INET;
+			targets[i].sin_addr.s_addr = queued.target.address;
+			targets[i].sin_port = queued.target.port;
+			packets[i].iov_base = sendQueueBytes.data() + queued.offset;
+			packets[i].iov_len = queued.size;
+			messages[i] = mmsghdr{};
+			messages[i].msg_hdr.msg_name = &targets[i];
+			messages[i].msg_hdr.msg_namelen = sizeof(sockaddr_in);
+			messages[i].msg_hdr.msg_iov = &packets[i];
+			messages[i].msg_hdr.msg_iovlen = 1;
+		}
+
+		// sendmmsg() stops before a packet that fails and reports the error with the next call, which then skips that packet
+		const int sent = sendmmsg(to_fd(ossocket), messages, (unsigned int) count, 0);
+		if (sent <= 0)
+		{
+			UDPLog("Failed to Flush() packet %zu of %zu over UDP socket, errno %d [%s:%d]\n", first, sendQueue.size(), errno, ip.c_str(), port);
+			bSentAll = false;
+			first++;
+			continue;
+		}
+
+		first += (size_t) sent;
+	}
+
+	sendQueue.clear();
+	sendQueueBytes.clear();
+	return bSentAll;
+}
+
+bool UDPSocket::Receive(std::vector<UDPDatagram>& datagrams)
+{
+	if (!ossocket)
+		return false;
+
+	// One slot per datagram of a batch, a burst of ReceiveBatchSize datagrams costs a single recvmmsg() call
+	if (receiveBuffer.size() < ReceiveBatchSize * ReceiveSlotSize)
+		receiveBuffer.resize(ReceiveBatchSize * ReceiveSlotSize);
+
+	mmsghdr messages[ReceiveBatchSize];
+	iovec slots[ReceiveBatchSize];
+	sockaddr_in senders[ReceiveBatchSize];
+
+	bool bReceivedAnyDatagram = false;
+	int count = 0;
+	do
+	{
+		for (size_t i = 0; i < ReceiveBatchSize; i++)
+		{
+			slots[i].iov_base = receiveBuffer.data() + i * ReceiveSlotSize;
+			slots[i].iov_len = ReceiveSlotSize;
+			messages[i] = mmsghdr{};
+			messages[i].msg_hdr.msg_iov = &slots[i];
+			messages[i].msg_hdr.msg_iovlen = 1;
+			messages[i].msg_hdr.msg_name = &senders[i];
+			messages[i].msg_hdr.msg_namelen = sizeof(sockaddr_in);
+		}
+
+		count = recvmmsg(to_fd(ossocket), messages, ReceiveBatchSize, MSG_DONTWAIT, nullptr);
+		if (count < 0)
+		{
+			if (errno == EBADF || errno == ENOTSOCK || errno == ENOTCONN)
+			{
+				Close();
+				UDPLog("Socket closed unexpectedly during recvmmsg() [%s:%d]\n", ip.c_str(), port);
+			}
+
+			// EAGAIN means there is no more incoming data, other errors should be harmless
+			break;
+		}
+
+		for (int i = 0; i < count; i++)
+		{
+			const size_t length = messages[i].msg_len;
+			if (length == 0 || (messages[i].msg_hdr.msg_flags & MSG_TRUNC))
+				continue;
+
+			bReceivedAnyDatagram = true;
+			UDPDatagram& datagram = datagrams.emplace_back();
+			datagram.message.assign((const char*) slots[i].iov_base, (const char*) slots[i].iov_base + length);
+			to_netsocket(senders[i], datagram.source);
+		}
+	} while (count == (int) ReceiveBatchSize); // a full batch means more may be waiting
+
+	bReceivedDataLastCall = bReceivedAnyDatagram;
+	return bReceivedAnyDatagram;
+}
+
+std::string UDPSocket::ToString() const
+{
+	sockaddr_in localAddress;
+	socklen_t addrSize = sizeof(localAddress);
+
+	if (ossocket && getsockname(to_fd(ossocket), (sockaddr*)&localAddress, &addrSize) == 0)
+	{
+		// get info from socket if it is bound
+		char ipAddress[INET_ADDRSTRLEN];
+		inet_ntop(AF_INET, &localAddress.sin_addr, ipAddress, INET_ADDRSTRLEN);
+		return std::string(ipAddress) + ":" + std::to_string(ntohs(localAddress.sin_port));
+	}
+	else
+	{
+		// just use the user-requested values
+		return ip + ":" + std::to_string(port);
+	}
+}
+
+#endif
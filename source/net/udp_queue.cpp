@@ -0,0 +1,113 @@
+#include "udp.h"
+
+#include <cstdio>
+
+// Queued sending is the same on every platform, only Send(), Resolve() and Flush() are in the backends (udp.cpp, udp_posix.cpp).
+// SendFragmented() and SendProtected() queue and flush right away so that fragmenting and protecting exist only once.
+
+// Built with every backend, so without <format> like udp_posix.cpp
+#define UDPLog(str, ...) do { char udpLogLine[256]; std::snprintf(udpLogLine, sizeof(udpLogLine), str, __VA_ARGS__); UDPSocket::Logger(udpLogLine); } while (0)
+
+void UDPSocket::Queue(std::span<const char> packet, const UDPTarget& target)
+{
+	if (packet.empty() || !target.IsValid())
+		return;
+
+	QueuedPacket& queued = sendQueue.emplace_back();
+	queued.offset = sendQueueBytes.size();
+	queued.size = packet.size();
+	queued.target = target;
+	sendQueueBytes.insert(sendQueueBytes.end(), packet.begin(), packet.end());
+}
+
+bool UDPSocket::QueueFragmented(const UDPDatagram& datagram, const UDPTarget& target, size_t maxDatagramSize)
+{
+	if (datagram.message.empty() || !target.IsValid())
+		return false;
+
+	if (datagram.message.size() <= maxDatagramSize)
+	{
+		Queue(datagram.message, target);
+		return true;
+	}
+
+	const size_t fragmentCount = FacePipe::GetFragmentCount(datagram.message.size(), maxDatagramSize);
+	if (fragmentCount == 0)
+	{
+		UDPLog("Failed to QueueFragmented() - message of %zu bytes is too large [%s:%d]\n", datagram.message.size(), ip.c_str(), port);
+		return false;
+	}
+
+	const uint32_t messageId = nextMessageId++;
+	for (size_t i = 0; i < fragmentCount; i++)
+	{
+		FacePipe::WriteFragment(datagram.message, messageId, i, maxDatagramSize, fragmentBuffer);
+		Queue(fragmentBuffer, target);
+	}
+
+	return true;
+}
+
+bool UDPSocket::QueueProtected(const UDPDatagram& datagram, const UDPTarget& target, FacePipe::ParityEncoder& parity, size_t maxDatagramSize)
+{
+	if (datagram.message.empty() || !target.IsValid())
+		return false;
+
+	// A protected fragment needs both headers and at least one byte of payload
+	if (maxDatagramSize <= sizeof(FacePipe::ParityHeader) + sizeof(FacePipe::FragmentHeader))
+	{
+		UDPLog("Failed to QueueProtected() - datagram size of %zu bytes leaves no room for a payload [%s:%d]\n", maxDatagramSize, ip.c_str(), port);
+		return false;
+	}
+
+	// Fragments leave room for the parity header so that the wrapped packets still fit
+	const size_t fragmentLimit = maxDatagramSize - sizeof(FacePipe::ParityHeader);
+	size_t fragmentCount = 1;
+	if (datagram.message.size() > fragmentLimit)
+	{
+		fragmentCount = FacePipe::GetFragmentCount(datagram.message.size(), fragmentLimit);
+		if (fragmentCount == 0)
+		{
+			UDPLog("Failed to QueueProtected() - message of %zu bytes is too large [%s:%d]\n", datagram.message.size(), ip.c_str(), port);
+			return false;
+		}
+	}
+
+	const uint32_t messageId = (fragmentCount > 1) ? nextMessageId++ : 0;
+	for (size_t i = 0; i < fragmentCount; i++)
+	{
+		std::span<const char> packet = datagram.message;
+		if (fragmentCount > 1)
+		{
+			FacePipe::WriteFragment(datagram.message, messageId, i, fragmentLimit, fragmentBuffer);
+			packet = fragmentBuffer;
+		}
+
+		const bool bGroupCompleted = parity.Protect(packet, parityPacket, parityBuffer);
+		Queue(parityPacket, target);
+
+		// The parity follows the last packet of its group
+		if (bGroupCompleted)
+			Queue(parityBuffer, target);
+	}
+
+	return true;
+}
+
+bool UDPSocket::SendFragmented(const UDPDatagram& datagram, const NetAddressIP4& target, size_t maxDatagramSize)
+{
+	UDPTarget resolved;
+	if (!Resolve(target, resolved))
+		return false;
+
+	return QueueFragmented(datagram, resolved, maxDatagramSize) && Flush();
+}
+
+bool UDPSocket::SendProtected(const UDPDatagram& datagram, const NetAddressIP4& target, FacePipe::ParityEncoder& parity, size_t maxDatagramSize)
+{
+	UDPTarget resolved;
+	if (!Resolve(target, resolved))
+		return false;
+
+	return QueueProtected(datagram, resolved, parity, maxDatagramSize) && Flush();
+}
@@ -135,6 +135,15 @@ void GLTriangleMesh::SendToGPU()
 	glBufferVector(GL_ELEMENT_ARRAY_BUFFER, indices, usage);
 }
 
+void GLTriangleMesh::SendPositionsToGPU()
+{
+	if (!vao) return;
+
+	glBindVertexArray(vao);
+	glBindBuffer(GL_ARRAY_BUFFER, positionBuffer);
+	glBufferVector(GL_ARRAY_BUFFER, positions, usage);
+}
+
 void GLTriangleMesh::Draw(GLenum drawMode)
 {
 	if (vao && positions.size() > 0 && indices.size() > 0)
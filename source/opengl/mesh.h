@@ -59,6 +59,7 @@ public:
 
 	void Clear();
 	void SendToGPU();
+	void SendPositionsToGPU(); // for animated meshes where only the vertex positions change
 	void Draw(GLenum drawMode = GL_TRIANGLES);
 	void AddVertex(glm::fvec3 pos, glm::fvec4 color, glm::fvec4 texcoord);
 	void AddVertex(glm::fvec3 pos, glm::fvec3 normal, glm::fvec4 color, glm::fvec4 texcoord);
@@ -0,0 +1,260 @@
+#include "tests.h"
+#include "net/facepipe.h"
+#include "net/facepipe_dictionary.h"
+#include "net/facepipe_encode.h"
+#include "net/facepipe_mesh.h"
+#include "net/facepipe_pca.h"
+#include "net/facepipe_pose.h"
+#include "net/facepipe_sparse.h"
+#include "net/facepipe_view.h"
+
+#include <functional>
+
+using namespace FacePipe;
+
+static char Buffer[SafeEncodeSize];
+
+// Content of a binary datagram written by one of the Encode* functions
+static std::vector<char> ContentOf(size_t Size)
+{
+	std::vector<char> Message(Buffer, Buffer + Size);
+	MessageInfo Info;
+	if (Size == 0 || !ParseHeader(Message, Info))
+		return std::vector<char>();
+
+	return std::vector<char>(Message.begin() + Info.ContentView.b, Message.begin() + Info.ContentView.e);
+}
+
+template<typename T>
+static void Append(std::vector<char>& Out, const T& Value)
+{
+	Out.insert(Out.end(), (const char*) &Value, (const char*) &Value + sizeof(T));
+}
+
+struct SectionCase
+{
+	const char* Name;
+	EFacepipeData DataType;
+	uint16_t Flags;
+	std::vector<char> Content;
+	std::function<bool(const std::vector<char>&, const MessageInfo&)> Read;
+};
+
+// Binary composite with Content as section 0 claiming ClaimedSize bytes, followed by a second section of filler
+// bytes that a reader trusting the counts of section 0 instead of its size would read as part of it
+static std::vector<char> MakeComposite(const SectionCase& Case, uint32_t ClaimedSize)
+{
+	BinaryHeader Header;
+	Header.DataType = (uint8_t) EFacepipeData::Composite;
+
+	CompositeSection Sections[2];
+	Sections[0].DataType = (uint8_t) Case.DataType;
+	Sections[0].Flags = Case.Flags;
+	Sections[0].Offset = sizeof(uint32_t) + sizeof(Sections);
+	Sections[0].Size = ClaimedSize;
+	Sections[1].DataType = (uint8_t) EFacepipeData::Blendshapes;
+	Sections[1].Offset = Sections[0].Offset + (((uint32_t) Case.Content.size() + 3) & ~3u);
+	Sections[1].Size = 4096;
+
+	std::vector<char> Message;
+	Append(Message, Header);
+	Append(Message, (uint32_t) 2);
+	Append(Message, Sections);
+	Message.insert(Message.end(), Case.Content.begin(), Case.Content.end());
+	Message.resize(sizeof(BinaryHeader) + Sections[1].Offset, 0);
+	Message.resize(Message.size() + Sections[1].Size, 0x7F);
+	return Message;
+}
+
+static std::vector<SectionCase> MakeCases()
+{
+	MessageInfo Info;
+	Info.DatagramType = EDatagramType::Bytes;
+
+	BlendshapeFrame Blendshapes;
+	for (size_t i = 0; i < ARKitBlendshapeCount; ++i)
+		Blendshapes.Set(i, 0.5f);
+	Blendshapes.Set("_neutral", 0.0f);
+
+	MatrixMap Matrices;
+	Matrices["face"] = std::vector<float>(16, 1.0f);
+	Matrices["jaw"] = std::vector<float>(16, 2.0f);
+
+	PoseMap Poses;
+	Poses["face"] = Pose();
+
+	std::vector<float> Landmarks(478 * 3, 0.25f);
+	const uint8_t UpdateIndices[] = { 3, 17, 40 };
+	const float UpdateValues[] = { 0.1f, 0.2f, 0.3f };
+	std::vector<float> Mean(ARKitBlendshapeCount, 0.1f);
+	std::vector<float> Components(2 * ARKitBlendshapeCount, 0.01f);
+
+	std::vector<SectionCase> Cases;
+
+	Info.DataType = EFacepipeData::Blendshapes;
+	Cases.push_back({ "Blendshapes", Info.DataType, 0, ContentOf(EncodeBlendshapes(Buffer, Info, Blendshapes)), [](auto& Message, auto& Section)
+	{
+		BlendshapeFrame Out;
+		return GetBlendshapes(Message, Section, Out);
+	} });
+	Cases.push_back({ "BlendshapesView", Info.DataType, 0, Cases.back().Content, [](auto& Message, auto& Section)
+	{
+		// The view only covers the names, they are checked while iterating
+		NamedValuesView View;
+		if (!GetBlendshapesView(Message, Section, View))
+			return false;
+
+		size_t NameOffset = 0;
+		std::string_view Name;
+		for (size_t i = 0; i < View.Values.size(); ++i)
+		{
+			if (!View.NextName(NameOffset, Name))
+				return false;
+		}
+		return true;
+	} });
+
+	Info.DataType = EFacepipeData::Matrices4x4;
+	Cases.push_back({ "Matrices", Info.DataType, 0, ContentOf(EncodeMatrices(Buffer, Info, Matrices)), [](auto& Message, auto& Section)
+	{
+		MatrixMap Out;
+		return GetMatrices(Message, Section, Out);
+	} });
+
+	Info.DataType = EFacepipeData::Poses;
+	Cases.push_back({ "Poses", Info.DataType, 0, ContentOf(EncodePoses(Buffer, Info, Poses)), [](auto& Message, auto& Section)
+	{
+		PoseMap Out;
+		return GetPoses(Message, Section, Out);
+	} });
+
+	Info.DataType = EFacepipeData::Landmarks3D;
+	Cases.push_back({ "Landmarks", Info.DataType, 0, ContentOf(EncodeLandmarks(Buffer, Info, Landmarks, 640, 480)), [](auto& Message, auto& Section)
+	{
+		std::vector<float> Out;
+		int Width = 0, Height = 0;
+		return GetLandmarks(Message, Section, Out, Width, Height);
+	} });
+	Cases.push_back({ "LandmarksFrameView", Info.DataType, 0, Cases.back().Content, [](auto& Message, auto& Section)
+	{
+		FrameView View;
+		return View.Bind(Message, Section) && View.GetLandmarks().size() == 478 * 3;
+	} });
+
+	EncodeSettings Quantized;
+	Quantized.QuantizedBits = 12;
+	Cases.push_back({ "QuantizedLandmarks", Info.DataType, (uint16_t) EBinaryFlags::Quantized, ContentOf(EncodeLandmarks(Buffer, Info, Landmarks, 640, 480, Quantized)), [](auto& Message, auto& Section)
+	{
+		std::vector<float> Out;
+		int Width = 0, Height = 0;
+		return GetLandmarks(Message, Section, Out, Width, Height);
+	} });
+	Cases.push_back({ "QuantizedLandmarksFrameView", Info.DataType, (uint16_t) EBinaryFlags::Quantized, Cases.back().Content, [](auto& Message, auto& Section)
+	{
+		FrameView View;
+		return View.Bind(Message, Section) && View.GetLandmarks().size() == 478 * 3;
+	} });
+
+	Info.DataType = EFacepipeData::BlendshapeUpdates;
+	Cases.push_back({ "BlendshapeUpdates", Info.DataType, 0, ContentOf(EncodeBlendshapeUpdates(Buffer, Info, UpdateIndices, UpdateValues)), [](auto& Message, auto& Section)
+	{
+		BlendshapeFrame Out;
+		return GetBlendshapeUpdates(Message, Section, Out);
+	} });
+
+	Info.DataType = EFacepipeData::ExpressionBasis;
+	const uint32_t BasisId = HashExpressionBasis(2, Mean, Components);
+	Cases.push_back({ "ExpressionBasis", Info.DataType, 0, ContentOf(EncodeExpressionBasis(Buffer, Info, BasisId, 2, Mean, Components)), [](auto& Message, auto& Section)
+	{
+		ExpressionBasis Out;
+		return GetExpressionBasis(Message, Section, Out);
+	} });
+
+	// No encoders for these, the layouts are in facepipe.h
+	std::vector<char> Dictionary;
+	Append(Dictionary, (uint32_t) 7);
+	Append(Dictionary, (uint32_t) 3);
+	for (const char* Name : { "jawOpen", "mouthClose", "_neutral" })
+	{
+		Append(Dictionary, (uint8_t) std::strlen(Name));
+		Dictionary.insert(Dictionary.end(), Name, Name + std::strlen(Name));
+	}
+	Cases.push_back({ "Dictionary", EFacepipeData::Dictionary, 0, Dictionary, [](auto& Message, auto& Section)
+	{
+		FacePipe::Dictionary Out;
+		return GetDictionary(Message, Section, Out);
+	} });
+
+	std::vector<char> Mesh;
+	for (uint32_t Value : { 11u, 4u, 0u, 0u })
+		Append(Mesh, Value);
+	for (int i = 0; i < 4 * 3; ++i)
+		Append(Mesh, (float) i);
+	Cases.push_back({ "Mesh", EFacepipeData::Mesh, 0, Mesh, [](auto& Message, auto& Section)
+	{
+		float Positions[4 * 3];
+		return GetMeshVertices(Message, Section, Positions, 4);
+	} });
+
+	const std::vector<uint32_t> Indices = { 0, 1, 2, 2, 1, 3 };
+	std::vector<char> Topology;
+	for (uint32_t Value : { HashMeshTopology(4, Indices, std::span<const float>()), 4u, (uint32_t) Indices.size(), 0u })
+		Append(Topology, Value);
+	for (uint32_t Index : Indices)
+		Append(Topology, Index);
+	Cases.push_back({ "MeshTopology", EFacepipeData::MeshTopology, 0, Topology, [](auto& Message, auto& Section)
+	{
+		MeshTopology Out;
+		return GetMeshTopology(Message, Section, Out);
+	} });
+
+	return Cases;
+}
+
+FACEPIPE_TEST(CompositeSectionsAreReadWithinTheirSize)
+{
+	for (const SectionCase& Case : MakeCases())
+	{
+		CHECK(Case.Content.size() > 16);
+
+		// The whole section reads fine, any shorter size has counts that run past the end of the section
+		const uint32_t FullSize = (uint32_t) Case.Content.size();
+		for (uint32_t ClaimedSize : { FullSize, FullSize - 1, FullSize - 4, 16u, 8u, 0u })
+		{
+			const std::vector<char> Message = MakeComposite(Case, ClaimedSize);
+
+			MessageInfo Info, Section;
+			CHECK(ParseHeader(Message, Info) && Info.DataType == EFacepipeData::Composite);
+			CHECK(GetSection(Message, Info, 0, Section) && Section.ContentView.e - Section.ContentView.b == ClaimedSize);
+
+			const bool bRead = Case.Read(Message, Section);
+			if (bRead != (ClaimedSize == FullSize))
+				std::printf("    %s section claiming %u of %u bytes %s\n", Case.Name, ClaimedSize, FullSize, bRead ? "was read" : "failed");
+			CHECK(bRead == (ClaimedSize == FullSize));
+		}
+	}
+}
+
+FACEPIPE_TEST(CompositeSectionTableIsBoundsChecked)
+{
+	const std::vector<SectionCase> Cases = MakeCases();
+	std::vector<char> Message = MakeComposite(Cases[0], (uint32_t) Cases[0].Content.size());
+
+	MessageInfo Info, Section;
+	CHECK(ParseHeader(Message, Info));
+	CHECK(GetSection(Message, Info, 1, Section));
+	CHECK(!GetSection(Message, Info, 2, Section));
+
+	// Second section reaching one byte past the datagram
+	CompositeSection Entry;
+	const size_t EntryOffset = Info.ContentView.b + sizeof(uint32_t) + sizeof(CompositeSection);
+	std::memcpy(&Entry, Message.data() + EntryOffset, sizeof(Entry));
+	Entry.Size += 1;
+	std::memcpy(Message.data() + EntryOffset, &Entry, sizeof(Entry));
+	CHECK(!GetSection(Message, Info, 1, Section));
+
+	// Section count larger than the table
+	const uint32_t Count = 1000;
+	std::memcpy(Message.data() + Info.ContentView.b, &Count, sizeof(Count));
+	CHECK(!GetSection(Message, Info, 999, Section));
+}
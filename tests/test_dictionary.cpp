@@ -0,0 +1,171 @@
+#include "tests.h"
+#include "net/facepipe_dictionary.h"
+
+#include <cstring>
+#include <string>
+
+using namespace FacePipe;
+
+// Two ARKit blendshapes and one that is not
+static const char* const Names[] = { "jawOpen", "mouthClose", "tongueCurl" };
+
+template<typename T>
+static void Append(std::vector<char>& Out, const T& Value)
+{
+	Out.insert(Out.end(), (const char*) &Value, (const char*) &Value + sizeof(T));
+}
+
+static std::vector<char> MakeAscii(const std::string& Content)
+{
+	const std::string Text = "a|facepipe|mediapipe|0,0,0|1.0|" + Content;
+	return std::vector<char>(Text.begin(), Text.end());
+}
+
+static std::vector<char> MakeBinary(EFacepipeData DataType, const std::vector<char>& Content)
+{
+	BinaryHeader Header;
+	Header.DataType = (uint8_t) DataType;
+
+	std::vector<char> Message;
+	Append(Message, Header);
+	Message.insert(Message.end(), Content.begin(), Content.end());
+	return Message;
+}
+
+static std::vector<char> MakeBinaryDictionary(uint32_t Id, uint32_t Count, std::span<const char* const> DictNames)
+{
+	std::vector<char> Content;
+	Append(Content, Id);
+	Append(Content, Count);
+	for (const char* Name : DictNames)
+	{
+		Content.push_back((char) std::strlen(Name));
+		Content.insert(Content.end(), Name, Name + std::strlen(Name));
+	}
+	return MakeBinary(EFacepipeData::Dictionary, Content);
+}
+
+static std::vector<char> MakeBinaryValues(uint32_t Id, std::span<const float> Values)
+{
+	std::vector<char> Content;
+	Append(Content, Id);
+	Append(Content, (uint32_t) Values.size());
+	for (float Value : Values)
+		Append(Content, Value);
+	return MakeBinary(EFacepipeData::BlendshapeValues, Content);
+}
+
+static bool UpdateDictionary(DictionaryCache& Cache, const std::vector<char>& Message)
+{
+	MessageInfo Info;
+	return ParseHeader(Message, Info) && Cache.Update(Message, Info);
+}
+
+static bool ReadValues(DictionaryCache& Cache, const std::vector<char>& Message, BlendshapeFrame& OutBlendshapes)
+{
+	MessageInfo Info;
+	return ParseHeader(Message, Info) && GetBlendshapeValues(Message, Info, Cache, OutBlendshapes);
+}
+
+static bool HasTestValues(const BlendshapeFrame& Blendshapes)
+{
+	const size_t Jaw = (size_t) FindARKitBlendshape("jawOpen");
+	const size_t Close = (size_t) FindARKitBlendshape("mouthClose");
+	auto Curl = Blendshapes.Other.find("tongueCurl");
+	return Blendshapes.IsValid(Jaw) && Blendshapes.Values[Jaw] == 0.5f && Blendshapes.IsValid(Close) && Blendshapes.Values[Close] == 0.25f
+		&& Curl != Blendshapes.Other.end() && Curl->second == 0.75f;
+}
+
+FACEPIPE_TEST(DictionaryValuesDecode)
+{
+	const float Values[] = { 0.5f, 0.25f, 0.75f };
+
+	DictionaryCache Cache;
+	CHECK(UpdateDictionary(Cache, MakeAscii("dict|7|jawOpen,mouthClose,tongueCurl")));
+
+	MessageInfo Info;
+	const std::vector<char> Values7 = MakeAscii("bsv|7|0.5,0.25,0.75");
+	CHECK(ParseHeader(Values7, Info));
+
+	const Dictionary* Dict = Cache.Find(Info, 7);
+	CHECK(Dict && Dict->Names.size() == 3 && Dict->Names[2] == "tongueCurl");
+	CHECK(Dict && Dict->ARKitIndices[0] == FindARKitBlendshape("jawOpen") && Dict->ARKitIndices[2] == -1);
+
+	BlendshapeFrame Blendshapes;
+	CHECK(ReadValues(Cache, Values7, Blendshapes) && HasTestValues(Blendshapes));
+
+	// Fewer values than names leave the rest alone
+	BlendshapeFrame Partial;
+	CHECK(ReadValues(Cache, MakeAscii("bsv|7|0.5"), Partial) && Partial.Values[FindARKitBlendshape("jawOpen")] == 0.5f && Partial.Other.empty());
+
+	// The same dictionary and values as binary content
+	DictionaryCache BinaryCache;
+	CHECK(UpdateDictionary(BinaryCache, MakeBinaryDictionary(7, 3, Names)));
+
+	Blendshapes = BlendshapeFrame();
+	CHECK(ReadValues(BinaryCache, MakeBinaryValues(7, Values), Blendshapes) && HasTestValues(Blendshapes));
+	CHECK(Cache.UnknownDictionaryCount == 0 && BinaryCache.UnknownDictionaryCount == 0);
+}
+
+FACEPIPE_TEST(UnknownDictionariesAreCounted)
+{
+	const float Values[] = { 0.5f, 0.25f, 0.75f };
+
+	DictionaryCache Cache;
+	BlendshapeFrame Blendshapes;
+	CHECK(!ReadValues(Cache, MakeBinaryValues(7, Values), Blendshapes));
+	CHECK(!ReadValues(Cache, MakeAscii("bsv|7|0.5,0.25,0.75"), Blendshapes));
+	CHECK(Cache.UnknownDictionaryCount == 2);
+
+	// Values for another id of a cached subject are unknown as well
+	CHECK(UpdateDictionary(Cache, MakeBinaryDictionary(7, 3, Names)));
+	CHECK(!ReadValues(Cache, MakeBinaryValues(6, Values), Blendshapes));
+	CHECK(Cache.UnknownDictionaryCount == 3 && Blendshapes.ValidMask == 0 && Blendshapes.Other.empty());
+
+	// A new id replaces the dictionary of the subject
+	const char* const Swapped[] = { "mouthClose", "jawOpen", "tongueCurl" };
+	CHECK(UpdateDictionary(Cache, MakeBinaryDictionary(8, 3, Swapped)));
+	CHECK(!ReadValues(Cache, MakeBinaryValues(7, Values), Blendshapes));
+	CHECK(ReadValues(Cache, MakeBinaryValues(8, Values), Blendshapes));
+	CHECK(Blendshapes.Values[FindARKitBlendshape("mouthClose")] == 0.5f && Cache.UnknownDictionaryCount == 4);
+
+	// Ids that do not parse completely
+	CHECK(!UpdateDictionary(Cache, MakeAscii("dict|7x|jawOpen")));
+	CHECK(!UpdateDictionary(Cache, MakeAscii("dict||jawOpen")));
+	CHECK(!ReadValues(Cache, MakeAscii("bsv|-1|0.5"), Blendshapes));
+}
+
+FACEPIPE_TEST(DictionaryCountsBeyondTheDeclaredSizeFail)
+{
+	DictionaryCache Cache;
+
+	// Name counts the content cannot hold, or that disagree with the names that follow
+	CHECK(!UpdateDictionary(Cache, MakeBinaryDictionary(7, UINT32_MAX, Names)));
+	CHECK(!UpdateDictionary(Cache, MakeBinaryDictionary(7, 4, Names)));
+	CHECK(!UpdateDictionary(Cache, MakeBinaryDictionary(7, 2, std::span<const char* const>(Names, 1))));
+
+	std::vector<char> Cut = MakeBinaryDictionary(7, 3, Names);
+	Cut.pop_back();
+	CHECK(!UpdateDictionary(Cache, Cut));
+
+	MessageInfo Info;
+	CHECK(ParseHeader(Cut, Info) && Cache.Find(Info, 7) == nullptr);
+
+	// More values than the dictionary has names fail without applying any of them
+	CHECK(UpdateDictionary(Cache, MakeBinaryDictionary(7, 3, Names)));
+
+	const float Four[] = { 0.5f, 0.25f, 0.75f, 1.0f };
+	BlendshapeFrame Blendshapes;
+	CHECK(!ReadValues(Cache, MakeBinaryValues(7, Four), Blendshapes));
+	CHECK(Blendshapes.ValidMask == 0 && Blendshapes.Other.empty());
+
+	// Binary values that claim more than the content holds
+	const std::vector<char> Three = MakeBinaryValues(7, std::span<const float>(Four, 3));
+	CHECK(!ReadValues(Cache, std::vector<char>(Three.begin(), Three.end() - sizeof(float)), Blendshapes));
+
+	DictionaryCache AsciiCache;
+	CHECK(UpdateDictionary(AsciiCache, MakeAscii("dict|7|jawOpen,mouthClose,tongueCurl")));
+	CHECK(!ReadValues(AsciiCache, MakeAscii("bsv|7|0.5,0.25,0.75,1.0"), Blendshapes));
+	CHECK(Blendshapes.ValidMask == 0 && Blendshapes.Other.empty());
+	CHECK(Cache.UnknownDictionaryCount == 0 && AsciiCache.UnknownDictionaryCount == 0);
+}
@@ -0,0 +1,249 @@
+#include "tests.h"
+#include "net/facepipe.h"
+#include "net/facepipe_encode.h"
+#include "net/facepipe_pose.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <random>
+
+using namespace FacePipe;
+
+static char Buffer[SafeEncodeSize];
+
+// The data of one MediaPipe face with random values
+struct RandomFace
+{
+	std::vector<float> Landmarks;
+	BlendshapeFrame Blendshapes;
+	MatrixMap Matrices;
+
+	RandomFace()
+	{
+		std::mt19937 Random(5);
+		std::uniform_real_distribution<float> Uniform(-1.0f, 1.0f);
+
+		Landmarks.resize(478 * 3);
+		for (float& Value : Landmarks)
+			Value = Uniform(Random);
+
+		for (size_t i = 0; i < ARKitBlendshapeCount; ++i)
+			Blendshapes.Set(i, (Uniform(Random) + 1.0f) / 2.0f);
+		Blendshapes.Set("_neutral", 0.25f);
+
+		std::vector<float>& Face = Matrices["face"];
+		Face.resize(16);
+		for (float& Value : Face)
+			Value = Uniform(Random);
+		Matrices["eyeL"] = std::vector<float>(16, 0.5f);
+	}
+};
+
+static bool ParseEncoded(size_t Size, std::vector<char>& OutMessage, MessageInfo& OutInfo)
+{
+	OutMessage.assign(Buffer, Buffer + Size);
+	return Size > 0 && ParseHeader(OutMessage, OutInfo);
+}
+
+static float MaxError(const std::vector<float>& A, const std::vector<float>& B)
+{
+	float Error = (A.size() == B.size()) ? 0.0f : INFINITY;
+	for (size_t i = 0; i < A.size() && i < B.size(); ++i)
+		Error = std::max(Error, std::fabs(A[i] - B[i]));
+	return Error;
+}
+
+FACEPIPE_TEST(EncodedDatagramsRoundTrip)
+{
+	const RandomFace Face;
+	std::vector<char> Message;
+	MessageInfo Parsed;
+
+	for (EDatagramType DatagramType : { EDatagramType::ASCII, EDatagramType::Bytes })
+	{
+		for (bool bSequenced : { false, true })
+		{
+			MessageInfo Info;
+			Info.DatagramType = DatagramType;
+			Info.Source = "mediapipe";
+			Info.Scene = 1;
+			Info.Camera = 2;
+			Info.Subject = 3;
+			Info.Time = 12345.678901234;
+			Info.bHasSequence = bSequenced;
+			Info.Sequence = 77;
+
+			Info.DataType = EFacepipeData::Landmarks3D;
+			CHECK(ParseEncoded(EncodeLandmarks(Buffer, Info, Face.Landmarks, 640, 480), Message, Parsed));
+			CHECK(Parsed.DatagramType == DatagramType && Parsed.DataType == EFacepipeData::Landmarks3D && Parsed.Source == "mediapipe");
+			CHECK(Parsed.Scene == 1 && Parsed.Camera == 2 && Parsed.Subject == 3 && Parsed.Time == Info.Time);
+			CHECK(Parsed.bHasSequence == bSequenced && (!bSequenced || Parsed.Sequence == 77));
+
+			// The shortest representation that round-trips gives back the same floats in ASCII too
+			std::vector<float> Landmarks;
+			int Width = 0, Height = 0;
+			CHECK(GetLandmarks(Message, Parsed, Landmarks, Width, Height));
+			CHECK(Landmarks == Face.Landmarks && Width == 640 && Height == 480);
+
+			Info.DataType = EFacepipeData::Blendshapes;
+			BlendshapeFrame Blendshapes;
+			CHECK(ParseEncoded(EncodeBlendshapes(Buffer, Info, Face.Blendshapes), Message, Parsed));
+			CHECK(GetBlendshapes(Message, Parsed, Blendshapes));
+			CHECK(Blendshapes.ValidMask == Face.Blendshapes.ValidMask && Blendshapes.Other == Face.Blendshapes.Other);
+			CHECK(std::memcmp(Blendshapes.Values, Face.Blendshapes.Values, sizeof(Blendshapes.Values)) == 0);
+
+			Info.DataType = EFacepipeData::Matrices4x4;
+			MatrixMap Matrices;
+			CHECK(ParseEncoded(EncodeMatrices(Buffer, Info, Face.Matrices), Message, Parsed));
+			CHECK(GetMatrices(Message, Parsed, Matrices) && Matrices == Face.Matrices);
+		}
+	}
+}
+
+FACEPIPE_TEST(QuantizedLandmarksStayWithinHalfAStep)
+{
+	const RandomFace Face;
+	std::vector<char> Message;
+	MessageInfo Info, Parsed;
+	Info.DatagramType = EDatagramType::Bytes;
+	Info.DataType = EFacepipeData::Landmarks3D;
+
+	for (uint32_t Bits : { 16u, 12u, 10u })
+	{
+		EncodeSettings Settings;
+		Settings.QuantizedBits = Bits;
+
+		std::vector<float> Landmarks;
+		int Width = 0, Height = 0;
+		CHECK(ParseEncoded(EncodeLandmarks(Buffer, Info, Face.Landmarks, 640, 480, Settings), Message, Parsed));
+		CHECK(GetLandmarks(Message, Parsed, Landmarks, Width, Height));
+
+		// The values span [-1, 1] split into 2^Bits - 1 steps
+		const float Bound = 2.0f / ((1u << Bits) - 1) * 0.5f * 1.001f;
+		const float Error = MaxError(Landmarks, Face.Landmarks);
+		if (Error > Bound)
+			std::printf("    %u bits off by %g, more than %g\n", Bits, Error, Bound);
+		CHECK(Error <= Bound);
+	}
+}
+
+FACEPIPE_TEST(NonFiniteValuesQuantizeSafely)
+{
+	const RandomFace Face;
+	std::vector<char> Message;
+	MessageInfo Info, Parsed;
+	Info.DatagramType = EDatagramType::Bytes;
+	Info.DataType = EFacepipeData::Landmarks3D;
+
+	// A lost landmark, and a single axis gone to infinity
+	std::vector<float> Values = Face.Landmarks;
+	Values[0] = Values[1] = Values[2] = NAN;
+	Values[3] = INFINITY;
+
+	EncodeSettings Settings;
+	Settings.QuantizedBits = 12;
+
+	std::vector<float> Landmarks;
+	int Width = 0, Height = 0;
+	CHECK(ParseEncoded(EncodeLandmarks(Buffer, Info, Values, 640, 480, Settings), Message, Parsed));
+	CHECK(GetLandmarks(Message, Parsed, Landmarks, Width, Height) && Landmarks.size() == Values.size());
+
+	// The others keep the precision of their own range
+	const float Bound = 2.0f / ((1u << 12) - 1) * 0.5f * 1.001f;
+	for (size_t i = 0; i < Landmarks.size(); ++i)
+	{
+		CHECK(std::isfinite(Landmarks[i]));
+		if (i > 3)
+			CHECK(std::fabs(Landmarks[i] - Values[i]) <= Bound);
+	}
+
+	// Rotations pack NaN components as zero
+	const float Rotation[4] = { NAN, 0.0f, 0.0f, 1.0f };
+	float Unpacked[4] = {};
+	UnpackRotation(PackRotation(Rotation), Unpacked);
+	CHECK(std::fabs(Unpacked[0]) < 0.01f && std::fabs(Unpacked[3] - 1.0f) < 0.01f);
+}
+
+FACEPIPE_TEST(FixedPrecisionAndOverflow)
+{
+	const RandomFace Face;
+	std::vector<char> Message;
+	MessageInfo Info, Parsed;
+	Info.DatagramType = EDatagramType::ASCII;
+	Info.DataType = EFacepipeData::Landmarks3D;
+
+	EncodeSettings Settings;
+	Settings.Precision = 4;
+
+	std::vector<float> Landmarks;
+	int Width = 0, Height = 0;
+	CHECK(ParseEncoded(EncodeLandmarks(Buffer, Info, Face.Landmarks, 640, 480, Settings), Message, Parsed));
+	CHECK(GetLandmarks(Message, Parsed, Landmarks, Width, Height));
+	CHECK(MaxError(Landmarks, Face.Landmarks) <= 0.00005f + 1e-7f);
+
+	// Too small a buffer writes nothing
+	CHECK(EncodeLandmarks(std::span<char>(Buffer, 100), Info, Face.Landmarks, 640, 480) == 0);
+	Info.DatagramType = EDatagramType::Bytes;
+	CHECK(EncodeLandmarks(std::span<char>(Buffer, 100), Info, Face.Landmarks, 640, 480) == 0);
+}
+
+FACEPIPE_BENCHMARK(EncodeThroughput)
+{
+	const RandomFace Face;
+	MessageInfo Info;
+	Info.Source = "mediapipe";
+	Info.bHasSequence = true;
+
+	EncodeSettings Fixed;
+	Fixed.Precision = 5;
+	EncodeSettings Quantized;
+	Quantized.QuantizedBits = 12;
+
+	struct Case
+	{
+		const char* Name;
+		EDatagramType DatagramType;
+		EFacepipeData DataType;
+		EncodeSettings Settings;
+	};
+
+	const Case Cases[] = {
+		{ "ascii l3d", EDatagramType::ASCII, EFacepipeData::Landmarks3D, {} },
+		{ "ascii l3d precision 5", EDatagramType::ASCII, EFacepipeData::Landmarks3D, Fixed },
+		{ "ascii bs", EDatagramType::ASCII, EFacepipeData::Blendshapes, {} },
+		{ "ascii mat44", EDatagramType::ASCII, EFacepipeData::Matrices4x4, {} },
+		{ "binary l3d", EDatagramType::Bytes, EFacepipeData::Landmarks3D, {} },
+		{ "binary l3d 12 bits", EDatagramType::Bytes, EFacepipeData::Landmarks3D, Quantized },
+		{ "binary bs", EDatagramType::Bytes, EFacepipeData::Blendshapes, {} },
+		{ "binary mat44", EDatagramType::Bytes, EFacepipeData::Matrices4x4, {} },
+	};
+
+	for (const Case& Benchmark : Cases)
+	{
+		Info.DatagramType = Benchmark.DatagramType;
+		Info.DataType = Benchmark.DataType;
+
+		const int Packets = (Benchmark.DatagramType == EDatagramType::ASCII) ? 20000 : 200000;
+		const size_t Allocations = Tests::AllocationCount();
+		size_t Bytes = 0;
+
+		const auto Start = std::chrono::steady_clock::now();
+		for (int i = 0; i < Packets; ++i)
+		{
+			Info.Sequence = (uint32_t) i;
+			switch (Benchmark.DataType)
+			{
+			case EFacepipeData::Landmarks3D: Bytes += EncodeLandmarks(Buffer, Info, Face.Landmarks, 640, 480, Benchmark.Settings); break;
+			case EFacepipeData::Blendshapes: Bytes += EncodeBlendshapes(Buffer, Info, Face.Blendshapes, Benchmark.Settings); break;
+			default: Bytes += EncodeMatrices(Buffer, Info, Face.Matrices, Benchmark.Settings); break;
+			}
+		}
+		const double Seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - Start).count();
+
+		std::printf("    %-24s %10.0f packets/s %6zu bytes\n", Benchmark.Name, Packets / Seconds, Bytes / Packets);
+		CHECK(Tests::AllocationCount() == Allocations);
+	}
+}
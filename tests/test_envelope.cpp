@@ -0,0 +1,293 @@
+#include "tests.h"
+#include "net/facepipe.h"
+#include "net/facepipe_encode.h"
+#include "net/facepipe_envelope.h"
+
+#include <charconv>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <random>
+
+using namespace FacePipe;
+
+// Frames of a MediaPipe face moving slightly, as the Python sender writes them: ASCII values are the shortest
+// representation of the double of a float32 (json.dumps of tolist()), binary values are written by the encoders
+struct RecordedTraffic
+{
+	std::vector<std::vector<char>> Ascii;
+	std::vector<std::vector<char>> Binary;
+	std::vector<std::vector<char>> Quantized;
+
+	RecordedTraffic(size_t FrameCount)
+	{
+		std::mt19937 Random(11);
+		std::normal_distribution<float> Jitter(0.0f, 0.002f);
+		std::uniform_real_distribution<float> Uniform(0.0f, 1.0f);
+
+		std::vector<float> Landmarks(478 * 3);
+		for (size_t i = 0; i < Landmarks.size(); ++i)
+			Landmarks[i] = (i % 3 == 2) ? (Uniform(Random) - 0.5f) * 0.1f : 0.3f + Uniform(Random) * 0.4f;
+
+		BlendshapeFrame Blendshapes;
+		MatrixMap Matrices;
+		std::vector<float>& Face = Matrices["face"];
+		Face = { 0.99f, 0.01f, -0.1f, 0.0f, -0.02f, 0.98f, 0.2f, 0.0f, 0.1f, -0.2f, 0.97f, 0.0f, 1.5f, -4.2f, -45.0f, 1.0f };
+
+		char Buffer[SafeEncodeSize];
+		MessageInfo Info;
+		Info.Source = "mediapipe";
+		Info.bHasSequence = true;
+		Info.DatagramType = EDatagramType::Bytes;
+
+		for (size_t Frame = 0; Frame < FrameCount; ++Frame)
+		{
+			for (float& Value : Landmarks)
+				Value += Jitter(Random);
+			for (size_t i = 0; i < ARKitBlendshapeCount; ++i)
+				Blendshapes.Set(i, Uniform(Random) * Uniform(Random));
+			Blendshapes.Set("_neutral", Uniform(Random) * 1e-5f);
+			Face[12] += Jitter(Random);
+
+			const double Time = 1000.0 + Frame / 30.0;
+			char Header[64];
+			std::snprintf(Header, sizeof(Header), "a|facepipe|mediapipe|0,0,0|%.4f,%zu|", Time, Frame);
+
+			std::string Text = std::string(Header) + "l3d|640,480|";
+			AppendValues(Text, Landmarks);
+			Ascii.emplace_back(Text.begin(), Text.end());
+
+			Text = std::string(Header) + "bs";
+			Text += "|_neutral=";
+			AppendValues(Text, std::span<const float>(&Blendshapes.Other.begin()->second, 1));
+			for (size_t i = 0; i < ARKitBlendshapeCount; ++i)
+			{
+				Text += "|" + std::string(ARKitBlendshapeNames[i]) + "=";
+				AppendValues(Text, std::span<const float>(&Blendshapes.Values[i], 1));
+			}
+			Ascii.emplace_back(Text.begin(), Text.end());
+
+			Text = std::string(Header) + "mat44|face=";
+			AppendValues(Text, Face);
+			Ascii.emplace_back(Text.begin(), Text.end());
+
+			Info.Time = Time;
+			Info.Sequence = (uint32_t) Frame;
+			Info.DataType = EFacepipeData::Landmarks3D;
+			Binary.emplace_back(Buffer, Buffer + EncodeLandmarks(Buffer, Info, Landmarks, 640, 480));
+			EncodeSettings Settings;
+			Settings.QuantizedBits = 12;
+			Quantized.emplace_back(Buffer, Buffer + EncodeLandmarks(Buffer, Info, Landmarks, 640, 480, Settings));
+			Info.DataType = EFacepipeData::Blendshapes;
+			Binary.emplace_back(Buffer, Buffer + EncodeBlendshapes(Buffer, Info, Blendshapes));
+			Info.DataType = EFacepipeData::Matrices4x4;
+			Binary.emplace_back(Buffer, Buffer + EncodeMatrices(Buffer, Info, Matrices));
+		}
+	}
+
+	static void AppendValues(std::string& Text, std::span<const float> Values)
+	{
+		char Value[32];
+		for (size_t i = 0; i < Values.size(); ++i)
+		{
+			if (i > 0)
+				Text += ',';
+			Text.append(Value, std::to_chars(Value, Value + sizeof(Value), (double) Values[i]).ptr);
+		}
+	}
+};
+
+static std::vector<char> Encode(const std::vector<char>& Datagram, EEnvelopeDictionary Dictionary)
+{
+	std::vector<char> Envelope(GetEnvelopeBound(Datagram.size()));
+	Envelope.resize(EncodeEnvelope(Datagram, Envelope, Dictionary));
+	return Envelope;
+}
+
+FACEPIPE_TEST(EnvelopesRoundTrip)
+{
+	const RecordedTraffic Traffic(4);
+	std::vector<char> Decoded;
+
+	for (const auto* Datagrams : { &Traffic.Ascii, &Traffic.Binary, &Traffic.Quantized })
+	{
+		for (const std::vector<char>& Datagram : *Datagrams)
+		{
+			for (EEnvelopeDictionary Dictionary : { EEnvelopeDictionary::None, EEnvelopeDictionary::Preset })
+			{
+				const std::vector<char> Envelope = Encode(Datagram, Dictionary);
+				CHECK(!Envelope.empty() && Envelope[0] == 'e');
+				CHECK(DecodeEnvelope(Envelope, Decoded) && Decoded == Datagram);
+
+				const std::vector<char>* ThreadDecoded = DecodeEnvelope(Envelope);
+				CHECK(ThreadDecoded && *ThreadDecoded == Datagram);
+			}
+		}
+	}
+
+	// Incompressible data does not fit into its own size, the caller sends it as is
+	std::vector<char> Noise(2000);
+	std::mt19937 Random(3);
+	for (char& Byte : Noise)
+		Byte = (char) Random();
+	std::vector<char> Out(Noise.size());
+	CHECK(EncodeEnvelope(Noise, Out) == 0);
+	CHECK(DecodeEnvelope(Encode(Noise, EEnvelopeDictionary::None), Decoded) && Decoded == Noise);
+}
+
+FACEPIPE_TEST(TruncatedEnvelopesFail)
+{
+	const RecordedTraffic Traffic(1);
+	std::vector<char> Decoded;
+
+	for (const std::vector<char>& Datagram : { Traffic.Ascii[0], Traffic.Binary[1] })
+	{
+		const std::vector<char> Envelope = Encode(Datagram, EEnvelopeDictionary::Preset);
+		for (size_t Size = 0; Size < Envelope.size(); ++Size)
+		{
+			const std::vector<char> Truncated(Envelope.begin(), Envelope.begin() + Size);
+			if (DecodeEnvelope(Truncated, Decoded))
+				std::printf("    envelope of %zu bytes decoded from %zu\n", Envelope.size(), Size);
+			CHECK(!DecodeEnvelope(Truncated, Decoded));
+		}
+	}
+}
+
+FACEPIPE_TEST(MalformedEnvelopeHeadersFail)
+{
+	const RecordedTraffic Traffic(1);
+	const std::vector<char> Envelope = Encode(Traffic.Binary[2], EEnvelopeDictionary::Preset);
+	std::vector<char> Decoded;
+
+	EnvelopeHeader Valid;
+	std::memcpy(&Valid, Envelope.data(), sizeof(Valid));
+
+	auto DecodesWith = [&](const EnvelopeHeader& Header)
+	{
+		std::vector<char> Changed = Envelope;
+		std::memcpy(Changed.data(), &Header, sizeof(Header));
+		return DecodeEnvelope(Changed, Decoded);
+	};
+
+	CHECK(DecodesWith(Valid));
+
+	EnvelopeHeader Header = Valid;
+	Header.Type = 'b';
+	CHECK(!DecodesWith(Header));
+
+	Header = Valid;
+	Header.Version = 2;
+	CHECK(!DecodesWith(Header));
+
+	Header = Valid;
+	Header.Codec = 3;
+	CHECK(!DecodesWith(Header));
+
+	Header = Valid;
+	Header.Dictionary = 2;
+	CHECK(!DecodesWith(Header));
+
+	// Without the dictionary the matches into it point before the datagram
+	Header = Valid;
+	Header.Dictionary = (uint8_t) EEnvelopeDictionary::None;
+	CHECK(!DecodesWith(Header));
+
+	// Decoded sizes that do not match the data, or that are beyond the limit
+	for (uint32_t DecodedSize : { 0u, Valid.DecodedSize - 1, Valid.DecodedSize + 1, uint32_t(MaxEnvelopeDecodedSize) + 1, UINT32_MAX })
+	{
+		Header = Valid;
+		Header.DecodedSize = DecodedSize;
+		CHECK(!DecodesWith(Header));
+	}
+}
+
+FACEPIPE_TEST(OversizeEnvelopeMatchesFail)
+{
+	std::vector<char> Decoded;
+
+	auto Envelope = [](uint32_t DecodedSize, std::initializer_list<uint8_t> Block)
+	{
+		EnvelopeHeader Header;
+		Header.DecodedSize = DecodedSize;
+		std::vector<char> Message((const char*) &Header, (const char*) &Header + sizeof(Header));
+		for (uint8_t Byte : Block)
+			Message.push_back((char) Byte);
+		return Message;
+	};
+
+	// 4 literals, then an 8 byte match one byte back repeats the last literal
+	CHECK(DecodeEnvelope(Envelope(12, { 0x44, 'a', 'b', 'c', 'd', 1, 0 }), Decoded) && std::string(Decoded.begin(), Decoded.end()) == "abcddddddddd");
+
+	// Offset 0, before the start without a dictionary, a match longer than the decoded size and a literal run past the input
+	CHECK(!DecodeEnvelope(Envelope(12, { 0x44, 'a', 'b', 'c', 'd', 0, 0 }), Decoded));
+	CHECK(!DecodeEnvelope(Envelope(12, { 0x44, 'a', 'b', 'c', 'd', 5, 0 }), Decoded));
+	CHECK(!DecodeEnvelope(Envelope(11, { 0x44, 'a', 'b', 'c', 'd', 1, 0 }), Decoded));
+	CHECK(!DecodeEnvelope(Envelope(12, { 0xC4, 'a', 'b', 'c', 'd', 1, 0 }), Decoded));
+
+	// Extended lengths that never end or that add up beyond the decoded size
+	CHECK(!DecodeEnvelope(Envelope(100, { 0xF0, 255, 255, 255 }), Decoded));
+	CHECK(!DecodeEnvelope(Envelope(12, { 0x4F, 'a', 'b', 'c', 'd', 1, 0, 255, 255, 10 }), Decoded));
+}
+
+FACEPIPE_TEST(CorruptedEnvelopesAreRejectedOrBounded)
+{
+	const RecordedTraffic Traffic(2);
+	std::mt19937 Random(9);
+	std::vector<char> Decoded;
+	size_t Rejected = 0;
+
+	for (const std::vector<char>& Datagram : Traffic.Ascii)
+	{
+		const std::vector<char> Envelope = Encode(Datagram, EEnvelopeDictionary::Preset);
+		for (int i = 0; i < 2000; ++i)
+		{
+			// Flipped bits in the data, the header is checked above
+			std::vector<char> Corrupted = Envelope;
+			for (int Flip = 1 + Random() % 4; Flip > 0; --Flip)
+				Corrupted[sizeof(EnvelopeHeader) + Random() % (Corrupted.size() - sizeof(EnvelopeHeader))] ^= (char) (1 << (Random() % 8));
+
+			if (!DecodeEnvelope(Corrupted, Decoded))
+				Rejected++;
+			else
+				CHECK(Decoded.size() == Datagram.size());
+		}
+	}
+
+	CHECK(Rejected > 0);
+}
+
+FACEPIPE_BENCHMARK(EnvelopeCompression)
+{
+	const RecordedTraffic Traffic(300);
+	std::vector<char> Decoded;
+
+	struct Case
+	{
+		const char* Name;
+		const std::vector<std::vector<char>>& Datagrams;
+	};
+
+	for (const Case& Benchmark : { Case{ "ascii", Traffic.Ascii }, Case{ "binary", Traffic.Binary }, Case{ "binary 12 bits", Traffic.Quantized } })
+	{
+		for (EEnvelopeDictionary Dictionary : { EEnvelopeDictionary::None, EEnvelopeDictionary::Preset })
+		{
+			std::vector<std::vector<char>> Envelopes;
+			size_t DatagramBytes = 0, EnvelopeBytes = 0;
+			for (const std::vector<char>& Datagram : Benchmark.Datagrams)
+			{
+				Envelopes.push_back(Encode(Datagram, Dictionary));
+				DatagramBytes += Datagram.size();
+				EnvelopeBytes += Envelopes.back().size();
+			}
+
+			const auto Start = std::chrono::steady_clock::now();
+			for (const std::vector<char>& Envelope : Envelopes)
+				CHECK(DecodeEnvelope(Envelope, Decoded));
+			const double Seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - Start).count();
+
+			std::printf("    %-16s %-7s %6.2fx %8.2f us per datagram (%zu bytes average)\n", Benchmark.Name,
+				(Dictionary == EEnvelopeDictionary::Preset) ? "preset" : "none", (double) DatagramBytes / EnvelopeBytes,
+				Seconds * 1e6 / Envelopes.size(), DatagramBytes / Benchmark.Datagrams.size());
+		}
+	}
+}
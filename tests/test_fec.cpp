@@ -0,0 +1,205 @@
+#include "tests.h"
+#include "net/facepipe_fec.h"
+#include "net/udp.h"
+
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <functional>
+#include <random>
+#include <thread>
+
+using namespace FacePipe;
+
+static const size_t GroupSize = 4;
+
+// Datagram i, 300 to 1400 bytes of a pattern that depends on i so that a rebuilt packet can be compared byte for byte
+static std::vector<char> MakeDatagram(uint32_t i)
+{
+	std::vector<char> Datagram(300 + (i * 7919) % 1100);
+	for (size_t k = 0; k < Datagram.size(); ++k)
+		Datagram[k] = (char) (i * 31 + k * 7);
+	std::memcpy(Datagram.data(), &i, sizeof(i));
+	return Datagram;
+}
+
+struct LoopbackResult
+{
+	size_t Dropped = 0;		// datagrams not sent, parity packets not counted
+	size_t Missing = 0;		// datagrams that were neither received nor rebuilt
+	size_t Corrupt = 0;		// rebuilt wrongly or delivered twice
+	size_t ExpectedRecovered = 0;
+	size_t ExpectedUnrecoverable = 0;
+	size_t Recovered = 0;
+	size_t Unrecoverable = 0;
+};
+
+// Sends GroupCount groups from one UDPSocket to another over loopback, skipping the packets for which Drop(Group, Index)
+// is true (Index GroupSize is the parity). The receiver unwraps them with a ParityDecoder on a simulated clock.
+static LoopbackResult RunLoopback(size_t GroupCount, const std::function<bool(size_t, size_t)>& Drop)
+{
+	LoopbackResult Result;
+
+	Net::StartWinsock();
+	UDPSocket Sender(Net::LocalHost, 0);
+	UDPSocket Receiver(Net::LocalHost, 29017);
+	UDPTarget Target;
+	CHECK(Sender.Start() && Receiver.Start() && UDPSocket::Resolve(Receiver, Target));
+
+	ParityEncoder Encoder(GroupSize);
+	ParityDecoder Decoder;
+	std::vector<char> Packet, Parity, Unwrapped;
+	std::vector<UDPDatagram> Received;
+	std::vector<int> Delivered(GroupCount * GroupSize, 0);
+
+	auto Deliver = [&](const std::vector<char>& Datagram)
+	{
+		uint32_t i = 0;
+		if (Datagram.size() < sizeof(i))
+		{
+			Result.Corrupt++;
+			return;
+		}
+
+		std::memcpy(&i, Datagram.data(), sizeof(i));
+		if (i >= Delivered.size() || Datagram != MakeDatagram(i) || Delivered[i]++ > 0)
+			Result.Corrupt++;
+	};
+
+	auto Drain = [&](double Now)
+	{
+		Received.clear();
+		Receiver.Receive(Received);
+		for (const UDPDatagram& Datagram : Received)
+		{
+			if (Decoder.Add(Datagram.message, Datagram.source.Key(), Now, Unwrapped))
+				Deliver(Unwrapped);
+			if (Decoder.TakeRecovered(Unwrapped))
+				Deliver(Unwrapped);
+		}
+	};
+
+	for (size_t Group = 0; Group < GroupCount; ++Group)
+	{
+		size_t DroppedInGroup = 0;
+		bool bAnyReceived = false;
+
+		for (size_t Index = 0; Index < GroupSize; ++Index)
+		{
+			const bool bCompleted = Encoder.Protect(MakeDatagram((uint32_t) (Group * GroupSize + Index)), Packet, Parity);
+			if (Drop(Group, Index))
+			{
+				DroppedInGroup++;
+			}
+			else
+			{
+				Sender.Queue(Packet, Target);
+				bAnyReceived = true;
+			}
+
+			if (bCompleted && !Drop(Group, GroupSize))
+			{
+				Sender.Queue(Parity, Target);
+				bAnyReceived = true;
+			}
+		}
+		CHECK(Sender.Flush());
+
+		// Groups of which nothing arrived are not counted by the decoder
+		const bool bParityReceived = !Drop(Group, GroupSize);
+		Result.Dropped += DroppedInGroup;
+		if (DroppedInGroup == 1 && bParityReceived)
+			Result.ExpectedRecovered++;
+		else if (bAnyReceived)
+			Result.ExpectedUnrecoverable += DroppedInGroup;
+
+		Drain(Group * 0.002);
+	}
+
+	// Whatever is still in flight, then every group is closed
+	for (int Attempt = 0; Attempt < 10; ++Attempt)
+	{
+		std::this_thread::sleep_for(std::chrono::milliseconds(2));
+		Drain(GroupCount * 0.002);
+	}
+	Decoder.Expire(1e9);
+
+	for (int Count : Delivered)
+		Result.Missing += (Count == 0) ? 1 : 0;
+
+	Result.Recovered = Decoder.RecoveredCount;
+	Result.Unrecoverable = Decoder.UnrecoverableCount;
+	CHECK(Decoder.InvalidCount == 0);
+	return Result;
+}
+
+static void CheckResult(const char* Name, const LoopbackResult& Result)
+{
+	const bool bExpected = Result.Corrupt == 0 && Result.Recovered == Result.ExpectedRecovered && Result.Unrecoverable == Result.ExpectedUnrecoverable
+		&& Result.Recovered + Result.Missing == Result.Dropped;
+	if (!bExpected)
+	{
+		std::printf("    %s: dropped %zu, recovered %zu (expected %zu), unrecoverable %zu (expected %zu), missing %zu, corrupt %zu\n", Name,
+			Result.Dropped, Result.Recovered, Result.ExpectedRecovered, Result.Unrecoverable, Result.ExpectedUnrecoverable, Result.Missing, Result.Corrupt);
+	}
+	CHECK(bExpected);
+}
+
+FACEPIPE_TEST(ParityRebuildsSingleLossesOverLoopback)
+{
+	// Per group of 4 and its parity: nothing lost, one packet, two packets, only the parity, one packet and the parity
+	const LoopbackResult Result = RunLoopback(500, [](size_t Group, size_t Index)
+	{
+		const size_t Lost = Group % GroupSize;
+		switch (Group % 5)
+		{
+		case 1: return Index == Lost;
+		case 2: return Index == Lost || Index == (Lost + 1) % GroupSize;
+		case 3: return Index == GroupSize;
+		case 4: return Index == Lost || Index == GroupSize;
+		default: return false;
+		}
+	});
+
+	CheckResult("pattern", Result);
+	CHECK(Result.Recovered == 100 && Result.Unrecoverable == 100 * 2 + 100 && Result.Missing == 300);
+}
+
+FACEPIPE_TEST(ParityRebuildsRandomLossesOverLoopback)
+{
+	for (double DropRate : { 0.01, 0.05, 0.2 })
+	{
+		std::mt19937 Random((uint32_t) (DropRate * 1000));
+		std::uniform_real_distribution<double> Uniform(0.0, 1.0);
+
+		// Decided up front since Drop is asked twice for the parity
+		std::vector<bool> Dropped(2000 * (GroupSize + 1));
+		for (size_t i = 0; i < Dropped.size(); ++i)
+			Dropped[i] = Uniform(Random) < DropRate;
+
+		const LoopbackResult Result = RunLoopback(2000, [&](size_t Group, size_t Index) { return Dropped[Group * (GroupSize + 1) + Index]; });
+
+		char Name[32];
+		std::snprintf(Name, sizeof(Name), "drop rate %.2f", DropRate);
+		CheckResult(Name, Result);
+	}
+}
+
+FACEPIPE_TEST(ProtectedQueueRejectsUnusableSizesAndTargets)
+{
+	UDPSocket Sender(Net::LocalHost, 0);
+	UDPTarget Target; // any valid loopback target, nothing is flushed
+	Target.address = 0x0100007F;
+	Target.port = 0x1771;
+
+	UDPDatagram Datagram;
+	Datagram.message = MakeDatagram(1);
+
+	// No room for a payload after the parity and fragment headers, the fragment size must not wrap around
+	ParityEncoder Encoder(GroupSize);
+	CHECK(!Sender.QueueProtected(Datagram, Target, Encoder, 0));
+	CHECK(!Sender.QueueProtected(Datagram, Target, Encoder, sizeof(ParityHeader) + sizeof(FragmentHeader)));
+	CHECK(!Sender.QueueProtected(Datagram, UDPTarget(), Encoder));
+	CHECK(!Sender.QueueFragmented(Datagram, UDPTarget()));
+	CHECK(Sender.QueueProtected(Datagram, Target, Encoder, sizeof(ParityHeader) + sizeof(FragmentHeader) + 100));
+}
@@ -0,0 +1,230 @@
+#include "tests.h"
+#include "net/facepipe_fragment.h"
+
+#include <cstring>
+
+using namespace FacePipe;
+
+// A message of Size bytes with a pattern that depends on Seed, so that mixed up fragments show
+static std::vector<char> MakeMessage(size_t Size, uint32_t Seed)
+{
+	std::vector<char> Message(Size);
+	for (size_t i = 0; i < Size; ++i)
+		Message[i] = (char) (Seed * 131 + i * 7);
+	return Message;
+}
+
+static std::vector<std::vector<char>> Fragment(const std::vector<char>& Message, uint32_t MessageId, size_t MaxDatagramSize = 1000)
+{
+	std::vector<std::vector<char>> Fragments(GetFragmentCount(Message.size(), MaxDatagramSize));
+	for (size_t i = 0; i < Fragments.size(); ++i)
+		CHECK(WriteFragment(Message, MessageId, i, MaxDatagramSize, Fragments[i]));
+	return Fragments;
+}
+
+static void SetHeader(std::vector<char>& Fragment, const FragmentHeader& Header)
+{
+	std::memcpy(Fragment.data(), &Header, sizeof(Header));
+}
+
+FACEPIPE_TEST(FragmentsReassembleInAnyOrder)
+{
+	const std::vector<char> Message = MakeMessage(4500, 1);
+	const std::vector<std::vector<char>> Fragments = Fragment(Message, 1);
+	CHECK(Fragments.size() == 5);
+
+	FragmentReassembler Reassembler;
+	std::vector<char> Out;
+	const size_t Order[] = { 3, 0, 4, 2, 1 };
+	for (size_t i = 0; i < 5; ++i)
+	{
+		const bool bCompleted = Reassembler.Add(Fragments[Order[i]], 1, 0.0, Out);
+		CHECK(bCompleted == (i == 4));
+	}
+
+	CHECK(Out == Message);
+	CHECK(Reassembler.CompletedCount == 1 && Reassembler.InvalidCount == 0);
+
+	// A single fragment message completes right away
+	const std::vector<char> Small = MakeMessage(100, 2);
+	CHECK(Reassembler.Add(Fragment(Small, 2)[0], 1, 0.0, Out) && Out == Small);
+}
+
+FACEPIPE_TEST(FragmentsOfDifferentSendersDoNotMix)
+{
+	const std::vector<char> A = MakeMessage(2500, 1);
+	const std::vector<char> B = MakeMessage(2500, 2);
+	const std::vector<std::vector<char>> FragmentsA = Fragment(A, 7);
+	const std::vector<std::vector<char>> FragmentsB = Fragment(B, 7);
+
+	FragmentReassembler Reassembler;
+	std::vector<char> Out;
+	for (size_t i = 0; i + 1 < FragmentsA.size(); ++i)
+	{
+		CHECK(!Reassembler.Add(FragmentsA[i], 100, 0.0, Out));
+		CHECK(!Reassembler.Add(FragmentsB[i], 200, 0.0, Out));
+	}
+
+	CHECK(Reassembler.Add(FragmentsB.back(), 200, 0.0, Out) && Out == B);
+	CHECK(Reassembler.Add(FragmentsA.back(), 100, 0.0, Out) && Out == A);
+}
+
+FACEPIPE_TEST(DuplicateFragmentsAreIgnored)
+{
+	const std::vector<char> Message = MakeMessage(2500, 3);
+	const std::vector<std::vector<char>> Fragments = Fragment(Message, 3);
+	CHECK(Fragments.size() == 3);
+
+	FragmentReassembler Reassembler;
+	std::vector<char> Out;
+	CHECK(!Reassembler.Add(Fragments[0], 1, 0.0, Out));
+	CHECK(!Reassembler.Add(Fragments[0], 1, 0.0, Out));
+	CHECK(!Reassembler.Add(Fragments[1], 1, 0.0, Out));
+	CHECK(Reassembler.Add(Fragments[2], 1, 0.0, Out) && Out == Message);
+
+	// Late duplicates of a completed message neither start nor complete it again
+	for (const std::vector<char>& Late : Fragments)
+		CHECK(!Reassembler.Add(Late, 1, 0.01, Out));
+
+	CHECK(Reassembler.CompletedCount == 1 && Reassembler.InvalidCount == 0 && Reassembler.EvictedCount == 0);
+}
+
+FACEPIPE_TEST(IncompleteFragmentsTimeOut)
+{
+	const std::vector<char> Message = MakeMessage(2500, 4);
+	const std::vector<std::vector<char>> Fragments = Fragment(Message, 4);
+
+	FragmentReassembler Reassembler(8, 0.25);
+	std::vector<char> Out;
+	CHECK(!Reassembler.Add(Fragments[0], 1, 0.0, Out));
+
+	// The rest arrives too late, the message is dropped and the rest starts it over without the first fragment
+	CHECK(!Reassembler.Add(Fragments[1], 1, 0.3, Out));
+	CHECK(!Reassembler.Add(Fragments[2], 1, 0.3, Out));
+	CHECK(Reassembler.TimedOutCount == 1 && Reassembler.CompletedCount == 0);
+
+	Reassembler.Expire(1.0);
+	CHECK(Reassembler.TimedOutCount == 2);
+}
+
+FACEPIPE_TEST(FullTableEvictsTheOldestMessage)
+{
+	std::vector<std::vector<char>> Messages;
+	std::vector<std::vector<std::vector<char>>> Fragments;
+	for (uint32_t Id = 0; Id < 3; ++Id)
+	{
+		Messages.push_back(MakeMessage(1500, Id));
+		Fragments.push_back(Fragment(Messages.back(), Id));
+	}
+
+	FragmentReassembler Reassembler(2, 0.25);
+	std::vector<char> Out;
+	for (uint32_t Id = 0; Id < 3; ++Id)
+		CHECK(!Reassembler.Add(Fragments[Id][0], 1, 0.01 * Id, Out));
+
+	CHECK(Reassembler.EvictedCount == 1);
+
+	CHECK(Reassembler.Add(Fragments[1][1], 1, 0.05, Out) && Out == Messages[1]);
+	CHECK(Reassembler.Add(Fragments[2][1], 1, 0.05, Out) && Out == Messages[2]);
+
+	// Message 0 lost its first fragment with the eviction
+	CHECK(!Reassembler.Add(Fragments[0][1], 1, 0.05, Out));
+	CHECK(Reassembler.CompletedCount == 2);
+}
+
+FACEPIPE_TEST(ContradictingFragmentsAreInvalid)
+{
+	const std::vector<char> Message = MakeMessage(2500, 5);
+	const std::vector<std::vector<char>> Fragments = Fragment(Message, 5);
+
+	FragmentReassembler Reassembler;
+	std::vector<char> Out;
+	CHECK(!Reassembler.Add(Fragments[0], 1, 0.0, Out));
+
+	// Same id, different total size
+	const std::vector<std::vector<char>> Other = Fragment(MakeMessage(2400, 6), 5);
+	CHECK(!Reassembler.Add(Other[1], 1, 0.0, Out));
+	CHECK(Reassembler.InvalidCount == 1);
+
+	// Same id, different fragment size and count
+	const std::vector<std::vector<char>> Smaller = Fragment(Message, 5, 600);
+	CHECK(!Reassembler.Add(Smaller[1], 1, 0.0, Out));
+	CHECK(Reassembler.InvalidCount == 2);
+
+	// The original message is unaffected
+	CHECK(!Reassembler.Add(Fragments[1], 1, 0.0, Out));
+	CHECK(Reassembler.Add(Fragments[2], 1, 0.0, Out) && Out == Message);
+}
+
+FACEPIPE_TEST(MalformedFragmentsAreInvalid)
+{
+	const std::vector<char> Message = MakeMessage(2500, 7);
+	const std::vector<std::vector<char>> Fragments = Fragment(Message, 7);
+
+	FragmentHeader Header;
+	CHECK(ReadFragmentHeader(Fragments[0], Header) && Header.FragmentCount == 3 && Header.FragmentSize == 1000 - sizeof(FragmentHeader));
+
+	std::vector<std::vector<char>> Malformed;
+
+	// Too short for a header, or a header without payload
+	Malformed.push_back(std::vector<char>(Fragments[0].begin(), Fragments[0].begin() + 5));
+	Malformed.push_back(std::vector<char>(Fragments[0].begin(), Fragments[0].begin() + sizeof(FragmentHeader)));
+
+	// Payload one byte short, or one byte too long
+	Malformed.push_back(std::vector<char>(Fragments[1].begin(), Fragments[1].end() - 1));
+	Malformed.push_back(Fragments[1]);
+	Malformed.back().push_back(0);
+
+	// The last fragment's payload does not match what is left of the message
+	Malformed.push_back(std::vector<char>(Fragments[2].begin(), Fragments[2].end() - 1));
+
+	auto Corrupt = [&](auto&& Change)
+	{
+		FragmentHeader Changed = Header;
+		Change(Changed);
+		Malformed.push_back(Fragments[0]);
+		SetHeader(Malformed.back(), Changed);
+	};
+
+	Corrupt([](FragmentHeader& H) { H.Type = 'x'; });
+	Corrupt([](FragmentHeader& H) { H.Version = 2; });
+	Corrupt([](FragmentHeader& H) { H.FragmentIndex = 3; });
+	Corrupt([](FragmentHeader& H) { H.FragmentCount = 0; });
+	Corrupt([](FragmentHeader& H) { H.FragmentCount = MaxFragmentCount + 1; });
+	Corrupt([](FragmentHeader& H) { H.FragmentSize = 0; });
+	Corrupt([](FragmentHeader& H) { H.MessageSize = 0; });
+	Corrupt([](FragmentHeader& H) { H.MessageSize = MaxFragmentedMessageSize + 1; });
+
+	// Totals that contradict the fragment size: too large for 3 fragments, or small enough for 2
+	Corrupt([](FragmentHeader& H) { H.MessageSize = 3 * H.FragmentSize + 1; });
+	Corrupt([](FragmentHeader& H) { H.MessageSize = 2 * H.FragmentSize; });
+
+	FragmentReassembler Reassembler;
+	std::vector<char> Out;
+	for (const std::vector<char>& Bad : Malformed)
+		CHECK(!Reassembler.Add(Bad, 1, 0.0, Out));
+
+	CHECK(Reassembler.InvalidCount == Malformed.size());
+
+	// None of them started a message, the real fragments still complete it
+	for (size_t i = 0; i < Fragments.size(); ++i)
+		CHECK(Reassembler.Add(Fragments[i], 1, 0.0, Out) == (i + 1 == Fragments.size()));
+
+	CHECK(Out == Message && Reassembler.EvictedCount == 0);
+}
+
+FACEPIPE_TEST(FragmentCountLimits)
+{
+	CHECK(GetFragmentCount(0) == 0);
+	CHECK(GetFragmentCount(1) == 1);
+	CHECK(GetFragmentCount(SafeDatagramSize - sizeof(FragmentHeader)) == 1);
+	CHECK(GetFragmentCount(SafeDatagramSize - sizeof(FragmentHeader) + 1) == 2);
+	CHECK(GetFragmentCount(MaxFragmentedMessageSize + 1, 65507) == 0);
+	CHECK(GetFragmentCount(100, sizeof(FragmentHeader)) == 0);
+
+	// More than MaxFragmentCount fragments of a small datagram size
+	CHECK(GetFragmentCount(MaxFragmentCount * 100 + 1, 100 + sizeof(FragmentHeader)) == 0);
+
+	std::vector<char> Out;
+	CHECK(!WriteFragment(MakeMessage(100, 8), 8, 1, 1000, Out));
+}
@@ -0,0 +1,134 @@
+#include "tests.h"
+#include "net/facepipe_livelink.h"
+
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+
+using namespace FacePipe;
+
+static void PutBigEndian(std::vector<char>& Out, uint32_t Value)
+{
+	for (int Shift = 24; Shift >= 0; Shift -= 8)
+		Out.push_back((char) (Value >> Shift));
+}
+
+static void PutBigEndian(std::vector<char>& Out, float Value)
+{
+	uint32_t Bits;
+	std::memcpy(&Bits, &Value, sizeof(Bits));
+	PutBigEndian(Out, Bits);
+}
+
+static void PutString(std::vector<char>& Out, const char* Text)
+{
+	PutBigEndian(Out, (uint32_t) std::strlen(Text));
+	Out.insert(Out.end(), Text, Text + std::strlen(Text));
+}
+
+static float FixtureValue(size_t i) { return (float) i / 64.0f - 0.25f; }
+
+// A packet as Live Link Face sends it: frame 1234.5 at 60 fps, 52 blendshapes and 9 rotations
+static std::vector<char> MakeFixture(const char* SubjectName = "iPhone")
+{
+	std::vector<char> Packet;
+	Packet.push_back((char) LiveLinkFaceVersion);
+	PutString(Packet, "7C1D5F2A-3B9E-4C60-8D2F-0A1B2C3D4E5F");
+	PutString(Packet, SubjectName);
+	PutBigEndian(Packet, (uint32_t) 1234);
+	PutBigEndian(Packet, 0.5f);
+	PutBigEndian(Packet, (uint32_t) 60);
+	PutBigEndian(Packet, (uint32_t) 1);
+	Packet.push_back((char) 61);
+	for (size_t i = 0; i < 61; ++i)
+		PutBigEndian(Packet, FixtureValue(i));
+	return Packet;
+}
+
+FACEPIPE_TEST(LiveLinkFacePacketParses)
+{
+	const std::vector<char> Packet = MakeFixture();
+
+	MessageInfo Info;
+	CHECK(ParseHeader(Packet, Info));
+	CHECK(Info.DatagramType == EDatagramType::LiveLinkFace && Info.DataType == EFacepipeData::Blendshapes && Info.Source == LiveLinkFaceSource);
+	CHECK(std::abs(Info.Time - 1234.5 / 60.0) < 1e-9);
+
+	BlendshapeFrame Blendshapes;
+	CHECK(GetBlendshapes(Packet, Info, Blendshapes));
+	for (size_t i = 0; i < ARKitBlendshapeCount; ++i)
+		CHECK(Blendshapes.IsValid(i) && Blendshapes.Values[i] == FixtureValue(i));
+
+	CHECK(Blendshapes.Other.size() == LiveLinkFaceRotationCount);
+	for (size_t i = 0; i < LiveLinkFaceRotationCount; ++i)
+	{
+		auto Rotation = Blendshapes.Other.find(LiveLinkFaceRotationNames[i]);
+		CHECK(Rotation != Blendshapes.Other.end() && Rotation->second == FixtureValue(ARKitBlendshapeCount + i));
+	}
+
+	std::string_view SubjectName;
+	CHECK(GetLiveLinkFaceSubjectName(Packet, Info, SubjectName) && SubjectName == "iPhone");
+
+	// Phones stay apart by subject name
+	MessageInfo Other;
+	CHECK(ParseHeader(MakeFixture("iPad"), Other) && Other.Subject != Info.Subject);
+
+	// Receivers may append a terminator
+	std::vector<char> Terminated = Packet;
+	Terminated.push_back('\0');
+	CHECK(ParseHeader(Terminated, Other) && Other.Subject == Info.Subject && GetBlendshapes(Terminated, Other, Blendshapes));
+}
+
+FACEPIPE_TEST(TruncatedLiveLinkFacePacketsFail)
+{
+	const std::vector<char> Packet = MakeFixture();
+
+	MessageInfo Info;
+	BlendshapeFrame Blendshapes;
+	for (size_t Size = 0; Size < Packet.size(); ++Size)
+	{
+		const std::vector<char> Truncated(Packet.begin(), Packet.begin() + Size);
+		if (ParseHeader(Truncated, Info))
+		{
+			std::printf("    packet truncated to %zu of %zu bytes parsed\n", Size, Packet.size());
+			CHECK(false);
+		}
+	}
+
+	// String lengths pointing past the end of the packet
+	std::vector<char> Corrupt = Packet;
+	Corrupt[1] = (char) 0x7F;
+	CHECK(!ParseHeader(Corrupt, Info));
+
+	// Fewer values than ARKit blendshapes
+	std::vector<char> Short;
+	Short.assign(Packet.begin(), Packet.begin() + (Packet.size() - 61 * sizeof(float) - 1));
+	Short.push_back((char) (ARKitBlendshapeCount - 1));
+	for (size_t i = 0; i + 1 < ARKitBlendshapeCount; ++i)
+		PutBigEndian(Short, FixtureValue(i));
+	CHECK(!ParseHeader(Short, Info));
+
+	// A view narrowed past the message is rejected by the getter as well
+	CHECK(ParseHeader(Packet, Info));
+	const std::vector<char> Cut(Packet.begin(), Packet.end() - sizeof(float));
+	CHECK(!GetBlendshapes(Cut, Info, Blendshapes));
+}
+
+FACEPIPE_TEST(OtherLiveLinkFaceVersionsFail)
+{
+	MessageInfo Info;
+	for (uint8_t Version : { 0, 5, 7, 255 })
+	{
+		std::vector<char> Packet = MakeFixture();
+		Packet[0] = (char) Version;
+		CHECK(!ParseHeader(Packet, Info));
+		CHECK(!ParseLiveLinkFaceHeader(Packet, Info));
+	}
+
+	// A FacePipe datagram is not mistaken for a Live Link Face packet
+	const char Ascii[] = "a|facepipe|mediapipe|0,0,0|1.0|bs|jawOpen=0.5";
+	const std::vector<char> Message(Ascii, Ascii + sizeof(Ascii) - 1);
+	std::string_view SubjectName;
+	CHECK(ParseHeader(Message, Info) && Info.DatagramType == EDatagramType::ASCII);
+	CHECK(!ParseLiveLinkFaceHeader(Message, Info) && !GetLiveLinkFaceSubjectName(Message, Info, SubjectName));
+}
@@ -0,0 +1,185 @@
+#include "tests.h"
+#include "net/facepipe_mesh.h"
+
+#include <cstring>
+#include <string>
+
+using namespace FacePipe;
+
+// A quad of two triangles with uvs at the corners of the texture
+static const uint32_t QuadIndices[] = { 0, 1, 2, 0, 2, 3 };
+static const float QuadUVs[] = { 0.0f, 0.0f, 1.0f, 0.0f, 1.0f, 1.0f, 0.0f, 1.0f };
+static const float QuadPositions[] = { 0.0f, 0.0f, 0.0f, 1.0f, 0.0f, 0.0f, 1.0f, 1.0f, 0.0f, 0.0f, 1.0f, 0.5f };
+
+template<typename T>
+static void Append(std::vector<char>& Out, const T& Value)
+{
+	Out.insert(Out.end(), (const char*) &Value, (const char*) &Value + sizeof(T));
+}
+
+static std::vector<char> MakeAscii(const std::string& Content)
+{
+	const std::string Text = "a|facepipe|mediapipe|0,0,0|1.0|" + Content;
+	return std::vector<char>(Text.begin(), Text.end());
+}
+
+static std::vector<char> MakeBinary(EFacepipeData DataType, const std::vector<char>& Content)
+{
+	BinaryHeader Header;
+	Header.DataType = (uint8_t) DataType;
+
+	std::vector<char> Message;
+	Append(Message, Header);
+	Message.insert(Message.end(), Content.begin(), Content.end());
+	return Message;
+}
+
+// Binary topology content, the counts in front of the arrays are taken from the spans
+static std::vector<char> MakeTopologyContent(uint32_t Id, uint32_t VertexCount, std::span<const uint32_t> Indices, std::span<const float> UVs)
+{
+	std::vector<char> Content;
+	Append(Content, Id);
+	Append(Content, VertexCount);
+	Append(Content, (uint32_t) Indices.size());
+	Append(Content, (uint32_t) (UVs.size() / 2));
+	for (uint32_t Index : Indices)
+		Append(Content, Index);
+	for (float UV : UVs)
+		Append(Content, UV);
+	return Content;
+}
+
+static std::vector<char> MakeVerticesContent(uint32_t Id, uint32_t VertexCount, std::span<const float> Positions)
+{
+	std::vector<char> Content;
+	Append(Content, Id);
+	Append(Content, VertexCount);
+	Append(Content, (uint32_t) 0);
+	Append(Content, (uint32_t) 0);
+	for (float Position : Positions)
+		Append(Content, Position);
+	return Content;
+}
+
+static bool UpdateTopology(MeshTopologyCache& Cache, const std::vector<char>& Message)
+{
+	MessageInfo Info;
+	return ParseHeader(Message, Info) && Cache.Update(Message, Info);
+}
+
+static bool ReadVertices(const MeshTopologyCache& Cache, const std::vector<char>& Message, std::vector<float>& OutPositions)
+{
+	MessageInfo Info;
+	uint32_t Id = 0, VertexCount = 0;
+	if (!ParseHeader(Message, Info) || !GetMeshVertexCount(Message, Info, Id, VertexCount))
+		return false;
+
+	const MeshTopology* Topology = Cache.Find(Id);
+	if (!Topology || Topology->VertexCount != VertexCount)
+		return false;
+
+	OutPositions.resize((size_t) VertexCount * 3);
+	return GetMeshVertices(Message, Info, OutPositions.data(), VertexCount);
+}
+
+FACEPIPE_TEST(MeshTopologyAndVerticesDecode)
+{
+	const uint32_t Id = HashMeshTopology(4, QuadIndices, QuadUVs);
+	const std::vector<float> Expected(std::begin(QuadPositions), std::end(QuadPositions));
+
+	MeshTopologyCache Cache;
+	CHECK(UpdateTopology(Cache, MakeAscii("meshtopo|" + std::to_string(Id) + "|4|0,1,2,0,2,3|0,0,1,0,1,1,0,1")));
+
+	const MeshTopology* Topology = Cache.Find(Id);
+	CHECK(Topology && Topology->VertexCount == 4);
+	CHECK(Topology && Topology->Indices == std::vector<uint32_t>(std::begin(QuadIndices), std::end(QuadIndices)));
+	CHECK(Topology && Topology->UVs == std::vector<float>(std::begin(QuadUVs), std::end(QuadUVs)));
+
+	std::vector<float> Positions;
+	CHECK(ReadVertices(Cache, MakeAscii("mesh|" + std::to_string(Id) + "|0,0,0,1,0,0,1,1,0,0,1,0.5"), Positions) && Positions == Expected);
+
+	// The same topology and vertices as binary content
+	MeshTopologyCache BinaryCache;
+	CHECK(UpdateTopology(BinaryCache, MakeBinary(EFacepipeData::MeshTopology, MakeTopologyContent(Id, 4, QuadIndices, QuadUVs))));
+	CHECK(BinaryCache.Find(Id) && BinaryCache.Find(Id)->Indices == Topology->Indices);
+
+	Positions.clear();
+	CHECK(ReadVertices(BinaryCache, MakeBinary(EFacepipeData::Mesh, MakeVerticesContent(Id, 4, QuadPositions)), Positions) && Positions == Expected);
+
+	// UVs are optional
+	const uint32_t NoUVsId = HashMeshTopology(4, QuadIndices, {});
+	CHECK(UpdateTopology(Cache, MakeAscii("meshtopo|" + std::to_string(NoUVsId) + "|4|0,1,2,0,2,3")));
+	CHECK(Cache.Find(NoUVsId) && Cache.Find(NoUVsId)->UVs.empty());
+}
+
+FACEPIPE_TEST(UnknownMeshTopologiesAreNotFound)
+{
+	const uint32_t Id = HashMeshTopology(4, QuadIndices, QuadUVs);
+
+	MeshTopologyCache Cache;
+	std::vector<float> Positions;
+	CHECK(Cache.Find(Id) == nullptr);
+	CHECK(!ReadVertices(Cache, MakeBinary(EFacepipeData::Mesh, MakeVerticesContent(Id, 4, QuadPositions)), Positions));
+
+	// An id that does not match the content is not cached
+	CHECK(!UpdateTopology(Cache, MakeBinary(EFacepipeData::MeshTopology, MakeTopologyContent(Id + 1, 4, QuadIndices, QuadUVs))));
+	CHECK(!UpdateTopology(Cache, MakeAscii("meshtopo|" + std::to_string(Id + 1) + "|4|0,1,2,0,2,3|0,0,1,0,1,1,0,1")));
+	CHECK(Cache.Find(Id + 1) == nullptr);
+
+	// The oldest topology is dropped once the cache is full
+	CHECK(UpdateTopology(Cache, MakeBinary(EFacepipeData::MeshTopology, MakeTopologyContent(Id, 4, QuadIndices, QuadUVs))));
+	for (uint32_t VertexCount = 5; VertexCount < 5 + MeshTopologyCache::MaxTopologies; ++VertexCount)
+	{
+		const uint32_t OtherId = HashMeshTopology(VertexCount, QuadIndices, {});
+		CHECK(UpdateTopology(Cache, MakeBinary(EFacepipeData::MeshTopology, MakeTopologyContent(OtherId, VertexCount, QuadIndices, {}))));
+	}
+	CHECK(Cache.Find(Id) == nullptr);
+}
+
+FACEPIPE_TEST(MeshCountsBeyondTheDeclaredSizeFail)
+{
+	MeshTopologyCache Cache;
+
+	// Hashes match the content, the content itself is inconsistent
+	const uint32_t OutOfRange[] = { 0, 1, 2, 0, 2, 4 };
+	CHECK(!UpdateTopology(Cache, MakeBinary(EFacepipeData::MeshTopology, MakeTopologyContent(HashMeshTopology(4, OutOfRange, {}), 4, OutOfRange, {}))));
+	CHECK(!UpdateTopology(Cache, MakeAscii("meshtopo|" + std::to_string(HashMeshTopology(4, OutOfRange, {})) + "|4|0,1,2,0,2,4")));
+
+	const std::span<const uint32_t> PartialTriangle(QuadIndices, 5);
+	CHECK(!UpdateTopology(Cache, MakeBinary(EFacepipeData::MeshTopology, MakeTopologyContent(HashMeshTopology(4, PartialTriangle, {}), 4, PartialTriangle, {}))));
+
+	const std::span<const float> ShortUVs(QuadUVs, 6);
+	CHECK(!UpdateTopology(Cache, MakeBinary(EFacepipeData::MeshTopology, MakeTopologyContent(HashMeshTopology(4, QuadIndices, ShortUVs), 4, QuadIndices, ShortUVs))));
+
+	CHECK(!UpdateTopology(Cache, MakeBinary(EFacepipeData::MeshTopology, MakeTopologyContent(HashMeshTopology(0, {}, {}), 0, {}, {}))));
+
+	// Index and uv counts that claim more than the content holds
+	const uint32_t Id = HashMeshTopology(4, QuadIndices, QuadUVs);
+	std::vector<char> Content = MakeTopologyContent(Id, 4, QuadIndices, QuadUVs);
+	const uint32_t TooMany = 0x40000000;
+	std::memcpy(Content.data() + 2 * sizeof(uint32_t), &TooMany, sizeof(TooMany));
+	CHECK(!UpdateTopology(Cache, MakeBinary(EFacepipeData::MeshTopology, Content)));
+
+	Content = MakeTopologyContent(Id, 4, QuadIndices, QuadUVs);
+	std::memcpy(Content.data() + 3 * sizeof(uint32_t), &TooMany, sizeof(TooMany));
+	CHECK(!UpdateTopology(Cache, MakeBinary(EFacepipeData::MeshTopology, Content)));
+
+	Content = MakeTopologyContent(Id, 4, QuadIndices, QuadUVs);
+	Content.pop_back();
+	CHECK(!UpdateTopology(Cache, MakeBinary(EFacepipeData::MeshTopology, Content)));
+
+	// Vertex packets must carry exactly the vertices of their topology
+	CHECK(UpdateTopology(Cache, MakeBinary(EFacepipeData::MeshTopology, MakeTopologyContent(Id, 4, QuadIndices, QuadUVs))));
+
+	std::vector<float> Positions(4 * 3);
+	const std::vector<char> Vertices = MakeBinary(EFacepipeData::Mesh, MakeVerticesContent(Id, 4, QuadPositions));
+	MessageInfo Info;
+	CHECK(ParseHeader(Vertices, Info) && !GetMeshVertices(Vertices, Info, Positions.data(), 3));
+
+	const std::vector<char> Claimed = MakeBinary(EFacepipeData::Mesh, MakeVerticesContent(Id, 5, QuadPositions));
+	CHECK(ParseHeader(Claimed, Info) && !GetMeshVertices(Claimed, Info, Positions.data(), 5));
+
+	const std::vector<char> Ascii = MakeAscii("mesh|" + std::to_string(Id) + "|0,0,0,1,0,0,1,1,0,0,1,0.5,1,1,1");
+	CHECK(ParseHeader(Ascii, Info) && !GetMeshVertices(Ascii, Info, Positions.data(), 4));
+	CHECK(!ReadVertices(Cache, Ascii, Positions));
+}
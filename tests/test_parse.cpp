@@ -0,0 +1,223 @@
+#include "tests.h"
+#include "net/facepipe.h"
+#include "net/facepipe_view.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+
+using namespace FacePipe;
+
+static std::vector<char> ToMessage(const std::string& Text)
+{
+	return std::vector<char>(Text.begin(), Text.end());
+}
+
+// A MediaPipe face: 478 landmarks, the ARKit blendshapes plus _neutral and the facial transform
+struct AsciiFace
+{
+	std::vector<char> Landmarks;
+	std::vector<char> Blendshapes;
+	std::vector<char> Matrices;
+
+	AsciiFace()
+	{
+		char Value[32];
+
+		std::string Text = "a|facepipe|mediapipe|0,0,0|42.3312|l3d|640,480|";
+		for (size_t i = 0; i < 478 * 3; ++i)
+		{
+			std::snprintf(Value, sizeof(Value), (i == 0) ? "%.6f" : ",%.6f", LandmarkValue(i));
+			Text += Value;
+		}
+		Landmarks = ToMessage(Text);
+
+		Text = "a|facepipe|mediapipe|0,0,0|42.3312|bs|_neutral=1.2e-05";
+		for (size_t i = 0; i < ARKitBlendshapeCount; ++i)
+		{
+			std::snprintf(Value, sizeof(Value), "=%.4f", BlendshapeValue(i));
+			Text += "|" + std::string(ARKitBlendshapeNames[i]) + Value;
+		}
+		Blendshapes = ToMessage(Text);
+
+		Matrices = ToMessage("a|facepipe|mediapipe|0,0,0|42.3312|mat44|face=1,0,0,0,0,1,0,0,0,0,1,0,0.1,-0.2,-45.5,1");
+	}
+
+	static float LandmarkValue(size_t i) { return (float) ((i * 7919) % 1000) / 1000.0f - 0.5f; }
+	static float BlendshapeValue(size_t i) { return (float) i / ARKitBlendshapeCount; }
+};
+
+static void CheckFrame(const Frame& Parsed)
+{
+	CHECK(Parsed.ImageWidth == 640 && Parsed.ImageHeight == 480);
+	CHECK(Parsed.Landmarks.size() == 478 * 3);
+	for (size_t i = 0; i < Parsed.Landmarks.size(); ++i)
+		CHECK(std::fabs(Parsed.Landmarks[i] - AsciiFace::LandmarkValue(i)) < 1e-6f);
+
+	CHECK(Parsed.Blendshapes.ValidMask == (uint64_t(1) << ARKitBlendshapeCount) - 1);
+	for (size_t i = 0; i < ARKitBlendshapeCount; ++i)
+		CHECK(std::fabs(Parsed.Blendshapes.Values[i] - AsciiFace::BlendshapeValue(i)) < 1e-4f);
+	CHECK(Parsed.Blendshapes.Other.size() == 1 && Parsed.Blendshapes.Other.begin()->first == "_neutral");
+
+	auto Face = Parsed.Matrices.find("face");
+	CHECK(Face != Parsed.Matrices.end() && Face->second.size() == 16 && Face->second[14] == -45.5f);
+}
+
+FACEPIPE_TEST(AsciiParseDoesNotAllocate)
+{
+	const AsciiFace Datagrams;
+	Frame Parsed;
+	MessageInfo Info;
+
+	// The first packets grow the reused storage (landmark capacity, _neutral and face map entries, source name)
+	size_t SteadyStateAllocations = 0;
+	for (int Packet = 0; Packet < 100; ++Packet)
+	{
+		const size_t Before = Tests::AllocationCount();
+
+		CHECK(ParseHeader(Datagrams.Landmarks, Info) && Info.DataType == EFacepipeData::Landmarks3D);
+		CHECK(GetLandmarks(Datagrams.Landmarks, Info, Parsed.Landmarks, Parsed.ImageWidth, Parsed.ImageHeight));
+		CHECK(ParseHeader(Datagrams.Blendshapes, Info) && Info.DataType == EFacepipeData::Blendshapes);
+		CHECK(GetBlendshapes(Datagrams.Blendshapes, Info, Parsed.Blendshapes));
+		CHECK(ParseHeader(Datagrams.Matrices, Info) && Info.DataType == EFacepipeData::Matrices4x4);
+		CHECK(GetMatrices(Datagrams.Matrices, Info, Parsed.Matrices));
+
+		if (Packet > 0)
+			SteadyStateAllocations += Tests::AllocationCount() - Before;
+	}
+
+	CHECK(SteadyStateAllocations == 0);
+	CheckFrame(Parsed);
+}
+
+FACEPIPE_TEST(CachedHeaderParseDoesNotAllocate)
+{
+	const AsciiFace Datagrams;
+	Frame Parsed;
+	MessageInfo Info;
+	HeaderPrefixCache Cache;
+
+	size_t SteadyStateAllocations = 0;
+	for (int Packet = 0; Packet < 100; ++Packet)
+	{
+		const size_t Before = Tests::AllocationCount();
+
+		CHECK(ParseHeader(Datagrams.Landmarks, Info, Cache) && Info.Source == "mediapipe" && Info.Time == 42.3312);
+		CHECK(GetLandmarks(Datagrams.Landmarks, Info, Parsed.Landmarks, Parsed.ImageWidth, Parsed.ImageHeight));
+		CHECK(ParseHeader(Datagrams.Blendshapes, Info, Cache));
+		CHECK(GetBlendshapes(Datagrams.Blendshapes, Info, Parsed.Blendshapes));
+		CHECK(ParseHeader(Datagrams.Matrices, Info, Cache));
+		CHECK(GetMatrices(Datagrams.Matrices, Info, Parsed.Matrices));
+
+		if (Packet > 0)
+			SteadyStateAllocations += Tests::AllocationCount() - Before;
+	}
+
+	CHECK(SteadyStateAllocations == 0);
+	CheckFrame(Parsed);
+}
+
+FACEPIPE_TEST(ChangedHeaderPrefixMissesTheCache)
+{
+	HeaderPrefixCache Cache;
+	MessageInfo Cached, Uncached;
+
+	// Same length as the first prefix so that only the bytes tell them apart, then more prefixes than the cache has entries
+	const char* Headers[] =
+	{
+		"a|facepipe|mediapipe|0,0,0|",
+		"a|facepipe|mediapipe|0,0,1|",
+		"a|facepipe|mediapipf|0,0,0|",
+		"a|facepipe|mediapipe|1,2,0|",
+		"a|facepipe|arkit|0,0,0|",
+		"a|facepipe|mediapipe|0,0,12|",
+		"a|facepipe|mediapipe|0,0,0|",
+		"b|facepipe|mediapipe|0,0,0|",
+	};
+
+	for (int Round = 0; Round < 3; ++Round)
+	{
+		for (const char* Header : Headers)
+		{
+			const std::vector<char> Message = ToMessage(std::string(Header) + "42.3312,7|bs|jawOpen=0.5");
+			const bool bCached = ParseHeader(Message, Cached, Cache);
+			const bool bUncached = ParseHeader(Message, Uncached);
+
+			const bool bSame = bCached == bUncached && Cached.Source == Uncached.Source && Cached.Scene == Uncached.Scene && Cached.Camera == Uncached.Camera
+				&& Cached.Subject == Uncached.Subject && Cached.DatagramType == Uncached.DatagramType && Cached.DataType == Uncached.DataType
+				&& Cached.Time == Uncached.Time && Cached.Sequence == Uncached.Sequence && Cached.ContentView.b == Uncached.ContentView.b;
+			if (!bSame)
+				std::printf("    %s parsed differently with the cache\n", Header);
+			CHECK(bSame);
+		}
+	}
+
+	// A subject that changes between two datagrams of the same source
+	const std::vector<char> First = ToMessage("a|facepipe|mediapipe|0,0,0|1.0|bs|jawOpen=0.5");
+	const std::vector<char> Second = ToMessage("a|facepipe|mediapipe|0,0,3|1.0|bs|jawOpen=0.5");
+	CHECK(ParseHeader(First, Cached, Cache) && Cached.Subject == 0);
+	CHECK(ParseHeader(Second, Cached, Cache) && Cached.Subject == 3 && Cached.Source == "mediapipe");
+	CHECK(ParseHeader(First, Cached, Cache) && Cached.Subject == 0);
+}
+
+FACEPIPE_TEST(FrameViewReadsLikeTheGetFunctions)
+{
+	const AsciiFace Datagrams;
+	Frame Parsed;
+	MessageInfo Info;
+	FrameView View;
+
+	CHECK(ParseHeader(Datagrams.Landmarks, Info) && GetLandmarks(Datagrams.Landmarks, Info, Parsed.Landmarks, Parsed.ImageWidth, Parsed.ImageHeight));
+	CHECK(View.Bind(Datagrams.Landmarks, Info) && View.GetImageWidth() == 640 && View.GetImageHeight() == 480);
+	CHECK(std::equal(View.GetLandmarks().begin(), View.GetLandmarks().end(), Parsed.Landmarks.begin(), Parsed.Landmarks.end()));
+
+	CHECK(ParseHeader(Datagrams.Blendshapes, Info) && GetBlendshapes(Datagrams.Blendshapes, Info, Parsed.Blendshapes));
+	CHECK(View.Bind(Datagrams.Blendshapes, Info) && View.GetCount() == ARKitBlendshapeCount + 1);
+	for (size_t i = 0; i < ARKitBlendshapeCount; ++i)
+	{
+		std::span<const float> Value;
+		CHECK(View.FindValues(ARKitBlendshapeNames[i], Value) && Value.size() == 1 && Value[0] == Parsed.Blendshapes.Values[i]);
+	}
+
+	std::span<const float> Face;
+	CHECK(ParseHeader(Datagrams.Matrices, Info) && GetMatrices(Datagrams.Matrices, Info, Parsed.Matrices));
+	CHECK(View.Bind(Datagrams.Matrices, Info) && View.FindValues("face", Face));
+	CHECK(std::equal(Face.begin(), Face.end(), Parsed.Matrices["face"].begin(), Parsed.Matrices["face"].end()));
+}
+
+FACEPIPE_TEST(ParsesNumbersInPlace)
+{
+	const std::vector<char> Message = ToMessage("+1.5|-2|1e-3|abc|7x|");
+
+	VectorView Token(0);
+	CHECK(Token.NextSubstring(Message, '|', Message.size()) && Token.ParseDouble(Message) == 1.5);
+	CHECK(Token.NextSubstring(Message, '|', Message.size()) && Token.ParseInt(Message) == -2);
+	CHECK(Token.NextSubstring(Message, '|', Message.size()) && Token.ParseFloat(Message) == 1e-3f);
+
+	// Anything that is not entirely a number parses as 0, like strtod on an empty string did
+	CHECK(Token.NextSubstring(Message, '|', Message.size()) && Token.ParseFloat(Message) == 0.0f);
+	CHECK(Token.NextSubstring(Message, '|', Message.size()) && Token.ParseInt(Message) == 0);
+}
+
+FACEPIPE_BENCHMARK(CachedHeaderParse)
+{
+	const AsciiFace Datagrams;
+	const std::vector<char>* Messages[] = { &Datagrams.Landmarks, &Datagrams.Blendshapes, &Datagrams.Matrices };
+	const int Packets = 300000;
+	MessageInfo Info;
+
+	for (bool bCached : { false, true })
+	{
+		HeaderPrefixCache Cache;
+		const auto Start = std::chrono::steady_clock::now();
+		for (int i = 0; i < Packets; ++i)
+		{
+			const std::vector<char>& Message = *Messages[i % 3];
+			CHECK(bCached ? ParseHeader(Message, Info, Cache) : ParseHeader(Message, Info));
+		}
+		const double Seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - Start).count();
+
+		std::printf("    %-9s %7.1f ns per header\n", bCached ? "cached" : "uncached", Seconds * 1e9 / Packets);
+	}
+}
@@ -0,0 +1,187 @@
+#include "tests.h"
+#include "net/facepipe_encode.h"
+#include "net/facepipe_pca.h"
+
+#include <cmath>
+#include <cstring>
+#include <string>
+
+using namespace FacePipe;
+
+static char Buffer[SafeEncodeSize];
+
+// Every channel at 0.5, the two components move jawOpen and mouthClose on their own
+struct TestBasis
+{
+	std::vector<float> Mean = std::vector<float>(ARKitBlendshapeCount, 0.5f);
+	std::vector<float> Components = std::vector<float>(2 * ARKitBlendshapeCount, 0.0f);
+	size_t Jaw = (size_t) FindARKitBlendshape("jawOpen");
+	size_t Close = (size_t) FindARKitBlendshape("mouthClose");
+	uint32_t Id = 0;
+
+	TestBasis()
+	{
+		Components[Jaw] = 1.0f;
+		Components[ARKitBlendshapeCount + Close] = 1.0f;
+		Id = HashExpressionBasis(2, Mean, Components);
+	}
+};
+
+static MessageInfo MakeInfo(EDatagramType DatagramType)
+{
+	MessageInfo Info;
+	Info.DatagramType = DatagramType;
+	Info.Source = "mediapipe";
+	return Info;
+}
+
+static std::vector<char> EncodeBasis(EDatagramType DatagramType, const TestBasis& Basis)
+{
+	const size_t Size = EncodeExpressionBasis(Buffer, MakeInfo(DatagramType), Basis.Id, 2, Basis.Mean, Basis.Components);
+	return std::vector<char>(Buffer, Buffer + Size);
+}
+
+static std::vector<char> EncodeCoefficients(EDatagramType DatagramType, uint32_t BasisId, std::span<const float> Coefficients)
+{
+	const size_t Size = EncodeExpressionCoefficients(Buffer, MakeInfo(DatagramType), BasisId, Coefficients);
+	return std::vector<char>(Buffer, Buffer + Size);
+}
+
+static bool UpdateBasis(ExpressionBasisCache& Cache, const std::vector<char>& Message)
+{
+	MessageInfo Info;
+	return ParseHeader(Message, Info) && Cache.Update(Message, Info);
+}
+
+// Decodes without a cache, a cache would skip the content of a basis id it already holds
+static bool DecodeBasis(const std::vector<char>& Message)
+{
+	MessageInfo Info;
+	ExpressionBasis Basis;
+	return ParseHeader(Message, Info) && GetExpressionBasis(Message, Info, Basis);
+}
+
+static bool ReadCoefficients(ExpressionBasisCache& Cache, const std::vector<char>& Message, BlendshapeFrame& OutBlendshapes)
+{
+	MessageInfo Info;
+	return ParseHeader(Message, Info) && GetExpressionCoefficients(Message, Info, Cache, OutBlendshapes);
+}
+
+FACEPIPE_TEST(ExpressionCoefficientsReconstructBlendshapes)
+{
+	const TestBasis Basis;
+
+	for (EDatagramType DatagramType : { EDatagramType::ASCII, EDatagramType::Bytes })
+	{
+		ExpressionBasisCache Cache;
+		CHECK(UpdateBasis(Cache, EncodeBasis(DatagramType, Basis)));
+
+		const ExpressionBasis* Cached = Cache.Find(Basis.Id);
+		CHECK(Cached && Cached->ComponentCount == 2 && Cached->Mean == Basis.Mean && Cached->Components == Basis.Components);
+
+		const float Coefficients[] = { 0.25f, -0.25f };
+		BlendshapeFrame Blendshapes;
+		CHECK(ReadCoefficients(Cache, EncodeCoefficients(DatagramType, Basis.Id, Coefficients), Blendshapes));
+		CHECK(Blendshapes.ValidMask == (uint64_t(1) << ARKitBlendshapeCount) - 1);
+		CHECK(Blendshapes.Values[Basis.Jaw] == 0.75f && Blendshapes.Values[Basis.Close] == 0.25f && Blendshapes.Values[ARKitBlendshapeCount - 1] == 0.5f);
+
+		// Reconstructed values stay within 0-1
+		const float Extreme[] = { 1.0f, -1.0f };
+		CHECK(ReadCoefficients(Cache, EncodeCoefficients(DatagramType, Basis.Id, Extreme), Blendshapes));
+		CHECK(Blendshapes.Values[Basis.Jaw] == 1.0f && Blendshapes.Values[Basis.Close] == 0.0f);
+
+		CHECK(Cache.UnknownBasisCount == 0);
+	}
+
+	// The sender side projection gives back the coefficients
+	ExpressionBasisCache Cache;
+	CHECK(UpdateBasis(Cache, EncodeBasis(EDatagramType::Bytes, Basis)));
+
+	BlendshapeFrame Blendshapes;
+	Blendshapes.Set(Basis.Jaw, 0.9f);
+	Blendshapes.Set(Basis.Close, 0.5f);
+
+	float Projected[2] = {};
+	ProjectOntoBasis(*Cache.Find(Basis.Id), Blendshapes, Projected);
+	CHECK(std::abs(Projected[0] - 0.4f) < 1e-6f && Projected[1] == 0.0f);
+}
+
+FACEPIPE_TEST(UnknownExpressionBasesAreCounted)
+{
+	const TestBasis Basis;
+	const float Coefficients[] = { 0.25f, -0.25f };
+
+	ExpressionBasisCache Cache;
+	BlendshapeFrame Blendshapes;
+	CHECK(!ReadCoefficients(Cache, EncodeCoefficients(EDatagramType::Bytes, Basis.Id, Coefficients), Blendshapes));
+	CHECK(!ReadCoefficients(Cache, EncodeCoefficients(EDatagramType::ASCII, Basis.Id, Coefficients), Blendshapes));
+	CHECK(Cache.UnknownBasisCount == 2 && Blendshapes.ValidMask == 0);
+
+	// A basis whose id does not match its content is not cached
+	TestBasis Mismatch;
+	Mismatch.Id = Basis.Id + 1;
+	CHECK(!UpdateBasis(Cache, EncodeBasis(EDatagramType::Bytes, Mismatch)));
+	CHECK(!UpdateBasis(Cache, EncodeBasis(EDatagramType::ASCII, Mismatch)));
+	CHECK(Cache.Find(Mismatch.Id) == nullptr);
+
+	CHECK(UpdateBasis(Cache, EncodeBasis(EDatagramType::Bytes, Basis)));
+	CHECK(ReadCoefficients(Cache, EncodeCoefficients(EDatagramType::Bytes, Basis.Id, Coefficients), Blendshapes));
+	CHECK(Cache.UnknownBasisCount == 2);
+}
+
+FACEPIPE_TEST(ExpressionCountsBeyondTheDeclaredSizeFail)
+{
+	const TestBasis Basis;
+
+	ExpressionBasisCache Cache;
+	CHECK(UpdateBasis(Cache, EncodeBasis(EDatagramType::Bytes, Basis)));
+
+	// More or fewer coefficients than the basis has components
+	const float Three[] = { 0.25f, -0.25f, 0.1f };
+	BlendshapeFrame Blendshapes;
+	for (EDatagramType DatagramType : { EDatagramType::ASCII, EDatagramType::Bytes })
+	{
+		CHECK(!ReadCoefficients(Cache, EncodeCoefficients(DatagramType, Basis.Id, Three), Blendshapes));
+		CHECK(!ReadCoefficients(Cache, EncodeCoefficients(DatagramType, Basis.Id, std::span<const float>(Three, 1)), Blendshapes));
+	}
+	CHECK(Blendshapes.ValidMask == 0);
+
+	// Binary coefficients that claim more values than the content holds
+	std::vector<char> Claimed = EncodeCoefficients(EDatagramType::Bytes, Basis.Id, Three);
+	Claimed.resize(Claimed.size() - sizeof(float));
+	CHECK(!ReadCoefficients(Cache, Claimed, Blendshapes));
+
+	// Component and channel counts of a binary basis: id, component count, channel count, reserved
+	const std::vector<char> Valid = EncodeBasis(EDatagramType::Bytes, Basis);
+	MessageInfo Info;
+	CHECK(ParseHeader(Valid, Info) && DecodeBasis(Valid));
+
+	auto SetCount = [&](size_t Slot, uint32_t Count)
+	{
+		std::vector<char> Changed = Valid;
+		std::memcpy(Changed.data() + Info.ContentView.b + Slot * sizeof(uint32_t), &Count, sizeof(Count));
+		return Changed;
+	};
+
+	CHECK(!DecodeBasis(SetCount(1, 3)));
+	CHECK(!DecodeBasis(SetCount(1, 0)));
+	CHECK(!DecodeBasis(SetCount(1, ARKitBlendshapeCount + 1)));
+	CHECK(!DecodeBasis(SetCount(1, UINT32_MAX)));
+	CHECK(!DecodeBasis(SetCount(2, ARKitBlendshapeCount + 1)));
+	CHECK(!DecodeBasis(std::vector<char>(Valid.begin(), Valid.end() - 1)));
+
+	// ASCII bases with a component count that does not match the rows
+	const size_t Size = EncodeExpressionBasis(Buffer, MakeInfo(EDatagramType::ASCII), Basis.Id, 2, Basis.Mean, Basis.Components);
+	std::string Ascii(Buffer, Size);
+	CHECK(DecodeBasis(std::vector<char>(Ascii.begin(), Ascii.end())));
+
+	const std::string Field = "|" + std::to_string(Basis.Id) + "|2|";
+	const size_t FieldStart = Ascii.find(Field);
+	CHECK(FieldStart != std::string::npos);
+	for (const char* Count : { "3", "53" })
+	{
+		std::string Changed = Ascii;
+		Changed.replace(FieldStart, Field.size(), "|" + std::to_string(Basis.Id) + "|" + Count + "|");
+		CHECK(!DecodeBasis(std::vector<char>(Changed.begin(), Changed.end())));
+	}
+}
@@ -0,0 +1,80 @@
+#include "tests.h"
+#include "net/facepipe_sequence.h"
+
+using namespace FacePipe;
+
+static MessageInfo Numbered(uint32_t Sequence, double Time)
+{
+	MessageInfo Info;
+	Info.Source = "mediapipe";
+	Info.DataType = EFacepipeData::Blendshapes;
+	Info.bHasSequence = true;
+	Info.Sequence = Sequence;
+	Info.Time = Time;
+	return Info;
+}
+
+FACEPIPE_TEST(SequenceDropsDuplicatesAndLateDatagrams)
+{
+	SequenceTracker Tracker;
+	int64_t LostChange = 0;
+
+	CHECK(Tracker.Accept(Numbered(10, 1.0)));
+	CHECK(Tracker.Accept(Numbered(13, 1.05), LostChange) && LostChange == 2);
+	CHECK(!Tracker.Accept(Numbered(13, 1.05)));
+	CHECK(!Tracker.Accept(Numbered(11, 1.016), LostChange) && LostChange == -1);
+
+	// Wrapping around 2^32 is a step forward
+	SequenceTracker Wrapping;
+	CHECK(Wrapping.Accept(Numbered(0xFFFFFFFFu, 1.0)));
+	CHECK(Wrapping.Accept(Numbered(0, 1.016), LostChange) && LostChange == 0);
+
+	const SequenceStats Totals = Tracker.GetTotals();
+	CHECK(Totals.Received == 4 && Totals.Lost == 1 && Totals.Duplicates == 1 && Totals.Reordered == 1 && Totals.Restarts == 0);
+}
+
+FACEPIPE_TEST(SequenceDetectsEarlyRestarts)
+{
+	// A source restarted after 100 datagrams, long before RestartDistance
+	SequenceTracker AppClock;
+	for (uint32_t i = 0; i < 100; ++i)
+		CHECK(AppClock.Accept(Numbered(i, 5.0 + i / 60.0)));
+
+	// Its clock started over too
+	CHECK(AppClock.Accept(Numbered(0, 0.1)));
+	CHECK(AppClock.Accept(Numbered(1, 0.116)));
+	CHECK(AppClock.GetTotals().Restarts == 1 && AppClock.GetTotals().Reordered == 0);
+
+	// Wall clock time keeps going while the numbers start over
+	SequenceTracker WallClock;
+	for (uint32_t i = 0; i < 100; ++i)
+		CHECK(WallClock.Accept(Numbered(i, 1700000000.0 + i / 60.0)));
+
+	CHECK(WallClock.Accept(Numbered(0, 1700000010.0)));
+	CHECK(WallClock.Accept(Numbered(1, 1700000010.016)));
+	CHECK(WallClock.GetTotals().Restarts == 1 && WallClock.GetTotals().Lost == 0);
+}
+
+FACEPIPE_TEST(SequenceCapsTheLossOfOneJump)
+{
+	SequenceTracker Tracker;
+	int64_t LostChange = 0;
+
+	CHECK(Tracker.Accept(Numbered(5, 1.0)));
+	CHECK(Tracker.Accept(Numbered(5 + SequenceTracker::RestartDistance, 2.0), LostChange) && LostChange == SequenceTracker::RestartDistance - 1);
+	CHECK(Tracker.Accept(Numbered(3000000000u, 3.0), LostChange) && LostChange == 0);
+
+	const SequenceStats Totals = Tracker.GetTotals();
+	CHECK(Totals.Lost == SequenceTracker::RestartDistance - 1 && Totals.Restarts == 1);
+}
+
+FACEPIPE_TEST(SequenceWithoutTimeRestartsByDistance)
+{
+	SequenceTracker Tracker;
+	for (uint32_t i = 0; i < 2000; ++i)
+		CHECK(Tracker.Accept(Numbered(i, 0.0)));
+
+	CHECK(!Tracker.Accept(Numbered(1900, 0.0)));
+	CHECK(Tracker.Accept(Numbered(0, 0.0)));
+	CHECK(Tracker.GetTotals().Restarts == 1 && Tracker.GetTotals().Reordered == 1);
+}
@@ -0,0 +1,112 @@
+#include "tests.h"
+#include "net/facepipe.h"
+
+#include <charconv>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <random>
+
+using namespace FacePipe;
+
+// What VectorView::ParseFloat did before the fast path, the fast path has to give the same float for every token
+static float FromChars(const std::string& Token)
+{
+	const char* First = Token.data();
+	const char* Last = Token.data() + Token.size();
+	if (First < Last && *First == '+')
+		++First;
+
+	float Value = 0.0f;
+	std::from_chars_result Result = std::from_chars(First, Last, Value);
+	return (Result.ec != std::errc() || Result.ptr != Last) ? 0.0f : Value;
+}
+
+static bool SameFloat(float A, float B)
+{
+	return std::memcmp(&A, &B, sizeof(float)) == 0; // tells -0 from 0
+}
+
+static bool ParsesLikeFromChars(const std::string& Token)
+{
+	return SameFloat(ParseFloatToken(Token.data(), Token.data() + Token.size()), FromChars(Token));
+}
+
+FACEPIPE_TEST(FloatTokensMatchFromChars)
+{
+	const char* Tokens[] = {
+		"0", "-0", "+0", "1", "-12.5", "0.51234567", "0.5123456716537476", "123456789.123456789", "9007199254740993",
+		"0.0000000000000000000001", "0.00000000000000000000001", "1e-3", "-2.5E+2", "inf", "nan", "", "-", ".", "1.", ".5",
+		"1.2.3", "0x10", "1,5", " 1", "99999999999999999999999",
+		// Rounding the decimal to double and then to float gives a different float for these
+		"2.664079785346985", "0.07525843754410744", "11.00390100479126", "0.05793991498649120", "0.7003307640552521",
+	};
+
+	for (const char* Token : Tokens)
+	{
+		if (!ParsesLikeFromChars(Token))
+			std::printf("    token \"%s\"\n", Token);
+		CHECK(ParsesLikeFromChars(Token));
+	}
+}
+
+FACEPIPE_TEST(RandomFloatTokensMatchFromChars)
+{
+	std::mt19937_64 Random(7);
+	size_t Mismatches = 0;
+	char Token[64];
+
+	for (int i = 0; i < 2000000; ++i)
+	{
+		// Landmarks as Python prints them (the double of a float32) and fixed precision values near float midpoints
+		float Value;
+		const uint32_t Bits = 0x30000000u + (uint32_t) (Random() % 0x1A000000u);
+		std::memcpy(&Value, &Bits, sizeof(Value));
+
+		const double Midpoint = ((double) Value + (double) std::nextafter(Value, INFINITY)) / 2.0;
+		const int Decimals = 1 + (int) (Random() % 20);
+		const bool bNegative = Random() % 2;
+
+		int Length = 0;
+		switch (i % 3)
+		{
+		case 0: Length = std::snprintf(Token, sizeof(Token), "%.17g", bNegative ? -(double) Value : (double) Value); break;
+		case 1: Length = std::snprintf(Token, sizeof(Token), "%.*f", Decimals, bNegative ? -Midpoint : Midpoint); break;
+		default: Length = std::snprintf(Token, sizeof(Token), "%.*f", Decimals, (double) (Random() % 100000000) / 1e4); break;
+		}
+
+		if (!ParsesLikeFromChars(std::string(Token, Length)) && ++Mismatches <= 10)
+			std::printf("    token \"%s\"\n", Token);
+	}
+
+	CHECK(Mismatches == 0);
+}
+
+FACEPIPE_TEST(FloatListTokensMatchParseArray)
+{
+	// ParseArray<float> takes the vectorized ParseFloatList, the other types still tokenize with NextSubstring
+	const char* Lists[] = {
+		"1,2,3", "1,2,", "1,2,,", ",1", ",,1", "1,,2", ",", ",,", "0.5", "12", "-1,-2,-3,",
+		"0.1,0.2,0.3,0.4,0.5,0.6,0.7,0.8,0.9,1.0,1.1,1.2,1.3,1.4,1.5,1.6,", // beyond one 32 byte block
+	};
+
+	for (const char* List : Lists)
+	{
+		const std::vector<char> Message(List, List + std::strlen(List));
+		VectorView ListView(0, Message.size());
+
+		std::vector<float> Floats;
+		ListView.ParseArray(Message, Floats);
+
+		std::vector<double> Doubles;
+		VectorView(0, Message.size()).ParseArray(Message, Doubles);
+
+		bool bSame = Floats.size() == Doubles.size();
+		for (size_t i = 0; bSame && i < Floats.size(); ++i)
+			bSame = Floats[i] == (float) Doubles[i];
+
+		if (!bSame)
+			std::printf("    list \"%s\" has %zu floats and %zu doubles\n", List, Floats.size(), Doubles.size());
+		CHECK(bSame);
+	}
+}
@@ -0,0 +1,82 @@
+#include "tests.h"
+#include "net/facepipe_encode.h"
+#include "net/facepipe_sparse.h"
+
+#include <cstdio>
+#include <cstring>
+#include <string>
+
+using namespace FacePipe;
+
+static char Buffer[SafeEncodeSize];
+
+// Every ARKit blendshape at 0.5, updates that were merged show as other values
+static BlendshapeFrame MakeBlendshapes()
+{
+	BlendshapeFrame Blendshapes;
+	for (size_t i = 0; i < ARKitBlendshapeCount; ++i)
+		Blendshapes.Set(i, 0.5f);
+	return Blendshapes;
+}
+
+static bool ApplyUpdates(const std::vector<char>& Message, BlendshapeFrame& InOutBlendshapes)
+{
+	MessageInfo Info;
+	return ParseHeader(Message, Info) && GetBlendshapeUpdates(Message, Info, InOutBlendshapes);
+}
+
+static bool ApplyUpdates(const std::string& Text, BlendshapeFrame& InOutBlendshapes)
+{
+	return ApplyUpdates(std::vector<char>(Text.begin(), Text.end()), InOutBlendshapes);
+}
+
+static bool IsUnchanged(const BlendshapeFrame& Blendshapes)
+{
+	const BlendshapeFrame Original = MakeBlendshapes();
+	return Blendshapes.ValidMask == Original.ValidMask && std::memcmp(Blendshapes.Values, Original.Values, sizeof(Original.Values)) == 0;
+}
+
+FACEPIPE_TEST(AsciiUpdatesMergeIntoBlendshapes)
+{
+	BlendshapeFrame Blendshapes = MakeBlendshapes();
+	CHECK(ApplyUpdates("a|facepipe|mediapipe|0,0,0|42.3312|bsu|17=0.25|9=0.1", Blendshapes));
+	CHECK(Blendshapes.Values[17] == 0.25f && Blendshapes.Values[9] == 0.1f);
+	CHECK(Blendshapes.Values[0] == 0.5f && Blendshapes.Values[ARKitBlendshapeCount - 1] == 0.5f);
+}
+
+FACEPIPE_TEST(MalformedUpdatesFailWithoutMerging)
+{
+	// The valid tuple in front of the malformed one must not be merged either
+	const char* Malformed[] =
+	{
+		"17x=0.25",		// index does not parse completely
+		"=0.25",		// no index
+		"x=0.25",
+		"-1=0.25",
+		"1.5=0.25",
+		"52=0.25",		// ARKitBlendshapeCount
+		"4294967313=0.25", // 2^32 + 17
+		"17",			// no value
+		"17=",
+	};
+
+	for (const char* Tuple : Malformed)
+	{
+		BlendshapeFrame Blendshapes = MakeBlendshapes();
+		const bool bApplied = ApplyUpdates(std::string("a|facepipe|mediapipe|0,0,0|42.3312|bsu|9=0.1|") + Tuple, Blendshapes);
+		if (bApplied || !IsUnchanged(Blendshapes))
+			std::printf("    '%s' was applied\n", Tuple);
+		CHECK(!bApplied && IsUnchanged(Blendshapes));
+	}
+
+	// Binary updates reject indices outside of the ARKit set the same way
+	MessageInfo Info;
+	Info.DatagramType = EDatagramType::Bytes;
+	const uint8_t Indices[] = { 9, 60 };
+	const float Values[] = { 0.1f, 0.25f };
+	const size_t Size = EncodeBlendshapeUpdates(Buffer, Info, Indices, Values);
+	CHECK(Size > 0);
+
+	BlendshapeFrame Blendshapes = MakeBlendshapes();
+	CHECK(!ApplyUpdates(std::vector<char>(Buffer, Buffer + Size), Blendshapes) && IsUnchanged(Blendshapes));
+}
@@ -0,0 +1,94 @@
+#include "tests.h"
+
+#include <atomic>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <new>
+#include <vector>
+
+static std::atomic<size_t> Allocations = 0;
+
+// Replacing the global operator new counts every allocation, including those of the standard library
+void* operator new(size_t Size)
+{
+	++Allocations;
+	if (void* Memory = std::malloc(Size ? Size : 1))
+		return Memory;
+
+	throw std::bad_alloc();
+}
+
+void operator delete(void* Memory) noexcept
+{
+	std::free(Memory);
+}
+
+void operator delete(void* Memory, size_t) noexcept
+{
+	std::free(Memory);
+}
+
+namespace Tests
+{
+	struct Entry
+	{
+		const char* Name = nullptr;
+		Function Body = nullptr;
+		bool bBenchmark = false;
+	};
+
+	// Function local so that it exists before the registrations of the other translation units use it
+	static std::vector<Entry>& GetEntries()
+	{
+		static std::vector<Entry> Entries;
+		return Entries;
+	}
+
+	static size_t FailedChecks = 0;
+
+	Registration::Registration(const char* Name, Function Body, bool bBenchmark)
+	{
+		GetEntries().push_back({ Name, Body, bBenchmark });
+	}
+
+	void Fail(const char* File, int Line, const char* Expression)
+	{
+		++FailedChecks;
+		std::printf("    %s(%d): CHECK(%s) failed\n", File, Line, Expression);
+	}
+
+	size_t AllocationCount()
+	{
+		return Allocations;
+	}
+}
+
+int main(int argc, char* args[])
+{
+	bool bBenchmarks = false;
+	for (int i = 1; i < argc; ++i)
+	{
+		if (std::strcmp(args[i], "--bench") == 0)
+			bBenchmarks = true;
+	}
+
+	size_t FailedTests = 0;
+	size_t Ran = 0;
+	for (const Tests::Entry& Test : Tests::GetEntries())
+	{
+		if (Test.bBenchmark && !bBenchmarks)
+			continue;
+
+		const size_t FailedBefore = Tests::FailedChecks;
+		std::printf("%s\n", Test.Name);
+		Test.Body();
+		++Ran;
+
+		if (Tests::FailedChecks != FailedBefore)
+			++FailedTests;
+	}
+
+	std::printf("%zu of %zu tests passed, %zu checks failed\n", Ran - FailedTests, Ran, Tests::FailedChecks);
+	return (int) Tests::FailedChecks;
+}
@@ -0,0 +1,45 @@
+#pragma once
+
+#include <stddef.h>
+
+/*
+* Tests of the FacePipe protocol (source/net), built as the FacePipeTests project by premake5.
+*
+*	binaries/tests				runs every test, the exit code is the number of failed checks
+*	binaries/tests --bench		runs the benchmarks as well
+*
+* Tests register themselves, a new test_*.cpp only has to be added to the folder:
+*
+*	FACEPIPE_TEST(ParsesLandmarks)
+*	{
+*		CHECK(FacePipe::ParseHeader(Message, Info));
+*	}
+*/
+
+namespace Tests
+{
+	using Function = void(*)();
+
+	struct Registration
+	{
+		Registration(const char* Name, Function Body, bool bBenchmark);
+	};
+
+	void Fail(const char* File, int Line, const char* Expression);
+
+	// Number of operator new calls since the program started, every allocation of the test process is counted
+	size_t AllocationCount();
+}
+
+#define FACEPIPE_TEST(Name) \
+	static void Name(); \
+	static Tests::Registration Name##Registration(#Name, Name, false); \
+	static void Name()
+
+// Benchmarks print their results and only run with --bench, they can CHECK like tests
+#define FACEPIPE_BENCHMARK(Name) \
+	static void Name(); \
+	static Tests::Registration Name##Registration(#Name, Name, true); \
+	static void Name()
+
+#define CHECK(Expression) do { if (!(Expression)) Tests::Fail(__FILE__, __LINE__, #Expression); } while (0)